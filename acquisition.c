@@ -0,0 +1,363 @@
+/*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*/
+
+#define _GNU_SOURCE
+
+#include "acquisition.h"
+#include "adc_event.h"
+#include "adc_metrics.h"
+#include "adc_rs485_decoder.h"
+#include "adc_rs485_encoder.h"
+#include "adc_rs485_simd.h"
+#include "latency.h"
+#include "serial.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+
+/** Size in bytes of the buffer used to read a serial port */
+#define READ_BUFFER_LENGTH 4096
+
+/** Maximum number of messages decoded at once */
+#define MSG_BUFFER_LENGTH 512
+
+/** Maximum number of events returned by one epoll_wait() */
+#define MAX_EVENTS 16
+
+/** epoll data identifying the stop eventfd, the ports are identified by their index */
+#define STOP_EVENT UINT32_MAX
+
+/** Worker thread of an acquisition engine */
+typedef struct
+{
+    acquisition_t *acquisition;
+    uint32_t index;
+    pthread_t thread;
+} acquisition_worker_t;
+
+/**
+ * Record the latencies of the messages of one batch. The last byte read is assumed received when
+ * read() returned, so the carriage return of a message has been received one byte duration earlier
+ * per byte read after it, and its start of header one byte duration earlier per byte of the frame.
+ * @param[in,out]   port        Port read.
+ * @param[in]       msgs        Messages decoded.
+ * @param[in]       ends        Offset of the byte that completed every message.
+ * @param[in]       count       Number of messages decoded.
+ * @param[in]       remaining   Number of bytes of the read from the offset 0 of ends to its end.
+ * @param[in]       read_ns     Time at which read() returned.
+ */
+static void acquisition_trace(acquisition_port_t *port, const adc_rs485_msg_t msgs[], const size_t ends[], size_t count,
+                              size_t remaining, uint64_t read_ns)
+{
+    uint64_t byte_ns = latency_byte_ns(port->serial.baudrate);
+    uint64_t decoded_ns = adc_event_now_ns();
+    uint64_t data_count = 0;
+    uint64_t status_count = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        // The length of a corrupted message is unknown, its frame is not traced
+        data_count += (msgs[i].msg_type == RS485_RETURNED_DATA) ? 1u : 0u;
+        status_count += ((msgs[i].msg_type == RS485_RETURNED_STATUS_GEN) || (msgs[i].msg_type == RS485_RETURNED_STATUS_HTR)) ? 1u : 0u;
+        latency_record(&port->latency[LATENCY_STAGE_DRIVER], (uint64_t)(remaining - ends[i] - 1u) * byte_ns);
+    }
+    latency_record_n(&port->latency[LATENCY_STAGE_FRAME], ADC_RS485_DATA_FRAME_LENGTH * byte_ns, data_count);
+    latency_record_n(&port->latency[LATENCY_STAGE_FRAME], ADC_RS485_STATUS_FRAME_LENGTH * byte_ns, status_count);
+    latency_record_n(&port->latency[LATENCY_STAGE_DECODE], decoded_ns - read_ns, count);
+}
+
+/**
+ * Read all bytes available on a serial port and decode them.
+ * @param[in,out]   acquisition     Acquisition engine.
+ * @param[in]       port_id         Index of the port to read.
+ * @return false if the port can't be read anymore, true otherwise.
+ */
+static bool acquisition_drain(acquisition_t *acquisition, uint32_t port_id)
+{
+    acquisition_port_t *port = &acquisition->ports[port_id];
+    uint8_t data[READ_BUFFER_LENGTH];
+    adc_rs485_msg_t msgs[MSG_BUFFER_LENGTH];
+    size_t ends[MSG_BUFFER_LENGTH];
+
+    for (;;)
+    {
+        ssize_t cnt = read(port->serial.fd, data, sizeof(data));
+        uint64_t read_ns = (port->latency != NULL) ? adc_event_now_ns() : 0;
+        if (cnt < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            // Nothing more to read, or a real error
+            return (errno == EAGAIN) || (errno == EWOULDBLOCK);
+        }
+        if (cnt == 0)
+        {
+            // End of file, the device is gone
+            return false;
+        }
+
+        if (acquisition->raw_handler != NULL)
+        {
+            acquisition->raw_handler(port_id, data, (size_t)cnt, acquisition->user);
+        }
+
+        size_t length = (size_t)cnt;
+        const uint8_t *pos = data;
+        while (length > 0)
+        {
+            size_t consumed = 0;
+            size_t count;
+            if (port->latency != NULL)
+            {
+                // Same batches, with the position of every message in the read
+                count = adc_rs485_decoder_decode_buffer_simd_ends(&port->decoder, pos, length, msgs, ends, MSG_BUFFER_LENGTH,
+                                                                  &consumed);
+                acquisition_trace(port, msgs, ends, count, length, read_ns);
+            }
+            else
+            {
+                count = adc_rs485_decoder_decode_buffer_simd(&port->decoder, pos, length, msgs, MSG_BUFFER_LENGTH, &consumed);
+            }
+            if (count > 0)
+            {
+                adc_metrics_count_msgs(&port->metrics, msgs, count);
+                acquisition->handler(port_id, msgs, count, acquisition->user);
+            }
+            pos += consumed;
+            length -= consumed;
+        }
+        adc_metrics_count_bytes(&port->metrics, &port->decoder, (size_t)cnt);
+
+        if ((size_t)cnt < sizeof(data))
+        {
+            // The driver has been emptied
+            return true;
+        }
+    }
+}
+
+/** Pin the calling thread to one CPU, chosen from the index of the worker */
+static void acquisition_pin_thread(uint32_t index)
+{
+    long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpu_count > 0)
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(index % (uint32_t)cpu_count, &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+}
+
+static void *acquisition_worker(void *arg)
+{
+    acquisition_worker_t *worker = (acquisition_worker_t *)arg;
+    acquisition_t *acquisition = worker->acquisition;
+    struct epoll_event events[MAX_EVENTS];
+    struct epoll_event event;
+    bool running = true;
+
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0)
+    {
+        acquisition_stop(acquisition);
+        return NULL;
+    }
+
+    event.events = EPOLLIN;
+    event.data.u32 = STOP_EVENT;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, acquisition->stop_fd, &event);
+
+    // The ports are distributed round-robin over the workers
+    for (uint32_t i = worker->index; i < acquisition->port_count; i += acquisition->thread_count)
+    {
+        int fd = acquisition->ports[i].serial.fd;
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+        event.events = EPOLLIN;
+        event.data.u32 = i;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    }
+
+    if (acquisition->pin_threads)
+    {
+        acquisition_pin_thread(worker->index);
+    }
+
+    while (running)
+    {
+        int count = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+        if ((count < 0) && (errno != EINTR))
+        {
+            break;
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            uint32_t id = events[i].data.u32;
+            if (id == STOP_EVENT)
+            {
+                // The eventfd is never read, so it wakes all workers
+                running = false;
+            }
+            else if (!acquisition_drain(acquisition, id))
+            {
+                acquisition_port_t *port = &acquisition->ports[id];
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, port->serial.fd, NULL);
+                port->failed = true;
+
+                uint32_t failed = __atomic_add_fetch(&acquisition->failed_ports, 1, __ATOMIC_RELAXED);
+                if (failed == acquisition->port_count)
+                {
+                    acquisition_stop(acquisition);
+                }
+            }
+        }
+    }
+
+    close(epoll_fd);
+    return NULL;
+}
+
+int32_t acquisition_init(acquisition_t *acquisition, acquisition_port_t ports[], size_t port_count,
+                         uint32_t thread_count, bool pin_threads, acquisition_handler_t handler, void *user)
+{
+    if ((port_count == 0) || (handler == NULL))
+    {
+        return EXIT_FAILURE;
+    }
+
+    if (thread_count == 0)
+    {
+        thread_count = 1;
+    }
+    if (thread_count > port_count)
+    {
+        thread_count = (uint32_t)port_count;
+    }
+    if (thread_count > ACQUISITION_MAX_THREADS)
+    {
+        thread_count = ACQUISITION_MAX_THREADS;
+    }
+
+    acquisition->ports = ports;
+    acquisition->port_count = port_count;
+    acquisition->thread_count = thread_count;
+    acquisition->pin_threads = pin_threads;
+    acquisition->handler = handler;
+    acquisition->raw_handler = NULL;
+    acquisition->user = user;
+    acquisition->failed_ports = 0;
+
+    for (size_t i = 0; i < port_count; i++)
+    {
+        adc_rs485_decoder_init(&ports[i].decoder);
+        ports[i].failed = false;
+        memset(&ports[i].metrics, 0, sizeof(ports[i].metrics));
+        ports[i].latency = NULL;
+    }
+
+    acquisition->stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    return (acquisition->stop_fd < 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int32_t acquisition_run(acquisition_t *acquisition)
+{
+    acquisition_worker_t workers[ACQUISITION_MAX_THREADS];
+    uint32_t started = 0;
+    sigset_t stop_signals;
+    sigset_t previous_signals;
+
+    // Block the stop signals before starting the workers so that they inherit the mask
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, &previous_signals);
+
+    int signal_fd = signalfd(-1, &stop_signals, SFD_CLOEXEC);
+    if (signal_fd >= 0)
+    {
+        for (uint32_t i = 0; i < acquisition->thread_count; i++)
+        {
+            workers[i].acquisition = acquisition;
+            workers[i].index = i;
+            if (pthread_create(&workers[i].thread, NULL, acquisition_worker, &workers[i]) != 0)
+            {
+                break;
+            }
+            started++;
+        }
+    }
+
+    if (started == acquisition->thread_count)
+    {
+        struct pollfd fds[2] = {
+            {.fd = signal_fd, .events = POLLIN, .revents = 0},
+            {.fd = acquisition->stop_fd, .events = POLLIN, .revents = 0}};
+
+        // Sleep until a stop signal is received or until the engine is stopped
+        while ((fds[1].revents & POLLIN) == 0)
+        {
+            if ((poll(fds, 2, -1) > 0) && ((fds[0].revents & POLLIN) != 0))
+            {
+                struct signalfd_siginfo info;
+                if (read(signal_fd, &info, sizeof(info)) > 0)
+                {
+                    acquisition_stop(acquisition);
+                }
+            }
+        }
+    }
+    else
+    {
+        acquisition_stop(acquisition);
+    }
+
+    for (uint32_t i = 0; i < started; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+    }
+
+    if (signal_fd >= 0)
+    {
+        close(signal_fd);
+    }
+    pthread_sigmask(SIG_SETMASK, &previous_signals, NULL);
+
+    if ((started != acquisition->thread_count) || (acquisition->failed_ports > 0))
+    {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+void acquisition_stop(acquisition_t *acquisition)
+{
+    uint64_t one = 1;
+    ssize_t written = write(acquisition->stop_fd, &one, sizeof(one));
+    (void)written;
+}
+
+void acquisition_close(acquisition_t *acquisition)
+{
+    if (acquisition->stop_fd >= 0)
+    {
+        close(acquisition->stop_fd);
+        acquisition->stop_fd = -1;
+    }
+}
@@ -0,0 +1,124 @@
+/**
+* This module reads any number of serial ports on a Linux machine and decodes the messages sent by
+* swiss air-data computers through RS485.
+*
+* The serial ports are watched with epoll: the threads sleep while the buses are idle and drain
+* every readable port in bulk into the decoder state of this port. The ports can be spread over
+* several worker threads, optionally pinned to a CPU each.
+*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*
+* Example code only. Use at own risk.
+*
+* This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* Simtec AG has no obligation to provide maintenance, support,  updates, enhancements, or modifications.
+*/
+
+#ifndef ACQUISITION_H
+#define ACQUISITION_H
+
+#include "adc_metrics.h"
+#include "adc_rs485_decoder.h"
+#include "latency.h"
+#include "serial.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Maximum number of worker threads of an acquisition engine */
+#define ACQUISITION_MAX_THREADS 64
+
+/**
+ * Function called with the messages decoded from one read of a serial port.
+ * It is called from the worker thread that owns the port.
+ *
+ * @param[in]   port_id     Index of the serial port in the array given to acquisition_init().
+ * @param[in]   msgs        Decoded messages, none of them is RS485_PENDING.
+ * @param[in]   count       Number of decoded messages.
+ * @param[in]   user        User pointer given to acquisition_init().
+ */
+typedef void (*acquisition_handler_t)(uint32_t port_id, const adc_rs485_msg_t msgs[], size_t count, void *user);
+
+/**
+ * Function called with the raw bytes of one read of a serial port, before they are decoded.
+ * It is called from the worker thread that owns the port.
+ *
+ * @param[in]   port_id     Index of the serial port in the array given to acquisition_init().
+ * @param[in]   data        Bytes read.
+ * @param[in]   length      Number of bytes read.
+ * @param[in]   user        User pointer given to acquisition_init().
+ */
+typedef void (*acquisition_raw_handler_t)(uint32_t port_id, const uint8_t data[], size_t length, void *user);
+
+/** One serial port read by an acquisition engine */
+typedef struct
+{
+    serial_port_t serial;        /**< Serial port, shall be opened before acquisition_run() */
+    adc_rs485_decoder_t decoder; /**< Decoder state of this port, only used by its worker thread */
+    bool failed;                 /**< Set when the port couldn't be read anymore and has been dropped */
+    adc_metrics_t metrics;       /**< Counters of this port, written by its worker thread only */
+    latency_histogram_t *latency; /**< Optional, set after acquisition_init() to trace the latency of every
+                                       message, one histogram per latency_stage_t */
+} acquisition_port_t;
+
+/** Acquisition engine */
+typedef struct
+{
+    acquisition_port_t *ports;
+    size_t port_count;
+    uint32_t thread_count;       /**< Number of worker threads, the ports are spread over them */
+    bool pin_threads;            /**< Pin every worker thread to its own CPU */
+    acquisition_handler_t handler;
+    acquisition_raw_handler_t raw_handler; /**< Optional, set after acquisition_init() to record the raw bytes */
+    void *user;
+    int stop_fd;                 /**< eventfd that wakes every thread when the engine shall stop */
+    uint32_t failed_ports;       /**< Number of ports dropped because of a read error */
+} acquisition_t;
+
+/**
+ * Initialize an acquisition engine.
+ *
+ * @param[out]  acquisition     Acquisition engine to initialize.
+ * @param[in]   ports           Serial ports to read. The serial ports shall already be opened.
+ * @param[in]   port_count      Number of serial ports.
+ * @param[in]   thread_count    Number of worker threads. It is limited to the number of ports and to
+ *                              ACQUISITION_MAX_THREADS.
+ * @param[in]   pin_threads     Pin every worker thread to its own CPU.
+ * @param[in]   handler         Function called with the decoded messages.
+ * @param[in]   user            User pointer passed to the handler.
+ *
+ * @return EXIT_FAILURE if the engine couldn't be initialized, EXIT_SUCCESS otherwise.
+ */
+int32_t acquisition_init(acquisition_t *acquisition, acquisition_port_t ports[], size_t port_count,
+                         uint32_t thread_count, bool pin_threads, acquisition_handler_t handler, void *user);
+
+/**
+ * Read and decode the serial ports until SIGINT or SIGTERM is received, until acquisition_stop() is
+ * called or until no port can be read anymore.
+ * SIGINT and SIGTERM are blocked in the calling thread and received through a signalfd.
+ *
+ * @param[in,out]   acquisition     Initialized acquisition engine.
+ *
+ * @return EXIT_FAILURE if the engine couldn't be started or if a port has been dropped,
+ * EXIT_SUCCESS otherwise.
+ */
+int32_t acquisition_run(acquisition_t *acquisition);
+
+/**
+ * Request an acquisition engine to stop. Can be called from any thread or from a signal handler.
+ *
+ * @param[in,out]   acquisition     Running acquisition engine.
+ */
+void acquisition_stop(acquisition_t *acquisition);
+
+/**
+ * Release the resources of an acquisition engine. The serial ports are not closed.
+ *
+ * @param[in,out]   acquisition     Acquisition engine that is not running anymore.
+ */
+void acquisition_close(acquisition_t *acquisition);
+
+#endif
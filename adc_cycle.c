@@ -0,0 +1,106 @@
+/*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*/
+
+#include "adc_cycle.h"
+#include "adc_event.h"
+#include "adc_rs485_decoder.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/** Close the current cycle and prepare the next one */
+static void adc_cycle_close(adc_cycle_assembler_t *assembler, adc_cycle_close_t reason, adc_cycle_t *completed)
+{
+    uint8_t port = assembler->cycle.port;
+
+    assembler->cycle.closed_by = (uint8_t)reason;
+    *completed = assembler->cycle;
+
+    memset(&assembler->cycle, 0, sizeof(assembler->cycle));
+    assembler->cycle.port = port;
+    assembler->open = false;
+}
+
+void adc_cycle_assembler_init(adc_cycle_assembler_t *assembler, uint8_t port, uint64_t timeout_ns)
+{
+    memset(assembler, 0, sizeof(*assembler));
+    assembler->cycle.port = port;
+    assembler->timeout_ns = timeout_ns;
+}
+
+size_t adc_cycle_add(adc_cycle_assembler_t *assembler, const adc_event_t *event, adc_cycle_t completed[ADC_CYCLE_MAX_COMPLETED])
+{
+    adc_cycle_t *cycle = &assembler->cycle;
+    size_t count = 0;
+
+    if (assembler->open && (event->timestamp_ns - cycle->start_ns > assembler->timeout_ns))
+    {
+        adc_cycle_close(assembler, ADC_CYCLE_CLOSED_BY_TIMEOUT, &completed[count++]);
+    }
+
+    // A label already received means that the general status of the cycle has been lost
+    if (assembler->open && (event->msg_type == RS485_RETURNED_DATA) && (event->data_type < RS485_DATA_NOT_VALID) &&
+        ((cycle->present & (1ull << event->data_type)) != 0))
+    {
+        adc_cycle_close(assembler, ADC_CYCLE_CLOSED_BY_REPEAT, &completed[count++]);
+    }
+
+    if (!assembler->open)
+    {
+        cycle->start_ns = event->timestamp_ns;
+        assembler->open = true;
+    }
+    cycle->end_ns = event->timestamp_ns;
+
+    switch (event->msg_type)
+    {
+    case RS485_RETURNED_DATA:
+        if (event->data_type < RS485_DATA_NOT_VALID)
+        {
+            cycle->values[event->data_type] = event->value;
+            cycle->flags[event->data_type] = event->flag;
+            cycle->present |= 1ull << event->data_type;
+        }
+        break;
+    case RS485_RETURNED_STATUS_HTR:
+        cycle->htr_status = (uint16_t)event->status;
+        cycle->present |= 1ull << ADC_CYCLE_HTR_STATUS;
+        break;
+    case RS485_RETURNED_STATUS_GEN:
+        cycle->gen_status = (uint16_t)event->status;
+        cycle->present |= 1ull << ADC_CYCLE_GEN_STATUS;
+        adc_cycle_close(assembler, ADC_CYCLE_CLOSED_BY_STATUS, &completed[count++]);
+        break;
+    default:
+        if (cycle->errors < UINT16_MAX)
+        {
+            cycle->errors++;
+        }
+        break;
+    }
+    return count;
+}
+
+bool adc_cycle_poll(adc_cycle_assembler_t *assembler, uint64_t now_ns, adc_cycle_t *completed)
+{
+    // The time of the messages may be slightly ahead of now_ns
+    if (assembler->open && (now_ns > assembler->cycle.start_ns) && (now_ns - assembler->cycle.start_ns > assembler->timeout_ns))
+    {
+        adc_cycle_close(assembler, ADC_CYCLE_CLOSED_BY_TIMEOUT, completed);
+        return true;
+    }
+    return false;
+}
+
+bool adc_cycle_flush(adc_cycle_assembler_t *assembler, adc_cycle_t *completed)
+{
+    if (assembler->open)
+    {
+        adc_cycle_close(assembler, ADC_CYCLE_CLOSED_BY_END, completed);
+        return true;
+    }
+    return false;
+}
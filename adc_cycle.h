@@ -0,0 +1,115 @@
+/**
+* This module groups the messages decoded from one air data computer into cycles.
+*
+* An air data computer sends a burst of labels followed by its general status. The cycle assembler
+* collects the labels of a burst into one adc_cycle_t, holding a value and a flag for every
+* data_type_t, and closes the cycle when the general status arrives. Consumers then receive one
+* time-consistent set of values per cycle instead of one message per label.
+*
+* A cycle is also closed when the general status has been lost: when a label is received a second
+* time, or when the cycle has been open for longer than the timeout.
+*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*
+* Example code only. Use at own risk.
+*
+* This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* Simtec AG has no obligation to provide maintenance, support,  updates, enhancements, or modifications.
+*/
+
+#ifndef ADC_CYCLE_H
+#define ADC_CYCLE_H
+
+#include "adc_event.h"
+#include "adc_rs485_decoder.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Bit of adc_cycle_t.present set when the cycle holds a general status */
+#define ADC_CYCLE_GEN_STATUS RS485_DATA_NOT_VALID
+
+/** Bit of adc_cycle_t.present set when the cycle holds a heater status */
+#define ADC_CYCLE_HTR_STATUS (RS485_DATA_NOT_VALID + 1)
+
+/** Maximum number of cycles completed by a single message */
+#define ADC_CYCLE_MAX_COMPLETED 2
+
+/** Reason why a cycle has been closed */
+typedef enum
+{
+    ADC_CYCLE_CLOSED_BY_STATUS = 0,  /**< The general status has been received */
+    ADC_CYCLE_CLOSED_BY_TIMEOUT = 1, /**< The cycle has been open for longer than the timeout */
+    ADC_CYCLE_CLOSED_BY_REPEAT = 2,  /**< A label of the cycle has been received again */
+    ADC_CYCLE_CLOSED_BY_END = 3      /**< The stream of messages has ended */
+} adc_cycle_close_t;
+
+/** Values received during one cycle of an air data computer */
+typedef struct
+{
+    uint64_t start_ns;                     /**< Receive time of the first message of the cycle */
+    uint64_t end_ns;                       /**< Receive time of the last message of the cycle */
+    uint64_t present;                      /**< One bit per data_type_t received, ADC_CYCLE_GEN_STATUS and ADC_CYCLE_HTR_STATUS */
+    float values[RS485_DATA_NOT_VALID];    /**< Value of every label, valid if its bit is set in present */
+    uint8_t flags[RS485_DATA_NOT_VALID];   /**< Flag of every label, flag_t */
+    uint16_t gen_status;                   /**< General status, valid if ADC_CYCLE_GEN_STATUS is set in present */
+    uint16_t htr_status;                   /**< Heater status, valid if ADC_CYCLE_HTR_STATUS is set in present */
+    uint16_t errors;                       /**< Number of messages that couldn't be decoded during the cycle */
+    uint8_t port;                          /**< Index of the serial port */
+    uint8_t closed_by;                     /**< Reason why the cycle has been closed, adc_cycle_close_t */
+} adc_cycle_t;
+
+/** State of the cycle assembler of one air data computer */
+typedef struct
+{
+    adc_cycle_t cycle;      /**< Cycle being assembled */
+    bool open;              /**< Set once the first message of the cycle has been received */
+    uint64_t timeout_ns;    /**< Maximum duration of a cycle */
+} adc_cycle_assembler_t;
+
+/**
+ * Initialize a cycle assembler.
+ *
+ * @param[out]  assembler   Cycle assembler.
+ * @param[in]   port        Index of the serial port, copied into the cycles.
+ * @param[in]   timeout_ns  Maximum time between the first message of a cycle and its general status.
+ */
+void adc_cycle_assembler_init(adc_cycle_assembler_t *assembler, uint8_t port, uint64_t timeout_ns);
+
+/**
+ * Add a decoded message to the current cycle.
+ *
+ * @param[in,out]   assembler   Cycle assembler.
+ * @param[in]       event       Decoded message.
+ * @param[out]      completed   Cycles completed by the message, in order.
+ *
+ * @return Number of cycles completed, at most ADC_CYCLE_MAX_COMPLETED.
+ */
+size_t adc_cycle_add(adc_cycle_assembler_t *assembler, const adc_event_t *event, adc_cycle_t completed[ADC_CYCLE_MAX_COMPLETED]);
+
+/**
+ * Close the current cycle if it has been open for longer than the timeout. Shall be called
+ * regularly, the general status may never come.
+ *
+ * @param[in,out]   assembler   Cycle assembler.
+ * @param[in]       now_ns      Current time, on the clock of the messages.
+ * @param[out]      completed   Cycle closed.
+ *
+ * @return true if a cycle has been closed.
+ */
+bool adc_cycle_poll(adc_cycle_assembler_t *assembler, uint64_t now_ns, adc_cycle_t *completed);
+
+/**
+ * Close the current cycle at the end of the stream of messages.
+ *
+ * @param[in,out]   assembler   Cycle assembler.
+ * @param[out]      completed   Cycle closed.
+ *
+ * @return true if a cycle was open.
+ */
+bool adc_cycle_flush(adc_cycle_assembler_t *assembler, adc_cycle_t *completed);
+
+#endif
@@ -0,0 +1,129 @@
+/*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*/
+
+#include "adc_event.h"
+#include "adc_rs485_decoder.h"
+#include <stdint.h>
+#include <time.h>
+
+/** Name of every label */
+static const char *const LABEL_NAME[RS485_DATA_NOT_VALID] = {
+    [RS485_QC] = "qc",
+    [RS485_PS] = "ps",
+    [RS485_AOA] = "aoa",
+    [RS485_AOS] = "aos",
+    [RS485_CAS] = "cas",
+    [RS485_TAS] = "tas",
+    [RS485_HP] = "hp",
+    [RS485_MACH] = "mach",
+    [RS485_SAT] = "sat",
+    [RS485_TAT] = "tat",
+    [RS485_QNH] = "qnh",
+    [RS485_CR] = "cr",
+    [RS485_PT] = "pt",
+    [RS485_CAS_RATE] = "cas_rate",
+    [RS485_TAS_RATE] = "tas_rate",
+    [RS485_HBARO] = "hbaro",
+    [RS485_DTR] = "dtr",
+    [RS485_HTR] = "htr",
+    [RS485_CUR] = "cur",
+    [RS485_QCRAW] = "qcraw",
+    [RS485_PSRAW] = "psraw",
+    [RS485_DPAOA] = "dpaoa",
+    [RS485_DPAOS] = "dpaos",
+    [RS485_IAT] = "iat",
+    [RS485_BAT] = "bat",
+    [RS485_STQC] = "stqc",
+    [RS485_STPS] = "stps",
+    [RS485_STAOA] = "staoa",
+    [RS485_STAOS] = "staos",
+    [RS485_QC_U] = "qc_u",
+    [RS485_PS_U] = "ps_u",
+    [RS485_HP_U] = "hp_u",
+    [RS485_HBARO_U] = "hbaro_u",
+    [RS485_CAS_U] = "cas_u",
+    [RS485_TAS_U] = "tas_u",
+    [RS485_CR_U] = "cr_u"};
+
+/** Name of every reason of a decoding error */
+static const char *const ERROR_NAME[ADC_RS485_ERROR_COUNT] = {
+    [ADC_RS485_ERROR_NO_SOH] = "no_soh",
+    [ADC_RS485_ERROR_TOO_LONG] = "too_long",
+    [ADC_RS485_ERROR_LENGTH] = "length",
+    [ADC_RS485_ERROR_LABEL] = "label",
+    [ADC_RS485_ERROR_STATUS_SOH] = "status_soh",
+    [ADC_RS485_ERROR_HEX] = "hex"};
+
+uint64_t adc_event_now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000000000u) + (uint64_t)now.tv_nsec;
+}
+
+void adc_event_from_msg(adc_event_t *event, const adc_rs485_msg_t *msg, uint8_t port, uint64_t timestamp_ns)
+{
+    event->timestamp_ns = timestamp_ns;
+    event->status = 0;
+    event->msg_type = (uint8_t)msg->msg_type;
+    event->data_type = (uint8_t)RS485_DATA_NOT_VALID;
+    event->flag = (uint8_t)FLAG_INVALID;
+    event->port = port;
+
+    switch (msg->msg_type)
+    {
+    case RS485_RETURNED_DATA:
+        event->value = msg->air_data.value;
+        event->data_type = (uint8_t)msg->air_data.type;
+        event->flag = (uint8_t)msg->air_data.flag;
+        break;
+    case RS485_RETURNED_STATUS_GEN:
+        event->status = msg->gen_status.number;
+        break;
+    case RS485_RETURNED_STATUS_HTR:
+        event->status = msg->htr_status.number;
+        break;
+    case RS485_ERROR:
+        event->status = (uint32_t)msg->error;
+        break;
+    default:
+        break;
+    }
+}
+
+void adc_event_to_msg(const adc_event_t *event, adc_rs485_msg_t *msg)
+{
+    msg->msg_type = (rs485_msg_type_t)event->msg_type;
+
+    switch (msg->msg_type)
+    {
+    case RS485_RETURNED_DATA:
+        msg->air_data.value = event->value;
+        msg->air_data.type = (data_type_t)event->data_type;
+        msg->air_data.flag = (flag_t)event->flag;
+        break;
+    case RS485_RETURNED_STATUS_GEN:
+        msg->gen_status.number = (uint16_t)event->status;
+        break;
+    case RS485_RETURNED_STATUS_HTR:
+        msg->htr_status.number = (uint16_t)event->status;
+        break;
+    case RS485_ERROR:
+        msg->error = (adc_rs485_error_t)event->status;
+        break;
+    default:
+        break;
+    }
+}
+
+const char *adc_event_label_name(uint32_t data_type)
+{
+    return (data_type < RS485_DATA_NOT_VALID) ? LABEL_NAME[data_type] : "unknown";
+}
+
+const char *adc_event_error_name(uint32_t error)
+{
+    return (error < ADC_RS485_ERROR_COUNT) ? ERROR_NAME[error] : "unknown";
+}
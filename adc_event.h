@@ -0,0 +1,80 @@
+/**
+* This module defines a compact, fixed-size record of one decoded message sent by a swiss air-data
+* computer, used to pass the messages between threads and processes.
+*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*
+* Example code only. Use at own risk.
+*
+* This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* Simtec AG has no obligation to provide maintenance, support,  updates, enhancements, or modifications.
+*/
+
+#ifndef ADC_EVENT_H
+#define ADC_EVENT_H
+
+#include "adc_rs485_decoder.h"
+#include <stdint.h>
+
+/** Decoded message, 16 bytes */
+typedef struct
+{
+    uint64_t timestamp_ns; /**< Monotonic time at which the message was received, in nanoseconds */
+    union
+    {
+        float value;       /**< Value of a data message */
+        uint32_t status;   /**< Status word of a general or heater status message, adc_rs485_error_t of an error */
+    };
+    uint8_t msg_type;      /**< Type of message, rs485_msg_type_t */
+    uint8_t data_type;     /**< Type of data of a data message, data_type_t */
+    uint8_t flag;          /**< Flag of a data message, flag_t */
+    uint8_t port;          /**< Index of the serial port the message was received on */
+} adc_event_t;
+
+/**
+ * Returns the current time of the monotonic clock, in nanoseconds.
+ *
+ * @return Current monotonic time.
+ */
+uint64_t adc_event_now_ns(void);
+
+/**
+ * Fill an event from a decoded message.
+ *
+ * @param[out]  event           Event to fill.
+ * @param[in]   msg             Decoded message, shall not be RS485_PENDING.
+ * @param[in]   port            Index of the serial port the message was received on.
+ * @param[in]   timestamp_ns    Monotonic time at which the message was received.
+ */
+void adc_event_from_msg(adc_event_t *event, const adc_rs485_msg_t *msg, uint8_t port, uint64_t timestamp_ns);
+
+/**
+ * Rebuild the decoded message of an event.
+ *
+ * @param[in]   event   Event.
+ * @param[out]  msg     Decoded message.
+ */
+void adc_event_to_msg(const adc_event_t *event, adc_rs485_msg_t *msg);
+
+/**
+ * Returns the short name of a label, e.g. "cas", used in machine-readable outputs.
+ *
+ * @param[in]   data_type   Type of data, data_type_t.
+ *
+ * @return Name of the label, "unknown" if the type of data is not valid.
+ */
+const char *adc_event_label_name(uint32_t data_type);
+
+/**
+ * Returns the short name of the reason of a decoding error, e.g. "hex".
+ *
+ * @param[in]   error   Reason of the error, adc_rs485_error_t.
+ *
+ * @return Name of the reason, "unknown" if it is not valid.
+ */
+const char *adc_event_error_name(uint32_t error);
+
+#endif
@@ -0,0 +1,208 @@
+/*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*/
+
+#include "adc_history.h"
+#include "adc_event.h"
+#include "adc_rs485_decoder.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static inline uint32_t adc_history_index(const adc_history_label_t *label, uint32_t first, uint32_t offset)
+{
+    uint32_t index = first + offset;
+    return (index < label->capacity) ? index : index - label->capacity;
+}
+
+/** Remove the oldest value of a label */
+static void adc_history_pop(adc_history_label_t *label)
+{
+    uint32_t index = label->head;
+    double value = (double)label->samples[index].value - label->offset;
+
+    // The oldest value is at the front of a deque only if no older value is smaller, or larger
+    if ((label->min_count > 0) && (label->minima[label->min_head] == index))
+    {
+        label->min_head = adc_history_index(label, label->min_head, 1);
+        label->min_count--;
+    }
+    if ((label->max_count > 0) && (label->maxima[label->max_head] == index))
+    {
+        label->max_head = adc_history_index(label, label->max_head, 1);
+        label->max_count--;
+    }
+
+    label->sum -= value;
+    label->sum_squares -= value * value;
+    label->head = adc_history_index(label, label->head, 1);
+    label->count--;
+}
+
+/** Remove the values of a label older than the window */
+static void adc_history_expire_label(adc_history_label_t *label, uint64_t now_ns)
+{
+    while ((label->count > 0) && (now_ns > label->samples[label->head].time_ns) &&
+           (now_ns - label->samples[label->head].time_ns > label->window_ns))
+    {
+        adc_history_pop(label);
+    }
+}
+
+/** Recompute the sums from the values in the window */
+static void adc_history_resum(adc_history_label_t *label)
+{
+    label->sum = 0.0;
+    label->sum_squares = 0.0;
+    for (uint32_t i = 0; i < label->count; i++)
+    {
+        double value = (double)label->samples[adc_history_index(label, label->head, i)].value - label->offset;
+        label->sum += value;
+        label->sum_squares += value * value;
+    }
+    label->added = 0;
+}
+
+static void adc_history_push(adc_history_label_t *label, uint64_t time_ns, float value)
+{
+    if (label->count == label->capacity)
+    {
+        adc_history_pop(label);
+    }
+    if (label->count == 0)
+    {
+        // Start again from exact sums, offset by the value to limit the cancellation
+        label->offset = value;
+        label->sum = 0.0;
+        label->sum_squares = 0.0;
+        label->added = 0;
+    }
+
+    uint32_t index = adc_history_index(label, label->head, label->count);
+    label->samples[index].time_ns = time_ns;
+    label->samples[index].value = value;
+    label->count++;
+
+    // The values that can't be the minimum or the maximum anymore leave the back of the deques
+    while ((label->min_count > 0) &&
+           (label->samples[label->minima[adc_history_index(label, label->min_head, label->min_count - 1)]].value >= value))
+    {
+        label->min_count--;
+    }
+    label->minima[adc_history_index(label, label->min_head, label->min_count++)] = index;
+
+    while ((label->max_count > 0) &&
+           (label->samples[label->maxima[adc_history_index(label, label->max_head, label->max_count - 1)]].value <= value))
+    {
+        label->max_count--;
+    }
+    label->maxima[adc_history_index(label, label->max_head, label->max_count++)] = index;
+
+    double offset_value = (double)value - label->offset;
+    label->sum += offset_value;
+    label->sum_squares += offset_value * offset_value;
+
+    if (++label->added >= label->capacity)
+    {
+        adc_history_resum(label);
+    }
+}
+
+int32_t adc_history_init(adc_history_t *history, const uint32_t capacities[RS485_DATA_NOT_VALID], uint64_t window_ns)
+{
+    size_t total = 0;
+
+    memset(history, 0, sizeof(*history));
+    for (uint32_t type = 0; type < RS485_DATA_NOT_VALID; type++)
+    {
+        total += capacities[type];
+    }
+    if (total == 0)
+    {
+        return EXIT_SUCCESS;
+    }
+
+    // The samples first, so that every array is aligned
+    history->memory = malloc(total * ADC_HISTORY_BYTES_PER_VALUE);
+    if (history->memory == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+
+    adc_history_sample_t *samples = history->memory;
+    uint32_t *indexes = (uint32_t *)&samples[total];
+    for (uint32_t type = 0; type < RS485_DATA_NOT_VALID; type++)
+    {
+        adc_history_label_t *label = &history->labels[type];
+        label->capacity = capacities[type];
+        label->window_ns = window_ns;
+        label->samples = samples;
+        label->minima = indexes;
+        label->maxima = indexes + capacities[type];
+        samples += capacities[type];
+        indexes += 2 * (size_t)capacities[type];
+    }
+    return EXIT_SUCCESS;
+}
+
+void adc_history_free(adc_history_t *history)
+{
+    free(history->memory);
+    memset(history, 0, sizeof(*history));
+}
+
+void adc_history_add(adc_history_t *history, const adc_event_t *event)
+{
+    if ((event->msg_type != RS485_RETURNED_DATA) || (event->data_type >= RS485_DATA_NOT_VALID) ||
+        (event->flag != FLAG_VALID) || !isfinite(event->value))
+    {
+        return;
+    }
+
+    adc_history_label_t *label = &history->labels[event->data_type];
+    if (label->capacity > 0)
+    {
+        adc_history_expire_label(label, event->timestamp_ns);
+        adc_history_push(label, event->timestamp_ns, event->value);
+    }
+}
+
+void adc_history_expire(adc_history_t *history, uint64_t now_ns)
+{
+    for (uint32_t type = 0; type < RS485_DATA_NOT_VALID; type++)
+    {
+        adc_history_expire_label(&history->labels[type], now_ns);
+    }
+}
+
+bool adc_history_stats(const adc_history_t *history, data_type_t type, adc_history_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    if (((uint32_t)type >= RS485_DATA_NOT_VALID) || (history->labels[type].count == 0))
+    {
+        return false;
+    }
+
+    const adc_history_label_t *label = &history->labels[type];
+    double count = (double)label->count;
+    double mean = label->sum / count;
+
+    stats->count = label->count;
+    stats->first_ns = label->samples[label->head].time_ns;
+    stats->last_ns = label->samples[adc_history_index(label, label->head, label->count - 1)].time_ns;
+    stats->mean = label->offset + mean;
+    if (label->count > 1)
+    {
+        // Rounding can make the variance of constant values slightly negative
+        double variance = (label->sum_squares - mean * label->sum) / (count - 1.0);
+        stats->variance = (variance > 0.0) ? variance : 0.0;
+    }
+    stats->stddev = sqrt(stats->variance);
+    stats->min = label->samples[label->minima[label->min_head]].value;
+    stats->max = label->samples[label->maxima[label->max_head]].value;
+    return true;
+}
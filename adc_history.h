@@ -0,0 +1,139 @@
+/**
+* This module keeps the recent values of every label of one air data computer, so that statistics
+* over a sliding time window can be queried at any time, e.g. the mean and standard deviation of
+* ps over the last 10 s or the maximum of cas over the last minute.
+*
+* Every label has its own ring of timestamped values, whose capacity is its memory budget: all
+* rings are allocated at once by adc_history_init() and nothing is allocated afterwards. A value
+* leaves the window when it is older than the window, or when the ring is full and a newer value is
+* added, in which case the window is shorter than requested for that label.
+*
+* The statistics are maintained while the values are added and removed: running sums of the values
+* and of their squares give the mean and the variance, and two monotonic deques give the minimum and
+* the maximum. A query therefore costs O(1), adding a value O(1) amortized. The sums are offset by
+* the first value of the label to limit the cancellation, and recomputed from the ring every time it
+* has been entirely replaced so that the rounding errors don't accumulate.
+*
+* Only the values flagged FLAG_VALID are kept. A history is not thread-safe: it is updated and
+* queried by the same thread.
+*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*
+* Example code only. Use at own risk.
+*
+* This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* Simtec AG has no obligation to provide maintenance, support,  updates, enhancements, or modifications.
+*/
+
+#ifndef ADC_HISTORY_H
+#define ADC_HISTORY_H
+
+#include "adc_event.h"
+#include "adc_rs485_decoder.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Default number of values kept per label, 10 s of a label sent at 400 Hz */
+#define ADC_HISTORY_DEFAULT_CAPACITY 4096
+
+/** Memory used per value kept, in bytes: the value with its time and one entry per deque */
+#define ADC_HISTORY_BYTES_PER_VALUE (sizeof(adc_history_sample_t) + 2 * sizeof(uint32_t))
+
+/** Value received for a label */
+typedef struct
+{
+    uint64_t time_ns;
+    float value;
+} adc_history_sample_t;
+
+/** Ring of the recent values of one label */
+typedef struct
+{
+    adc_history_sample_t *samples; /**< Values in the window, from the oldest at head */
+    uint32_t *minima;              /**< Indexes of the samples with increasing values, the minimum first */
+    uint32_t *maxima;              /**< Indexes of the samples with decreasing values, the maximum first */
+    uint32_t capacity;             /**< Maximum number of values kept, 0 if the label is not kept */
+    uint32_t head;
+    uint32_t count;
+    uint32_t min_head;
+    uint32_t min_count;
+    uint32_t max_head;
+    uint32_t max_count;
+    uint32_t added;                /**< Values added since the sums have been recomputed */
+    uint64_t window_ns;
+    double offset;                 /**< Subtracted from the values before they are summed */
+    double sum;                    /**< Sum of the values minus offset */
+    double sum_squares;            /**< Sum of the squares of the values minus offset */
+} adc_history_label_t;
+
+/** Recent values of all labels of one air data computer */
+typedef struct
+{
+    adc_history_label_t labels[RS485_DATA_NOT_VALID];
+    void *memory;                  /**< Single allocation holding the rings of all labels */
+} adc_history_t;
+
+/** Statistics of one label over its window */
+typedef struct
+{
+    uint32_t count;                /**< Number of values in the window, the other fields are only valid if not 0 */
+    uint64_t first_ns;             /**< Time of the oldest value in the window */
+    uint64_t last_ns;              /**< Time of the newest value in the window */
+    double mean;
+    double variance;               /**< Sample variance, 0 with a single value */
+    double stddev;
+    float min;
+    float max;
+} adc_history_stats_t;
+
+/**
+ * Allocate the rings of all labels.
+ *
+ * @param[out]  history     History to initialize.
+ * @param[in]   capacities  Maximum number of values kept of every label, 0 to not keep a label.
+ * @param[in]   window_ns   Duration of the window of every label.
+ *
+ * @return EXIT_FAILURE if the memory couldn't be allocated, EXIT_SUCCESS otherwise.
+ */
+int32_t adc_history_init(adc_history_t *history, const uint32_t capacities[RS485_DATA_NOT_VALID], uint64_t window_ns);
+
+/**
+ * Free the rings of all labels.
+ *
+ * @param[in,out]   history     History.
+ */
+void adc_history_free(adc_history_t *history);
+
+/**
+ * Add a decoded message. The messages of a label shall be added in the order they have been received.
+ *
+ * @param[in,out]   history     History.
+ * @param[in]       event       Decoded message, the statuses, the errors and the values not valid are ignored.
+ */
+void adc_history_add(adc_history_t *history, const adc_event_t *event);
+
+/**
+ * Remove the values older than the window from all labels, also those not received anymore.
+ *
+ * @param[in,out]   history     History.
+ * @param[in]       now_ns      Current time, on the clock of the messages.
+ */
+void adc_history_expire(adc_history_t *history, uint64_t now_ns);
+
+/**
+ * Compute the statistics of one label over the values in its window, in O(1). The values older than
+ * the window are only removed by adc_history_add() and adc_history_expire().
+ *
+ * @param[in]   history     History.
+ * @param[in]   type        Type of data.
+ * @param[out]  stats       Statistics of the label.
+ *
+ * @return false if the label has no value in its window, true otherwise.
+ */
+bool adc_history_stats(const adc_history_t *history, data_type_t type, adc_history_stats_t *stats);
+
+#endif
@@ -0,0 +1,316 @@
+/*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*/
+
+#include "adc_metrics.h"
+#include "adc_event.h"
+#include "adc_rs485_decoder.h"
+#include "latency.h"
+#include "latest_table.h"
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/** Add to a counter that has a single writer, readers see either the old or the new value */
+static inline void adc_metrics_add(uint64_t *counter, uint64_t value)
+{
+    if (value != 0)
+    {
+        __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + value, __ATOMIC_RELAXED);
+    }
+}
+
+void adc_metrics_count_bytes(adc_metrics_t *metrics, const adc_rs485_decoder_t *decoder, size_t bytes)
+{
+    adc_metrics_add(&metrics->bytes, bytes);
+    __atomic_store_n(&metrics->truncated, (uint64_t)decoder->truncated, __ATOMIC_RELAXED);
+    __atomic_store_n(&metrics->errors[ADC_RS485_ERROR_NO_SOH], decoder->resync, __ATOMIC_RELAXED);
+}
+
+void adc_metrics_count_msgs(adc_metrics_t *metrics, const adc_rs485_msg_t msgs[], size_t count)
+{
+    uint64_t errors[ADC_RS485_ERROR_COUNT] = {0};
+    uint64_t frames = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (msgs[i].msg_type != RS485_ERROR)
+        {
+            frames++;
+        }
+        else if ((uint32_t)msgs[i].error < ADC_RS485_ERROR_COUNT)
+        {
+            errors[msgs[i].error]++;
+        }
+    }
+
+    adc_metrics_add(&metrics->frames, frames);
+    for (size_t reason = 0; reason < ADC_RS485_ERROR_COUNT; reason++)
+    {
+        adc_metrics_add(&metrics->errors[reason], errors[reason]);
+    }
+}
+
+void adc_metrics_merge(adc_metrics_t *metrics, const adc_metrics_t *part)
+{
+    adc_metrics_add(&metrics->bytes, part->bytes);
+    adc_metrics_add(&metrics->frames, part->frames);
+    for (size_t reason = 0; reason < ADC_RS485_ERROR_COUNT; reason++)
+    {
+        adc_metrics_add(&metrics->errors[reason], part->errors[reason]);
+    }
+    adc_metrics_add(&metrics->truncated, part->truncated);
+}
+
+void adc_metrics_read(const adc_metrics_t *metrics, adc_metrics_t *copy)
+{
+    copy->bytes = __atomic_load_n(&metrics->bytes, __ATOMIC_RELAXED);
+    copy->frames = __atomic_load_n(&metrics->frames, __ATOMIC_RELAXED);
+    for (size_t reason = 0; reason < ADC_RS485_ERROR_COUNT; reason++)
+    {
+        copy->errors[reason] = __atomic_load_n(&metrics->errors[reason], __ATOMIC_RELAXED);
+    }
+    copy->truncated = __atomic_load_n(&metrics->truncated, __ATOMIC_RELAXED);
+}
+
+void adc_metrics_report_init(adc_metrics_report_t *report, const char *const names[], const adc_metrics_t *const metrics[],
+                             const latest_table_t *const tables[], size_t port_count)
+{
+    memset(report, 0, sizeof(*report));
+    report->port_count = (port_count < ADC_METRICS_MAX_PORTS) ? port_count : ADC_METRICS_MAX_PORTS;
+    for (size_t i = 0; i < report->port_count; i++)
+    {
+        report->names[i] = names[i];
+        report->metrics[i] = metrics[i];
+        report->tables[i] = tables[i];
+    }
+}
+
+void adc_metrics_report_set_latency(adc_metrics_report_t *report, const latency_histogram_t *const latency[])
+{
+    for (size_t i = 0; i < report->port_count; i++)
+    {
+        report->latency[i] = latency[i];
+    }
+}
+
+void adc_metrics_report_update(adc_metrics_report_t *report, uint64_t now_ns)
+{
+    double elapsed_s = (report->update_ns != 0) ? (double)(now_ns - report->update_ns) / 1e9 : 0.0;
+
+    for (size_t port = 0; port < report->port_count; port++)
+    {
+        adc_metrics_t *counters = &report->counters[port];
+        latest_snapshot_t *snapshot = &report->snapshots[port];
+
+        adc_metrics_read(report->metrics[port], counters);
+        latest_table_snapshot(report->tables[port], snapshot);
+
+        // The first update has no previous counters, its rates stay 0
+        if (elapsed_s > 0.0)
+        {
+            report->byte_rates[port] = (float)((double)(counters->bytes - report->previous_bytes[port]) / elapsed_s);
+            report->frame_rates[port] = (float)((double)(counters->frames - report->previous_frames[port]) / elapsed_s);
+            for (size_t type = 0; type < RS485_DATA_NOT_VALID; type++)
+            {
+                uint32_t updates = snapshot->data[type].update_count - report->previous_updates[port][type];
+                report->label_rates[port][type] = (float)((double)updates / elapsed_s);
+            }
+        }
+
+        report->previous_bytes[port] = counters->bytes;
+        report->previous_frames[port] = counters->frames;
+        for (size_t type = 0; type < RS485_DATA_NOT_VALID; type++)
+        {
+            report->previous_updates[port][type] = snapshot->data[type].update_count;
+        }
+
+        for (uint32_t stage = 0; (report->latency[port] != NULL) && (stage < LATENCY_STAGE_COUNT); stage++)
+        {
+            latency_summarize(&report->latency[port][stage], &report->latencies[port][stage]);
+        }
+    }
+    report->update_ns = now_ns;
+}
+
+/** Text being formatted into a caller buffer */
+typedef struct
+{
+    char *buffer;
+    size_t length;
+    size_t pos;
+} adc_metrics_text_t;
+
+static void adc_metrics_printf(adc_metrics_text_t *text, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+static void adc_metrics_printf(adc_metrics_text_t *text, const char *format, ...)
+{
+    if (text->pos + 1 >= text->length)
+    {
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(&text->buffer[text->pos], text->length - text->pos, format, args);
+    va_end(args);
+
+    if (written > 0)
+    {
+        size_t room = text->length - text->pos - 1;
+        text->pos += ((size_t)written < room) ? (size_t)written : room;
+    }
+}
+
+/** Write the help and type lines of a metric */
+static void adc_metrics_prometheus_header(adc_metrics_text_t *text, const char *name, const char *type, const char *help)
+{
+    adc_metrics_printf(text, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+size_t adc_metrics_report_prometheus(const adc_metrics_report_t *report, char buffer[], size_t length)
+{
+    adc_metrics_text_t text = {buffer, length, 0};
+
+    if (length > 0)
+    {
+        buffer[0] = '\0';
+    }
+
+    adc_metrics_prometheus_header(&text, "adc_bytes_total", "counter", "Bytes received.");
+    for (size_t port = 0; port < report->port_count; port++)
+    {
+        adc_metrics_printf(&text, "adc_bytes_total{port=\"%s\"} %llu\n", report->names[port],
+                           (unsigned long long)report->counters[port].bytes);
+    }
+
+    adc_metrics_prometheus_header(&text, "adc_frames_total", "counter", "Data and status messages decoded.");
+    for (size_t port = 0; port < report->port_count; port++)
+    {
+        adc_metrics_printf(&text, "adc_frames_total{port=\"%s\"} %llu\n", report->names[port],
+                           (unsigned long long)report->counters[port].frames);
+    }
+
+    adc_metrics_prometheus_header(&text, "adc_frame_errors_total", "counter", "Messages that couldn't be decoded, per reason.");
+    for (size_t port = 0; port < report->port_count; port++)
+    {
+        for (uint32_t reason = ADC_RS485_ERROR_NO_SOH + 1; reason < ADC_RS485_ERROR_COUNT; reason++)
+        {
+            adc_metrics_printf(&text, "adc_frame_errors_total{port=\"%s\",reason=\"%s\"} %llu\n", report->names[port],
+                               adc_event_error_name(reason), (unsigned long long)report->counters[port].errors[reason]);
+        }
+    }
+
+    adc_metrics_prometheus_header(&text, "adc_resync_bytes_total", "counter", "Bytes discarded while searching the next start of header.");
+    for (size_t port = 0; port < report->port_count; port++)
+    {
+        adc_metrics_printf(&text, "adc_resync_bytes_total{port=\"%s\"} %llu\n", report->names[port],
+                           (unsigned long long)report->counters[port].errors[ADC_RS485_ERROR_NO_SOH]);
+    }
+
+    adc_metrics_prometheus_header(&text, "adc_truncated_frames_total", "counter", "Messages interrupted by a start of header before their end.");
+    for (size_t port = 0; port < report->port_count; port++)
+    {
+        adc_metrics_printf(&text, "adc_truncated_frames_total{port=\"%s\"} %llu\n", report->names[port],
+                           (unsigned long long)report->counters[port].truncated);
+    }
+
+    adc_metrics_prometheus_header(&text, "adc_label_messages_total", "counter", "Values received per label.");
+    for (size_t port = 0; port < report->port_count; port++)
+    {
+        for (uint32_t type = 0; type < RS485_DATA_NOT_VALID; type++)
+        {
+            if (report->snapshots[port].data[type].update_count != 0)
+            {
+                adc_metrics_printf(&text, "adc_label_messages_total{port=\"%s\",label=\"%s\"} %u\n", report->names[port],
+                                   adc_event_label_name(type), report->snapshots[port].data[type].update_count);
+            }
+        }
+    }
+
+    adc_metrics_prometheus_header(&text, "adc_label_rate_hz", "gauge", "Values received per second per label.");
+    for (size_t port = 0; port < report->port_count; port++)
+    {
+        for (uint32_t type = 0; type < RS485_DATA_NOT_VALID; type++)
+        {
+            if (report->snapshots[port].data[type].update_count != 0)
+            {
+                adc_metrics_printf(&text, "adc_label_rate_hz{port=\"%s\",label=\"%s\"} %.1f\n", report->names[port],
+                                   adc_event_label_name(type), report->label_rates[port][type]);
+            }
+        }
+    }
+
+    if (report->latency[0] != NULL)
+    {
+        static const char *const quantiles[] = {"0.5", "0.9", "0.99", "0.999"};
+
+        adc_metrics_prometheus_header(&text, "adc_latency_seconds", "gauge", "Latency percentiles of every stage of the decoder.");
+        for (size_t port = 0; port < report->port_count; port++)
+        {
+            for (uint32_t stage = 0; stage < LATENCY_STAGE_COUNT; stage++)
+            {
+                const latency_summary_t *summary = &report->latencies[port][stage];
+                const uint64_t values[] = {summary->p50, summary->p90, summary->p99, summary->p999};
+
+                for (size_t i = 0; (summary->count > 0) && (i < sizeof(values) / sizeof(values[0])); i++)
+                {
+                    adc_metrics_printf(&text, "adc_latency_seconds{port=\"%s\",stage=\"%s\",quantile=\"%s\"} %.9f\n", report->names[port],
+                                       latency_stage_name((latency_stage_t)stage), quantiles[i], (double)values[i] / 1e9);
+                }
+            }
+        }
+
+        adc_metrics_prometheus_header(&text, "adc_latency_messages_total", "counter", "Messages whose latency has been traced, per stage.");
+        for (size_t port = 0; port < report->port_count; port++)
+        {
+            for (uint32_t stage = 0; stage < LATENCY_STAGE_COUNT; stage++)
+            {
+                adc_metrics_printf(&text, "adc_latency_messages_total{port=\"%s\",stage=\"%s\"} %llu\n", report->names[port],
+                                   latency_stage_name((latency_stage_t)stage), (unsigned long long)report->latencies[port][stage].count);
+            }
+        }
+    }
+
+    return text.pos;
+}
+
+size_t adc_metrics_report_line(const adc_metrics_report_t *report, size_t port, char buffer[], size_t length)
+{
+    adc_metrics_text_t text = {buffer, length, 0};
+    const adc_metrics_t *counters = &report->counters[port];
+
+    if (length > 0)
+    {
+        buffer[0] = '\0';
+    }
+
+    adc_metrics_printf(&text, "[%s] %.0f B/s %.0f frames/s, frames %llu, errors", report->names[port],
+                       report->byte_rates[port], report->frame_rates[port], (unsigned long long)counters->frames);
+    for (uint32_t reason = ADC_RS485_ERROR_NO_SOH + 1; reason < ADC_RS485_ERROR_COUNT; reason++)
+    {
+        adc_metrics_printf(&text, " %s %llu", adc_event_error_name(reason), (unsigned long long)counters->errors[reason]);
+    }
+    adc_metrics_printf(&text, ", truncated %llu, resync %llu B, labels", (unsigned long long)counters->truncated,
+                       (unsigned long long)counters->errors[ADC_RS485_ERROR_NO_SOH]);
+    for (uint32_t type = 0; type < RS485_DATA_NOT_VALID; type++)
+    {
+        if (report->snapshots[port].data[type].update_count != 0)
+        {
+            adc_metrics_printf(&text, " %s %.1f Hz", adc_event_label_name(type), report->label_rates[port][type]);
+        }
+    }
+    if (report->latency[port] != NULL)
+    {
+        adc_metrics_printf(&text, ", latency p99");
+        for (uint32_t stage = 0; stage < LATENCY_STAGE_COUNT; stage++)
+        {
+            adc_metrics_printf(&text, " %s %.3f ms", latency_stage_name((latency_stage_t)stage),
+                               (double)report->latencies[port][stage].p99 / 1e6);
+        }
+    }
+    return text.pos;
+}
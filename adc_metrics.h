@@ -0,0 +1,152 @@
+/**
+* This module counts, for every serial port, the bytes received, the messages decoded, the messages
+* that couldn't be decoded for every reason and the bytes discarded while searching the start of
+* the next message. The update rate of every label is computed from the latest value tables.
+*
+* The counters of a port are written by the thread decoding the port only, with relaxed atomic
+* stores once per batch of messages, and can be read from any other thread. A report gathers the
+* counters of all ports and formats them in the Prometheus text format or as a short stats line,
+* together with the latency percentiles of every stage when the latencies are traced.
+*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*
+* Example code only. Use at own risk.
+*
+* This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* Simtec AG has no obligation to provide maintenance, support,  updates, enhancements, or modifications.
+*/
+
+#ifndef ADC_METRICS_H
+#define ADC_METRICS_H
+
+#include "adc_rs485_decoder.h"
+#include "latency.h"
+#include "latest_table.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/** Maximum number of serial ports of a report */
+#define ADC_METRICS_MAX_PORTS 64
+
+/** Counters of one serial port */
+typedef struct
+{
+    uint64_t bytes;                         /**< Bytes received */
+    uint64_t frames;                        /**< Data and status messages decoded */
+    uint64_t errors[ADC_RS485_ERROR_COUNT]; /**< Messages that couldn't be decoded per reason, ADC_RS485_ERROR_NO_SOH
+                                                 counts the bytes discarded while searching the next start of header */
+    uint64_t truncated;                     /**< Messages interrupted by a start of header before their end */
+} adc_metrics_t;
+
+/** Counters of all serial ports at the time of the last update of a report, too large for the stack */
+typedef struct
+{
+    size_t port_count;
+    const char *names[ADC_METRICS_MAX_PORTS];
+    const adc_metrics_t *metrics[ADC_METRICS_MAX_PORTS];
+    const latest_table_t *tables[ADC_METRICS_MAX_PORTS];
+    adc_metrics_t counters[ADC_METRICS_MAX_PORTS];           /**< Counters at the last update */
+    latest_snapshot_t snapshots[ADC_METRICS_MAX_PORTS];      /**< Latest values at the last update */
+    uint64_t previous_bytes[ADC_METRICS_MAX_PORTS];
+    uint64_t previous_frames[ADC_METRICS_MAX_PORTS];
+    uint32_t previous_updates[ADC_METRICS_MAX_PORTS][RS485_DATA_NOT_VALID];
+    float byte_rates[ADC_METRICS_MAX_PORTS];                 /**< Bytes per second since the previous update */
+    float frame_rates[ADC_METRICS_MAX_PORTS];                /**< Messages decoded per second since the previous update */
+    float label_rates[ADC_METRICS_MAX_PORTS][RS485_DATA_NOT_VALID]; /**< Updates per second of every label */
+    const latency_histogram_t *latency[ADC_METRICS_MAX_PORTS]; /**< Histograms of the stages of every port, NULL if not traced */
+    latency_summary_t latencies[ADC_METRICS_MAX_PORTS][LATENCY_STAGE_COUNT]; /**< Latencies at the last update */
+    uint64_t update_ns;                                      /**< Time of the last update, 0 before the first one */
+} adc_metrics_report_t;
+
+/**
+ * Count the bytes of one read, and the messages truncated and the bytes discarded so far by the
+ * decoder of the port.
+ * Shall only be called by the thread decoding the port.
+ *
+ * @param[in,out]   metrics     Counters of the port.
+ * @param[in]       decoder     Decoder state of the port.
+ * @param[in]       bytes       Number of bytes read.
+ */
+void adc_metrics_count_bytes(adc_metrics_t *metrics, const adc_rs485_decoder_t *decoder, size_t bytes);
+
+/**
+ * Count decoded messages. Shall only be called by the thread decoding the port.
+ *
+ * @param[in,out]   metrics     Counters of the port.
+ * @param[in]       msgs        Decoded messages, none of them is RS485_PENDING.
+ * @param[in]       count       Number of messages.
+ */
+void adc_metrics_count_msgs(adc_metrics_t *metrics, const adc_rs485_msg_t msgs[], size_t count);
+
+/**
+ * Add the counters of a part of the stream decoded separately, e.g. by another thread. Shall only be
+ * called by the thread owning the counters of the port.
+ *
+ * @param[in,out]   metrics     Counters of the port.
+ * @param[in]       part        Counters of the part, its truncated messages included.
+ */
+void adc_metrics_merge(adc_metrics_t *metrics, const adc_metrics_t *part);
+
+/**
+ * Copy the counters of a port. Can be called from any thread.
+ *
+ * @param[in]   metrics     Counters of the port.
+ * @param[out]  copy        Copy of the counters.
+ */
+void adc_metrics_read(const adc_metrics_t *metrics, adc_metrics_t *copy);
+
+/**
+ * Initialize a report.
+ *
+ * @param[out]  report      Report to initialize.
+ * @param[in]   names       Name of every serial port.
+ * @param[in]   metrics     Counters of every serial port.
+ * @param[in]   tables      Latest value table of every serial port.
+ * @param[in]   port_count  Number of serial ports, at most ADC_METRICS_MAX_PORTS.
+ */
+void adc_metrics_report_init(adc_metrics_report_t *report, const char *const names[], const adc_metrics_t *const metrics[],
+                             const latest_table_t *const tables[], size_t port_count);
+
+/**
+ * Add the latencies of every port to a report.
+ *
+ * @param[in,out]   report      Initialized report.
+ * @param[in]       latency     Histograms of the stages of every serial port, indexed by latency_stage_t.
+ */
+void adc_metrics_report_set_latency(adc_metrics_report_t *report, const latency_histogram_t *const latency[]);
+
+/**
+ * Read the counters of all ports and compute the rates since the previous update.
+ *
+ * @param[in,out]   report  Report.
+ * @param[in]       now_ns  Current monotonic time.
+ */
+void adc_metrics_report_update(adc_metrics_report_t *report, uint64_t now_ns);
+
+/**
+ * Format the last update of a report in the Prometheus text format.
+ *
+ * @param[in]   report  Report.
+ * @param[out]  buffer  Buffer that will contain the text, null terminated.
+ * @param[in]   length  Size of the buffer.
+ *
+ * @return Length of the text, truncated to the buffer.
+ */
+size_t adc_metrics_report_prometheus(const adc_metrics_report_t *report, char buffer[], size_t length);
+
+/**
+ * Format the last update of one port of a report as a single line, without the end of line.
+ *
+ * @param[in]   report  Report.
+ * @param[in]   port    Index of the serial port.
+ * @param[out]  buffer  Buffer that will contain the text, null terminated.
+ * @param[in]   length  Size of the buffer.
+ *
+ * @return Length of the text, truncated to the buffer.
+ */
+size_t adc_metrics_report_line(const adc_metrics_report_t *report, size_t port, char buffer[], size_t length);
+
+#endif
@@ -0,0 +1,182 @@
+/*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*/
+
+#include "adc_resample.h"
+#include "adc_event.h"
+#include "adc_rs485_decoder.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Flag of a value computed from two values, the first one that is not valid */
+static inline uint8_t adc_resample_worst_flag(uint8_t first, uint8_t second)
+{
+    return (first != FLAG_VALID) ? first : second;
+}
+
+/**
+ * Compute the value of one label at an instant.
+ * @return false if the label hadn't been received yet at the instant.
+ */
+static bool adc_resample_label(const adc_resampler_t *resampler, uint32_t type, uint64_t time_ns, float *value, uint8_t *flag)
+{
+    const adc_resample_sample_t *samples = resampler->samples[type];
+    uint32_t count = resampler->counts[type];
+    uint32_t kept = (count < ADC_RESAMPLE_HISTORY) ? count : ADC_RESAMPLE_HISTORY;
+    const adc_resample_sample_t *before = NULL;
+    const adc_resample_sample_t *after = NULL;
+
+    // Search from the newest value the last one received at or before the instant
+    for (uint32_t i = 1; i <= kept; i++)
+    {
+        const adc_resample_sample_t *sample = &samples[(count - i) % ADC_RESAMPLE_HISTORY];
+        if (sample->time_ns <= time_ns)
+        {
+            before = sample;
+            break;
+        }
+        after = sample;
+    }
+
+    if (before == NULL)
+    {
+        // Either received after the instant only, or the history is too short and the oldest value is the best one
+        if (count <= ADC_RESAMPLE_HISTORY)
+        {
+            return false;
+        }
+        before = after;
+        after = NULL;
+    }
+
+    *value = before->value;
+    *flag = before->flag;
+
+    if ((resampler->methods[type] == ADC_RESAMPLE_LINEAR) && (after != NULL) && (after->time_ns > before->time_ns))
+    {
+        float ratio = (float)((double)(time_ns - before->time_ns) / (double)(after->time_ns - before->time_ns));
+        *value = before->value + (after->value - before->value) * ratio;
+        *flag = adc_resample_worst_flag(before->flag, after->flag);
+    }
+
+    if ((resampler->stale_ns != 0) && (time_ns > before->time_ns) && (time_ns - before->time_ns > resampler->stale_ns))
+    {
+        *flag = FLAG_INVALID;
+    }
+    return true;
+}
+
+/** Compute the row of the next instant */
+static void adc_resample_row(adc_resampler_t *resampler, adc_resample_row_t *row)
+{
+    memset(row, 0, sizeof(*row));
+    row->time_ns = resampler->next_ns;
+    row->port = resampler->port;
+    row->valid = true;
+
+    for (uint32_t type = 0; type < RS485_DATA_NOT_VALID; type++)
+    {
+        if ((resampler->counts[type] > 0) &&
+            adc_resample_label(resampler, type, row->time_ns, &row->values[type], &row->flags[type]))
+        {
+            row->present |= 1ull << type;
+            row->valid = row->valid && (row->flags[type] == FLAG_VALID);
+        }
+    }
+
+    row->present |= resampler->status_present;
+    row->gen_status = resampler->gen_status;
+    row->htr_status = resampler->htr_status;
+    resampler->next_ns += resampler->period_ns;
+}
+
+void adc_resampler_init(adc_resampler_t *resampler, uint8_t port, uint64_t period_ns, uint64_t stale_ns)
+{
+    memset(resampler, 0, sizeof(*resampler));
+    resampler->port = port;
+    resampler->period_ns = (period_ns > 0) ? period_ns : 1u;
+    resampler->stale_ns = stale_ns;
+    resampler->delay_ns = resampler->period_ns;
+}
+
+void adc_resampler_set_delay(adc_resampler_t *resampler, uint64_t delay_ns)
+{
+    resampler->delay_ns = (delay_ns > 0) ? delay_ns : resampler->period_ns;
+}
+
+int32_t adc_resampler_set_method(adc_resampler_t *resampler, data_type_t type, adc_resample_method_t method)
+{
+    if ((uint32_t)type >= RS485_DATA_NOT_VALID)
+    {
+        return EXIT_FAILURE;
+    }
+    resampler->methods[type] = (uint8_t)method;
+    return EXIT_SUCCESS;
+}
+
+void adc_resampler_add(adc_resampler_t *resampler, const adc_event_t *event)
+{
+    if (resampler->next_ns == 0)
+    {
+        // The first row is at the first multiple of the period after the first message
+        resampler->next_ns = ((event->timestamp_ns / resampler->period_ns) + 1u) * resampler->period_ns;
+    }
+    resampler->last_ns = event->timestamp_ns;
+
+    switch (event->msg_type)
+    {
+    case RS485_RETURNED_DATA:
+        if (event->data_type < RS485_DATA_NOT_VALID)
+        {
+            uint32_t type = event->data_type;
+            adc_resample_sample_t *sample = &resampler->samples[type][resampler->counts[type] % ADC_RESAMPLE_HISTORY];
+            sample->time_ns = event->timestamp_ns;
+            sample->value = event->value;
+            sample->flag = event->flag;
+            resampler->counts[type]++;
+
+            // Keep the position in the history after the counter wraps
+            if (resampler->counts[type] == 0)
+            {
+                resampler->counts[type] = ADC_RESAMPLE_HISTORY;
+            }
+        }
+        break;
+    case RS485_RETURNED_STATUS_GEN:
+        resampler->gen_status = (uint16_t)event->status;
+        resampler->status_present |= 1ull << ADC_RESAMPLE_GEN_STATUS;
+        break;
+    case RS485_RETURNED_STATUS_HTR:
+        resampler->htr_status = (uint16_t)event->status;
+        resampler->status_present |= 1ull << ADC_RESAMPLE_HTR_STATUS;
+        break;
+    default:
+        break;
+    }
+}
+
+size_t adc_resampler_poll(adc_resampler_t *resampler, uint64_t now_ns, adc_resample_row_t rows[], size_t max_rows)
+{
+    size_t count = 0;
+
+    while ((resampler->next_ns != 0) && (count < max_rows) && (now_ns >= resampler->next_ns + resampler->delay_ns))
+    {
+        adc_resample_row(resampler, &rows[count++]);
+    }
+    return count;
+}
+
+size_t adc_resampler_flush(adc_resampler_t *resampler, adc_resample_row_t rows[], size_t max_rows)
+{
+    size_t count = 0;
+
+    while ((resampler->next_ns != 0) && (count < max_rows) && (resampler->next_ns <= resampler->last_ns))
+    {
+        adc_resample_row(resampler, &rows[count++]);
+    }
+    return count;
+}
@@ -0,0 +1,159 @@
+/**
+* This module resamples the messages decoded from one air data computer into rows at a fixed rate.
+*
+* The labels of an air data computer are not all sent at the same rate: the heater labels and the
+* sensor temperatures are slower than the pressures. The resampler computes the value of every
+* label received at the same instants, multiples of the period on the clock of the messages, so
+* that the rows of several serial ports are aligned too. Every label is either held, the latest
+* value received before the instant is used, or linearly interpolated between the values received
+* just before and just after the instant.
+*
+* A row is computed after a delay, one period of the rows by default, so that the interpolated
+* labels have received their value following the instant. A label whose next value hasn't been
+* received yet when its row is computed is held: to interpolate a label slower than the output rate,
+* the delay shall be at least the period of that label. The history of every label shall also cover
+* the delay, a label sent more than ADC_RESAMPLE_HISTORY - 1 times during the delay is computed from
+* the oldest value kept instead. The flag of a label is the worst flag of the values it is computed from, a label not
+* received for longer than the stale time is FLAG_INVALID, and a row is only valid if all its
+* labels are FLAG_VALID.
+*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*
+* Example code only. Use at own risk.
+*
+* This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* Simtec AG has no obligation to provide maintenance, support,  updates, enhancements, or modifications.
+*/
+
+#ifndef ADC_RESAMPLE_H
+#define ADC_RESAMPLE_H
+
+#include "adc_event.h"
+#include "adc_rs485_decoder.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Bit of adc_resample_row_t.present set when the row holds a general status */
+#define ADC_RESAMPLE_GEN_STATUS RS485_DATA_NOT_VALID
+
+/** Bit of adc_resample_row_t.present set when the row holds a heater status */
+#define ADC_RESAMPLE_HTR_STATUS (RS485_DATA_NOT_VALID + 1)
+
+/** Number of values kept per label, labels sent up to 15 times during the delay of the rows are exact */
+#define ADC_RESAMPLE_HISTORY 16
+
+/** Computation of the value of a label at the instant of a row */
+typedef enum
+{
+    ADC_RESAMPLE_HOLD = 0,  /**< Latest value received before the instant */
+    ADC_RESAMPLE_LINEAR = 1 /**< Interpolated between the values received before and after the instant, held
+                                 if the value after the instant hasn't been received within the delay */
+} adc_resample_method_t;
+
+/** Values of all labels of one air data computer at the same instant */
+typedef struct
+{
+    uint64_t time_ns;                    /**< Instant of the row, a multiple of the period */
+    uint64_t present;                    /**< One bit per data_type_t received so far, ADC_RESAMPLE_GEN_STATUS and ADC_RESAMPLE_HTR_STATUS */
+    float values[RS485_DATA_NOT_VALID];  /**< Value of every label, valid if its bit is set in present */
+    uint8_t flags[RS485_DATA_NOT_VALID]; /**< Flag of every label, flag_t */
+    uint16_t gen_status;                 /**< Latest general status, valid if ADC_RESAMPLE_GEN_STATUS is set in present */
+    uint16_t htr_status;                 /**< Latest heater status, valid if ADC_RESAMPLE_HTR_STATUS is set in present */
+    uint8_t port;                        /**< Index of the serial port */
+    bool valid;                          /**< Set if the flag of every label present is FLAG_VALID */
+} adc_resample_row_t;
+
+/** Value received for a label */
+typedef struct
+{
+    uint64_t time_ns;
+    float value;
+    uint8_t flag;
+} adc_resample_sample_t;
+
+/** State of the resampler of one air data computer */
+typedef struct
+{
+    adc_resample_sample_t samples[RS485_DATA_NOT_VALID][ADC_RESAMPLE_HISTORY]; /**< Latest values of every label */
+    uint32_t counts[RS485_DATA_NOT_VALID]; /**< Number of values received per label, the next one is stored at counts % ADC_RESAMPLE_HISTORY */
+    uint8_t methods[RS485_DATA_NOT_VALID]; /**< adc_resample_method_t of every label */
+    uint64_t period_ns;
+    uint64_t stale_ns;                     /**< Age after which a label held is invalid */
+    uint64_t delay_ns;                     /**< Time after its instant at which a row is computed */
+    uint64_t next_ns;                      /**< Instant of the next row, 0 before the first message */
+    uint64_t last_ns;                      /**< Receive time of the latest message */
+    uint64_t status_present;               /**< ADC_RESAMPLE_GEN_STATUS and ADC_RESAMPLE_HTR_STATUS bits received */
+    uint16_t gen_status;
+    uint16_t htr_status;
+    uint8_t port;
+} adc_resampler_t;
+
+/**
+ * Initialize a resampler, every label is held.
+ *
+ * @param[out]  resampler   Resampler.
+ * @param[in]   port        Index of the serial port, copied into the rows.
+ * @param[in]   period_ns   Time between two rows.
+ * @param[in]   stale_ns    Age after which the value of a label is invalid, 0 to never invalidate it.
+ */
+void adc_resampler_init(adc_resampler_t *resampler, uint8_t port, uint64_t period_ns, uint64_t stale_ns);
+
+/**
+ * Select how the value of one label is computed.
+ *
+ * @param[in,out]   resampler   Resampler.
+ * @param[in]       type        Type of data.
+ * @param[in]       method      Computation of the value at the instant of the rows.
+ *
+ * @return EXIT_FAILURE if the type of data is not valid, EXIT_SUCCESS otherwise.
+ */
+int32_t adc_resampler_set_method(adc_resampler_t *resampler, data_type_t type, adc_resample_method_t method);
+
+/**
+ * Select how long after its instant a row is computed, one period of the rows by default. To
+ * interpolate a label slower than the output rate, the delay shall be at least the period of that
+ * label.
+ *
+ * @param[in,out]   resampler   Resampler.
+ * @param[in]       delay_ns    Time after its instant at which a row is computed, 0 for one period.
+ */
+void adc_resampler_set_delay(adc_resampler_t *resampler, uint64_t delay_ns);
+
+/**
+ * Add a decoded message. The messages shall be added in the order they have been received.
+ *
+ * @param[in,out]   resampler   Resampler.
+ * @param[in]       event       Decoded message, errors are ignored.
+ */
+void adc_resampler_add(adc_resampler_t *resampler, const adc_event_t *event);
+
+/**
+ * Compute the rows whose instant is at least the delay before the current time. Shall be called
+ * regularly, also when no message is received, until it returns less than max_rows.
+ *
+ * @param[in,out]   resampler   Resampler.
+ * @param[in]       now_ns      Current time, on the clock of the messages.
+ * @param[out]      rows        Rows computed, in order.
+ * @param[in]       max_rows    Maximum number of rows that can be written to the array.
+ *
+ * @return Number of rows computed.
+ */
+size_t adc_resampler_poll(adc_resampler_t *resampler, uint64_t now_ns, adc_resample_row_t rows[], size_t max_rows);
+
+/**
+ * Compute the rows up to the latest message at the end of the stream of messages. Shall be called
+ * until it returns less than max_rows.
+ *
+ * @param[in,out]   resampler   Resampler.
+ * @param[out]      rows        Rows computed, in order.
+ * @param[in]       max_rows    Maximum number of rows that can be written to the array.
+ *
+ * @return Number of rows computed.
+ */
+size_t adc_resampler_flush(adc_resampler_t *resampler, adc_resample_row_t rows[], size_t max_rows);
+
+#endif
@@ -4,6 +4,7 @@
 */
 
 #include "adc_rs485_decoder.h"
+#include "adc_rs485_labels.h"
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -17,111 +18,62 @@
 /** Carriage return */
 #define CR ((char)0x0Du)
 
-/** Maximum size in byte of the buffer needed to decode one message */
-#define MAX_BUFFER_LENGTH 12
-
-/** Maximum number of label ID per Start Of Header */
-#define NUMBER_OF_LABELS_PER_SOH 15
-
-/** Air data label ID meaning for SOH_1 message */
-static const data_type_t SOH1_LABEL[NUMBER_OF_LABELS_PER_SOH] = {
-    [0] = RS485_DATA_NOT_VALID,
-    [1] = RS485_QC,
-    [2] = RS485_PS,
-    [3] = RS485_AOA,
-    [4] = RS485_AOS,
-    [5] = RS485_CAS,
-    [6] = RS485_TAS,
-    [7] = RS485_HP,
-    [8] = RS485_MACH,
-    [9] = RS485_SAT,
-    [10] = RS485_TAT,
-    [11] = RS485_DATA_NOT_VALID,
-    [12] = RS485_DATA_NOT_VALID,
-    [13] = RS485_DATA_NOT_VALID,
-    [14] = RS485_QNH};
-
-/** Air data label ID meaning for SOH_2 message */
-static const data_type_t SOH2_LABEL[NUMBER_OF_LABELS_PER_SOH] = {
-    [0] = RS485_DATA_NOT_VALID,
-    [1] = RS485_CR,
-    [2] = RS485_PT,
-    [3] = RS485_DATA_NOT_VALID,
-    [4] = RS485_DATA_NOT_VALID,
-    [5] = RS485_CAS_RATE,
-    [6] = RS485_TAS_RATE,
-    [7] = RS485_HBARO,
-    [8] = RS485_DATA_NOT_VALID,
-    [9] = RS485_DATA_NOT_VALID,
-    [10] = RS485_DATA_NOT_VALID,
-    [11] = RS485_DATA_NOT_VALID,
-    [12] = RS485_DTR,
-    [13] = RS485_HTR,
-    [14] = RS485_CUR};
-
-/** Air data label ID meaning for SOH_3 message */
-static const data_type_t SOH3_LABEL[NUMBER_OF_LABELS_PER_SOH] = {
-    [0] = RS485_DATA_NOT_VALID,
-    [1] = RS485_QCRAW,
-    [2] = RS485_PSRAW,
-    [3] = RS485_DPAOA,
-    [4] = RS485_DPAOS,
-    [5] = RS485_IAT,
-    [6] = RS485_BAT,
-    [7] = RS485_DATA_NOT_VALID,
-    [8] = RS485_DATA_NOT_VALID,
-    [9] = RS485_DATA_NOT_VALID,
-    [10] = RS485_STQC,
-    [11] = RS485_STPS,
-    [12] = RS485_STAOA,
-    [13] = RS485_STAOS,
-    [14] = RS485_DATA_NOT_VALID};
-
-/** Air data label ID meaning for SOH_4 message */
-static const data_type_t SOH4_LABEL[NUMBER_OF_LABELS_PER_SOH] = {RS485_DATA_NOT_VALID};
-
-/** Air data label ID meaning for SOH_5 message */
-static const data_type_t SOH5_LABEL[NUMBER_OF_LABELS_PER_SOH] = {
-    [0] = RS485_DATA_NOT_VALID,
-    [1] = RS485_QC_U,
-    [2] = RS485_PS_U,
-    [3] = RS485_HP_U,
-    [4] = RS485_HBARO_U,
-    [5] = RS485_CAS_U,
-    [6] = RS485_TAS_U,
-    [7] = RS485_CR_U,
-    [8] = RS485_DATA_NOT_VALID,
-    [9] = RS485_DATA_NOT_VALID,
-    [10] = RS485_DATA_NOT_VALID,
-    [11] = RS485_DATA_NOT_VALID,
-    [12] = RS485_DATA_NOT_VALID,
-    [13] = RS485_DATA_NOT_VALID,
-    [14] = RS485_DATA_NOT_VALID};
-
-/** Map all labels ber SOH in a 2D table */
-static const data_type_t *soh_label_map[5] = {SOH1_LABEL, SOH2_LABEL, SOH3_LABEL, SOH4_LABEL, SOH5_LABEL};
+/** Key of a label in LABEL_TYPE: start of header in the high nibble, label ID in the low nibble */
+#define LABEL_KEY(soh, label) ((uint8_t)(((soh) << 4) | ((label) & 0x0Fu)))
+
+/** Entry of a label in LABEL_TYPE, 0 if the product the decoder is built for never sends it */
+#define LABEL_TYPE_ENTRY(type, soh, label, products) \
+    [LABEL_KEY(soh, label)] = (((products) & ADC_RS485_PRODUCT) != 0) ? (uint8_t)((type) + 1u) : 0u,
+
+/**
+ * Type of data of every start of header and label ID, plus one, generated from ADC_RS485_LABELS.
+ * The combinations that don't correspond to any data sent by the product are 0.
+ */
+static const uint8_t LABEL_TYPE[256] = {ADC_RS485_LABELS(LABEL_TYPE_ENTRY)};
+
+/** Returns the type of data of a data message, with a single lookup */
+static inline data_type_t rs485_label_type(uint8_t soh, uint8_t label_byte)
+{
+    // A SOH above 0x0F would not fit in the key, no data is sent with such a SOH
+    uint8_t entry = (soh <= 0x0Fu) ? LABEL_TYPE[LABEL_KEY(soh, label_byte)] : 0u;
+
+    return (entry != 0) ? (data_type_t)(entry - 1u) : RS485_DATA_NOT_VALID;
+}
+
+data_type_t adc_rs485_label_type(uint8_t soh, uint8_t label_byte)
+{
+    return rs485_label_type(soh, label_byte);
+}
 
 /** 
- * Verify if the string contains only hexadecimal characters encoded in ASCII.
- * @param[in]   string  String containing an encoded float number.
- * @param[in]   string  String containing an encoded float number.
+ * Value of every ASCII character as hexadecimal digit, plus one. 
+ * Characters that are not an hexadecimal digit ('0' to '9' and 'A' to 'F') are 0.
+ */
+static const uint8_t HEX_DIGIT[256] = {
+    ['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5, ['5'] = 6, ['6'] = 7, ['7'] = 8,
+    ['8'] = 9, ['9'] = 10, ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16};
+
+/** 
+ * Verify and convert a number encoded in hexadecimal characters in ASCII, in a single pass.
+ * @param[in]   string          Hexadecimal characters, most significant digit first.
+ * @param[in]   string_length   Number of characters to convert, at most 8.
+ * @param[out]  bits            Pointer that will contain the converted number. Only valid if the 
+ *                              string is valid.
  * @return TRUE is the string is valid, FALSE otherwise
  */
-static bool rs485_is_string_hexa(char string[], uint8_t string_length)
+static bool rs485_decode_hexa(const uint8_t string[], uint8_t string_length, uint32_t *bits)
 {
-    bool is_hex_valid = true;
+    uint32_t value = 0;
+    uint8_t is_hex_valid = 1;
 
-    for(uint8_t i = 0; i < string_length; i++)
+    for (uint8_t i = 0; i < string_length; i++)
     {
-        // All characters should be between '0' and '9', or between 'A' and 'F'
-        if(((string[i] < '0') || (string[i] > '9')) &&
-           ((string[i] < 'A') || (string[i] > 'F')))
-           {
-               // The character is not valid, exit immediately
-               is_hex_valid = false;
-               break;
-           }
+        // A zero in the table marks an invalid character
+        uint8_t digit = HEX_DIGIT[string[i]];
+        is_hex_valid &= (digit != 0);
+        value = (value << 4) | (uint8_t)(digit - 1u);
     }
+    *bits = value;
     return is_hex_valid;
 }
 
@@ -130,36 +82,35 @@ static bool rs485_is_string_hexa(char string[], uint8_t string_length)
  * @note The message length shall be 11 bytes long.
  * @param[in]   msg     Data received by the air data computer.
  * @param[out]  data    Pointer to an air data that will contain the decoded air data.
+ * @param[out]  error   Reason of the error, only updated if there was an error.
  * @return RS485_ERROR if there was an error decoding the message, RS485_RETURNED_DATA otherwise.
  */
-static rs485_msg_type_t rs485_decode_data(uint8_t msg[], air_data_t *data)
+static rs485_msg_type_t rs485_decode_data(const uint8_t msg[], air_data_t *data, adc_rs485_error_t *error)
 {
-    uint8_t label = msg[1] & 0x0Fu;
-    uint8_t soh = msg[0];
+    data_type_t type = rs485_label_type(msg[0], msg[1]);
     rs485_msg_type_t returned_value = RS485_ERROR;
 
-    if ((soh >= SOH_1) && (soh <= SOH_5) && (label < NUMBER_OF_LABELS_PER_SOH))
+    *error = ADC_RS485_ERROR_LABEL;
+    if (type != RS485_DATA_NOT_VALID)
     {
-        data_type_t type = soh_label_map[soh - 1][label];
+        *error = ADC_RS485_ERROR_HEX;
 
-        if (type != RS485_DATA_NOT_VALID)
+        union
         {
-            // Mark end of string and convert ASCII-hex to integer
-            msg[10] = '\0';
+            uint32_t bits;
+            float value;
+        } converter;
 
-            // Verify that the data bits are well composed only of hexadecimal characters
-            if(rs485_is_string_hexa((char *)&msg[2], 8))
-            {
-                // Cast integer-bits to float
-                int32_t bits = strtoll((char *)&msg[2], NULL, 16);
-                float *value_ptr = (float *)&bits;
-                data->value = *value_ptr;
-
-                // No error, the flag and type can now be updated
-                data->flag = (flag_t)(msg[1] >> 4) & 0x07u;
-                data->type = type;
-                returned_value = RS485_RETURNED_DATA;
-            }
+        // Verify that the data bits are well composed only of hexadecimal characters and convert them
+        if (rs485_decode_hexa(&msg[2], 8, &converter.bits))
+        {
+            // Copy integer-bits to float
+            data->value = converter.value;
+
+            // No error, the flag and type can now be updated
+            data->flag = (flag_t)(msg[1] >> 4) & 0x07u;
+            data->type = type;
+            returned_value = RS485_RETURNED_DATA;
         }
     }
     return returned_value;
@@ -171,32 +122,35 @@ static rs485_msg_type_t rs485_decode_data(uint8_t msg[], air_data_t *data)
  * @param[in]   msg     Data received by the air data computer.
  * @param[out]  gen_st  Pointer to an air data general status that will contain the decoded air data.
  * @param[out]  htr_st  Pointer to an air data heater status that will contain the decoded air data.
+ * @param[out]  error   Reason of the error, only updated if there was an error.
  * @return RS485_ERROR if there was an error decoding the message, the type of status otherwise.
  */
-static rs485_msg_type_t rs485_decode_status(uint8_t msg[], adc_gen_status_t *gen_st, htr_status_t *htr_st)
+static rs485_msg_type_t rs485_decode_status(const uint8_t msg[], adc_gen_status_t *gen_st, htr_status_t *htr_st,
+                                            adc_rs485_error_t *error)
 {
     uint8_t label = msg[1] & 0x0Fu;
     uint8_t soh = msg[0];
     rs485_msg_type_t returned_value = RS485_ERROR;
 
+    *error = ADC_RS485_ERROR_LABEL;
     if (label == 0xFu)
     {
-        // Mark end of string and convert ASCII-hex to integer
-        msg[6] = '\0';
+        uint32_t bits = 0;
 
-        // Verify that the status bits are well composed only of hexadecimal characters
-        if(rs485_is_string_hexa((char *) &msg[2], 4))
+        *error = ADC_RS485_ERROR_HEX;
+
+        // Verify that the status bits are well composed only of hexadecimal characters and convert them
+        if (rs485_decode_hexa(&msg[2], 4, &bits))
         {
-            // Cast ASCII in integer
-            int32_t bits = strtol((char *)&msg[2], NULL, 16);
+            *error = ADC_RS485_ERROR_STATUS_SOH;
             if (soh == SOH_1)
             {
-                gen_st->number = bits;
+                gen_st->number = (uint16_t)bits;
                 returned_value = RS485_RETURNED_STATUS_GEN;
             }
-            else if (soh == SOH_2)
+            else if ((soh == SOH_2) && ADC_RS485_PROFILE_HEATER)
             {
-                htr_st->number = bits;
+                htr_st->number = (uint16_t)bits;
                 returned_value = RS485_RETURNED_STATUS_HTR;
             }
         }
@@ -212,53 +166,329 @@ static rs485_msg_type_t rs485_decode_status(uint8_t msg[], adc_gen_status_t *gen
  * @param[out]  parsed_msg      Pointer that will contain the decoded air data message.
  * @return void
  */
-static void rs485_decode_msg(uint8_t raw_msg[], uint8_t raw_msg_length, adc_rs485_msg_t *parsed_msg)
+static void rs485_decode_msg(const uint8_t raw_msg[], uint8_t raw_msg_length, adc_rs485_msg_t *parsed_msg)
 {
+    adc_rs485_error_t error = ADC_RS485_ERROR_LENGTH;
+
     parsed_msg->msg_type = RS485_ERROR;
 
     if (raw_msg_length == 11)
     {
-        parsed_msg->msg_type = rs485_decode_data(raw_msg, &(parsed_msg->air_data));
+        parsed_msg->msg_type = rs485_decode_data(raw_msg, &(parsed_msg->air_data), &error);
     }
     else if (raw_msg_length == 7)
     {
-        parsed_msg->msg_type = rs485_decode_status(raw_msg, &(parsed_msg->gen_status), &(parsed_msg->htr_status));
+        parsed_msg->msg_type = rs485_decode_status(raw_msg, &(parsed_msg->gen_status), &(parsed_msg->htr_status), &error);
+    }
+
+    if (parsed_msg->msg_type == RS485_ERROR)
+    {
+        parsed_msg->error = error;
     }
 }
 
-adc_rs485_msg_t adc_rs485_decode(char raw_data)
+/** Decoder state used by adc_rs485_decode() */
+static adc_rs485_decoder_t default_decoder = {{0}, 0, 0, 0};
+
+void adc_rs485_decoder_init(adc_rs485_decoder_t *decoder)
 {
-    static uint8_t buffer[MAX_BUFFER_LENGTH] = {0};
-    static uint8_t pos = 0;
+    for (uint8_t i = 0; i < ADC_RS485_BUFFER_LENGTH; i++)
+    {
+        decoder->buffer[i] = 0;
+    }
+    decoder->pos = 0;
+    decoder->truncated = 0;
+    decoder->resync = 0;
+}
 
-    adc_rs485_msg_t returned_message;
-    returned_message.msg_type = RS485_ERROR;
+void adc_rs485_decoder_reset(adc_rs485_decoder_t *decoder)
+{
+    decoder->pos = 0;
+}
+
+/** Returned by rs485_frame_byte() while a message is being received */
+#define FRAME_PENDING 0u
+
+/** Returned by rs485_frame_byte() when the byte can't belong to any message */
+#define FRAME_ERROR UINT8_MAX
+
+/** 
+ * Frames one byte received from an air data computer.
+ * @param[in,out]   decoder     Decoder state of the stream the byte was received on.
+ * @param[in]       raw_data    Raw 8 bits data received by an air data computer.
+ * @param[out]      error       Reason of the error, only updated if FRAME_ERROR is returned.
+ * @return Length of the message completed by the byte, stored in the buffer of the decoder state,
+ * FRAME_PENDING if no message is complete yet or FRAME_ERROR.
+ */
+static inline uint8_t rs485_frame_byte(adc_rs485_decoder_t *decoder, uint8_t raw_data, adc_rs485_error_t *error)
+{
+    uint8_t length = FRAME_PENDING;
 
     if ((raw_data == SOH_1) || (raw_data == SOH_2) || (raw_data == SOH_3) || (raw_data == SOH_5))
     {
-        // A SOH marks the beggining of a message
-        buffer[0] = (uint8_t)raw_data;
-        pos = 1;
-        returned_message.msg_type = RS485_PENDING;
+        // A SOH marks the beggining of a message, the previous one is lost if it wasn't complete
+        if (decoder->pos > 0)
+        {
+            decoder->truncated++;
+        }
+        decoder->buffer[0] = raw_data;
+        decoder->pos = 1;
     }
-    else if ((pos > 0) && (pos < MAX_BUFFER_LENGTH))
+    else if ((decoder->pos > 0) && (decoder->pos < ADC_RS485_BUFFER_LENGTH))
     {
         // Store the byte received
-        buffer[pos] = (uint8_t)raw_data;
+        decoder->buffer[decoder->pos] = raw_data;
 
         if (raw_data == CR)
         {
-            // A carriage return marks the end of a message, decode
-            rs485_decode_msg(buffer, pos + 1, &returned_message);
-            pos = 0;
+            // A carriage return marks the end of a message
+            length = decoder->pos + 1;
+            decoder->pos = 0;
         }
         else
         {
             // Current message is not totally received
-            pos++;
-            returned_message.msg_type = RS485_PENDING;
+            decoder->pos++;
         }
     }
+    else if (decoder->pos == ADC_RS485_BUFFER_LENGTH)
+    {
+        // The message is longer than any message, the next bytes are discarded until a SOH
+        *error = ADC_RS485_ERROR_TOO_LONG;
+        length = FRAME_ERROR;
+        decoder->pos = 0;
+    }
+    else
+    {
+        *error = ADC_RS485_ERROR_NO_SOH;
+        length = FRAME_ERROR;
+        decoder->resync++;
+    }
+    return length;
+}
+
+/** 
+ * Processes one byte received from an air data computer.
+ * @param[in,out]   decoder     Decoder state of the stream the byte was received on.
+ * @param[in]       raw_data    Raw 8 bits data received by an air data computer.
+ * @param[out]      msg         Pointer that will contain the decoded message. Only the message 
+ *                              type is updated while the message is pending.
+ * @return void
+ */
+static inline void rs485_decode_byte(adc_rs485_decoder_t *decoder, uint8_t raw_data, adc_rs485_msg_t *msg)
+{
+    uint8_t length = rs485_frame_byte(decoder, raw_data, &msg->error);
+
+    if (length == FRAME_PENDING)
+    {
+        msg->msg_type = RS485_PENDING;
+    }
+    else if (length == FRAME_ERROR)
+    {
+        msg->msg_type = RS485_ERROR;
+    }
+    else
+    {
+        // A carriage return marks the end of a message, decode
+        rs485_decode_msg(decoder->buffer, length, msg);
+    }
+}
+
+/** 
+ * Decodes an entire message and calls its handler.
+ * @param[in]   dispatch        Handlers of the messages.
+ * @param[in]   raw_msg         Data received by the air data computer.
+ * @param[in]   raw_msg_length  Length of the message received.
+ * @return Number of handlers called, 0 or 1.
+ */
+static size_t rs485_dispatch_msg(const adc_rs485_dispatch_t *dispatch, const uint8_t raw_msg[], uint8_t raw_msg_length)
+{
+    adc_rs485_error_t error = ADC_RS485_ERROR_LENGTH;
+    uint32_t bits = 0;
+
+    if (raw_msg_length == 11)
+    {
+        data_type_t type = rs485_label_type(raw_msg[0], raw_msg[1]);
 
+        error = ADC_RS485_ERROR_LABEL;
+        if (type != RS485_DATA_NOT_VALID)
+        {
+            adc_rs485_data_handler_t handler = dispatch->data[type];
+
+            // Nobody subscribed to this data, don't even convert it
+            if (handler == NULL)
+            {
+                return 0;
+            }
+
+            error = ADC_RS485_ERROR_HEX;
+            if (rs485_decode_hexa(&raw_msg[2], 8, &bits))
+            {
+                union
+                {
+                    uint32_t bits;
+                    float value;
+                } converter = {.bits = bits};
+
+                handler(type, converter.value, (flag_t)((raw_msg[1] >> 4) & 0x07u), dispatch->data_user[type]);
+                return 1;
+            }
+        }
+    }
+    else if (raw_msg_length == 7)
+    {
+        adc_gen_status_t gen_status;
+        htr_status_t htr_status;
+        rs485_msg_type_t msg_type = rs485_decode_status(raw_msg, &gen_status, &htr_status, &error);
+
+        if ((msg_type == RS485_RETURNED_STATUS_GEN) && (dispatch->gen_status != NULL))
+        {
+            dispatch->gen_status(gen_status, dispatch->gen_status_user);
+            return 1;
+        }
+        if ((msg_type == RS485_RETURNED_STATUS_HTR) && (dispatch->htr_status != NULL))
+        {
+            dispatch->htr_status(htr_status, dispatch->htr_status_user);
+            return 1;
+        }
+        if (msg_type != RS485_ERROR)
+        {
+            return 0;
+        }
+    }
+
+    if (dispatch->error == NULL)
+    {
+        return 0;
+    }
+    dispatch->error(error, dispatch->error_user);
+    return 1;
+}
+
+void adc_rs485_dispatch_init(adc_rs485_dispatch_t *dispatch)
+{
+    for (uint32_t type = 0; type < RS485_DATA_NOT_VALID; type++)
+    {
+        dispatch->data[type] = NULL;
+        dispatch->data_user[type] = NULL;
+    }
+    adc_rs485_dispatch_on_gen_status(dispatch, NULL, NULL);
+    adc_rs485_dispatch_on_htr_status(dispatch, NULL, NULL);
+    adc_rs485_dispatch_on_error(dispatch, NULL, NULL);
+}
+
+int32_t adc_rs485_dispatch_on_data(adc_rs485_dispatch_t *dispatch, data_type_t type, adc_rs485_data_handler_t handler, void *user)
+{
+    // A handler of a data the product never sends would never be called
+    if (!adc_rs485_profile_sends(type))
+    {
+        return EXIT_FAILURE;
+    }
+    dispatch->data[type] = handler;
+    dispatch->data_user[type] = user;
+    return EXIT_SUCCESS;
+}
+
+void adc_rs485_dispatch_on_gen_status(adc_rs485_dispatch_t *dispatch, adc_rs485_gen_status_handler_t handler, void *user)
+{
+    dispatch->gen_status = handler;
+    dispatch->gen_status_user = user;
+}
+
+void adc_rs485_dispatch_on_htr_status(adc_rs485_dispatch_t *dispatch, adc_rs485_htr_status_handler_t handler, void *user)
+{
+    dispatch->htr_status = handler;
+    dispatch->htr_status_user = user;
+}
+
+void adc_rs485_dispatch_on_error(adc_rs485_dispatch_t *dispatch, adc_rs485_error_handler_t handler, void *user)
+{
+    dispatch->error = handler;
+    dispatch->error_user = user;
+}
+
+size_t adc_rs485_decoder_dispatch(adc_rs485_decoder_t *decoder, const adc_rs485_dispatch_t *dispatch,
+                                  const uint8_t data[], size_t length)
+{
+    size_t called = 0;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        adc_rs485_error_t error;
+        uint8_t msg_length = rs485_frame_byte(decoder, data[i], &error);
+
+        if (msg_length == FRAME_ERROR)
+        {
+            // A byte outside of a message is only counted in the resync counter, as by the buffer decoders
+            if ((dispatch->error != NULL) && (error != ADC_RS485_ERROR_NO_SOH))
+            {
+                dispatch->error(error, dispatch->error_user);
+                called++;
+            }
+        }
+        else if (msg_length != FRAME_PENDING)
+        {
+            called += rs485_dispatch_msg(dispatch, decoder->buffer, msg_length);
+        }
+    }
+    return called;
+}
+
+adc_rs485_msg_t adc_rs485_decoder_decode(adc_rs485_decoder_t *decoder, char raw_data)
+{
+    adc_rs485_msg_t returned_message;
+    rs485_decode_byte(decoder, (uint8_t)raw_data, &returned_message);
     return returned_message;
 }
+
+/**
+ * Decodes all bytes of a buffer, see adc_rs485_decoder_decode_buffer_ends().
+ * Inlined in both public functions, so that the offsets cost nothing when ends is NULL.
+ */
+static inline size_t rs485_decode_buffer(adc_rs485_decoder_t *decoder, const uint8_t data[], size_t length,
+                                         adc_rs485_msg_t msgs[], size_t ends[], size_t max_msgs, size_t *consumed)
+{
+    size_t msg_count = 0;
+    size_t i = 0;
+
+    while ((i < length) && (msg_count < max_msgs))
+    {
+        // Decode directly in the caller's array, the slot is only kept if a message was completed
+        adc_rs485_msg_t *msg = &msgs[msg_count];
+        rs485_decode_byte(decoder, data[i], msg);
+
+        // The bytes discarded until the next SOH are only counted in the decoder state
+        if ((msg->msg_type != RS485_PENDING) && ((msg->msg_type != RS485_ERROR) || (msg->error != ADC_RS485_ERROR_NO_SOH)))
+        {
+            if (ends != NULL)
+            {
+                ends[msg_count] = i;
+            }
+            msg_count++;
+        }
+        i++;
+    }
+
+    if (consumed != NULL)
+    {
+        *consumed = i;
+    }
+    return msg_count;
+}
+
+size_t adc_rs485_decoder_decode_buffer(adc_rs485_decoder_t *decoder, const uint8_t data[], size_t length,
+                                       adc_rs485_msg_t msgs[], size_t max_msgs, size_t *consumed)
+{
+    return rs485_decode_buffer(decoder, data, length, msgs, NULL, max_msgs, consumed);
+}
+
+size_t adc_rs485_decoder_decode_buffer_ends(adc_rs485_decoder_t *decoder, const uint8_t data[], size_t length,
+                                            adc_rs485_msg_t msgs[], size_t ends[], size_t max_msgs, size_t *consumed)
+{
+    return rs485_decode_buffer(decoder, data, length, msgs, ends, max_msgs, consumed);
+}
+
+adc_rs485_msg_t adc_rs485_decode(char raw_data)
+{
+    return adc_rs485_decoder_decode(&default_decoder, raw_data);
+}
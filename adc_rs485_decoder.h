@@ -19,6 +19,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 /** Flag returned by the air data computer associated with the a value */
 typedef enum
@@ -149,6 +150,19 @@ typedef enum
     RS485_ERROR = 4                /**< An error happened during the decoding of the message */
 } rs485_msg_type_t;
 
+/** Reason why the air data rs485 decoder returned RS485_ERROR */
+typedef enum
+{
+    ADC_RS485_ERROR_NO_SOH = 0,     /**< Byte received outside of a message, discarded until the next start of header.
+                                         Only returned by the decoders called per byte */
+    ADC_RS485_ERROR_TOO_LONG = 1,   /**< No carriage return within the length of the longest message */
+    ADC_RS485_ERROR_LENGTH = 2,     /**< Carriage return received neither at the end of a data nor of a status message */
+    ADC_RS485_ERROR_LABEL = 3,      /**< Label ID that doesn't correspond to any data or status for this start of header */
+    ADC_RS485_ERROR_STATUS_SOH = 4, /**< Status message with a start of header that has no status */
+    ADC_RS485_ERROR_HEX = 5,        /**< Character that is not an hexadecimal digit */
+    ADC_RS485_ERROR_COUNT = 6       /**< Number of reasons */
+} adc_rs485_error_t;
+
 /** Decoded RS485 air data message sent by a swiss air-data computer*/
 typedef struct
 {
@@ -158,13 +172,241 @@ typedef struct
         air_data_t air_data;
         adc_gen_status_t gen_status;
         htr_status_t htr_status;
+        adc_rs485_error_t error;   /**< Reason of an RS485_ERROR message */
     };
     
 }adc_rs485_msg_t;
 
+/**
+ * Returns the type of data carried by a data message.
+ *
+ * @param[in]   soh         Start of header of the message (first byte).
+ * @param[in]   label_byte  Label and flag byte of the message (second byte). Only the label ID in 
+ *                          the 4 least significant bits is used.
+ *
+ * @return Type of data of the message, RS485_DATA_NOT_VALID if the SOH and label ID combination
+ * doesn't correspond to any data sent by the product the decoder is built for (see adc_rs485_labels.h).
+ */
+data_type_t adc_rs485_label_type(uint8_t soh, uint8_t label_byte);
+
+/** Maximum size in byte of the buffer needed to decode one message */
+#define ADC_RS485_BUFFER_LENGTH 12
+
+/**
+ * State of one RS485 decoder. 
+ * 
+ * Every serial stream shall use its own decoder state. Different decoder states do not share any 
+ * data and can be used concurrently from different threads.
+ */
+typedef struct
+{
+    uint8_t buffer[ADC_RS485_BUFFER_LENGTH]; /**< Bytes of the message currently being received */
+    uint8_t pos;                             /**< Number of bytes stored in the buffer, 0 when waiting for a SOH */
+    uint32_t truncated;                      /**< Number of messages interrupted by a SOH before their carriage return */
+    uint64_t resync;                         /**< Number of bytes received outside of a message, discarded until the next SOH */
+} adc_rs485_decoder_t;
+
+/**
+ * Initialize a decoder state. Shall be called once before the decoder state is used.
+ *
+ * @param[out]  decoder     Decoder state to initialize.
+ */
+void adc_rs485_decoder_init(adc_rs485_decoder_t *decoder);
+
+/**
+ * Reset a decoder state. Any partially received message is discarded and the decoder waits for 
+ * the next start of header.
+ *
+ * @param[in,out]   decoder     Decoder state to reset.
+ */
+void adc_rs485_decoder_reset(adc_rs485_decoder_t *decoder);
+
+/**
+ * Decodes a message transmitted by a swiss air-data computer through RS485, using the given 
+ * decoder state.
+ * 
+ * This function shall be called everytime a new byte has been received on the stream that
+ * belongs to the decoder state. It behaves exactly like adc_rs485_decode().
+ *
+ * @param[in,out]   decoder     Decoder state of the stream the byte was received on.
+ * @param[in]       raw_data    Raw 8 bits data received by an air data computer.
+ *
+ * @return Decoded air data message.
+ */
+adc_rs485_msg_t adc_rs485_decoder_decode(adc_rs485_decoder_t *decoder, char raw_data);
+
+/**
+ * Decodes all bytes of a buffer received from a swiss air-data computer through RS485, using the 
+ * given decoder state.
+ *
+ * The bytes are processed exactly as if adc_rs485_decoder_decode() had been called for each of
+ * them, but only the completed messages are written to the message array: neither RS485_PENDING
+ * nor the ADC_RS485_ERROR_NO_SOH error of every byte received outside of a message, which are only
+ * counted in the resync counter of the decoder state.
+ * Decoding stops at the end of the buffer or as soon as the message array is full. A message that
+ * is not completely received at the end of the buffer is kept in the decoder state and completed by
+ * the next call.
+ *
+ * @param[in,out]   decoder     Decoder state of the stream the bytes were received on.
+ * @param[in]       data        Raw bytes received by an air data computer.
+ * @param[in]       length      Number of bytes in the buffer.
+ * @param[out]      msgs        Array that will contain the decoded messages.
+ * @param[in]       max_msgs    Maximum number of messages that can be written to the array.
+ * @param[out]      consumed    Number of bytes of the buffer that have been processed. Can be NULL
+ *                              if the caller doesn't need this information.
+ *
+ * @return Number of messages written to the message array.
+ */
+size_t adc_rs485_decoder_decode_buffer(adc_rs485_decoder_t *decoder, const uint8_t data[], size_t length,
+                                       adc_rs485_msg_t msgs[], size_t max_msgs, size_t *consumed);
+
+/**
+ * Decodes all bytes of a buffer exactly like adc_rs485_decoder_decode_buffer(), and also returns
+ * where every message ends, e.g. to compute back when its carriage return has been received.
+ *
+ * @param[in,out]   decoder     Decoder state of the stream the bytes were received on.
+ * @param[in]       data        Raw bytes received by an air data computer.
+ * @param[in]       length      Number of bytes in the buffer.
+ * @param[out]      msgs        Array that will contain the decoded messages.
+ * @param[out]      ends        Array that will contain, for every message, the offset in the buffer of
+ *                              the byte that completed it, usually its carriage return.
+ * @param[in]       max_msgs    Maximum number of messages that can be written to both arrays.
+ * @param[out]      consumed    Number of bytes of the buffer that have been processed. Can be NULL
+ *                              if the caller doesn't need this information.
+ *
+ * @return Number of messages written to the message array.
+ */
+size_t adc_rs485_decoder_decode_buffer_ends(adc_rs485_decoder_t *decoder, const uint8_t data[], size_t length,
+                                            adc_rs485_msg_t msgs[], size_t ends[], size_t max_msgs, size_t *consumed);
+
+/**
+ * Function called with a data message decoded by adc_rs485_decoder_dispatch().
+ *
+ * @param[in]   type    Type of data of the message, the one the handler has been registered for.
+ * @param[in]   value   Value of the data.
+ * @param[in]   flag    Flag of the data.
+ * @param[in]   user    User pointer given at registration.
+ */
+typedef void (*adc_rs485_data_handler_t)(data_type_t type, float value, flag_t flag, void *user);
+
+/**
+ * Function called with a general status message decoded by adc_rs485_decoder_dispatch().
+ *
+ * @param[in]   status  Decoded general status.
+ * @param[in]   user    User pointer given at registration.
+ */
+typedef void (*adc_rs485_gen_status_handler_t)(adc_gen_status_t status, void *user);
+
+/**
+ * Function called with a heater status message decoded by adc_rs485_decoder_dispatch().
+ *
+ * @param[in]   status  Decoded heater status.
+ * @param[in]   user    User pointer given at registration.
+ */
+typedef void (*adc_rs485_htr_status_handler_t)(htr_status_t status, void *user);
+
+/**
+ * Function called for every message that adc_rs485_decoder_dispatch() couldn't decode. It is not
+ * called for the bytes received outside of a message, which are only counted in the resync counter
+ * of the decoder state.
+ *
+ * @param[in]   error   Reason of the error.
+ * @param[in]   user    User pointer given at registration.
+ */
+typedef void (*adc_rs485_error_handler_t)(adc_rs485_error_t error, void *user);
+
+/**
+ * Handlers called by adc_rs485_decoder_dispatch(), one per type of data, per status and for the
+ * errors. A NULL handler means that nobody subscribed to the message: it is skipped as early as
+ * possible, a data message without handler is not even converted.
+ *
+ * The table is only read while decoding and can be shared by several decoder states.
+ */
+typedef struct
+{
+    adc_rs485_data_handler_t data[RS485_DATA_NOT_VALID];
+    void *data_user[RS485_DATA_NOT_VALID];
+    adc_rs485_gen_status_handler_t gen_status;
+    void *gen_status_user;
+    adc_rs485_htr_status_handler_t htr_status;
+    void *htr_status_user;
+    adc_rs485_error_handler_t error;
+    void *error_user;
+} adc_rs485_dispatch_t;
+
+/**
+ * Initialize a dispatch table without any handler.
+ *
+ * @param[out]  dispatch    Dispatch table to initialize.
+ */
+void adc_rs485_dispatch_init(adc_rs485_dispatch_t *dispatch);
+
+/**
+ * Register the handler of one type of data, replacing the previous one.
+ *
+ * @param[in,out]   dispatch    Dispatch table.
+ * @param[in]       type        Type of data.
+ * @param[in]       handler     Function called with every message of this type, NULL to unsubscribe.
+ * @param[in]       user        User pointer passed to the handler.
+ *
+ * @return EXIT_FAILURE if the type of data is not valid or never sent by the product the decoder is
+ * built for, EXIT_SUCCESS otherwise.
+ */
+int32_t adc_rs485_dispatch_on_data(adc_rs485_dispatch_t *dispatch, data_type_t type, adc_rs485_data_handler_t handler, void *user);
+
+/**
+ * Register the handler of the general status, replacing the previous one.
+ *
+ * @param[in,out]   dispatch    Dispatch table.
+ * @param[in]       handler     Function called with every general status, NULL to unsubscribe.
+ * @param[in]       user        User pointer passed to the handler.
+ */
+void adc_rs485_dispatch_on_gen_status(adc_rs485_dispatch_t *dispatch, adc_rs485_gen_status_handler_t handler, void *user);
+
+/**
+ * Register the handler of the heater status, replacing the previous one.
+ *
+ * @param[in,out]   dispatch    Dispatch table.
+ * @param[in]       handler     Function called with every heater status, NULL to unsubscribe.
+ * @param[in]       user        User pointer passed to the handler.
+ */
+void adc_rs485_dispatch_on_htr_status(adc_rs485_dispatch_t *dispatch, adc_rs485_htr_status_handler_t handler, void *user);
+
+/**
+ * Register the handler of the errors, replacing the previous one.
+ *
+ * @param[in,out]   dispatch    Dispatch table.
+ * @param[in]       handler     Function called for every message that couldn't be decoded, NULL to unsubscribe.
+ * @param[in]       user        User pointer passed to the handler.
+ */
+void adc_rs485_dispatch_on_error(adc_rs485_dispatch_t *dispatch, adc_rs485_error_handler_t handler, void *user);
+
+/**
+ * Decodes all bytes of a buffer received from a swiss air-data computer through RS485 and calls
+ * the handler registered for every message, in the order of the messages.
+ *
+ * The bytes are framed exactly as by adc_rs485_decoder_decode(), but no message is returned: the
+ * handlers are called directly from the dispatch table with the decoded values. Messages without
+ * handler are skipped, so that the hexadecimal digits of a data message nobody subscribed to are
+ * neither checked nor converted. This function can be called with a single byte, e.g. from the
+ * interrupt routine of a serial port.
+ *
+ * @param[in,out]   decoder     Decoder state of the stream the bytes were received on.
+ * @param[in]       dispatch    Handlers of the messages.
+ * @param[in]       data        Raw bytes received by an air data computer.
+ * @param[in]       length      Number of bytes in the buffer.
+ *
+ * @return Number of handlers called.
+ */
+size_t adc_rs485_decoder_dispatch(adc_rs485_decoder_t *decoder, const adc_rs485_dispatch_t *dispatch,
+                                  const uint8_t data[], size_t length);
+
 /**
  * Decodes a message transmitted by a swiss air-data computer through RS485.
  * 
+ * This function uses a single decoder state shared by the whole program and is therefore not
+ * thread-safe. Use adc_rs485_decoder_decode() to decode several streams.
+ *
  * This function shall be called everytime a new byte has been received.
  * If the byte is the last of a message and this message was decoded successfully, an rs485 air data 
  * message will be returned.
@@ -0,0 +1,136 @@
+/*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*/
+
+#include "adc_rs485_encoder.h"
+#include "adc_rs485_decoder.h"
+#include "adc_rs485_labels.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Start of header of a data packet */
+#define SOH_1 0x01u
+#define SOH_2 0x02u
+
+/** Carriage return */
+#define CR 0x0Du
+
+/** Set in every label byte so that it differs from any SOH and from CR */
+#define LABEL_MARK 0x80u
+
+/** Label ID of the status messages */
+#define STATUS_LABEL 0x0Fu
+
+/** Start of header and label ID of a type of data */
+typedef struct
+{
+    uint8_t soh;
+    uint8_t label;
+} label_address_t;
+
+/** Entry of a type of data in LABEL_ADDRESS */
+#define LABEL_ADDRESS_ENTRY(type, soh, label, products) [type] = {soh, label},
+
+/**
+ * Start of header and label ID per data_type_t, generated from the same description as the lookup
+ * table of the decoder. The labels of every product are encoded, whatever the decoder is built for.
+ */
+static const label_address_t LABEL_ADDRESS[RS485_DATA_NOT_VALID] = {ADC_RS485_LABELS(LABEL_ADDRESS_ENTRY)};
+
+/** Uppercase hexadecimal digits, as sent by the air data computers */
+static const uint8_t HEX_CHAR[16] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'};
+
+/**
+ * Encode a number in hexadecimal characters in ASCII, most significant digit first.
+ * @param[in]   bits            Number to encode.
+ * @param[in]   string_length   Number of digits.
+ * @param[out]  string          Array that will contain the digits.
+ */
+static void rs485_encode_hexa(uint32_t bits, uint8_t string_length, uint8_t string[])
+{
+    for (uint8_t i = string_length; i > 0; i--)
+    {
+        string[i - 1u] = HEX_CHAR[bits & 0x0Fu];
+        bits >>= 4;
+    }
+}
+
+/** Encode a status frame */
+static size_t rs485_encode_status(uint8_t soh, uint16_t bits, uint8_t frame[])
+{
+    frame[0] = soh;
+    frame[1] = LABEL_MARK | STATUS_LABEL;
+    rs485_encode_hexa(bits, 4, &frame[2]);
+    frame[6] = CR;
+    return ADC_RS485_STATUS_FRAME_LENGTH;
+}
+
+bool adc_rs485_label_of(data_type_t type, uint8_t *soh, uint8_t *label)
+{
+    if ((uint32_t)type >= RS485_DATA_NOT_VALID)
+    {
+        return false;
+    }
+    *soh = LABEL_ADDRESS[type].soh;
+    *label = LABEL_ADDRESS[type].label;
+    return true;
+}
+
+size_t adc_rs485_encode_data(const air_data_t *data, uint8_t frame[])
+{
+    uint8_t soh;
+    uint8_t label;
+
+    if (!adc_rs485_label_of(data->type, &soh, &label) || ((uint32_t)data->flag > 0x07u))
+    {
+        return 0;
+    }
+
+    union
+    {
+        uint32_t bits;
+        float value;
+    } converter;
+
+    // Copy float to integer-bits
+    converter.value = data->value;
+
+    frame[0] = soh;
+    frame[1] = (uint8_t)(LABEL_MARK | ((uint32_t)data->flag << 4) | label);
+    rs485_encode_hexa(converter.bits, 8, &frame[2]);
+    frame[10] = CR;
+    return ADC_RS485_DATA_FRAME_LENGTH;
+}
+
+size_t adc_rs485_encode_gen_status(adc_gen_status_t status, uint8_t frame[])
+{
+    return rs485_encode_status(SOH_1, status.number, frame);
+}
+
+size_t adc_rs485_encode_htr_status(htr_status_t status, uint8_t frame[])
+{
+    return rs485_encode_status(SOH_2, status.number, frame);
+}
+
+size_t adc_rs485_encode(const adc_rs485_msg_t *msg, uint8_t frame[])
+{
+    size_t length = 0;
+
+    switch (msg->msg_type)
+    {
+    case RS485_RETURNED_DATA:
+        length = adc_rs485_encode_data(&msg->air_data, frame);
+        break;
+    case RS485_RETURNED_STATUS_GEN:
+        length = adc_rs485_encode_gen_status(msg->gen_status, frame);
+        break;
+    case RS485_RETURNED_STATUS_HTR:
+        length = adc_rs485_encode_htr_status(msg->htr_status, frame);
+        break;
+    default:
+        break;
+    }
+    return length;
+}
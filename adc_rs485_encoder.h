@@ -0,0 +1,87 @@
+/**
+* This module encodes messages in the RS485 format of the swiss air-data computers. It is the
+* inverse of the decoder: a message encoded by this module is decoded back to the same message.
+*
+* The label byte of every frame has its most significant bit set, so that it can never be
+* mistaken for a start of header or a carriage return.
+*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*
+* Example code only. Use at own risk.
+*
+* This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* Simtec AG has no obligation to provide maintenance, support,  updates, enhancements, or modifications.
+*/
+
+#ifndef RS485_ENCODER_H
+#define RS485_ENCODER_H
+
+#include "adc_rs485_decoder.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/** Length in bytes of a data frame: SOH, label, 8 hexadecimal digits and CR */
+#define ADC_RS485_DATA_FRAME_LENGTH 11
+
+/** Length in bytes of a status frame: SOH, label, 4 hexadecimal digits and CR */
+#define ADC_RS485_STATUS_FRAME_LENGTH 7
+
+/** Maximum length in bytes of any frame */
+#define ADC_RS485_MAX_FRAME_LENGTH ADC_RS485_DATA_FRAME_LENGTH
+
+/**
+ * Returns the start of header and label ID of a type of data.
+ *
+ * @param[in]   type    Type of data.
+ * @param[out]  soh     Start of header of the messages carrying this type of data.
+ * @param[out]  label   Label ID of the messages carrying this type of data.
+ *
+ * @return false if the type of data is not valid, true otherwise.
+ */
+bool adc_rs485_label_of(data_type_t type, uint8_t *soh, uint8_t *label);
+
+/**
+ * Encode a data message.
+ *
+ * @param[in]   data    Type, value and flag of the data.
+ * @param[out]  frame   Array of at least ADC_RS485_DATA_FRAME_LENGTH bytes that will contain the frame.
+ *
+ * @return Length of the frame, 0 if the type of data or the flag is not valid.
+ */
+size_t adc_rs485_encode_data(const air_data_t *data, uint8_t frame[]);
+
+/**
+ * Encode a general status message.
+ *
+ * @param[in]   status  General status.
+ * @param[out]  frame   Array of at least ADC_RS485_STATUS_FRAME_LENGTH bytes that will contain the frame.
+ *
+ * @return Length of the frame.
+ */
+size_t adc_rs485_encode_gen_status(adc_gen_status_t status, uint8_t frame[]);
+
+/**
+ * Encode a heater status message.
+ *
+ * @param[in]   status  Heater status.
+ * @param[out]  frame   Array of at least ADC_RS485_STATUS_FRAME_LENGTH bytes that will contain the frame.
+ *
+ * @return Length of the frame.
+ */
+size_t adc_rs485_encode_htr_status(htr_status_t status, uint8_t frame[]);
+
+/**
+ * Encode any message that the decoder can return.
+ *
+ * @param[in]   msg     Message, of type RS485_RETURNED_DATA, RS485_RETURNED_STATUS_GEN or
+ *                      RS485_RETURNED_STATUS_HTR.
+ * @param[out]  frame   Array of at least ADC_RS485_MAX_FRAME_LENGTH bytes that will contain the frame.
+ *
+ * @return Length of the frame, 0 if the message can't be encoded.
+ */
+size_t adc_rs485_encode(const adc_rs485_msg_t *msg, uint8_t frame[]);
+
+#endif
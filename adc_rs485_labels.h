@@ -0,0 +1,118 @@
+/**
+* This module describes, in a single place, every data label that swiss air-data computers send
+* through RS485: its type of data, its start of header, its label ID and the products that send it.
+* The lookup table of the decoder and the label addresses of the encoder are generated from it.
+*
+* The decoder can be specialized at compile time for one product by defining ADC_RS485_PRODUCT,
+* e.g. -DADC_RS485_PRODUCT=ADC_RS485_PRODUCT_AOA16: the labels the product never sends are then
+* rejected as unknown labels, like the labels no product sends, and the heater status is rejected
+* by the products without heater. Without it, the labels of every product are accepted.
+*
+* Only depends on the C standard headers, like the decoder.
+*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*
+* Example code only. Use at own risk.
+*
+* This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* Simtec AG has no obligation to provide maintenance, support,  updates, enhancements, or modifications.
+*/
+
+#ifndef RS485_LABELS_H
+#define RS485_LABELS_H
+
+#include "adc_rs485_decoder.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Products, one bit each */
+#define ADC_RS485_PRODUCT_ADC10 0x01u  /**< ADC-10 air data computer */
+#define ADC_RS485_PRODUCT_ADS12 0x02u  /**< ADS-12 air data system */
+#define ADC_RS485_PRODUCT_AOA16 0x04u  /**< AOA-16 angle of attack computer */
+#define ADC_RS485_PRODUCT_ADP55 0x08u  /**< ADP-5.5 air data probe */
+#define ADC_RS485_PRODUCT_PSS8 0x10u   /**< PSS-8 pressure sensor system */
+#define ADC_RS485_PRODUCT_PMH 0x20u    /**< PMH pressure module */
+#define ADC_RS485_PRODUCT_ALL 0x3Fu
+
+/** Product the decoder is built for, all products by default */
+#ifndef ADC_RS485_PRODUCT
+#define ADC_RS485_PRODUCT ADC_RS485_PRODUCT_ALL
+#endif
+
+/**
+ * Every data label, as X(type, soh, label ID, products), the products listed being the ones that
+ * send the label. A product missing from a row never sends the label, so that a profile built for
+ * it rejects the label.
+ *
+ * The ICDs are not distributed with this code. The products of every row shall be checked against
+ * the data label table of the ICD revision of the units before a profile is used in a product: a
+ * product missing by mistake makes its profile reject a label the unit sends.
+ */
+#define ADC_RS485_LABELS(X)                                                                                                  \
+    X(RS485_QC, 1, 1, ADC_RS485_PRODUCT_ALL)                                                                                 \
+    X(RS485_PS, 1, 2, ADC_RS485_PRODUCT_ALL)                                                                                 \
+    X(RS485_AOA, 1, 3, ADC_RS485_PRODUCT_ADS12 | ADC_RS485_PRODUCT_AOA16 | ADC_RS485_PRODUCT_ADP55)                          \
+    X(RS485_AOS, 1, 4, ADC_RS485_PRODUCT_ADS12 | ADC_RS485_PRODUCT_AOA16 | ADC_RS485_PRODUCT_ADP55)                          \
+    X(RS485_CAS, 1, 5, ADC_RS485_PRODUCT_ADC10 | ADC_RS485_PRODUCT_ADS12 | ADC_RS485_PRODUCT_AOA16 | ADC_RS485_PRODUCT_PSS8) \
+    X(RS485_TAS, 1, 6, ADC_RS485_PRODUCT_ADC10 | ADC_RS485_PRODUCT_ADS12 | ADC_RS485_PRODUCT_AOA16)                          \
+    X(RS485_HP, 1, 7, ADC_RS485_PRODUCT_ADC10 | ADC_RS485_PRODUCT_ADS12 | ADC_RS485_PRODUCT_AOA16 | ADC_RS485_PRODUCT_PSS8)  \
+    X(RS485_MACH, 1, 8, ADC_RS485_PRODUCT_ADC10 | ADC_RS485_PRODUCT_ADS12)                                                   \
+    X(RS485_SAT, 1, 9, ADC_RS485_PRODUCT_ADC10 | ADC_RS485_PRODUCT_ADS12)                                                    \
+    X(RS485_TAT, 1, 10, ADC_RS485_PRODUCT_ADC10 | ADC_RS485_PRODUCT_ADS12)                                                   \
+    X(RS485_QNH, 1, 14, ADC_RS485_PRODUCT_ADC10 | ADC_RS485_PRODUCT_ADS12)                                                   \
+    X(RS485_CR, 2, 1, ADC_RS485_PRODUCT_ADC10 | ADC_RS485_PRODUCT_ADS12 | ADC_RS485_PRODUCT_AOA16)                           \
+    X(RS485_PT, 2, 2, ADC_RS485_PRODUCT_ADC10 | ADC_RS485_PRODUCT_ADS12 | ADC_RS485_PRODUCT_ADP55)                           \
+    X(RS485_CAS_RATE, 2, 5, ADC_RS485_PRODUCT_ADC10 | ADC_RS485_PRODUCT_ADS12)                                               \
+    X(RS485_TAS_RATE, 2, 6, ADC_RS485_PRODUCT_ADC10 | ADC_RS485_PRODUCT_ADS12)                                               \
+    X(RS485_HBARO, 2, 7, ADC_RS485_PRODUCT_ADC10 | ADC_RS485_PRODUCT_ADS12)                                                  \
+    X(RS485_DTR, 2, 12, ADC_RS485_PRODUCT_ADS12 | ADC_RS485_PRODUCT_AOA16 | ADC_RS485_PRODUCT_ADP55)                         \
+    X(RS485_HTR, 2, 13, ADC_RS485_PRODUCT_ADS12 | ADC_RS485_PRODUCT_AOA16 | ADC_RS485_PRODUCT_ADP55)                         \
+    X(RS485_CUR, 2, 14, ADC_RS485_PRODUCT_ADS12 | ADC_RS485_PRODUCT_AOA16 | ADC_RS485_PRODUCT_ADP55)                         \
+    X(RS485_QCRAW, 3, 1, ADC_RS485_PRODUCT_ADP55 | ADC_RS485_PRODUCT_PSS8 | ADC_RS485_PRODUCT_PMH)                           \
+    X(RS485_PSRAW, 3, 2, ADC_RS485_PRODUCT_ADP55 | ADC_RS485_PRODUCT_PSS8 | ADC_RS485_PRODUCT_PMH)                           \
+    X(RS485_DPAOA, 3, 3, ADC_RS485_PRODUCT_ADS12 | ADC_RS485_PRODUCT_AOA16 | ADC_RS485_PRODUCT_ADP55)                        \
+    X(RS485_DPAOS, 3, 4, ADC_RS485_PRODUCT_ADS12 | ADC_RS485_PRODUCT_AOA16 | ADC_RS485_PRODUCT_ADP55)                        \
+    X(RS485_IAT, 3, 5, ADC_RS485_PRODUCT_ADS12 | ADC_RS485_PRODUCT_AOA16)                                                    \
+    X(RS485_BAT, 3, 6, ADC_RS485_PRODUCT_ALL)                                                                                \
+    X(RS485_STQC, 3, 10, ADC_RS485_PRODUCT_ADP55 | ADC_RS485_PRODUCT_PSS8 | ADC_RS485_PRODUCT_PMH)                           \
+    X(RS485_STPS, 3, 11, ADC_RS485_PRODUCT_ADP55 | ADC_RS485_PRODUCT_PSS8 | ADC_RS485_PRODUCT_PMH)                           \
+    X(RS485_STAOA, 3, 12, ADC_RS485_PRODUCT_ADS12 | ADC_RS485_PRODUCT_AOA16 | ADC_RS485_PRODUCT_ADP55)                       \
+    X(RS485_STAOS, 3, 13, ADC_RS485_PRODUCT_ADS12 | ADC_RS485_PRODUCT_AOA16 | ADC_RS485_PRODUCT_ADP55)                       \
+    X(RS485_QC_U, 5, 1, ADC_RS485_PRODUCT_ADC10 | ADC_RS485_PRODUCT_ADS12)                                                   \
+    X(RS485_PS_U, 5, 2, ADC_RS485_PRODUCT_ADC10 | ADC_RS485_PRODUCT_ADS12)                                                   \
+    X(RS485_HP_U, 5, 3, ADC_RS485_PRODUCT_ADC10 | ADC_RS485_PRODUCT_ADS12)                                                   \
+    X(RS485_HBARO_U, 5, 4, ADC_RS485_PRODUCT_ADC10 | ADC_RS485_PRODUCT_ADS12)                                                \
+    X(RS485_CAS_U, 5, 5, ADC_RS485_PRODUCT_ADC10 | ADC_RS485_PRODUCT_ADS12)                                                  \
+    X(RS485_TAS_U, 5, 6, ADC_RS485_PRODUCT_ADC10 | ADC_RS485_PRODUCT_ADS12)                                                  \
+    X(RS485_CR_U, 5, 7, ADC_RS485_PRODUCT_ADC10 | ADC_RS485_PRODUCT_ADS12)
+
+/** Products that send the heater status, the ones that send the heater labels */
+#define ADC_RS485_HEATER_PRODUCTS (ADC_RS485_PRODUCT_ADS12 | ADC_RS485_PRODUCT_AOA16 | ADC_RS485_PRODUCT_ADP55)
+
+/** Bit of a type of data in ADC_RS485_PROFILE_TYPES if the product sends it */
+#define ADC_RS485_PROFILE_BIT(type, soh, label, products) \
+    | ((((products) & ADC_RS485_PRODUCT) != 0) ? (UINT64_C(1) << (type)) : UINT64_C(0))
+
+/** Types of data sent by the product the decoder is built for, one bit per data_type_t */
+#define ADC_RS485_PROFILE_TYPES (UINT64_C(0) ADC_RS485_LABELS(ADC_RS485_PROFILE_BIT))
+
+/** True if the product the decoder is built for sends the heater status */
+#define ADC_RS485_PROFILE_HEATER ((ADC_RS485_HEATER_PRODUCTS & ADC_RS485_PRODUCT) != 0)
+
+/**
+ * Returns whether the product the decoder is built for sends a type of data. The result is a
+ * constant when the type is, so that the code handling the other types is compiled out.
+ *
+ * @param[in]   type    Type of data.
+ *
+ * @return false if the type of data is not valid or is never sent by the product, true otherwise.
+ */
+static inline bool adc_rs485_profile_sends(data_type_t type)
+{
+    return ((uint32_t)type < RS485_DATA_NOT_VALID) && (((ADC_RS485_PROFILE_TYPES >> type) & 1u) != 0);
+}
+
+#endif
@@ -0,0 +1,476 @@
+/*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*/
+
+#include "adc_rs485_simd.h"
+#include "adc_rs485_decoder.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define RS485_SIMD_X86
+#include <immintrin.h>
+#endif
+
+/** Start of header of a data packet */
+#define SOH_1 0x01u
+#define SOH_2 0x02u
+#define SOH_3 0x03u
+#define SOH_5 0x05u
+
+/** Carriage return */
+#define CR 0x0Du
+
+/** Length in byte of a data message: SOH, label, 8 hexadecimal digits and CR */
+#define DATA_MSG_LENGTH 11
+
+/** Number of bytes scanned at once when searching the frame boundaries */
+#define BLOCK_LENGTH 64
+
+/** Maximum number of scans skipped between two scans of a long run without data message, as a power of 2 */
+#define MAX_SKIP_SHIFT 5
+
+/** Maximum number of data messages whose digits are converted together */
+#define BATCH_LENGTH 4
+
+/** Position of the delimiters found in a block, one bit per byte */
+typedef struct
+{
+    uint64_t soh;    /**< Start of headers */
+    uint64_t cr;     /**< Carriage returns */
+    uint64_t starts; /**< Start of headers of the complete data messages that fit in the block */
+} rs485_block_masks_t;
+
+/**
+ * Search the delimiters in a block of BLOCK_LENGTH bytes.
+ * @param[in]   block   Bytes to scan.
+ * @param[out]  masks   Position of the delimiters found.
+ */
+typedef void (*rs485_scan_fn)(const uint8_t block[], rs485_block_masks_t *masks);
+
+/**
+ * Verify and convert the hexadecimal digits of BATCH_LENGTH data messages.
+ * @param[in]   digits  Pointers to the 8 hexadecimal digits of every message.
+ * @param[out]  bits    Converted 32 bits of every message.
+ * @return Bit mask of the messages whose digits are all valid, bit 0 being the first message.
+ */
+typedef uint32_t (*rs485_convert_fn)(const uint8_t *const digits[BATCH_LENGTH], uint32_t bits[BATCH_LENGTH]);
+
+/** Implementation of the decoder for one instruction set */
+typedef struct
+{
+    rs485_scan_fn scan;
+    rs485_convert_fn convert;
+} rs485_simd_impl_t;
+
+/** Data message waiting for the conversion of its digits */
+typedef struct
+{
+    const uint8_t *digits[BATCH_LENGTH];
+    adc_rs485_msg_t *msgs[BATCH_LENGTH];
+    uint32_t length;
+} rs485_batch_t;
+
+static void rs485_scan_scalar(const uint8_t block[], rs485_block_masks_t *masks)
+{
+    masks->soh = 0;
+    masks->cr = 0;
+    for (uint32_t i = 0; i < BLOCK_LENGTH; i++)
+    {
+        uint8_t byte = block[i];
+        if ((byte == SOH_1) || (byte == SOH_2) || (byte == SOH_3) || (byte == SOH_5))
+        {
+            masks->soh |= (uint64_t)1u << i;
+        }
+        else if (byte == CR)
+        {
+            masks->cr |= (uint64_t)1u << i;
+        }
+    }
+}
+
+#ifdef RS485_SIMD_X86
+
+/** Assemble the 4 big endian bytes of a converted message */
+static inline uint32_t rs485_be32(const uint8_t bytes[])
+{
+    return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | (uint32_t)bytes[3];
+}
+
+__attribute__((target("sse2"))) static inline __m128i rs485_is_delimiter_sse2(__m128i v, __m128i *is_cr)
+{
+    __m128i is_soh = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(SOH_1)), _mm_cmpeq_epi8(v, _mm_set1_epi8(SOH_2))),
+                                  _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(SOH_3)), _mm_cmpeq_epi8(v, _mm_set1_epi8(SOH_5))));
+    *is_cr = _mm_cmpeq_epi8(v, _mm_set1_epi8(CR));
+    return is_soh;
+}
+
+__attribute__((target("sse2"))) static void rs485_scan_sse2(const uint8_t block[], rs485_block_masks_t *masks)
+{
+    masks->soh = 0;
+    masks->cr = 0;
+    for (uint32_t i = 0; i < BLOCK_LENGTH; i += 16)
+    {
+        __m128i is_cr;
+        __m128i is_soh = rs485_is_delimiter_sse2(_mm_loadu_si128((const __m128i *)&block[i]), &is_cr);
+        masks->soh |= (uint64_t)(uint32_t)_mm_movemask_epi8(is_soh) << i;
+        masks->cr |= (uint64_t)(uint32_t)_mm_movemask_epi8(is_cr) << i;
+    }
+}
+
+/**
+ * Verify and convert the digits of two messages, 8 digits each.
+ * @return Bit mask of the valid digits, bit 0 being the first digit of the first message.
+ */
+__attribute__((target("sse2"))) static inline uint32_t rs485_convert_pair_sse2(const uint8_t *a, const uint8_t *b, uint8_t bytes[8])
+{
+    __m128i v = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)a), _mm_loadl_epi64((const __m128i *)b));
+
+    // All characters should be between '0' and '9', or between 'A' and 'F'
+    __m128i is_digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+    __m128i is_hex = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('F' + 1)));
+    uint32_t valid = (uint32_t)_mm_movemask_epi8(_mm_or_si128(is_digit, is_hex));
+
+    // One nibble per byte, then merge the two nibbles of every 16 bits word into one byte
+    __m128i nibbles = _mm_sub_epi8(_mm_sub_epi8(v, _mm_set1_epi8('0')), _mm_and_si128(is_hex, _mm_set1_epi8('A' - '9' - 1)));
+    __m128i words = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(nibbles, _mm_set1_epi16(0x00FF)), 4), _mm_srli_epi16(nibbles, 8));
+    _mm_storel_epi64((__m128i *)bytes, _mm_packus_epi16(words, words));
+
+    return valid;
+}
+
+__attribute__((target("sse2"))) static uint32_t rs485_convert_sse2(const uint8_t *const digits[BATCH_LENGTH], uint32_t bits[BATCH_LENGTH])
+{
+    uint32_t valid = 0;
+
+    for (uint32_t k = 0; k < BATCH_LENGTH; k += 2)
+    {
+        uint8_t bytes[8];
+        uint32_t valid_digits = rs485_convert_pair_sse2(digits[k], digits[k + 1], bytes);
+        bits[k] = rs485_be32(&bytes[0]);
+        bits[k + 1] = rs485_be32(&bytes[4]);
+        valid |= (uint32_t)((valid_digits & 0x00FFu) == 0x00FFu) << k;
+        valid |= (uint32_t)((valid_digits & 0xFF00u) == 0xFF00u) << (k + 1);
+    }
+    return valid;
+}
+
+__attribute__((target("avx2"))) static void rs485_scan_avx2(const uint8_t block[], rs485_block_masks_t *masks)
+{
+    masks->soh = 0;
+    masks->cr = 0;
+    for (uint32_t i = 0; i < BLOCK_LENGTH; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)&block[i]);
+        __m256i is_soh = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(SOH_1)), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(SOH_2))),
+                                         _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(SOH_3)), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(SOH_5))));
+        __m256i is_cr = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(CR));
+        masks->soh |= (uint64_t)(uint32_t)_mm256_movemask_epi8(is_soh) << i;
+        masks->cr |= (uint64_t)(uint32_t)_mm256_movemask_epi8(is_cr) << i;
+    }
+}
+
+__attribute__((target("avx2"))) static uint32_t rs485_convert_avx2(const uint8_t *const digits[BATCH_LENGTH], uint32_t bits[BATCH_LENGTH])
+{
+    uint64_t lanes[BATCH_LENGTH];
+    for (uint32_t k = 0; k < BATCH_LENGTH; k++)
+    {
+        memcpy(&lanes[k], digits[k], sizeof(lanes[k]));
+    }
+    __m256i v = _mm256_set_epi64x((long long)lanes[3], (long long)lanes[2], (long long)lanes[1], (long long)lanes[0]);
+
+    // All characters should be between '0' and '9', or between 'A' and 'F'
+    __m256i is_digit = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+    __m256i is_hex = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('A' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('F' + 1), v));
+    uint32_t valid_digits = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(is_digit, is_hex));
+
+    // One nibble per byte, then merge the two nibbles of every 16 bits word into one byte
+    __m256i nibbles = _mm256_sub_epi8(_mm256_sub_epi8(v, _mm256_set1_epi8('0')), _mm256_and_si256(is_hex, _mm256_set1_epi8('A' - '9' - 1)));
+    __m256i words = _mm256_or_si256(_mm256_slli_epi16(_mm256_and_si256(nibbles, _mm256_set1_epi16(0x00FF)), 4), _mm256_srli_epi16(nibbles, 8));
+
+    // The packing is done per 128 bits lane: messages 0 and 1 in bytes 0-7, messages 2 and 3 in bytes 16-23
+    uint8_t bytes[32];
+    _mm256_storeu_si256((__m256i *)bytes, _mm256_packus_epi16(words, words));
+    bits[0] = rs485_be32(&bytes[0]);
+    bits[1] = rs485_be32(&bytes[4]);
+    bits[2] = rs485_be32(&bytes[16]);
+    bits[3] = rs485_be32(&bytes[20]);
+
+    uint32_t valid = 0;
+    for (uint32_t k = 0; k < BATCH_LENGTH; k++)
+    {
+        valid |= (uint32_t)(((valid_digits >> (8 * k)) & 0xFFu) == 0xFFu) << k;
+    }
+    return valid;
+}
+
+#endif
+
+/** Implementation of every instruction set, indexed by adc_rs485_simd_t. Without SIMD instructions, the portable decoder is used */
+static const rs485_simd_impl_t simd_impl[] = {
+    [ADC_RS485_SIMD_NONE] = {NULL, NULL},
+#ifdef RS485_SIMD_X86
+    [ADC_RS485_SIMD_SSE2] = {rs485_scan_sse2, rs485_convert_sse2},
+    [ADC_RS485_SIMD_AVX2] = {rs485_scan_avx2, rs485_convert_avx2},
+#endif
+};
+
+/** Instruction set in use, negative until it has been detected */
+static int32_t selected_simd = -1;
+
+adc_rs485_simd_t adc_rs485_simd_supported(void)
+{
+    adc_rs485_simd_t simd = ADC_RS485_SIMD_NONE;
+
+#ifdef RS485_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        simd = ADC_RS485_SIMD_AVX2;
+    }
+    else if (__builtin_cpu_supports("sse2"))
+    {
+        simd = ADC_RS485_SIMD_SSE2;
+    }
+#endif
+    return simd;
+}
+
+adc_rs485_simd_t adc_rs485_simd_select(adc_rs485_simd_t simd)
+{
+    adc_rs485_simd_t supported = adc_rs485_simd_supported();
+    if (simd > supported)
+    {
+        simd = supported;
+    }
+    __atomic_store_n(&selected_simd, (int32_t)simd, __ATOMIC_RELAXED);
+    return simd;
+}
+
+/** Returns the implementation in use, detecting the instruction set at the first call */
+static const rs485_simd_impl_t *rs485_simd_impl(void)
+{
+    int32_t simd = __atomic_load_n(&selected_simd, __ATOMIC_RELAXED);
+    if (simd < 0)
+    {
+        simd = (int32_t)adc_rs485_simd_select(ADC_RS485_SIMD_AVX2);
+    }
+    return &simd_impl[simd];
+}
+
+/** Search the delimiters in the last bytes of the buffer, when less than a block is left */
+static void rs485_scan_tail(const uint8_t data[], size_t length, rs485_block_masks_t *masks)
+{
+    uint8_t block[BLOCK_LENGTH] = {0};
+    memcpy(block, data, length);
+    rs485_scan_scalar(block, masks);
+}
+
+/** Search the complete data messages of a scanned block: SOH, 9 bytes without delimiter and CR */
+static inline void rs485_find_starts(rs485_block_masks_t *masks)
+{
+    uint64_t delimiters = masks->soh | masks->cr;
+    uint64_t starts = masks->soh & (masks->cr >> (DATA_MSG_LENGTH - 1));
+
+    for (uint32_t k = 1; k < (DATA_MSG_LENGTH - 1); k++)
+    {
+        starts &= ~(delimiters >> k);
+    }
+    masks->starts = starts;
+}
+
+/**
+ * Scan the block starting at a position of the buffer and search its complete data messages.
+ * @return Length of the block, less than BLOCK_LENGTH at the end of the buffer.
+ */
+static inline size_t rs485_scan_block(const rs485_simd_impl_t *impl, const uint8_t data[], size_t start, size_t length,
+                                      rs485_block_masks_t *masks)
+{
+    size_t block_length = length - start;
+
+    if (block_length >= BLOCK_LENGTH)
+    {
+        block_length = BLOCK_LENGTH;
+        impl->scan(&data[start], masks);
+    }
+    else
+    {
+        rs485_scan_tail(&data[start], block_length, masks);
+    }
+    rs485_find_starts(masks);
+    return block_length;
+}
+
+/** Convert the digits of all messages waiting in the batch and complete the messages */
+static void rs485_flush_batch(const rs485_simd_impl_t *impl, rs485_batch_t *batch)
+{
+    if (batch->length > 0)
+    {
+        uint32_t bits[BATCH_LENGTH];
+
+        // Unused entries convert the first message again, they are ignored
+        for (uint32_t k = batch->length; k < BATCH_LENGTH; k++)
+        {
+            batch->digits[k] = batch->digits[0];
+        }
+        uint32_t valid = impl->convert(batch->digits, bits);
+
+        for (uint32_t k = 0; k < batch->length; k++)
+        {
+            if ((valid >> k) & 1u)
+            {
+                // Defined copy of the integer bits into the float
+                union
+                {
+                    uint32_t bits;
+                    float value;
+                } converter = {.bits = bits[k]};
+                batch->msgs[k]->air_data.value = converter.value;
+            }
+            else
+            {
+                batch->msgs[k]->msg_type = RS485_ERROR;
+                batch->msgs[k]->error = ADC_RS485_ERROR_HEX;
+            }
+        }
+        batch->length = 0;
+    }
+}
+
+/**
+ * Decodes all bytes of a buffer, see adc_rs485_decoder_decode_buffer_simd_ends().
+ * Inlined in both public functions, so that the offsets cost nothing when ends is NULL.
+ */
+static inline size_t rs485_decode_buffer_simd(adc_rs485_decoder_t *decoder, const uint8_t data[], size_t length,
+                                              adc_rs485_msg_t msgs[], size_t ends[], size_t max_msgs, size_t *consumed)
+{
+    const rs485_simd_impl_t *impl = rs485_simd_impl();
+    rs485_block_masks_t masks = {0, 0, 0};
+    rs485_batch_t batch;
+    size_t block_start = 0;
+    size_t block_length = 0;
+    size_t msg_count = 0;
+    size_t i = 0;
+
+    if (impl->scan == NULL)
+    {
+        return adc_rs485_decoder_decode_buffer_ends(decoder, data, length, msgs, ends, max_msgs, consumed);
+    }
+
+    batch.length = 0;
+
+    while ((i < length) && (msg_count < max_msgs))
+    {
+        // Scan a new block when the next data message could overlap the end of the current one
+        if ((block_length == 0) || ((i - block_start) > (BLOCK_LENGTH - DATA_MSG_LENGTH)))
+        {
+            block_start = i;
+            block_length = rs485_scan_block(impl, data, i, length, &masks);
+        }
+
+        uint32_t offset = (uint32_t)(i - block_start);
+        uint64_t starts = masks.starts >> offset;
+
+        if ((starts & 1u) != 0)
+        {
+            // Complete data message: SOH, 9 bytes without delimiter and CR
+            adc_rs485_msg_t *msg = &msgs[msg_count];
+            data_type_t type = adc_rs485_label_type(data[i], data[i + 1]);
+
+            if (type != RS485_DATA_NOT_VALID)
+            {
+                msg->msg_type = RS485_RETURNED_DATA;
+                msg->air_data.type = type;
+                msg->air_data.flag = (flag_t)((data[i + 1] >> 4) & 0x07u);
+
+                batch.digits[batch.length] = &data[i + 2];
+                batch.msgs[batch.length] = msg;
+                batch.length++;
+                if (batch.length == BATCH_LENGTH)
+                {
+                    rs485_flush_batch(impl, &batch);
+                }
+            }
+            else
+            {
+                msg->msg_type = RS485_ERROR;
+                msg->error = ADC_RS485_ERROR_LABEL;
+            }
+
+            // The decoder state after a CR doesn't depend on the message
+            if (decoder->pos > 0)
+            {
+                decoder->truncated++;
+            }
+            decoder->pos = 0;
+            if (ends != NULL)
+            {
+                ends[msg_count] = i + DATA_MSG_LENGTH - 1u;
+            }
+            msg_count++;
+            i += DATA_MSG_LENGTH;
+        }
+        else
+        {
+            // Everything up to the next complete data message is handed at once to the portable decoder
+            size_t run_end = i + (size_t)__builtin_ctzll(starts | ((uint64_t)1u << 63));
+            size_t used = 0;
+
+            // The messages starting in the last bytes of a full block are only found by the next scan. In
+            // long runs without data message, like noise, the blocks are scanned less and less often:
+            // the bytes skipped are decoded by the portable decoder all the same
+            uint32_t empty_blocks = 0;
+            while ((starts == 0) && (block_length == BLOCK_LENGTH))
+            {
+                size_t skip = (size_t)(BLOCK_LENGTH - DATA_MSG_LENGTH + 1) << empty_blocks;
+                block_start = ((length - block_start) > skip) ? (block_start + skip) : length;
+                empty_blocks += (empty_blocks < MAX_SKIP_SHIFT) ? 1u : 0u;
+                block_length = rs485_scan_block(impl, data, block_start, length, &masks);
+                starts = masks.starts;
+                run_end = block_start + (size_t)__builtin_ctzll(starts | ((uint64_t)1u << 63));
+            }
+            if (starts == 0)
+            {
+                run_end = block_start + block_length;
+            }
+            if (ends != NULL)
+            {
+                size_t count = adc_rs485_decoder_decode_buffer_ends(decoder, &data[i], run_end - i, &msgs[msg_count],
+                                                                    &ends[msg_count], max_msgs - msg_count, &used);
+                for (size_t k = msg_count; k < msg_count + count; k++)
+                {
+                    ends[k] += i;
+                }
+                msg_count += count;
+            }
+            else
+            {
+                msg_count += adc_rs485_decoder_decode_buffer(decoder, &data[i], run_end - i, &msgs[msg_count],
+                                                             max_msgs - msg_count, &used);
+            }
+            i += used;
+        }
+    }
+
+    rs485_flush_batch(impl, &batch);
+
+    if (consumed != NULL)
+    {
+        *consumed = i;
+    }
+    return msg_count;
+}
+
+size_t adc_rs485_decoder_decode_buffer_simd(adc_rs485_decoder_t *decoder, const uint8_t data[], size_t length,
+                                            adc_rs485_msg_t msgs[], size_t max_msgs, size_t *consumed)
+{
+    return rs485_decode_buffer_simd(decoder, data, length, msgs, NULL, max_msgs, consumed);
+}
+
+size_t adc_rs485_decoder_decode_buffer_simd_ends(adc_rs485_decoder_t *decoder, const uint8_t data[], size_t length,
+                                                 adc_rs485_msg_t msgs[], size_t ends[], size_t max_msgs, size_t *consumed)
+{
+    return rs485_decode_buffer_simd(decoder, data, length, msgs, ends, max_msgs, consumed);
+}
@@ -0,0 +1,95 @@
+/**
+* This module decodes messages received by a swiss air-data computer through RS485 using the SIMD
+* instructions of x86 processors (SSE2 and AVX2).
+*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*
+* Compiled and tested with gcc version 8.1.0 (x86_64-posix-seh-rev0, Built by MinGW-W64 project)
+*
+* Example code only. Use at own risk.
+*
+* This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* Simtec AG has no obligation to provide maintenance, support,  updates, enhancements, or modifications.
+*/
+
+#ifndef RS485_SIMD_H
+#define RS485_SIMD_H
+
+#include "adc_rs485_decoder.h"
+#include <stdint.h>
+#include <stddef.h>
+
+/** Instruction set used by the SIMD decoder */
+typedef enum
+{
+    ADC_RS485_SIMD_NONE = 0, /**< Portable code, no SIMD instructions */
+    ADC_RS485_SIMD_SSE2 = 1, /**< 16 bytes per instruction */
+    ADC_RS485_SIMD_AVX2 = 2  /**< 32 bytes per instruction */
+} adc_rs485_simd_t;
+
+/**
+ * Returns the best instruction set supported by the processor. This is the one used by
+ * adc_rs485_decoder_decode_buffer_simd() unless another one has been selected.
+ *
+ * @return Best instruction set supported by the processor.
+ */
+adc_rs485_simd_t adc_rs485_simd_supported(void);
+
+/**
+ * Select the instruction set used by adc_rs485_decoder_decode_buffer_simd(). Mainly useful to
+ * compare the different implementations.
+ *
+ * @param[in]   simd    Wanted instruction set. It is lowered to the best one supported by the
+ *                      processor if needed.
+ *
+ * @return Instruction set that is now used.
+ */
+adc_rs485_simd_t adc_rs485_simd_select(adc_rs485_simd_t simd);
+
+/**
+ * Decodes all bytes of a buffer received from a swiss air-data computer through RS485, using the
+ * given decoder state.
+ *
+ * This function has exactly the same behaviour and returns exactly the same messages as
+ * adc_rs485_decoder_decode_buffer(). Frame boundaries are searched 64 bytes at a time and the
+ * hexadecimal digits of several data messages are validated and converted together. The bytes
+ * between two complete data messages (status messages, corrupted or truncated messages, noise) are
+ * handed at once to the portable decoder. With ADC_RS485_SIMD_NONE, the portable decoder
+ * adc_rs485_decoder_decode_buffer() is called directly.
+ *
+ * @param[in,out]   decoder     Decoder state of the stream the bytes were received on.
+ * @param[in]       data        Raw bytes received by an air data computer.
+ * @param[in]       length      Number of bytes in the buffer.
+ * @param[out]      msgs        Array that will contain the decoded messages.
+ * @param[in]       max_msgs    Maximum number of messages that can be written to the array.
+ * @param[out]      consumed    Number of bytes of the buffer that have been processed. Can be NULL
+ *                              if the caller doesn't need this information.
+ *
+ * @return Number of messages written to the message array.
+ */
+size_t adc_rs485_decoder_decode_buffer_simd(adc_rs485_decoder_t *decoder, const uint8_t data[], size_t length,
+                                            adc_rs485_msg_t msgs[], size_t max_msgs, size_t *consumed);
+
+/**
+ * Decodes all bytes of a buffer exactly like adc_rs485_decoder_decode_buffer_simd(), and also
+ * returns where every message ends, like adc_rs485_decoder_decode_buffer_ends().
+ *
+ * @param[in,out]   decoder     Decoder state of the stream the bytes were received on.
+ * @param[in]       data        Raw bytes received by an air data computer.
+ * @param[in]       length      Number of bytes in the buffer.
+ * @param[out]      msgs        Array that will contain the decoded messages.
+ * @param[out]      ends        Array that will contain, for every message, the offset in the buffer of
+ *                              the byte that completed it.
+ * @param[in]       max_msgs    Maximum number of messages that can be written to both arrays.
+ * @param[out]      consumed    Number of bytes of the buffer that have been processed. Can be NULL
+ *                              if the caller doesn't need this information.
+ *
+ * @return Number of messages written to the message array.
+ */
+size_t adc_rs485_decoder_decode_buffer_simd_ends(adc_rs485_decoder_t *decoder, const uint8_t data[], size_t length,
+                                                 adc_rs485_msg_t msgs[], size_t ends[], size_t max_msgs, size_t *consumed);
+
+#endif
@@ -0,0 +1,284 @@
+/*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*/
+
+#include "adc_shm.h"
+#include "adc_event.h"
+#include "latest_table.h"
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** Alignment of the tables and of the ring in the segment */
+#define SHM_ALIGNMENT 64u
+
+static uint64_t shm_align(uint64_t offset)
+{
+    return (offset + SHM_ALIGNMENT - 1u) & ~(uint64_t)(SHM_ALIGNMENT - 1u);
+}
+
+static void shm_reset(adc_shm_t *shm)
+{
+    memset(shm, 0, sizeof(*shm));
+    shm->fd = -1;
+    shm->base = MAP_FAILED;
+}
+
+/** Set the pointers to the parts of a mapped segment */
+static void shm_locate(adc_shm_t *shm)
+{
+    uint8_t *base = (uint8_t *)shm->base;
+
+    shm->header = (adc_shm_header_t *)base;
+    shm->tables = (latest_table_t *)(base + shm->header->tables_offset);
+    shm->ring = (shm->header->ring_capacity > 0) ? (adc_shm_slot_t *)(base + shm->header->ring_offset) : NULL;
+}
+
+/**
+ * Check that the tables and the ring described by the header of a segment lie within its size, and
+ * that the capacity of the ring is a power of two, before a reader uses them.
+ */
+static bool shm_layout_valid(const adc_shm_header_t *header, size_t size)
+{
+    uint64_t capacity = header->ring_capacity;
+
+    if ((header->tables_offset < sizeof(adc_shm_header_t)) || (header->tables_offset > size) ||
+        ((header->tables_offset % SHM_ALIGNMENT) != 0) ||
+        ((uint64_t)header->port_count * sizeof(latest_table_t) > size - header->tables_offset))
+    {
+        return false;
+    }
+    if (capacity == 0)
+    {
+        return true;
+    }
+    // The capacity is used as a mask by adc_shm_publish() and adc_shm_read_ring()
+    return ((capacity & (capacity - 1u)) == 0) && (header->ring_offset <= size) && ((header->ring_offset % SHM_ALIGNMENT) == 0) &&
+           (capacity * sizeof(adc_shm_slot_t) <= size - header->ring_offset);
+}
+
+int32_t adc_shm_create(adc_shm_t *shm, const char *name, const char *const port_names[], uint32_t port_count, uint32_t ring_capacity)
+{
+    shm_reset(shm);
+
+    if ((port_count == 0) || (port_count > ADC_SHM_MAX_PORTS) || (ring_capacity > (1u << 30)))
+    {
+        return EXIT_FAILURE;
+    }
+
+    uint32_t capacity = 0;
+    if (ring_capacity > 0)
+    {
+        for (capacity = 1; capacity < ring_capacity; capacity <<= 1)
+        {
+        }
+    }
+
+    uint64_t tables_offset = shm_align(sizeof(adc_shm_header_t));
+    uint64_t ring_offset = shm_align(tables_offset + (uint64_t)port_count * sizeof(latest_table_t));
+    uint64_t total_size = ring_offset + (uint64_t)capacity * sizeof(adc_shm_slot_t);
+
+    snprintf(shm->name, sizeof(shm->name), "%s", name);
+
+    // Start from a new segment so that a reader never sees the layout of a previous run change
+    shm_unlink(shm->name);
+    shm->fd = shm_open(shm->name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (shm->fd < 0)
+    {
+        return EXIT_FAILURE;
+    }
+    shm->owner = true;
+
+    if (ftruncate(shm->fd, (off_t)total_size) != 0)
+    {
+        adc_shm_close(shm);
+        return EXIT_FAILURE;
+    }
+
+    shm->size = (size_t)total_size;
+    shm->base = mmap(NULL, shm->size, PROT_READ | PROT_WRITE, MAP_SHARED, shm->fd, 0);
+    if (shm->base == MAP_FAILED)
+    {
+        adc_shm_close(shm);
+        return EXIT_FAILURE;
+    }
+
+    // The segment is zero-filled by ftruncate(): the tables are initialized and the ring is empty
+    adc_shm_header_t *header = (adc_shm_header_t *)shm->base;
+    header->version = ADC_SHM_VERSION;
+    header->header_size = sizeof(adc_shm_header_t);
+    header->label_count = RS485_DATA_NOT_VALID;
+    header->port_count = port_count;
+    header->ring_capacity = capacity;
+    header->tables_offset = tables_offset;
+    header->ring_offset = ring_offset;
+    header->total_size = total_size;
+    for (uint32_t i = 0; i < port_count; i++)
+    {
+        snprintf(header->ports[i], ADC_SHM_PORT_NAME_LENGTH, "%s", port_names[i]);
+    }
+    shm_locate(shm);
+
+    // The magic is written last: a reader that sees it also sees a complete header
+    __atomic_store_n(&header->magic, ADC_SHM_MAGIC, __ATOMIC_RELEASE);
+
+    return EXIT_SUCCESS;
+}
+
+void adc_shm_publish(adc_shm_t *shm, const adc_event_t events[], size_t count)
+{
+    if (shm->ring == NULL)
+    {
+        return;
+    }
+
+    uint64_t head = shm->header->ring_head;
+    uint64_t mask = shm->header->ring_capacity - 1u;
+
+    for (size_t i = 0; i < count; i++, head++)
+    {
+        adc_shm_slot_t *slot = &shm->ring[head & mask];
+
+        // Odd sequence: a reader copying the previous message of this slot detects the overwrite
+        __atomic_store_n(&slot->sequence, 2u * head + 1u, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        slot->event = events[i];
+        __atomic_store_n(&slot->sequence, 2u * head + 2u, __ATOMIC_RELEASE);
+    }
+
+    __atomic_store_n(&shm->header->ring_head, head, __ATOMIC_RELEASE);
+}
+
+int32_t adc_shm_open(adc_shm_t *shm, const char *name)
+{
+    struct stat status;
+
+    shm_reset(shm);
+    snprintf(shm->name, sizeof(shm->name), "%s", name);
+
+    shm->fd = shm_open(shm->name, O_RDONLY, 0);
+    if (shm->fd < 0)
+    {
+        return EXIT_FAILURE;
+    }
+
+    if ((fstat(shm->fd, &status) != 0) || ((size_t)status.st_size < sizeof(adc_shm_header_t)))
+    {
+        adc_shm_close(shm);
+        return EXIT_FAILURE;
+    }
+
+    shm->size = (size_t)status.st_size;
+    shm->base = mmap(NULL, shm->size, PROT_READ, MAP_SHARED, shm->fd, 0);
+    if (shm->base == MAP_FAILED)
+    {
+        adc_shm_close(shm);
+        return EXIT_FAILURE;
+    }
+
+    const adc_shm_header_t *header = (const adc_shm_header_t *)shm->base;
+    if ((__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != ADC_SHM_MAGIC) ||
+        (header->version != ADC_SHM_VERSION) ||
+        (header->header_size != sizeof(adc_shm_header_t)) ||
+        (header->label_count != RS485_DATA_NOT_VALID) ||
+        (header->port_count > ADC_SHM_MAX_PORTS) ||
+        (header->total_size != shm->size) ||
+        !shm_layout_valid(header, shm->size))
+    {
+        adc_shm_close(shm);
+        return EXIT_FAILURE;
+    }
+    shm_locate(shm);
+
+    return EXIT_SUCCESS;
+}
+
+void adc_shm_close(adc_shm_t *shm)
+{
+    if (shm->base != MAP_FAILED)
+    {
+        munmap(shm->base, shm->size);
+    }
+    if (shm->fd >= 0)
+    {
+        close(shm->fd);
+    }
+    if (shm->owner)
+    {
+        shm_unlink(shm->name);
+    }
+    shm_reset(shm);
+}
+
+latest_table_t *adc_shm_table(const adc_shm_t *shm, uint32_t port)
+{
+    if (port >= shm->header->port_count)
+    {
+        return NULL;
+    }
+    return &shm->tables[port];
+}
+
+uint64_t adc_shm_ring_head(const adc_shm_t *shm)
+{
+    return __atomic_load_n(&shm->header->ring_head, __ATOMIC_ACQUIRE);
+}
+
+size_t adc_shm_read_ring(const adc_shm_t *shm, uint64_t *cursor, adc_event_t events[], size_t max_events, uint64_t *lost)
+{
+    uint64_t capacity = shm->header->ring_capacity;
+    uint64_t head = adc_shm_ring_head(shm);
+    uint64_t skipped = 0;
+    size_t count = 0;
+
+    if (lost != NULL)
+    {
+        *lost = 0;
+    }
+    if (shm->ring == NULL)
+    {
+        return 0;
+    }
+
+    // The messages older than one capacity have been overwritten
+    if (head - *cursor > capacity)
+    {
+        skipped += head - capacity - *cursor;
+        *cursor = head - capacity;
+    }
+
+    while ((*cursor < head) && (count < max_events))
+    {
+        const adc_shm_slot_t *slot = &shm->ring[*cursor & (capacity - 1u)];
+        uint64_t expected = 2u * *cursor + 2u;
+
+        uint64_t before = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        events[count] = slot->event;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        uint64_t after = __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED);
+
+        if ((before == expected) && (after == expected))
+        {
+            count++;
+        }
+        else
+        {
+            // The writer has lapped the reader while it was copying
+            skipped++;
+        }
+        (*cursor)++;
+    }
+
+    if (lost != NULL)
+    {
+        *lost = skipped;
+    }
+    return count;
+}
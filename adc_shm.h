@@ -0,0 +1,156 @@
+/**
+* This module publishes the data decoded from swiss air-data computers in POSIX shared memory, so
+* that any number of processes on the same machine can read it without sockets or text parsing.
+*
+* The shared memory segment has a fixed, versioned layout:
+*   - a header (adc_shm_header_t),
+*   - one latest value table (latest_table_t) per serial port, read through its seqlocks,
+*   - optionally, a ring of the most recent messages of all ports.
+*
+* The decoder program creates the segment and writes it, other processes use the reader functions
+* of this module.
+*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*
+* Example code only. Use at own risk.
+*
+* This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* Simtec AG has no obligation to provide maintenance, support,  updates, enhancements, or modifications.
+*/
+
+#ifndef ADC_SHM_H
+#define ADC_SHM_H
+
+#include "adc_event.h"
+#include "latest_table.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Identifies a segment written by the decoder program, "ADCS" */
+#define ADC_SHM_MAGIC 0x53434441u
+
+/** Version of the layout of the segment, changed at every incompatible modification */
+#define ADC_SHM_VERSION 1u
+
+/** Maximum number of serial ports published in one segment */
+#define ADC_SHM_MAX_PORTS 64
+
+/** Maximum length of the name of a serial port, including the terminating null character */
+#define ADC_SHM_PORT_NAME_LENGTH 32
+
+/** Header at the beginning of the segment */
+typedef struct
+{
+    uint32_t magic;             /**< ADC_SHM_MAGIC */
+    uint32_t version;           /**< ADC_SHM_VERSION */
+    uint32_t header_size;       /**< Size of this header in bytes */
+    uint32_t label_count;       /**< Number of data labels per table, RS485_DATA_NOT_VALID */
+    uint32_t port_count;        /**< Number of latest value tables */
+    uint32_t ring_capacity;     /**< Number of messages in the ring, a power of two, 0 without ring */
+    uint64_t tables_offset;     /**< Offset of the first table from the beginning of the segment */
+    uint64_t ring_offset;       /**< Offset of the ring from the beginning of the segment */
+    uint64_t total_size;        /**< Size of the segment in bytes */
+    uint64_t ring_head;         /**< Number of messages written into the ring since the start */
+    char ports[ADC_SHM_MAX_PORTS][ADC_SHM_PORT_NAME_LENGTH]; /**< Name of every serial port */
+} adc_shm_header_t;
+
+/** One message of the ring */
+typedef struct
+{
+    uint64_t sequence;          /**< 2 * index + 2 once the message at this index is written, odd while writing */
+    adc_event_t event;
+} adc_shm_slot_t;
+
+/** Shared memory segment opened by a process */
+typedef struct
+{
+    char name[64];
+    int fd;
+    void *base;
+    size_t size;
+    bool owner;                 /**< Set for the process that created the segment */
+    adc_shm_header_t *header;
+    latest_table_t *tables;
+    adc_shm_slot_t *ring;
+} adc_shm_t;
+
+/**
+ * Create and map a shared memory segment. An existing segment with the same name is replaced.
+ *
+ * @param[out]  shm             Segment.
+ * @param[in]   name            Name of the segment, e.g. "/adc".
+ * @param[in]   port_names      Name of every serial port.
+ * @param[in]   port_count      Number of serial ports, at most ADC_SHM_MAX_PORTS.
+ * @param[in]   ring_capacity   Number of recent messages kept in the ring, rounded up to a power of
+ *                              two, 0 for no ring.
+ *
+ * @return EXIT_FAILURE if the segment couldn't be created, EXIT_SUCCESS otherwise.
+ */
+int32_t adc_shm_create(adc_shm_t *shm, const char *name, const char *const port_names[], uint32_t port_count, uint32_t ring_capacity);
+
+/**
+ * Append messages to the ring of a segment. Shall only be called by a single thread of the process
+ * that created the segment.
+ *
+ * @param[in,out]   shm     Segment created by adc_shm_create().
+ * @param[in]       events  Messages.
+ * @param[in]       count   Number of messages.
+ */
+void adc_shm_publish(adc_shm_t *shm, const adc_event_t events[], size_t count);
+
+/**
+ * Open and map an existing shared memory segment for reading.
+ *
+ * @param[out]  shm     Segment.
+ * @param[in]   name    Name of the segment, e.g. "/adc".
+ *
+ * @return EXIT_FAILURE if the segment doesn't exist, has an incompatible layout, or describes tables or a
+ * ring that don't fit in it, EXIT_SUCCESS otherwise.
+ */
+int32_t adc_shm_open(adc_shm_t *shm, const char *name);
+
+/**
+ * Unmap a segment. The segment is also removed if this process created it.
+ *
+ * @param[in,out]   shm     Segment.
+ */
+void adc_shm_close(adc_shm_t *shm);
+
+/**
+ * Returns the latest value table of a serial port. Read it with the latest_table_read*() functions.
+ *
+ * @param[in]   shm     Segment.
+ * @param[in]   port    Index of the serial port.
+ *
+ * @return Latest value table, NULL if the port doesn't exist.
+ */
+latest_table_t *adc_shm_table(const adc_shm_t *shm, uint32_t port);
+
+/**
+ * Read the messages written into the ring since the last call.
+ *
+ * @param[in]       shm         Segment.
+ * @param[in,out]   cursor      Index of the next message to read. Start with 0 to read all messages still
+ *                              in the ring, or with adc_shm_ring_head() to read only the new ones.
+ * @param[out]      events      Array that will contain the messages.
+ * @param[in]       max_events  Size of the array.
+ * @param[out]      lost        Number of messages overwritten before they could be read. Can be NULL.
+ *
+ * @return Number of messages read.
+ */
+size_t adc_shm_read_ring(const adc_shm_t *shm, uint64_t *cursor, adc_event_t events[], size_t max_events, uint64_t *lost);
+
+/**
+ * Returns the number of messages written into the ring since the segment was created.
+ *
+ * @param[in]   shm     Segment.
+ *
+ * @return Index of the next message that will be written.
+ */
+uint64_t adc_shm_ring_head(const adc_shm_t *shm);
+
+#endif
@@ -0,0 +1,819 @@
+/*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*/
+
+#include "adc_store.h"
+#include "adc_event.h"
+#include "adc_rs485_decoder.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/** Size in bytes of the write buffer of a store file */
+#define STORE_BUFFER_LENGTH (1024 * 1024)
+
+/** Maximum number of bits of a timestamp: a prefix of 5 bits and a 64-bit difference */
+#define TIME_MAX_BITS 69
+
+/** Maximum number of bits of a value: a prefix of 2 bits, the window in 10 bits and 32 bits */
+#define VALUE_MAX_BITS 44
+
+/** Maximum number of bytes of a run of flags: the flag and a LEB128 length below 2^14 */
+#define FLAG_RUN_MAX_LENGTH 3
+
+/** Size in bytes of the sections of a block being compressed */
+#define TIME_SECTION_LENGTH ((ADC_STORE_BLOCK_SAMPLES * TIME_MAX_BITS + 7) / 8)
+#define VALUE_SECTION_LENGTH ((ADC_STORE_BLOCK_SAMPLES * VALUE_MAX_BITS + 7) / 8)
+#define FLAG_SECTION_LENGTH (ADC_STORE_BLOCK_SAMPLES * FLAG_RUN_MAX_LENGTH)
+
+/** Number of prefix codes of the differences of time deltas */
+#define TIME_CODES 5
+
+/** Width of the zigzag-encoded difference of time deltas after a prefix of 1 to 5 ones */
+static const uint8_t TIME_CODE_BITS[TIME_CODES] = {7, 12, 20, 32, 64};
+
+/** Write the lowest count bits of value, most significant first, into a zeroed bit stream */
+static inline void store_put_bits(uint8_t data[], size_t *pos, uint64_t value, uint32_t count)
+{
+    while (count > 0)
+    {
+        uint32_t room = 8u - (uint32_t)(*pos & 7u);
+        uint32_t take = (count < room) ? count : room;
+        uint8_t bits = (uint8_t)((value >> (count - take)) & ((1u << take) - 1u));
+
+        data[*pos >> 3] |= (uint8_t)(bits << (room - take));
+        *pos += take;
+        count -= take;
+    }
+}
+
+/** Read count bits of a bit stream of length bits */
+static inline bool store_get_bits(const uint8_t data[], size_t length, size_t *pos, uint32_t count, uint64_t *value)
+{
+    uint64_t result = 0;
+
+    if ((*pos > length) || (count > length - *pos))
+    {
+        return false;
+    }
+    while (count > 0)
+    {
+        uint32_t room = 8u - (uint32_t)(*pos & 7u);
+        uint32_t take = (count < room) ? count : room;
+        uint8_t bits = (uint8_t)((data[*pos >> 3] >> (room - take)) & ((1u << take) - 1u));
+
+        result = (result << take) | bits;
+        *pos += take;
+        count -= take;
+    }
+    *value = result;
+    return true;
+}
+
+static inline float store_bits_float(uint32_t bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static void store_write(adc_store_writer_t *writer, const void *data, size_t length)
+{
+    if (!writer->failed && (fwrite(data, 1, length, writer->file) != length))
+    {
+        writer->failed = true;
+    }
+    writer->offset += length;
+}
+
+/** Append the current run of flags of a stream */
+static void store_end_run(adc_store_stream_t *stream)
+{
+    uint32_t run = stream->run;
+
+    stream->flags[stream->flag_length++] = stream->flag;
+    while (run >= 0x80u)
+    {
+        stream->flags[stream->flag_length++] = (uint8_t)(run | 0x80u);
+        run >>= 7;
+    }
+    stream->flags[stream->flag_length++] = (uint8_t)run;
+}
+
+static void store_reset_stream(adc_store_stream_t *stream)
+{
+    memset(stream->times, 0, TIME_SECTION_LENGTH);
+    memset(stream->values, 0, VALUE_SECTION_LENGTH);
+    stream->time_bits = 0;
+    stream->value_bits = 0;
+    stream->flag_length = 0;
+    stream->count = 0;
+    stream->delta = 0;
+    stream->trailing = 32;
+    stream->flag_mask = 0;
+    stream->min = NAN;
+    stream->max = NAN;
+}
+
+/** Write the block of a stream and add it to the index */
+static void store_flush_stream(adc_store_writer_t *writer, adc_store_stream_t *stream, uint8_t port, uint8_t type)
+{
+    adc_store_block_t block;
+
+    if (type < RS485_DATA_NOT_VALID)
+    {
+        store_end_run(stream);
+    }
+
+    memset(&block, 0, sizeof(block));
+    block.magic = ADC_STORE_BLOCK_MAGIC;
+    block.port = port;
+    block.stream = type;
+    block.flags = stream->flag_mask;
+    block.count = stream->count;
+    block.first_ns = stream->first * writer->resolution_ns;
+    block.last_ns = stream->previous * writer->resolution_ns;
+    block.min = stream->min;
+    block.max = stream->max;
+    block.time_length = (uint32_t)((stream->time_bits + 7u) / 8u);
+    block.value_length = (uint32_t)((stream->value_bits + 7u) / 8u);
+    block.length = block.time_length + block.value_length + (uint32_t)stream->flag_length;
+
+    if (writer->index_count == writer->index_capacity)
+    {
+        size_t capacity = (writer->index_capacity > 0) ? 2 * writer->index_capacity : 1024;
+        adc_store_index_entry_t *index = realloc(writer->index, capacity * sizeof(*index));
+        if (index == NULL)
+        {
+            // The file stays readable without its index
+            writer->failed = true;
+        }
+        else
+        {
+            writer->index = index;
+            writer->index_capacity = capacity;
+        }
+    }
+    if (writer->index_count < writer->index_capacity)
+    {
+        writer->index[writer->index_count].offset = writer->offset;
+        writer->index[writer->index_count].block = block;
+        writer->index_count++;
+    }
+
+    store_write(writer, &block, sizeof(block));
+    store_write(writer, stream->times, block.time_length);
+    store_write(writer, stream->values, block.value_length);
+    store_write(writer, stream->flags, stream->flag_length);
+    store_reset_stream(stream);
+}
+
+static void store_add_time(adc_store_stream_t *stream, uint64_t time)
+{
+    if (stream->count == 0)
+    {
+        stream->first = time;
+        stream->previous = time;
+        return;
+    }
+
+    // The timestamps come from the clock of a single port, they never go back
+    time = (time > stream->previous) ? time : stream->previous;
+    int64_t delta = (int64_t)(time - stream->previous);
+    int64_t delta_of_delta = delta - stream->delta;
+    uint64_t zigzag = ((uint64_t)delta_of_delta << 1) ^ (uint64_t)(delta_of_delta >> 63);
+
+    stream->previous = time;
+    stream->delta = delta;
+
+    if (zigzag == 0)
+    {
+        store_put_bits(stream->times, &stream->time_bits, 0, 1);
+        return;
+    }
+    for (uint32_t code = 0; code < TIME_CODES; code++)
+    {
+        if ((TIME_CODE_BITS[code] == 64) || (zigzag < (1ull << TIME_CODE_BITS[code])))
+        {
+            // code + 1 ones, followed by a zero except after the longest prefix
+            uint32_t prefix_bits = (code + 1 < TIME_CODES) ? code + 2 : TIME_CODES;
+            uint64_t prefix = (code + 1 < TIME_CODES) ? ((1u << (code + 1)) - 1u) << 1 : (1u << TIME_CODES) - 1u;
+            store_put_bits(stream->times, &stream->time_bits, prefix, prefix_bits);
+            store_put_bits(stream->times, &stream->time_bits, zigzag, TIME_CODE_BITS[code]);
+            return;
+        }
+    }
+}
+
+static void store_add_value(adc_store_stream_t *stream, uint32_t bits)
+{
+    if (stream->count == 0)
+    {
+        store_put_bits(stream->values, &stream->value_bits, bits, 32);
+        stream->value = bits;
+        return;
+    }
+
+    uint32_t difference = bits ^ stream->value;
+    stream->value = bits;
+    if (difference == 0)
+    {
+        store_put_bits(stream->values, &stream->value_bits, 0, 1);
+        return;
+    }
+
+    uint8_t leading = (uint8_t)__builtin_clz(difference);
+    uint8_t trailing = (uint8_t)__builtin_ctz(difference);
+    if ((stream->trailing < 32) && (leading >= stream->leading) && (trailing >= stream->trailing))
+    {
+        // Within the window of the previous value
+        store_put_bits(stream->values, &stream->value_bits, 0x2u, 2);
+        store_put_bits(stream->values, &stream->value_bits, difference >> stream->trailing,
+                       32u - stream->leading - stream->trailing);
+        return;
+    }
+
+    uint32_t length = 32u - leading - trailing;
+    store_put_bits(stream->values, &stream->value_bits, 0x3u, 2);
+    store_put_bits(stream->values, &stream->value_bits, leading, 5);
+    store_put_bits(stream->values, &stream->value_bits, length - 1u, 5);
+    store_put_bits(stream->values, &stream->value_bits, difference >> trailing, length);
+    stream->leading = leading;
+    stream->trailing = trailing;
+}
+
+static void store_add_flag(adc_store_stream_t *stream, uint8_t flag)
+{
+    if (stream->count == 0)
+    {
+        stream->flag = flag;
+        stream->run = 1;
+    }
+    else if (flag == stream->flag)
+    {
+        stream->run++;
+    }
+    else
+    {
+        store_end_run(stream);
+        stream->flag = flag;
+        stream->run = 1;
+    }
+    stream->flag_mask |= (uint8_t)(1u << (flag & 7u));
+}
+
+int32_t adc_store_writer_open(adc_store_writer_t *writer, const char *path, const char *const devices[], uint32_t port_count,
+                              uint64_t resolution_ns)
+{
+    adc_store_header_t header;
+    struct timespec now;
+
+    memset(writer, 0, sizeof(*writer));
+    writer->port_count = (port_count < ADC_STORE_MAX_PORTS) ? port_count : ADC_STORE_MAX_PORTS;
+    writer->resolution_ns = (resolution_ns > 0) ? resolution_ns : 1u;
+
+    size_t stream_count = (size_t)writer->port_count * ADC_STORE_STREAMS;
+    size_t section_length = TIME_SECTION_LENGTH + VALUE_SECTION_LENGTH + FLAG_SECTION_LENGTH;
+    writer->streams = calloc(stream_count, sizeof(*writer->streams));
+    writer->memory = malloc(stream_count * section_length);
+    writer->file = fopen(path, "wb");
+    if ((writer->streams == NULL) || (writer->memory == NULL) || (writer->file == NULL))
+    {
+        adc_store_writer_close(writer);
+        return EXIT_FAILURE;
+    }
+
+    writer->buffer = malloc(STORE_BUFFER_LENGTH);
+    if (writer->buffer != NULL)
+    {
+        setvbuf(writer->file, writer->buffer, _IOFBF, STORE_BUFFER_LENGTH);
+    }
+
+    uint8_t *sections = writer->memory;
+    for (size_t i = 0; i < stream_count; i++)
+    {
+        writer->streams[i].times = sections;
+        writer->streams[i].values = sections + TIME_SECTION_LENGTH;
+        writer->streams[i].flags = sections + TIME_SECTION_LENGTH + VALUE_SECTION_LENGTH;
+        store_reset_stream(&writer->streams[i]);
+        sections += section_length;
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.magic = ADC_STORE_MAGIC;
+    header.version = ADC_STORE_VERSION;
+    header.header_size = sizeof(header);
+    header.port_count = writer->port_count;
+    header.resolution_ns = writer->resolution_ns;
+    clock_gettime(CLOCK_REALTIME, &now);
+    header.start_realtime_ns = ((int64_t)now.tv_sec * 1000000000) + now.tv_nsec;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    header.start_monotonic_ns = ((uint64_t)now.tv_sec * 1000000000u) + (uint64_t)now.tv_nsec;
+    for (uint32_t i = 0; i < writer->port_count; i++)
+    {
+        snprintf(header.devices[i], sizeof(header.devices[i]), "%s", devices[i]);
+    }
+
+    store_write(writer, &header, sizeof(header));
+    if (writer->failed)
+    {
+        adc_store_writer_close(writer);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+void adc_store_writer_add(adc_store_writer_t *writer, const adc_event_t events[], size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        const adc_event_t *event = &events[i];
+        uint8_t type;
+        uint32_t bits = event->status;
+        float value = event->value;
+
+        if ((event->msg_type == RS485_RETURNED_DATA) && (event->data_type < RS485_DATA_NOT_VALID))
+        {
+            type = event->data_type;
+        }
+        else if (event->msg_type == RS485_RETURNED_STATUS_GEN)
+        {
+            type = ADC_STORE_GEN_STATUS;
+            value = (float)event->status;
+        }
+        else if (event->msg_type == RS485_RETURNED_STATUS_HTR)
+        {
+            type = ADC_STORE_HTR_STATUS;
+            value = (float)event->status;
+        }
+        else
+        {
+            continue;
+        }
+        if (event->port >= writer->port_count)
+        {
+            continue;
+        }
+
+        adc_store_stream_t *stream = &writer->streams[(size_t)event->port * ADC_STORE_STREAMS + type];
+        uint64_t time = event->timestamp_ns / writer->resolution_ns;
+
+        if ((stream->count == ADC_STORE_BLOCK_SAMPLES) ||
+            ((stream->count > 0) && (time > stream->first) &&
+             ((time - stream->first) * writer->resolution_ns >= ADC_STORE_BLOCK_SPAN_NS)))
+        {
+            store_flush_stream(writer, stream, event->port, type);
+        }
+
+        store_add_time(stream, time);
+        store_add_value(stream, bits);
+        if (type < RS485_DATA_NOT_VALID)
+        {
+            store_add_flag(stream, event->flag);
+        }
+        // Infinite values are kept in the range, the queries up to an infinite bound return them
+        if (!isnan(value))
+        {
+            stream->min = (isnan(stream->min) || (value < stream->min)) ? value : stream->min;
+            stream->max = (isnan(stream->max) || (value > stream->max)) ? value : stream->max;
+        }
+        stream->count++;
+        writer->samples++;
+    }
+}
+
+int32_t adc_store_writer_close(adc_store_writer_t *writer)
+{
+    int32_t return_code = EXIT_SUCCESS;
+
+    if (writer->file != NULL)
+    {
+        for (uint32_t port = 0; port < writer->port_count; port++)
+        {
+            for (uint32_t type = 0; type < ADC_STORE_STREAMS; type++)
+            {
+                adc_store_stream_t *stream = &writer->streams[(size_t)port * ADC_STORE_STREAMS + type];
+                if (stream->count > 0)
+                {
+                    store_flush_stream(writer, stream, (uint8_t)port, (uint8_t)type);
+                }
+            }
+        }
+
+        // The index is aligned so that the reader can use it in place
+        static const uint8_t padding[8] = {0};
+        store_write(writer, padding, (8u - (writer->offset & 7u)) & 7u);
+
+        adc_store_trailer_t trailer = {
+            .magic = ADC_STORE_INDEX_MAGIC,
+            .count = writer->index_count,
+            .offset = writer->offset};
+        store_write(writer, writer->index, writer->index_count * sizeof(*writer->index));
+        store_write(writer, &trailer, sizeof(trailer));
+
+        if ((fclose(writer->file) != 0) || writer->failed)
+        {
+            return_code = EXIT_FAILURE;
+        }
+        writer->file = NULL;
+    }
+    free(writer->buffer);
+    free(writer->memory);
+    free(writer->streams);
+    free(writer->index);
+    writer->buffer = NULL;
+    writer->memory = NULL;
+    writer->streams = NULL;
+    writer->index = NULL;
+    return return_code;
+}
+
+/** Use the index at the end of the file, if the file has been closed properly */
+static bool store_read_index(adc_store_reader_t *reader)
+{
+    adc_store_trailer_t trailer;
+
+    if (reader->size < reader->header.header_size + sizeof(trailer))
+    {
+        return false;
+    }
+    memcpy(&trailer, &reader->base[reader->size - sizeof(trailer)], sizeof(trailer));
+
+    uint64_t end = reader->size - sizeof(trailer);
+    if ((trailer.magic != ADC_STORE_INDEX_MAGIC) || ((trailer.offset & 7u) != 0) ||
+        (trailer.offset < reader->header.header_size) || (trailer.offset > end) ||
+        (trailer.count != (end - trailer.offset) / sizeof(adc_store_index_entry_t)) ||
+        (trailer.offset + trailer.count * sizeof(adc_store_index_entry_t) != end))
+    {
+        return false;
+    }
+    reader->index = (const adc_store_index_entry_t *)&reader->base[trailer.offset];
+    reader->block_count = (size_t)trailer.count;
+    return true;
+}
+
+/** Build the index by walking from one block header to the next */
+static int32_t store_scan_index(adc_store_reader_t *reader)
+{
+    size_t pos = reader->header.header_size;
+    size_t capacity = 0;
+
+    while (reader->size - pos >= sizeof(adc_store_block_t))
+    {
+        adc_store_block_t block;
+        memcpy(&block, &reader->base[pos], sizeof(block));
+        if ((block.magic != ADC_STORE_BLOCK_MAGIC) || (block.length > reader->size - pos - sizeof(block)))
+        {
+            break;
+        }
+
+        if (reader->block_count == capacity)
+        {
+            capacity = (capacity > 0) ? 2 * capacity : 1024;
+            adc_store_index_entry_t *scanned = realloc(reader->scanned, capacity * sizeof(*scanned));
+            if (scanned == NULL)
+            {
+                return EXIT_FAILURE;
+            }
+            reader->scanned = scanned;
+        }
+        reader->scanned[reader->block_count].offset = pos;
+        reader->scanned[reader->block_count].block = block;
+        reader->block_count++;
+        pos += sizeof(block) + block.length;
+    }
+    reader->index = reader->scanned;
+    return EXIT_SUCCESS;
+}
+
+int32_t adc_store_reader_open(adc_store_reader_t *reader, const char *path)
+{
+    struct stat status;
+
+    memset(reader, 0, sizeof(*reader));
+    reader->base = MAP_FAILED;
+
+    reader->fd = open(path, O_RDONLY);
+    if (reader->fd < 0)
+    {
+        return EXIT_FAILURE;
+    }
+
+    if ((fstat(reader->fd, &status) != 0) || ((size_t)status.st_size < sizeof(adc_store_header_t)))
+    {
+        adc_store_reader_close(reader);
+        return EXIT_FAILURE;
+    }
+
+    reader->size = (size_t)status.st_size;
+    reader->base = mmap(NULL, reader->size, PROT_READ, MAP_PRIVATE, reader->fd, 0);
+    if (reader->base == MAP_FAILED)
+    {
+        adc_store_reader_close(reader);
+        return EXIT_FAILURE;
+    }
+
+    memcpy(&reader->header, reader->base, sizeof(reader->header));
+    for (size_t i = 0; i < ADC_STORE_MAX_PORTS; i++)
+    {
+        reader->header.devices[i][ADC_STORE_DEVICE_LENGTH - 1] = '\0';
+    }
+    if ((reader->header.magic != ADC_STORE_MAGIC) ||
+        (reader->header.version != ADC_STORE_VERSION) ||
+        (reader->header.header_size < sizeof(adc_store_header_t)) ||
+        (reader->header.header_size > reader->size) ||
+        (reader->header.port_count > ADC_STORE_MAX_PORTS) ||
+        (reader->header.resolution_ns == 0))
+    {
+        adc_store_reader_close(reader);
+        return EXIT_FAILURE;
+    }
+
+    if (!store_read_index(reader) && (store_scan_index(reader) != EXIT_SUCCESS))
+    {
+        adc_store_reader_close(reader);
+        return EXIT_FAILURE;
+    }
+
+    for (size_t i = 0; i < reader->block_count; i++)
+    {
+        const adc_store_block_t *block = &reader->index[i].block;
+        reader->first_ns = ((i == 0) || (block->first_ns < reader->first_ns)) ? block->first_ns : reader->first_ns;
+        reader->last_ns = (block->last_ns > reader->last_ns) ? block->last_ns : reader->last_ns;
+    }
+    return EXIT_SUCCESS;
+}
+
+void adc_store_reader_close(adc_store_reader_t *reader)
+{
+    if (reader->base != MAP_FAILED)
+    {
+        munmap((void *)reader->base, reader->size);
+        reader->base = MAP_FAILED;
+    }
+    if (reader->fd >= 0)
+    {
+        close(reader->fd);
+        reader->fd = -1;
+    }
+    free(reader->scanned);
+    reader->scanned = NULL;
+    reader->index = NULL;
+    reader->block_count = 0;
+}
+
+void adc_store_cursor_init(adc_store_cursor_t *cursor, const adc_store_reader_t *reader, uint8_t port, uint8_t stream,
+                           uint64_t from_ns, uint64_t to_ns, float min, float max)
+{
+    memset(cursor, 0, sizeof(*cursor));
+    cursor->reader = reader;
+    cursor->port = port;
+    cursor->stream = stream;
+    cursor->from_ns = from_ns;
+    cursor->to_ns = to_ns;
+    cursor->min = min;
+    cursor->max = max;
+}
+
+/** Whether the values are filtered, the blocks of NaN only are then skipped */
+static inline bool store_filtered(const adc_store_cursor_t *cursor)
+{
+    return (cursor->min > -INFINITY) || (cursor->max < INFINITY);
+}
+
+/** Find the next block of the stream within the ranges, from its header only */
+static bool store_next_block(adc_store_cursor_t *cursor)
+{
+    const adc_store_reader_t *reader = cursor->reader;
+
+    while (cursor->next_block < reader->block_count)
+    {
+        const adc_store_index_entry_t *entry = &reader->index[cursor->next_block++];
+        const adc_store_block_t *block = &entry->block;
+
+        if ((block->port != cursor->port) || (block->stream != cursor->stream) || (block->last_ns < cursor->from_ns))
+        {
+            continue;
+        }
+        if (block->first_ns > cursor->to_ns)
+        {
+            // The blocks of a stream are in the order of their time
+            cursor->next_block = reader->block_count;
+            return false;
+        }
+        if (store_filtered(cursor) && !((block->max >= cursor->min) && (block->min <= cursor->max)))
+        {
+            continue;
+        }
+        if ((entry->offset > reader->size - sizeof(*block)) || (block->length > reader->size - entry->offset - sizeof(*block)) ||
+            ((uint64_t)block->time_length + block->value_length > block->length) || (block->count == 0))
+        {
+            continue;
+        }
+
+        const uint8_t *data = &reader->base[entry->offset + sizeof(*block)];
+        cursor->block = block;
+        cursor->times = data;
+        cursor->values = data + block->time_length;
+        cursor->flags = data + block->time_length + block->value_length;
+        cursor->time_bits = (size_t)block->time_length * 8u;
+        cursor->value_bits = (size_t)block->value_length * 8u;
+        cursor->flag_length = block->length - block->time_length - block->value_length;
+        cursor->time_pos = 0;
+        cursor->value_pos = 0;
+        cursor->flag_pos = 0;
+        cursor->decoded = 0;
+        cursor->run = 0;
+        return true;
+    }
+    return false;
+}
+
+static bool store_next_time(adc_store_cursor_t *cursor)
+{
+    uint64_t bit;
+    uint32_t ones = 0;
+
+    if (cursor->decoded == 0)
+    {
+        cursor->time = cursor->block->first_ns / cursor->reader->header.resolution_ns;
+        cursor->delta = 0;
+        return true;
+    }
+
+    do
+    {
+        if (!store_get_bits(cursor->times, cursor->time_bits, &cursor->time_pos, 1, &bit))
+        {
+            return false;
+        }
+        ones += (uint32_t)bit;
+    } while ((bit != 0) && (ones < TIME_CODES));
+
+    if (ones > 0)
+    {
+        uint64_t zigzag;
+        if (!store_get_bits(cursor->times, cursor->time_bits, &cursor->time_pos, TIME_CODE_BITS[ones - 1], &zigzag))
+        {
+            return false;
+        }
+        cursor->delta += (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1u);
+    }
+    cursor->time += (uint64_t)cursor->delta;
+    return true;
+}
+
+static bool store_next_value(adc_store_cursor_t *cursor)
+{
+    uint64_t bits;
+
+    if (cursor->decoded == 0)
+    {
+        cursor->trailing = 32;
+        if (!store_get_bits(cursor->values, cursor->value_bits, &cursor->value_pos, 32, &bits))
+        {
+            return false;
+        }
+        cursor->value = (uint32_t)bits;
+        return true;
+    }
+
+    if (!store_get_bits(cursor->values, cursor->value_bits, &cursor->value_pos, 1, &bits))
+    {
+        return false;
+    }
+    if (bits == 0)
+    {
+        return true;
+    }
+    if (!store_get_bits(cursor->values, cursor->value_bits, &cursor->value_pos, 1, &bits))
+    {
+        return false;
+    }
+    if (bits != 0)
+    {
+        uint64_t leading;
+        uint64_t length;
+        if (!store_get_bits(cursor->values, cursor->value_bits, &cursor->value_pos, 5, &leading) ||
+            !store_get_bits(cursor->values, cursor->value_bits, &cursor->value_pos, 5, &length) ||
+            (leading + length + 1u > 32u))
+        {
+            return false;
+        }
+        cursor->leading = (uint8_t)leading;
+        cursor->trailing = (uint8_t)(32u - leading - length - 1u);
+    }
+    else if (cursor->trailing >= 32)
+    {
+        return false;
+    }
+
+    if (!store_get_bits(cursor->values, cursor->value_bits, &cursor->value_pos,
+                        32u - cursor->leading - cursor->trailing, &bits))
+    {
+        return false;
+    }
+    cursor->value ^= (uint32_t)bits << cursor->trailing;
+    return true;
+}
+
+static bool store_next_flag(adc_store_cursor_t *cursor)
+{
+    if (cursor->run == 0)
+    {
+        uint64_t run = 0;
+        uint32_t shift = 0;
+        uint8_t byte;
+
+        if (cursor->flag_pos >= cursor->flag_length)
+        {
+            return false;
+        }
+        cursor->flag = cursor->flags[cursor->flag_pos++];
+        do
+        {
+            if ((cursor->flag_pos >= cursor->flag_length) || (shift >= 64))
+            {
+                return false;
+            }
+            byte = cursor->flags[cursor->flag_pos++];
+            run |= (uint64_t)(byte & 0x7Fu) << shift;
+            shift += 7;
+        } while ((byte & 0x80u) != 0);
+
+        if (run == 0)
+        {
+            return false;
+        }
+        cursor->run = run;
+    }
+    cursor->run--;
+    return true;
+}
+
+bool adc_store_cursor_next(adc_store_cursor_t *cursor, adc_event_t *event)
+{
+    bool data = (cursor->stream < RS485_DATA_NOT_VALID);
+
+    for (;;)
+    {
+        if ((cursor->block == NULL) && !store_next_block(cursor))
+        {
+            return false;
+        }
+
+        while (cursor->decoded < cursor->block->count)
+        {
+            if (!store_next_time(cursor) || !store_next_value(cursor) || (data && !store_next_flag(cursor)))
+            {
+                // Corrupted block, the rest of it is skipped
+                break;
+            }
+            cursor->decoded++;
+
+            uint64_t time_ns = cursor->time * cursor->reader->header.resolution_ns;
+            if (time_ns > cursor->to_ns)
+            {
+                cursor->block = NULL;
+                cursor->next_block = cursor->reader->block_count;
+                return false;
+            }
+            if (time_ns < cursor->from_ns)
+            {
+                continue;
+            }
+
+            event->timestamp_ns = time_ns;
+            event->status = cursor->value;
+            event->port = cursor->port;
+            if (data)
+            {
+                event->msg_type = (uint8_t)RS485_RETURNED_DATA;
+                event->data_type = cursor->stream;
+                event->flag = cursor->flag;
+            }
+            else
+            {
+                event->msg_type = (uint8_t)((cursor->stream == ADC_STORE_GEN_STATUS) ? RS485_RETURNED_STATUS_GEN : RS485_RETURNED_STATUS_HTR);
+                event->data_type = (uint8_t)RS485_DATA_NOT_VALID;
+                event->flag = (uint8_t)FLAG_INVALID;
+            }
+
+            float value = data ? store_bits_float(cursor->value) : (float)cursor->value;
+            if (!store_filtered(cursor) || ((value >= cursor->min) && (value <= cursor->max)))
+            {
+                return true;
+            }
+        }
+        cursor->block = NULL;
+    }
+}
@@ -0,0 +1,289 @@
+/**
+* This module stores the decoded messages of swiss air-data computers in a compact columnar file for
+* long-term archiving, and reads back the messages of a time range without decoding the whole file.
+*
+* Every label, the general status and the heater status of every port are a stream of their own.
+* The samples of a stream are grouped in blocks of up to ADC_STORE_BLOCK_SAMPLES samples, and every
+* block holds three sections, compressed as in Gorilla (Pelkonen et al., VLDB 2015):
+*   - the timestamps, as the difference between the last two time deltas, which is usually 0 or a
+*     few microseconds of jitter, with a variable-length prefix code,
+*   - the values, as the bits that have changed since the previous value (XOR of the float bits),
+*     written within the same window of bits as the previous value whenever possible,
+*   - the flags of a label, as runs of the same flag_t (flag, then LEB128 length of the run).
+* The timestamps are rounded down to the resolution of the file, 1 us by default, far below the
+* duration of one byte on the serial line. The errors are not stored.
+*
+* Every block starts with a header (adc_store_block_t) that holds the time range, the minimum and
+* the maximum of its values: a reader skips the blocks outside of a query from the header alone.
+* When the file is closed, all block headers are appended as an index at the end of the file, so
+* that a query doesn't even touch the pages of the blocks it skips. A file that hasn't been closed
+* properly is still readable, by walking from one block header to the next.
+*
+* All numbers of the headers are in the byte order of the machine that wrote the file, the bit
+* streams are written most significant bit first.
+*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*
+* Example code only. Use at own risk.
+*
+* This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* Simtec AG has no obligation to provide maintenance, support,  updates, enhancements, or modifications.
+*/
+
+#ifndef ADC_STORE_H
+#define ADC_STORE_H
+
+#include "adc_event.h"
+#include "adc_rs485_decoder.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/** Identifies a store file, "ADCS" */
+#define ADC_STORE_MAGIC 0x53434441u
+
+/** Identifies a block, "ADCB" */
+#define ADC_STORE_BLOCK_MAGIC 0x42434441u
+
+/** Identifies the index at the end of a store file, "ADCI" */
+#define ADC_STORE_INDEX_MAGIC 0x49434441u
+
+/** Version of the format of the store files */
+#define ADC_STORE_VERSION 1u
+
+/** Maximum number of ports of a store file */
+#define ADC_STORE_MAX_PORTS 64
+
+/** Maximum length of the name of a device, including the terminating null character */
+#define ADC_STORE_DEVICE_LENGTH 96
+
+/** Stream of the general status of a port, after the streams of the labels */
+#define ADC_STORE_GEN_STATUS RS485_DATA_NOT_VALID
+
+/** Stream of the heater status of a port */
+#define ADC_STORE_HTR_STATUS (RS485_DATA_NOT_VALID + 1)
+
+/** Number of streams per port */
+#define ADC_STORE_STREAMS (RS485_DATA_NOT_VALID + 2)
+
+/** Maximum number of samples of a block */
+#define ADC_STORE_BLOCK_SAMPLES 1024
+
+/** Maximum duration of a block, so that slow labels are written regularly too */
+#define ADC_STORE_BLOCK_SPAN_NS (60ull * 1000000000u)
+
+/** Default resolution of the timestamps */
+#define ADC_STORE_DEFAULT_RESOLUTION_NS 1000u
+
+/** Header at the beginning of a store file */
+typedef struct
+{
+    uint32_t magic;                     /**< ADC_STORE_MAGIC */
+    uint32_t version;                   /**< ADC_STORE_VERSION */
+    uint32_t header_size;               /**< Size of this header in bytes */
+    uint32_t port_count;
+    uint64_t resolution_ns;             /**< Resolution of the timestamps */
+    int64_t start_realtime_ns;          /**< Wall-clock time at which the file has been created, since 1970 */
+    uint64_t start_monotonic_ns;        /**< Monotonic time at which the file has been created */
+    char devices[ADC_STORE_MAX_PORTS][ADC_STORE_DEVICE_LENGTH]; /**< Name of every port */
+} adc_store_header_t;
+
+/** Header of a block, followed by its timestamps, its values and its flags */
+typedef struct
+{
+    uint32_t magic;                     /**< ADC_STORE_BLOCK_MAGIC */
+    uint32_t length;                    /**< Number of bytes of the sections after this header */
+    uint8_t port;
+    uint8_t stream;                     /**< data_type_t, ADC_STORE_GEN_STATUS or ADC_STORE_HTR_STATUS */
+    uint8_t flags;                      /**< One bit per flag_t of the samples */
+    uint8_t reserved;
+    uint32_t count;                     /**< Number of samples */
+    uint64_t first_ns;                  /**< Time of the first sample */
+    uint64_t last_ns;                   /**< Time of the last sample */
+    float min;                          /**< Smallest value, NaN if all are NaN; status words are exact */
+    float max;                          /**< Largest value, NaN if all are NaN */
+    uint32_t time_length;               /**< Number of bytes of the timestamps */
+    uint32_t value_length;              /**< Number of bytes of the values, the flags take the rest */
+} adc_store_block_t;
+
+/** Entry of the index at the end of a store file */
+typedef struct
+{
+    uint64_t offset;                    /**< Position of the block header in the file */
+    adc_store_block_t block;
+} adc_store_index_entry_t;
+
+/** Last bytes of a store file that has been closed properly */
+typedef struct
+{
+    uint32_t magic;                     /**< ADC_STORE_INDEX_MAGIC */
+    uint32_t reserved;
+    uint64_t count;                     /**< Number of entries of the index */
+    uint64_t offset;                    /**< Position of the index in the file */
+} adc_store_trailer_t;
+
+/** Block of one stream being compressed */
+typedef struct
+{
+    uint8_t *times;                     /**< Bits of the timestamps */
+    uint8_t *values;                    /**< Bits of the values */
+    uint8_t *flags;                     /**< Runs of the flags */
+    size_t time_bits;
+    size_t value_bits;
+    size_t flag_length;
+    uint32_t count;
+    uint64_t first;                     /**< Time of the first sample, in units of the resolution */
+    uint64_t previous;                  /**< Time of the previous sample, in units of the resolution */
+    int64_t delta;                      /**< Previous time delta */
+    uint32_t value;                     /**< Bits of the previous value */
+    uint8_t leading;                    /**< Leading zeros of the window of the previous value */
+    uint8_t trailing;                   /**< Trailing zeros of the window of the previous value, 32 if none yet */
+    uint8_t flag;                       /**< Flag of the current run */
+    uint32_t run;                       /**< Length of the current run */
+    uint8_t flag_mask;
+    float min;
+    float max;
+} adc_store_stream_t;
+
+/** Store file being written */
+typedef struct
+{
+    FILE *file;
+    char *buffer;                       /**< Write buffer of the file */
+    void *memory;                       /**< Blocks of all streams */
+    adc_store_stream_t *streams;        /**< ADC_STORE_STREAMS per port */
+    adc_store_index_entry_t *index;
+    size_t index_count;
+    size_t index_capacity;
+    uint32_t port_count;
+    uint64_t resolution_ns;
+    uint64_t offset;                    /**< Size of the file so far */
+    uint64_t samples;                   /**< Number of samples stored */
+    bool failed;                        /**< Set when the file couldn't be written */
+} adc_store_writer_t;
+
+/** Store file being read */
+typedef struct
+{
+    int fd;
+    const uint8_t *base;                /**< Whole file, mapped in memory */
+    size_t size;
+    adc_store_header_t header;
+    const adc_store_index_entry_t *index; /**< Header of every block, in the order of the file */
+    adc_store_index_entry_t *scanned;   /**< Index built when the file hasn't been closed properly */
+    size_t block_count;
+    uint64_t first_ns;                  /**< Time of the oldest sample of the file, 0 if empty */
+    uint64_t last_ns;                   /**< Time of the newest sample of the file */
+} adc_store_reader_t;
+
+/** Samples of one stream within a range of time and of values */
+typedef struct
+{
+    const adc_store_reader_t *reader;
+    uint8_t port;
+    uint8_t stream;
+    uint64_t from_ns;
+    uint64_t to_ns;
+    float min;
+    float max;
+    size_t next_block;                  /**< Next entry of the index to look at */
+    const adc_store_block_t *block;     /**< Block being decoded, NULL if none */
+    const uint8_t *times;
+    const uint8_t *values;
+    const uint8_t *flags;
+    size_t time_bits;
+    size_t value_bits;
+    size_t flag_length;
+    size_t time_pos;                    /**< Position in bits */
+    size_t value_pos;                   /**< Position in bits */
+    size_t flag_pos;                    /**< Position in bytes */
+    uint32_t decoded;                   /**< Samples of the block decoded so far */
+    uint64_t time;
+    int64_t delta;
+    uint32_t value;
+    uint8_t leading;
+    uint8_t trailing;
+    uint8_t flag;
+    uint64_t run;                       /**< Remaining samples of the current run of flags */
+} adc_store_cursor_t;
+
+/**
+ * Create a store file and write its header.
+ *
+ * @param[out]  writer          Store file.
+ * @param[in]   path            Path of the file, an existing file is replaced.
+ * @param[in]   devices         Name of every port.
+ * @param[in]   port_count      Number of ports, at most ADC_STORE_MAX_PORTS.
+ * @param[in]   resolution_ns   Resolution of the timestamps, e.g. ADC_STORE_DEFAULT_RESOLUTION_NS.
+ *
+ * @return EXIT_FAILURE if the file couldn't be created, EXIT_SUCCESS otherwise.
+ */
+int32_t adc_store_writer_open(adc_store_writer_t *writer, const char *path, const char *const devices[], uint32_t port_count,
+                              uint64_t resolution_ns);
+
+/**
+ * Add decoded messages. The messages of a port shall be added in the order they have been received.
+ *
+ * @param[in,out]   writer  Store file.
+ * @param[in]       events  Decoded messages, the errors are ignored.
+ * @param[in]       count   Number of messages.
+ */
+void adc_store_writer_add(adc_store_writer_t *writer, const adc_event_t events[], size_t count);
+
+/**
+ * Write the blocks not complete yet and the index, then close a store file.
+ *
+ * @param[in,out]   writer  Store file.
+ *
+ * @return EXIT_FAILURE if the file couldn't be completely written, EXIT_SUCCESS otherwise.
+ */
+int32_t adc_store_writer_close(adc_store_writer_t *writer);
+
+/**
+ * Open a store file and map it in memory.
+ *
+ * @param[out]  reader  Store file.
+ * @param[in]   path    Path of the file.
+ *
+ * @return EXIT_FAILURE if the file couldn't be opened or isn't a store file, EXIT_SUCCESS otherwise.
+ */
+int32_t adc_store_reader_open(adc_store_reader_t *reader, const char *path);
+
+/**
+ * Unmap and close a store file.
+ *
+ * @param[in,out]   reader  Store file.
+ */
+void adc_store_reader_close(adc_store_reader_t *reader);
+
+/**
+ * Start reading the samples of one stream received within a range of time, whose value is within a
+ * range. The blocks outside of the ranges are skipped without being decompressed.
+ *
+ * @param[out]  cursor      Cursor.
+ * @param[in]   reader      Store file, open as long as the cursor is used.
+ * @param[in]   port        Index of the port.
+ * @param[in]   stream      data_type_t, ADC_STORE_GEN_STATUS or ADC_STORE_HTR_STATUS.
+ * @param[in]   from_ns     Monotonic time of the first sample read.
+ * @param[in]   to_ns       Monotonic time of the last sample read.
+ * @param[in]   min         Smallest value read, -INFINITY for all; compared to the status word of a status.
+ * @param[in]   max         Largest value read, INFINITY for all.
+ */
+void adc_store_cursor_init(adc_store_cursor_t *cursor, const adc_store_reader_t *reader, uint8_t port, uint8_t stream,
+                           uint64_t from_ns, uint64_t to_ns, float min, float max);
+
+/**
+ * Read the next sample of a stream.
+ *
+ * @param[in,out]   cursor  Cursor.
+ * @param[out]      event   Sample, as the decoded message it has been stored from.
+ *
+ * @return false once all samples in the ranges have been read, true otherwise.
+ */
+bool adc_store_cursor_next(adc_store_cursor_t *cursor, adc_event_t *event);
+
+#endif
@@ -0,0 +1,427 @@
+/*
+ * 2023 (c) Simtec AG
+ * All rights reserved
+ *
+ * Measure the throughput of the decoders of swiss air-data computer messages on synthetic streams:
+ * clean cycles, noise made only of start of headers, corrupted hexadecimal digits and truncated
+ * frames. Every decoder is run on the same streams and the results are printed one per line, as
+ * JSON or CSV, to compare decoder versions and to size the hardware.
+ *
+ * Example code only. Use at own risk.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Simtec AG has no obligation to provide maintenance, support,
+ * updates, enhancements, or modifications.
+ */
+
+#include "adc_rs485_decoder.h"
+#include "adc_rs485_encoder.h"
+#include "adc_rs485_simd.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/** Default size of every stream, in megabytes */
+#define DEFAULT_SIZE_MB 16
+
+/** Default number of runs per decoder and stream, the fastest one is reported */
+#define DEFAULT_RUNS 5
+
+/** Maximum number of messages decoded at once by the buffer decoders */
+#define MSG_BUFFER_LENGTH 4096
+
+/** Labels of one cycle of an ADC-10, followed by the general status */
+static const data_type_t ADC10_CYCLE[] = {
+    RS485_QC, RS485_PS, RS485_CAS, RS485_TAS, RS485_HP, RS485_HBARO,
+    RS485_CR, RS485_MACH, RS485_SAT, RS485_TAT, RS485_QNH, RS485_PT};
+
+/** Start of headers, the only bytes of the noise stream */
+static const uint8_t SOH[4] = {0x01u, 0x02u, 0x03u, 0x05u};
+
+/** Kind of synthetic stream */
+typedef enum
+{
+    STREAM_CLEAN,           /**< ADC-10 cycles without any error */
+    STREAM_SOH_NOISE,       /**< Only start of headers, no message is ever completed */
+    STREAM_HEX_CORRUPTION,  /**< ADC-10 cycles, half of the frames have an invalid digit */
+    STREAM_TRUNCATED,       /**< ADC-10 cycles, half of the frames end early with a CR */
+    STREAM_COUNT
+} stream_kind_t;
+
+static const char *const STREAM_NAME[STREAM_COUNT] = {"clean", "soh-noise", "hex-corruption", "truncated"};
+
+/** Decoder measured */
+typedef enum
+{
+    DECODER_BYTE,           /**< adc_rs485_decode(), one call per byte */
+    DECODER_BUFFER,         /**< adc_rs485_decoder_decode_buffer() */
+    DECODER_DISPATCH,       /**< adc_rs485_decoder_dispatch() with a handler for every message */
+    DECODER_SIMD_NONE,      /**< adc_rs485_decoder_decode_buffer_simd() without SIMD instructions */
+    DECODER_SIMD_SSE2,      /**< adc_rs485_decoder_decode_buffer_simd() with SSE2 */
+    DECODER_SIMD_AVX2,      /**< adc_rs485_decoder_decode_buffer_simd() with AVX2 */
+    DECODER_COUNT
+} decoder_kind_t;
+
+static const char *const DECODER_NAME[DECODER_COUNT] = {"byte", "buffer", "dispatch", "simd-none", "simd-sse2", "simd-avx2"};
+
+/** Result of one decoder on one stream */
+typedef struct
+{
+    uint64_t messages;      /**< Messages returned, including errors */
+    uint64_t frames;        /**< Valid data and status messages */
+    uint64_t errors;
+    uint32_t checksum;      /**< Of all returned messages, identical for all decoders */
+    double seconds;         /**< Time of the fastest run */
+} result_t;
+
+/** xorshift64* pseudo-random generator, the streams are identical at every execution */
+static uint64_t random_next(uint64_t *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ull;
+}
+
+static double now_s(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+/** Damage a frame as requested by the kind of stream, returns its new length */
+static size_t damage_frame(stream_kind_t kind, uint64_t *rng, uint8_t frame[], size_t length)
+{
+    if ((random_next(rng) & 1u) == 0)
+    {
+        return length;
+    }
+
+    size_t pos = 2 + (size_t)(random_next(rng) % (length - 3));
+    if (kind == STREAM_HEX_CORRUPTION)
+    {
+        frame[pos] = 'G';
+    }
+    else if (kind == STREAM_TRUNCATED)
+    {
+        // The CR arrives early, the frame is rejected because of its length
+        frame[pos] = 0x0Du;
+        length = pos + 1;
+    }
+    return length;
+}
+
+/** Fill a buffer with a synthetic stream */
+static void generate_stream(stream_kind_t kind, uint8_t data[], size_t length)
+{
+    uint64_t rng = 0x5EED0000u + (uint64_t)kind;
+    uint8_t frame[ADC_RS485_MAX_FRAME_LENGTH];
+    size_t pos = 0;
+    size_t label = 0;
+
+    if (kind == STREAM_SOH_NOISE)
+    {
+        for (size_t i = 0; i < length; i++)
+        {
+            data[i] = SOH[random_next(&rng) & 3u];
+        }
+        return;
+    }
+
+    while (pos < length)
+    {
+        size_t frame_length;
+
+        if (label < sizeof(ADC10_CYCLE) / sizeof(ADC10_CYCLE[0]))
+        {
+            air_data_t air_data = {
+                .type = ADC10_CYCLE[label],
+                .value = (float)(random_next(&rng) % 100000u) / 8.0f,
+                .flag = FLAG_VALID};
+            frame_length = adc_rs485_encode_data(&air_data, frame);
+            label++;
+        }
+        else
+        {
+            adc_gen_status_t status = {.number = (uint16_t)random_next(&rng)};
+            frame_length = adc_rs485_encode_gen_status(status, frame);
+            label = 0;
+        }
+
+        frame_length = damage_frame(kind, &rng, frame, frame_length);
+        if (frame_length > length - pos)
+        {
+            frame_length = length - pos;
+        }
+        memcpy(&data[pos], frame, frame_length);
+        pos += frame_length;
+    }
+}
+
+/** Account for one message, bits identifies its content */
+static inline void count_bits(result_t *result, rs485_msg_type_t msg_type, uint32_t bits)
+{
+    if (msg_type == RS485_ERROR)
+    {
+        result->errors++;
+    }
+    else
+    {
+        result->frames++;
+    }
+    result->messages++;
+    result->checksum = (result->checksum * 31u) ^ bits ^ (uint32_t)msg_type;
+}
+
+/** Account for one returned message */
+static void count_message(const adc_rs485_msg_t *msg, result_t *result)
+{
+    uint32_t bits = 0;
+
+    switch (msg->msg_type)
+    {
+    case RS485_RETURNED_DATA:
+        memcpy(&bits, &msg->air_data.value, sizeof(bits));
+        bits ^= ((uint32_t)msg->air_data.type << 8) | (uint32_t)msg->air_data.flag;
+        break;
+    case RS485_RETURNED_STATUS_GEN:
+    case RS485_RETURNED_STATUS_HTR:
+        bits = msg->gen_status.number;
+        break;
+    default:
+        bits = (uint32_t)msg->error;
+        break;
+    }
+    count_bits(result, msg->msg_type, bits);
+}
+
+/** Handlers of the dispatch decoder, accounting for the messages as count_message() does */
+static void count_data(data_type_t type, float value, flag_t flag, void *user)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    count_bits((result_t *)user, RS485_RETURNED_DATA, bits ^ (((uint32_t)type << 8) | (uint32_t)flag));
+}
+
+static void count_gen_status(adc_gen_status_t status, void *user)
+{
+    count_bits((result_t *)user, RS485_RETURNED_STATUS_GEN, status.number);
+}
+
+static void count_htr_status(htr_status_t status, void *user)
+{
+    count_bits((result_t *)user, RS485_RETURNED_STATUS_HTR, status.number);
+}
+
+static void count_error(adc_rs485_error_t error, void *user)
+{
+    count_bits((result_t *)user, RS485_ERROR, (uint32_t)error);
+}
+
+/** Run a decoder once on a whole stream */
+static void run_decoder(decoder_kind_t kind, const uint8_t data[], size_t length, result_t *result)
+{
+    static adc_rs485_msg_t msgs[MSG_BUFFER_LENGTH];
+    adc_rs485_decoder_t decoder;
+
+    memset(result, 0, sizeof(*result));
+    adc_rs485_decoder_init(&decoder);
+
+    if (kind == DECODER_BYTE)
+    {
+        // Flush the state left by the previous run
+        adc_rs485_decode(0x0D);
+        for (size_t i = 0; i < length; i++)
+        {
+            adc_rs485_msg_t msg = adc_rs485_decode((char)data[i]);
+            // The bytes outside of a message are not returned by the buffer decoders
+            if ((msg.msg_type != RS485_PENDING) && ((msg.msg_type != RS485_ERROR) || (msg.error != ADC_RS485_ERROR_NO_SOH)))
+            {
+                count_message(&msg, result);
+            }
+        }
+        return;
+    }
+
+    if (kind == DECODER_DISPATCH)
+    {
+        adc_rs485_dispatch_t dispatch;
+
+        adc_rs485_dispatch_init(&dispatch);
+        for (uint32_t type = 0; type < RS485_DATA_NOT_VALID; type++)
+        {
+            adc_rs485_dispatch_on_data(&dispatch, (data_type_t)type, count_data, result);
+        }
+        adc_rs485_dispatch_on_gen_status(&dispatch, count_gen_status, result);
+        adc_rs485_dispatch_on_htr_status(&dispatch, count_htr_status, result);
+        adc_rs485_dispatch_on_error(&dispatch, count_error, result);
+        adc_rs485_decoder_dispatch(&decoder, &dispatch, data, length);
+        return;
+    }
+
+    while (length > 0)
+    {
+        size_t consumed = 0;
+        size_t count;
+
+        if (kind == DECODER_BUFFER)
+        {
+            count = adc_rs485_decoder_decode_buffer(&decoder, data, length, msgs, MSG_BUFFER_LENGTH, &consumed);
+        }
+        else
+        {
+            count = adc_rs485_decoder_decode_buffer_simd(&decoder, data, length, msgs, MSG_BUFFER_LENGTH, &consumed);
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            count_message(&msgs[i], result);
+        }
+        data += consumed;
+        length -= consumed;
+    }
+}
+
+/** Run a decoder several times and keep the fastest run */
+static void measure(decoder_kind_t kind, const uint8_t data[], size_t length, uint32_t runs, result_t *best)
+{
+    for (uint32_t run = 0; run < runs; run++)
+    {
+        result_t result;
+        double start = now_s();
+        run_decoder(kind, data, length, &result);
+        result.seconds = now_s() - start;
+
+        if ((run == 0) || (result.seconds < best->seconds))
+        {
+            *best = result;
+        }
+    }
+}
+
+static void print_result(bool csv, stream_kind_t stream, decoder_kind_t decoder, size_t length, const result_t *result)
+{
+    double bytes_per_s = (double)length / result->seconds;
+    double frames_per_s = (double)result->frames / result->seconds;
+
+    if (csv)
+    {
+        printf("%s,%s,%zu,%llu,%llu,%llu,%.6f,%.0f,%.0f,%08x\n",
+               STREAM_NAME[stream], DECODER_NAME[decoder], length, (unsigned long long)result->messages,
+               (unsigned long long)result->frames, (unsigned long long)result->errors, result->seconds,
+               bytes_per_s, frames_per_s, result->checksum);
+    }
+    else
+    {
+        printf("{\"stream\":\"%s\",\"decoder\":\"%s\",\"bytes\":%zu,\"messages\":%llu,\"frames\":%llu,"
+               "\"errors\":%llu,\"seconds\":%.6f,\"bytes_per_s\":%.0f,\"frames_per_s\":%.0f,\"checksum\":\"%08x\"}\n",
+               STREAM_NAME[stream], DECODER_NAME[decoder], length, (unsigned long long)result->messages,
+               (unsigned long long)result->frames, (unsigned long long)result->errors, result->seconds,
+               bytes_per_s, frames_per_s, result->checksum);
+    }
+}
+
+static void print_help()
+{
+    printf("Usage: bench [options]\n");
+    printf("Measure the throughput of the decoders, one result per line. \n");
+    printf("\n");
+    printf("Options: \n");
+    printf("  --size n:    Size of every stream in megabytes. By default, 16 is used. \n");
+    printf("  --runs n:    Runs per decoder and stream, the fastest is reported. By default, 5 is used. \n");
+    printf("  --csv:       Print CSV instead of JSON lines. \n");
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    size_t size_mb = DEFAULT_SIZE_MB;
+    uint32_t runs = DEFAULT_RUNS;
+    bool csv = false;
+    int32_t return_code = EXIT_SUCCESS;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if ((strcmp(argv[i], "--size") == 0) && (i + 1 < argc))
+        {
+            size_mb = strtoul(argv[++i], NULL, 10);
+        }
+        else if ((strcmp(argv[i], "--runs") == 0) && (i + 1 < argc))
+        {
+            runs = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--csv") == 0)
+        {
+            csv = true;
+        }
+        else
+        {
+            print_help();
+            return EXIT_FAILURE;
+        }
+    }
+
+    size_t length = size_mb * 1024u * 1024u;
+    uint8_t *data = malloc(length);
+    if ((data == NULL) || (length == 0) || (runs == 0))
+    {
+        printf("Invalid size or number of runs\n");
+        free(data);
+        return EXIT_FAILURE;
+    }
+
+    adc_rs485_simd_t supported = adc_rs485_simd_supported();
+    if (csv)
+    {
+        printf("stream,decoder,bytes,messages,frames,errors,seconds,bytes_per_s,frames_per_s,checksum\n");
+    }
+
+    for (stream_kind_t stream = 0; stream < STREAM_COUNT; stream++)
+    {
+        result_t reference;
+
+        generate_stream(stream, data, length);
+
+        for (decoder_kind_t decoder = 0; decoder < DECODER_COUNT; decoder++)
+        {
+            result_t result;
+
+            if (decoder >= DECODER_SIMD_NONE)
+            {
+                adc_rs485_simd_t simd = (adc_rs485_simd_t)(decoder - DECODER_SIMD_NONE);
+                if (simd > supported)
+                {
+                    continue;
+                }
+                adc_rs485_simd_select(simd);
+            }
+
+            measure(decoder, data, length, runs, &result);
+            print_result(csv, stream, decoder, length, &result);
+            fflush(stdout);
+
+            // All decoders shall return the same messages
+            if (decoder == DECODER_BYTE)
+            {
+                reference = result;
+            }
+            else if ((result.checksum != reference.checksum) || (result.messages != reference.messages))
+            {
+                fprintf(stderr, "%s differs from %s on the %s stream\n", DECODER_NAME[decoder],
+                        DECODER_NAME[DECODER_BYTE], STREAM_NAME[stream]);
+                return_code = EXIT_FAILURE;
+            }
+        }
+    }
+
+    adc_rs485_simd_select(supported);
+    free(data);
+    return return_code;
+}
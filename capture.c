@@ -0,0 +1,206 @@
+/*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*/
+
+#include "capture.h"
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/** Size in bytes of the write buffer of a capture file */
+#define CAPTURE_BUFFER_LENGTH (1024 * 1024)
+
+/** Maximum length of an unsigned LEB128 encoded 64-bit number */
+#define LEB128_MAX_LENGTH 10
+
+/** Encode an unsigned LEB128 number, returns its length */
+static size_t capture_put_leb128(uint8_t buffer[], uint64_t value)
+{
+    size_t length = 0;
+
+    while (value >= 0x80u)
+    {
+        buffer[length++] = (uint8_t)(value | 0x80u);
+        value >>= 7;
+    }
+    buffer[length++] = (uint8_t)value;
+    return length;
+}
+
+/** Decode an unsigned LEB128 number at the position of the reader */
+static bool capture_get_leb128(capture_reader_t *reader, uint64_t *value)
+{
+    uint64_t result = 0;
+
+    for (uint32_t shift = 0; (shift < 64) && (reader->pos < reader->size); shift += 7)
+    {
+        uint8_t byte = reader->base[reader->pos++];
+        result |= (uint64_t)(byte & 0x7Fu) << shift;
+        if ((byte & 0x80u) == 0)
+        {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+int32_t capture_writer_open(capture_writer_t *writer, const char *path, const char *device, uint32_t baudrate)
+{
+    capture_header_t header;
+    struct timespec now;
+
+    writer->file = fopen(path, "wb");
+    if (writer->file == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+
+    writer->buffer = malloc(CAPTURE_BUFFER_LENGTH);
+    if (writer->buffer != NULL)
+    {
+        setvbuf(writer->file, writer->buffer, _IOFBF, CAPTURE_BUFFER_LENGTH);
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.magic = CAPTURE_MAGIC;
+    header.version = CAPTURE_VERSION;
+    header.header_size = sizeof(header);
+    header.baudrate = baudrate;
+    clock_gettime(CLOCK_REALTIME, &now);
+    header.start_realtime_ns = ((int64_t)now.tv_sec * 1000000000) + now.tv_nsec;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    header.start_monotonic_ns = ((uint64_t)now.tv_sec * 1000000000u) + (uint64_t)now.tv_nsec;
+    snprintf(header.device, sizeof(header.device), "%s", device);
+    writer->last_ns = header.start_monotonic_ns;
+
+    if (fwrite(&header, sizeof(header), 1, writer->file) != 1)
+    {
+        capture_writer_close(writer);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int32_t capture_writer_write(capture_writer_t *writer, const uint8_t data[], size_t length, uint64_t timestamp_ns)
+{
+    uint8_t prefix[2 * LEB128_MAX_LENGTH];
+    size_t prefix_length;
+
+    // The monotonic clock never goes back, but the timestamps may come from several threads
+    uint64_t delta = (timestamp_ns > writer->last_ns) ? (timestamp_ns - writer->last_ns) : 0;
+    writer->last_ns += delta;
+
+    prefix_length = capture_put_leb128(prefix, delta);
+    prefix_length += capture_put_leb128(&prefix[prefix_length], length);
+
+    if ((fwrite(prefix, 1, prefix_length, writer->file) != prefix_length) ||
+        (fwrite(data, 1, length, writer->file) != length))
+    {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int32_t capture_writer_close(capture_writer_t *writer)
+{
+    int32_t return_code = EXIT_SUCCESS;
+
+    if (writer->file != NULL)
+    {
+        if (fclose(writer->file) != 0)
+        {
+            return_code = EXIT_FAILURE;
+        }
+        writer->file = NULL;
+    }
+    free(writer->buffer);
+    writer->buffer = NULL;
+    return return_code;
+}
+
+int32_t capture_reader_open(capture_reader_t *reader, const char *path)
+{
+    struct stat status;
+
+    memset(reader, 0, sizeof(*reader));
+    reader->base = MAP_FAILED;
+
+    reader->fd = open(path, O_RDONLY);
+    if (reader->fd < 0)
+    {
+        return EXIT_FAILURE;
+    }
+
+    if ((fstat(reader->fd, &status) != 0) || ((size_t)status.st_size < sizeof(capture_header_t)))
+    {
+        capture_reader_close(reader);
+        return EXIT_FAILURE;
+    }
+
+    reader->size = (size_t)status.st_size;
+    reader->base = mmap(NULL, reader->size, PROT_READ, MAP_PRIVATE, reader->fd, 0);
+    if (reader->base == MAP_FAILED)
+    {
+        capture_reader_close(reader);
+        return EXIT_FAILURE;
+    }
+    madvise((void *)reader->base, reader->size, MADV_SEQUENTIAL);
+
+    memcpy(&reader->header, reader->base, sizeof(reader->header));
+    reader->header.device[CAPTURE_DEVICE_LENGTH - 1] = '\0';
+    if ((reader->header.magic != CAPTURE_MAGIC) ||
+        (reader->header.version != CAPTURE_VERSION) ||
+        (reader->header.header_size < sizeof(capture_header_t)) ||
+        (reader->header.header_size > reader->size))
+    {
+        capture_reader_close(reader);
+        return EXIT_FAILURE;
+    }
+
+    reader->pos = reader->header.header_size;
+    reader->time_ns = reader->header.start_monotonic_ns;
+    return EXIT_SUCCESS;
+}
+
+bool capture_reader_next(capture_reader_t *reader, const uint8_t **data, size_t *length, uint64_t *timestamp_ns)
+{
+    uint64_t delta;
+    uint64_t chunk_length;
+
+    if (!capture_get_leb128(reader, &delta) || !capture_get_leb128(reader, &chunk_length) ||
+        (chunk_length > reader->size - reader->pos))
+    {
+        reader->pos = reader->size;
+        return false;
+    }
+
+    reader->time_ns += delta;
+    *data = &reader->base[reader->pos];
+    *length = (size_t)chunk_length;
+    *timestamp_ns = reader->time_ns;
+    reader->pos += (size_t)chunk_length;
+    return true;
+}
+
+void capture_reader_close(capture_reader_t *reader)
+{
+    if (reader->base != MAP_FAILED)
+    {
+        munmap((void *)reader->base, reader->size);
+        reader->base = MAP_FAILED;
+    }
+    if (reader->fd >= 0)
+    {
+        close(reader->fd);
+        reader->fd = -1;
+    }
+}
@@ -0,0 +1,135 @@
+/**
+* This module records the raw bytes received from a swiss air-data computer into a capture file and
+* reads them back, so that a recorded stream can be decoded again later, e.g. by a new version of
+* the decoder.
+*
+* A capture file starts with a fixed header (capture_header_t) followed by the chunks of bytes in
+* the order they have been read from the serial port. Every chunk starts with two unsigned LEB128
+* numbers: the time elapsed since the previous chunk in nanoseconds, then the number of bytes of
+* the chunk. All numbers of the header are in the byte order of the machine that wrote the file.
+*
+* The reader maps the whole file in memory, so that a capture can be decoded as fast as the memory
+* allows.
+*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*
+* Example code only. Use at own risk.
+*
+* This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* Simtec AG has no obligation to provide maintenance, support,  updates, enhancements, or modifications.
+*/
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/** Identifies a capture file, "ADCR" */
+#define CAPTURE_MAGIC 0x52434441u
+
+/** Version of the format of the capture files */
+#define CAPTURE_VERSION 1u
+
+/** Maximum length of the name of the device, including the terminating null character */
+#define CAPTURE_DEVICE_LENGTH 96
+
+/** Header at the beginning of a capture file, 128 bytes */
+typedef struct
+{
+    uint32_t magic;                     /**< CAPTURE_MAGIC */
+    uint32_t version;                   /**< CAPTURE_VERSION */
+    uint32_t header_size;               /**< Size of this header in bytes */
+    uint32_t baudrate;                  /**< Baudrate of the serial port */
+    int64_t start_realtime_ns;          /**< Wall-clock time at which the capture started, since 1970 */
+    uint64_t start_monotonic_ns;        /**< Monotonic time at which the capture started */
+    char device[CAPTURE_DEVICE_LENGTH]; /**< Serial port on which the bytes have been received */
+} capture_header_t;
+
+/** Capture file being written */
+typedef struct
+{
+    FILE *file;
+    char *buffer;               /**< Write buffer of the file */
+    uint64_t last_ns;           /**< Monotonic time of the previous chunk */
+} capture_writer_t;
+
+/** Capture file being read */
+typedef struct
+{
+    int fd;
+    const uint8_t *base;        /**< Whole file, mapped in memory */
+    size_t size;
+    size_t pos;                 /**< Offset of the next chunk */
+    uint64_t time_ns;           /**< Monotonic time of the previous chunk */
+    capture_header_t header;
+} capture_reader_t;
+
+/**
+ * Create a capture file and write its header.
+ *
+ * @param[out]  writer      Capture file.
+ * @param[in]   path        Path of the file, an existing file is replaced.
+ * @param[in]   device      Name of the serial port that is recorded.
+ * @param[in]   baudrate    Baudrate of the serial port.
+ *
+ * @return EXIT_FAILURE if the file couldn't be created, EXIT_SUCCESS otherwise.
+ */
+int32_t capture_writer_open(capture_writer_t *writer, const char *path, const char *device, uint32_t baudrate);
+
+/**
+ * Append one chunk of received bytes to a capture file.
+ *
+ * @param[in,out]   writer          Capture file.
+ * @param[in]       data            Bytes received.
+ * @param[in]       length          Number of bytes.
+ * @param[in]       timestamp_ns    Monotonic time at which the bytes have been received.
+ *
+ * @return EXIT_FAILURE if the chunk couldn't be written, EXIT_SUCCESS otherwise.
+ */
+int32_t capture_writer_write(capture_writer_t *writer, const uint8_t data[], size_t length, uint64_t timestamp_ns);
+
+/**
+ * Write the buffered chunks and close a capture file.
+ *
+ * @param[in,out]   writer  Capture file.
+ *
+ * @return EXIT_FAILURE if the file couldn't be completely written, EXIT_SUCCESS otherwise.
+ */
+int32_t capture_writer_close(capture_writer_t *writer);
+
+/**
+ * Open a capture file and map it in memory.
+ *
+ * @param[out]  reader  Capture file.
+ * @param[in]   path    Path of the file.
+ *
+ * @return EXIT_FAILURE if the file couldn't be opened or isn't a capture file, EXIT_SUCCESS otherwise.
+ */
+int32_t capture_reader_open(capture_reader_t *reader, const char *path);
+
+/**
+ * Get the next chunk of a capture file. The bytes are not copied.
+ *
+ * @param[in,out]   reader          Capture file.
+ * @param[out]      data            Bytes of the chunk, valid until the file is closed.
+ * @param[out]      length          Number of bytes of the chunk.
+ * @param[out]      timestamp_ns    Monotonic time at which the bytes have been received.
+ *
+ * @return false at the end of the file or if the last chunk is truncated, true otherwise.
+ */
+bool capture_reader_next(capture_reader_t *reader, const uint8_t **data, size_t *length, uint64_t *timestamp_ns);
+
+/**
+ * Unmap and close a capture file.
+ *
+ * @param[in,out]   reader  Capture file.
+ */
+void capture_reader_close(capture_reader_t *reader);
+
+#endif
@@ -0,0 +1,277 @@
+/*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*/
+
+#include "dashboard.h"
+#include "adc_event.h"
+#include "adc_history.h"
+#include "latest_table.h"
+#include "print_msg.h"
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/** Width of the title and status cells */
+#define WIDE_CELL_LENGTH 48
+
+/** Width of the cell of a label */
+#define LABEL_CELL_LENGTH 48
+
+/** Labels are shown in two columns, or in one with their statistics */
+#define LABEL_COLUMNS 2
+
+/** Width of one column of labels, including the space between the columns */
+#define COLUMN_WIDTH (LABEL_CELL_LENGTH + 2)
+
+/** Period over which the update rate of the labels is computed, in seconds */
+#define DASHBOARD_RATE_PERIOD_S 1.0
+
+/** ANSI sequences */
+#define ANSI_CLEAR_SCREEN "\x1b[2J"
+#define ANSI_HIDE_CURSOR "\x1b[?25l"
+#define ANSI_SHOW_CURSOR "\x1b[?25h"
+
+/** Append text to the output of a refresh */
+static size_t dashboard_append(dashboard_t *dashboard, size_t pos, const char *text, size_t length)
+{
+    memcpy(&dashboard->output[pos], text, length);
+    return pos + length;
+}
+
+/** Write the whole output, a single write() unless the terminal accepts only a part of it */
+static void dashboard_write(dashboard_t *dashboard, size_t length)
+{
+    const char *data = dashboard->output;
+
+    while (length > 0)
+    {
+        ssize_t written = write(dashboard->fd, data, length);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return;
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+}
+
+static dashboard_cell_t *dashboard_add_cell(dashboard_t *dashboard, uint16_t row, uint16_t column, uint16_t width)
+{
+    dashboard_cell_t *cell = &dashboard->cells[dashboard->cell_count++];
+    cell->row = row;
+    cell->column = column;
+    cell->width = width;
+    cell->shown[0] = '\0';
+    return cell;
+}
+
+/** Place the cells of every port: title, statuses, then the labels received so far in two columns */
+static void dashboard_layout(dashboard_t *dashboard)
+{
+    uint16_t row = 1;
+
+    dashboard->cell_count = 0;
+    for (size_t port = 0; port < dashboard->port_count; port++)
+    {
+        bool statistics = (dashboard->histories[port] != NULL);
+        size_t columns = statistics ? 1 : LABEL_COLUMNS;
+        uint16_t width = statistics ? DASHBOARD_CELL_LENGTH : LABEL_CELL_LENGTH;
+        size_t labels = 0;
+
+        dashboard_add_cell(dashboard, row++, 1, WIDE_CELL_LENGTH);
+        dashboard_add_cell(dashboard, row++, 1, WIDE_CELL_LENGTH);
+        for (uint32_t type = 0; type < RS485_DATA_NOT_VALID; type++)
+        {
+            if ((dashboard->layout[port] & (1ull << type)) != 0)
+            {
+                uint16_t column = (uint16_t)(1 + (labels % columns) * COLUMN_WIDTH);
+                dashboard_add_cell(dashboard, (uint16_t)(row + labels / columns), column, width);
+                labels++;
+            }
+        }
+        row = (uint16_t)(row + (labels + columns - 1) / columns + 1);
+    }
+    dashboard->bottom_row = row;
+}
+
+/** Queue the text of a cell if it differs from the one on the screen */
+static size_t dashboard_update_cell(dashboard_t *dashboard, size_t pos, dashboard_cell_t *cell, const char *text)
+{
+    char padded[DASHBOARD_CELL_LENGTH + 1];
+    char position[32];
+
+    // Padded to the width of the cell so that a shorter text erases the previous one
+    snprintf(padded, sizeof(padded), "%-*.*s", cell->width, cell->width, text);
+    if (strcmp(padded, cell->shown) == 0)
+    {
+        return pos;
+    }
+    memcpy(cell->shown, padded, sizeof(padded));
+
+    int length = snprintf(position, sizeof(position), "\x1b[%u;%uH", cell->row, cell->column);
+    pos = dashboard_append(dashboard, pos, position, (size_t)length);
+    return dashboard_append(dashboard, pos, padded, strlen(padded));
+}
+
+void dashboard_init(dashboard_t *dashboard, int fd, const char *const names[], const latest_table_t *const tables[], size_t port_count)
+{
+    memset(dashboard, 0, sizeof(*dashboard));
+    dashboard->fd = fd;
+    dashboard->port_count = (port_count < DASHBOARD_MAX_PORTS) ? port_count : DASHBOARD_MAX_PORTS;
+    for (size_t i = 0; i < dashboard->port_count; i++)
+    {
+        dashboard->names[i] = names[i];
+        dashboard->tables[i] = tables[i];
+    }
+}
+
+void dashboard_set_histories(dashboard_t *dashboard, const adc_history_t *const histories[])
+{
+    for (size_t i = 0; i < dashboard->port_count; i++)
+    {
+        dashboard->histories[i] = histories[i];
+    }
+}
+
+void dashboard_count(dashboard_t *dashboard, const adc_event_t events[], size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (events[i].port < dashboard->port_count)
+        {
+            dashboard->messages[events[i].port]++;
+            if (events[i].msg_type == RS485_ERROR)
+            {
+                dashboard->errors[events[i].port]++;
+            }
+        }
+    }
+}
+
+void dashboard_refresh(dashboard_t *dashboard, uint64_t now_ns)
+{
+    bool relayout = !dashboard->started;
+    size_t pos = 0;
+
+    // The rates are computed over a whole period so that they don't flicker at every refresh
+    double elapsed_s = (double)(now_ns - dashboard->rate_time_ns) / 1e9;
+    bool update_rates = (elapsed_s >= DASHBOARD_RATE_PERIOD_S);
+    if (update_rates)
+    {
+        dashboard->rate_time_ns = now_ns;
+    }
+
+    // Copy the tables first: a label received for the first time changes the layout
+    for (size_t port = 0; port < dashboard->port_count; port++)
+    {
+        uint64_t layout = 0;
+
+        latest_table_snapshot(dashboard->tables[port], &dashboard->snapshots[port]);
+        for (uint32_t type = 0; type < RS485_DATA_NOT_VALID; type++)
+        {
+            if (dashboard->snapshots[port].data[type].update_count != 0)
+            {
+                layout |= 1ull << type;
+            }
+        }
+        relayout |= (layout != dashboard->layout[port]);
+        dashboard->layout[port] = layout;
+    }
+
+    if (relayout)
+    {
+        dashboard_layout(dashboard);
+        if (!dashboard->started)
+        {
+            pos = dashboard_append(dashboard, pos, ANSI_HIDE_CURSOR, strlen(ANSI_HIDE_CURSOR));
+            dashboard->started = true;
+        }
+        pos = dashboard_append(dashboard, pos, ANSI_CLEAR_SCREEN, strlen(ANSI_CLEAR_SCREEN));
+    }
+
+    dashboard_cell_t *cell = dashboard->cells;
+    for (size_t port = 0; port < dashboard->port_count; port++)
+    {
+        const latest_snapshot_t *snapshot = &dashboard->snapshots[port];
+        char text[DASHBOARD_CELL_LENGTH + PRINT_LINE_LENGTH];
+
+        snprintf(text, sizeof(text), "%s  messages %llu  errors %llu", dashboard->names[port],
+                 (unsigned long long)dashboard->messages[port], (unsigned long long)dashboard->errors[port]);
+        pos = dashboard_update_cell(dashboard, pos, cell++, text);
+
+        char gen_status[8] = "-";
+        char htr_status[8] = "-";
+        if (snapshot->gen_status.update_count != 0)
+        {
+            snprintf(gen_status, sizeof(gen_status), "0x%04X", snapshot->gen_status.status & 0xFFFFu);
+        }
+        if (snapshot->htr_status.update_count != 0)
+        {
+            snprintf(htr_status, sizeof(htr_status), "0x%04X", snapshot->htr_status.status & 0xFFFFu);
+        }
+        snprintf(text, sizeof(text), "General status %-6s  Heater status %s", gen_status, htr_status);
+        pos = dashboard_update_cell(dashboard, pos, cell++, text);
+
+        for (uint32_t type = 0; type < RS485_DATA_NOT_VALID; type++)
+        {
+            const latest_value_t *value = &snapshot->data[type];
+            if ((dashboard->layout[port] & (1ull << type)) == 0)
+            {
+                continue;
+            }
+
+            air_data_t air_data = {
+                .type = (data_type_t)type,
+                .value = value->value,
+                .flag = (value->flag <= FLAG_INVALID) ? value->flag : FLAG_INVALID};
+            char line[PRINT_LINE_LENGTH];
+            print_format_air_data(&air_data, line, sizeof(line));
+
+            if (update_rates)
+            {
+                uint32_t updates = value->update_count - dashboard->previous_counts[port][type];
+                dashboard->previous_counts[port][type] = value->update_count;
+                dashboard->rates[port][type] = (float)((double)updates / elapsed_s);
+            }
+
+            adc_history_stats_t stats;
+            if ((dashboard->histories[port] != NULL) && adc_history_stats(dashboard->histories[port], (data_type_t)type, &stats))
+            {
+                snprintf(text, sizeof(text), "%-34s %5.0f/s  mean %11.5g  sd %10.4g  min %11.5g  max %11.5g", line,
+                         dashboard->rates[port][type], stats.mean, stats.stddev, (double)stats.min, (double)stats.max);
+            }
+            else
+            {
+                snprintf(text, sizeof(text), "%-34s %5.0f/s", line, dashboard->rates[port][type]);
+            }
+            pos = dashboard_update_cell(dashboard, pos, cell++, text);
+        }
+    }
+
+    if (pos > 0)
+    {
+        char position[32];
+        int length = snprintf(position, sizeof(position), "\x1b[%u;1H", dashboard->bottom_row);
+        pos = dashboard_append(dashboard, pos, position, (size_t)length);
+        dashboard_write(dashboard, pos);
+    }
+}
+
+void dashboard_close(dashboard_t *dashboard)
+{
+    if (dashboard->started)
+    {
+        int length = snprintf(dashboard->output, sizeof(dashboard->output), "\x1b[%u;1H" ANSI_SHOW_CURSOR "\n",
+                              dashboard->bottom_row);
+        dashboard_write(dashboard, (size_t)length);
+        dashboard->started = false;
+    }
+}
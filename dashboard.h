@@ -0,0 +1,121 @@
+/**
+* This module shows the latest values of all labels of one or several swiss air-data computers as
+* a dashboard in an ANSI terminal, instead of printing every message.
+*
+* The dashboard keeps a model of the screen. It is redrawn at a fixed rate from the latest value
+* tables: only the cells whose text has changed are written, with ANSI cursor positioning, and the
+* whole refresh is sent to the terminal with a single write. The decoding rate is therefore
+* independent of the speed of the terminal.
+*
+* When the recent values of the labels are kept, every label is shown on its own line with its
+* mean, standard deviation, minimum and maximum over the window.
+*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*
+* Example code only. Use at own risk.
+*
+* This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* Simtec AG has no obligation to provide maintenance, support,  updates, enhancements, or modifications.
+*/
+
+#ifndef DASHBOARD_H
+#define DASHBOARD_H
+
+#include "adc_event.h"
+#include "adc_history.h"
+#include "latest_table.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Maximum number of air data computers shown */
+#define DASHBOARD_MAX_PORTS 64
+
+/** Maximum width of a cell, in characters */
+#define DASHBOARD_CELL_LENGTH 112
+
+/** Number of cells per air data computer: title, statuses and one per label */
+#define DASHBOARD_CELLS_PER_PORT (2 + RS485_DATA_NOT_VALID)
+
+/** Maximum number of cells of the screen */
+#define DASHBOARD_MAX_CELLS (DASHBOARD_MAX_PORTS * DASHBOARD_CELLS_PER_PORT)
+
+/** One text area of the screen */
+typedef struct
+{
+    uint16_t row;                           /**< Row of the cell, starting at 1 */
+    uint16_t column;                        /**< Column of the cell, starting at 1 */
+    uint16_t width;                         /**< Width of the cell in characters */
+    char shown[DASHBOARD_CELL_LENGTH + 1];  /**< Text currently on the screen, empty if unknown */
+} dashboard_cell_t;
+
+/** Dashboard, too large for the stack */
+typedef struct
+{
+    size_t port_count;
+    const char *names[DASHBOARD_MAX_PORTS];             /**< Name of every air data computer */
+    const latest_table_t *tables[DASHBOARD_MAX_PORTS];  /**< Latest values of every air data computer */
+    const adc_history_t *histories[DASHBOARD_MAX_PORTS]; /**< Recent values of every air data computer, NULL if not kept */
+    uint64_t messages[DASHBOARD_MAX_PORTS];             /**< Messages received per port */
+    uint64_t errors[DASHBOARD_MAX_PORTS];               /**< Errors received per port */
+    uint64_t layout[DASHBOARD_MAX_PORTS];               /**< Labels shown per port, one bit per data_type_t */
+    latest_snapshot_t snapshots[DASHBOARD_MAX_PORTS];
+    uint32_t previous_counts[DASHBOARD_MAX_PORTS][RS485_DATA_NOT_VALID]; /**< Update counters at rate_time_ns */
+    float rates[DASHBOARD_MAX_PORTS][RS485_DATA_NOT_VALID];            /**< Updates per second of every label */
+    uint64_t rate_time_ns;                              /**< Time at which the rates have been computed */
+    dashboard_cell_t cells[DASHBOARD_MAX_CELLS];
+    size_t cell_count;
+    uint16_t bottom_row;                                /**< First row below the dashboard */
+    bool started;
+    int fd;                                             /**< Terminal */
+    char output[DASHBOARD_MAX_CELLS * (DASHBOARD_CELL_LENGTH + 16) + 64]; /**< Text of one refresh */
+} dashboard_t;
+
+/**
+ * Initialize a dashboard. Nothing is written to the terminal before the first refresh.
+ *
+ * @param[out]  dashboard   Dashboard to initialize.
+ * @param[in]   fd          File descriptor of the terminal.
+ * @param[in]   names       Name of every air data computer, e.g. its serial port.
+ * @param[in]   tables      Latest value table of every air data computer.
+ * @param[in]   port_count  Number of air data computers, at most DASHBOARD_MAX_PORTS.
+ */
+void dashboard_init(dashboard_t *dashboard, int fd, const char *const names[], const latest_table_t *const tables[], size_t port_count);
+
+/**
+ * Show the statistics of the recent values of every label. The histories shall be updated by the
+ * thread refreshing the dashboard.
+ *
+ * @param[in,out]   dashboard   Dashboard.
+ * @param[in]       histories   Recent values of every air data computer, in the order of the names.
+ */
+void dashboard_set_histories(dashboard_t *dashboard, const adc_history_t *const histories[]);
+
+/**
+ * Count the decoded messages, shown in the title of every air data computer.
+ *
+ * @param[in,out]   dashboard   Dashboard.
+ * @param[in]       events      Decoded messages.
+ * @param[in]       count       Number of messages.
+ */
+void dashboard_count(dashboard_t *dashboard, const adc_event_t events[], size_t count);
+
+/**
+ * Redraw the cells that have changed since the last refresh, with a single write to the terminal.
+ *
+ * @param[in,out]   dashboard   Dashboard.
+ * @param[in]       now_ns      Current monotonic time, used to compute the update rate of every label.
+ */
+void dashboard_refresh(dashboard_t *dashboard, uint64_t now_ns);
+
+/**
+ * Show the cursor again and move it below the dashboard.
+ *
+ * @param[in,out]   dashboard   Dashboard.
+ */
+void dashboard_close(dashboard_t *dashboard);
+
+#endif
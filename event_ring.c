@@ -0,0 +1,379 @@
+/*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*/
+
+#define _GNU_SOURCE
+
+#include "event_ring.h"
+#include "adc_event.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/** Number of times a blocked producer yields before it starts sleeping */
+#define BLOCK_SPIN_COUNT 64
+
+/** Sleeping time in nanoseconds of a blocked producer */
+#define BLOCK_SLEEP_NS 50000
+
+/** Returns the key under which a message is coalesced */
+static uint32_t event_ring_key(const adc_event_t *event)
+{
+    switch (event->msg_type)
+    {
+    case RS485_RETURNED_DATA:
+        return (event->data_type < RS485_DATA_NOT_VALID) ? event->data_type : RS485_DATA_NOT_VALID + 2;
+    case RS485_RETURNED_STATUS_GEN:
+        return RS485_DATA_NOT_VALID;
+    case RS485_RETURNED_STATUS_HTR:
+        return RS485_DATA_NOT_VALID + 1;
+    default:
+        return RS485_DATA_NOT_VALID + 2;
+    }
+}
+
+/**
+ * Write one message into the ring if there is room.
+ * @return false if the ring is full, true otherwise.
+ */
+static bool event_ring_try_push(event_ring_t *ring, const adc_event_t *event)
+{
+    uint64_t head = ring->head;
+
+    if ((head - ring->cached_tail) > ring->mask)
+    {
+        // The ring looked full the last time, check if the consumer made room since
+        ring->cached_tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if ((head - ring->cached_tail) > ring->mask)
+        {
+            return false;
+        }
+    }
+
+    ring->slots[head & ring->mask] = *event;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    ring->pushed++;
+    return true;
+}
+
+/** Count lost messages, the counter is read by other threads */
+static void event_ring_count_drop(event_ring_t *ring)
+{
+    __atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+}
+
+/** Remove the oldest message of a full ring */
+static void event_ring_drop_oldest(event_ring_t *ring)
+{
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+    // If the exchange fails the consumer has just made room, nothing needs to be dropped
+    if (((ring->head - tail) > ring->mask) &&
+        __atomic_compare_exchange_n(&ring->tail, &tail, tail + 1, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {
+        event_ring_count_drop(ring);
+    }
+}
+
+/** Returns the bit mask of the keys kept aside, can be called without the coalesce mutex */
+static inline uint64_t event_ring_coalesce_pending(event_ring_t *ring)
+{
+    return __atomic_load_n(&ring->coalesce_pending, __ATOMIC_ACQUIRE);
+}
+
+/** Remove the first keys of the coalesce table, the table is locked */
+static void event_ring_coalesce_remove_first(event_ring_t *ring, uint32_t count)
+{
+    uint64_t pending = ring->coalesce_pending;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        pending &= ~((uint64_t)1u << ring->coalesce_order[i]);
+    }
+    ring->coalesce_count -= count;
+    memmove(&ring->coalesce_order[0], &ring->coalesce_order[count], ring->coalesce_count);
+    __atomic_store_n(&ring->coalesce_pending, pending, __ATOMIC_RELEASE);
+}
+
+/** Move the coalesced messages into the ring in arrival order, as long as there is room. The table is locked */
+static void event_ring_flush_coalesced(event_ring_t *ring)
+{
+    uint32_t flushed = 0;
+
+    while ((flushed < ring->coalesce_count) && event_ring_try_push(ring, &ring->coalesced[ring->coalesce_order[flushed]]))
+    {
+        flushed++;
+    }
+    event_ring_coalesce_remove_first(ring, flushed);
+}
+
+/** Keep the message aside until there is room, replacing an older message with the same key. The table is locked */
+static void event_ring_coalesce(event_ring_t *ring, const adc_event_t *event)
+{
+    uint32_t key = event_ring_key(event);
+    uint64_t bit = (uint64_t)1u << key;
+
+    if ((ring->coalesce_pending & bit) != 0)
+    {
+        // The message is now the latest one to have arrived
+        uint32_t pos = 0;
+        while (ring->coalesce_order[pos] != key)
+        {
+            pos++;
+        }
+        memmove(&ring->coalesce_order[pos], &ring->coalesce_order[pos + 1], ring->coalesce_count - pos - 1u);
+        ring->coalesce_count--;
+        event_ring_count_drop(ring);
+    }
+    ring->coalesced[key] = *event;
+    ring->coalesce_order[ring->coalesce_count++] = (uint8_t)key;
+    __atomic_store_n(&ring->coalesce_pending, ring->coalesce_pending | bit, __ATOMIC_RELEASE);
+}
+
+/** Push one message with the coalesce policy, once messages are kept aside or the ring is full */
+static void event_ring_push_coalescing(event_ring_t *ring, const adc_event_t *event)
+{
+    pthread_mutex_lock(&ring->coalesce_mutex);
+
+    // Older coalesced messages go first, new messages wait behind them
+    event_ring_flush_coalesced(ring);
+    if ((ring->coalesce_count != 0) || !event_ring_try_push(ring, event))
+    {
+        event_ring_coalesce(ring, event);
+    }
+    pthread_mutex_unlock(&ring->coalesce_mutex);
+}
+
+/**
+ * Pop the coalesced messages in arrival order, only once the ring is empty: they arrived after the
+ * messages of the ring.
+ * @return Number of messages popped.
+ */
+static size_t event_ring_pop_coalesced(event_ring_t *ring, adc_event_t events[], size_t max_events)
+{
+    size_t count = 0;
+
+    pthread_mutex_lock(&ring->coalesce_mutex);
+
+    // The producer only pushes into the ring under the mutex while messages are kept aside
+    if (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE))
+    {
+        while ((count < ring->coalesce_count) && (count < max_events))
+        {
+            events[count] = ring->coalesced[ring->coalesce_order[count]];
+            count++;
+        }
+        event_ring_coalesce_remove_first(ring, (uint32_t)count);
+    }
+    pthread_mutex_unlock(&ring->coalesce_mutex);
+    return count;
+}
+
+/** Wait until there is room in the ring or until the ring is closed */
+static void event_ring_push_blocking(event_ring_t *ring, const adc_event_t *event)
+{
+    uint32_t spins = 0;
+
+    while (!event_ring_try_push(ring, event))
+    {
+        if (__atomic_load_n(&ring->closed, __ATOMIC_RELAXED) != 0)
+        {
+            event_ring_count_drop(ring);
+            break;
+        }
+
+        if (spins < BLOCK_SPIN_COUNT)
+        {
+            sched_yield();
+            spins++;
+        }
+        else
+        {
+            struct timespec pause = {.tv_sec = 0, .tv_nsec = BLOCK_SLEEP_NS};
+            nanosleep(&pause, NULL);
+        }
+    }
+}
+
+void event_ring_notifier_init(event_ring_notifier_t *notifier)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+
+    pthread_mutex_init(&notifier->mutex, NULL);
+    pthread_cond_init(&notifier->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    notifier->sleeping = 0;
+}
+
+int32_t event_ring_init(event_ring_t *ring, size_t capacity, event_ring_overflow_t overflow, event_ring_notifier_t *notifier)
+{
+    size_t rounded = 2;
+    while (rounded < capacity)
+    {
+        rounded <<= 1;
+    }
+
+    memset(ring, 0, sizeof(*ring));
+    if (posix_memalign((void **)&ring->slots, EVENT_RING_CACHE_LINE, rounded * sizeof(adc_event_t)) != 0)
+    {
+        ring->slots = NULL;
+        return EXIT_FAILURE;
+    }
+
+    ring->mask = rounded - 1;
+    ring->overflow = overflow;
+    ring->notifier = notifier;
+    pthread_mutex_init(&ring->coalesce_mutex, NULL);
+    return EXIT_SUCCESS;
+}
+
+void event_ring_free(event_ring_t *ring)
+{
+    if (ring->slots != NULL)
+    {
+        pthread_mutex_destroy(&ring->coalesce_mutex);
+    }
+    free(ring->slots);
+    ring->slots = NULL;
+}
+
+void event_ring_push(event_ring_t *ring, const adc_event_t events[], size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        switch (ring->overflow)
+        {
+        case EVENT_RING_DROP_OLDEST:
+            if (!event_ring_try_push(ring, &events[i]))
+            {
+                event_ring_drop_oldest(ring);
+                event_ring_try_push(ring, &events[i]);
+            }
+            break;
+
+        case EVENT_RING_COALESCE:
+            // Without message kept aside, the mutex is only taken when the ring is full
+            if ((event_ring_coalesce_pending(ring) != 0) || !event_ring_try_push(ring, &events[i]))
+            {
+                event_ring_push_coalescing(ring, &events[i]);
+            }
+            break;
+
+        default:
+            event_ring_push_blocking(ring, &events[i]);
+            break;
+        }
+    }
+
+    // Wake up the consumer if it sleeps, the fence orders the push before the check
+    event_ring_notifier_t *notifier = ring->notifier;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if ((notifier != NULL) && (__atomic_load_n(&notifier->sleeping, __ATOMIC_RELAXED) != 0))
+    {
+        event_ring_wake(notifier);
+    }
+}
+
+size_t event_ring_pop(event_ring_t *ring, adc_event_t events[], size_t max_events)
+{
+    for (;;)
+    {
+        uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+        // With the drop-oldest policy the producer can move the tail past the cached head
+        if ((int64_t)(ring->cached_head - tail) <= 0)
+        {
+            ring->cached_head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        }
+
+        size_t count = (size_t)(ring->cached_head - tail);
+        if (count > max_events)
+        {
+            count = max_events;
+        }
+        if (count == 0)
+        {
+            // The messages kept aside are only taken by the consumer, the producer may be quiet
+            if ((ring->overflow == EVENT_RING_COALESCE) && (event_ring_coalesce_pending(ring) != 0))
+            {
+                return event_ring_pop_coalesced(ring, events, max_events);
+            }
+            return 0;
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            events[i] = ring->slots[(tail + i) & ring->mask];
+        }
+
+        if (ring->overflow != EVENT_RING_DROP_OLDEST)
+        {
+            __atomic_store_n(&ring->tail, tail + count, __ATOMIC_RELEASE);
+            return count;
+        }
+
+        // The producer may have dropped the oldest messages meanwhile, their slots may have been
+        // overwritten: only keep the copy if the tail didn't move
+        if (__atomic_compare_exchange_n(&ring->tail, &tail, tail + count, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            return count;
+        }
+    }
+}
+
+uint64_t event_ring_dropped(const event_ring_t *ring)
+{
+    return __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+}
+
+void event_ring_close(event_ring_t *ring)
+{
+    __atomic_store_n(&ring->closed, 1, __ATOMIC_RELAXED);
+}
+
+void event_ring_wait(event_ring_notifier_t *notifier, event_ring_t *const rings[], size_t count, uint32_t timeout_ms)
+{
+    struct timespec deadline;
+    bool empty = true;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ms / 1000u;
+    deadline.tv_nsec += (long)(timeout_ms % 1000u) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&notifier->mutex);
+    __atomic_store_n(&notifier->sleeping, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    // Check again once the producers can see that the consumer sleeps
+    for (size_t i = 0; (i < count) && empty; i++)
+    {
+        empty = (__atomic_load_n(&rings[i]->head, __ATOMIC_ACQUIRE) == __atomic_load_n(&rings[i]->tail, __ATOMIC_ACQUIRE)) &&
+                (event_ring_coalesce_pending(rings[i]) == 0);
+    }
+    if (empty)
+    {
+        pthread_cond_timedwait(&notifier->cond, &notifier->mutex, &deadline);
+    }
+
+    __atomic_store_n(&notifier->sleeping, 0, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&notifier->mutex);
+}
+
+void event_ring_wake(event_ring_notifier_t *notifier)
+{
+    pthread_mutex_lock(&notifier->mutex);
+    pthread_cond_signal(&notifier->cond);
+    pthread_mutex_unlock(&notifier->mutex);
+}
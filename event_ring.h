@@ -0,0 +1,165 @@
+/**
+* This module implements a bounded, lock-free, single-producer/single-consumer ring of decoded
+* messages, used to hand the messages from a serial reader thread to a slower consumer.
+*
+* The producer never takes a lock while there is room in the ring. When the ring is full, the
+* configured overflow policy decides whether the producer waits, drops the oldest message or only
+* keeps the latest message per label. The latest messages kept aside are shared with the consumer
+* under a mutex: the consumer takes them in arrival order once it has emptied the ring, so that they
+* are delivered even if the producer doesn't push anything anymore. The consumer can sleep until a
+* producer pushes a message.
+*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*
+* Example code only. Use at own risk.
+*
+* This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* Simtec AG has no obligation to provide maintenance, support,  updates, enhancements, or modifications.
+*/
+
+#ifndef EVENT_RING_H
+#define EVENT_RING_H
+
+#include "adc_event.h"
+#include "adc_rs485_decoder.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Size in bytes of a cache line, the producer and consumer indexes are kept on separate lines */
+#define EVENT_RING_CACHE_LINE 64
+
+/** Number of keys used to coalesce the messages: one per data type, general status, heater status, error */
+#define EVENT_RING_COALESCE_KEYS (RS485_DATA_NOT_VALID + 3)
+
+/** What the producer does when the ring is full */
+typedef enum
+{
+    EVENT_RING_BLOCK = 0,       /**< Wait until the consumer makes room */
+    EVENT_RING_DROP_OLDEST = 1, /**< Drop the oldest message of the ring */
+    EVENT_RING_COALESCE = 2     /**< Keep aside only the latest message per label until there is room */
+} event_ring_overflow_t;
+
+/** Wakes up a consumer sleeping on one or several rings */
+typedef struct
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    uint32_t sleeping;            /**< Set while the consumer sleeps */
+} event_ring_notifier_t;
+
+/** Single-producer/single-consumer ring of decoded messages */
+typedef struct
+{
+    // Written by the producer
+    uint64_t head __attribute__((aligned(EVENT_RING_CACHE_LINE))); /**< Index of the next message to write */
+    uint64_t cached_tail;         /**< Last tail seen by the producer */
+    uint64_t pushed;              /**< Number of messages pushed */
+    uint64_t dropped;             /**< Number of messages dropped or coalesced because the ring was full */
+
+    // Shared by the producer and the consumer under the coalesce mutex, only with the coalesce policy
+    pthread_mutex_t coalesce_mutex;
+    uint64_t coalesce_pending;    /**< Bit mask of the keys waiting in the coalesce table, also read without the mutex */
+    uint8_t coalesce_order[EVENT_RING_COALESCE_KEYS]; /**< Keys waiting, the least recently updated first */
+    uint32_t coalesce_count;      /**< Number of keys waiting */
+    adc_event_t coalesced[EVENT_RING_COALESCE_KEYS]; /**< Latest message per key waiting for room */
+
+    // Written by the consumer
+    uint64_t tail __attribute__((aligned(EVENT_RING_CACHE_LINE))); /**< Index of the next message to read */
+    uint64_t cached_head;         /**< Last head seen by the consumer */
+
+    // Read only once initialized
+    adc_event_t *slots __attribute__((aligned(EVENT_RING_CACHE_LINE)));
+    uint64_t mask;                /**< Capacity minus one, the capacity is a power of two */
+    event_ring_overflow_t overflow;
+    event_ring_notifier_t *notifier;
+    uint32_t closed;              /**< Set when the consumer is gone, a blocked producer gives up */
+} event_ring_t;
+
+/**
+ * Initialize a notifier.
+ *
+ * @param[out]  notifier    Notifier to initialize.
+ */
+void event_ring_notifier_init(event_ring_notifier_t *notifier);
+
+/**
+ * Initialize a ring.
+ *
+ * @param[out]  ring        Ring to initialize.
+ * @param[in]   capacity    Number of messages the ring can hold, rounded up to a power of two.
+ * @param[in]   overflow    Overflow policy.
+ * @param[in]   notifier    Notifier woken up when a message is pushed, can be NULL.
+ *
+ * @return EXIT_FAILURE if the memory couldn't be allocated, EXIT_SUCCESS otherwise.
+ */
+int32_t event_ring_init(event_ring_t *ring, size_t capacity, event_ring_overflow_t overflow, event_ring_notifier_t *notifier);
+
+/**
+ * Release the memory of a ring.
+ *
+ * @param[in,out]   ring    Ring that is not used anymore.
+ */
+void event_ring_free(event_ring_t *ring);
+
+/**
+ * Push messages into a ring. Shall only be called by the producer.
+ *
+ * @param[in,out]   ring    Ring.
+ * @param[in]       events  Messages to push.
+ * @param[in]       count   Number of messages.
+ */
+void event_ring_push(event_ring_t *ring, const adc_event_t events[], size_t count);
+
+/**
+ * Pop messages from a ring. Shall only be called by the consumer. Never blocks, except on the mutex
+ * of the coalesce policy: once the ring is empty, the messages kept aside are popped as well.
+ *
+ * @param[in,out]   ring        Ring.
+ * @param[out]      events      Array that will contain the messages.
+ * @param[in]       max_events  Size of the array.
+ *
+ * @return Number of messages popped.
+ */
+size_t event_ring_pop(event_ring_t *ring, adc_event_t events[], size_t max_events);
+
+/**
+ * Returns the number of messages dropped or coalesced because the ring was full.
+ *
+ * @param[in]   ring    Ring.
+ *
+ * @return Number of messages lost by the ring.
+ */
+uint64_t event_ring_dropped(const event_ring_t *ring);
+
+/**
+ * Mark a ring as closed: a producer blocked by a full ring stops waiting and drops its messages.
+ *
+ * @param[in,out]   ring    Ring.
+ */
+void event_ring_close(event_ring_t *ring);
+
+/**
+ * Sleep until a message is pushed into one of the rings, or until the timeout elapses.
+ * Returns immediately if one of the rings isn't empty or has messages kept aside. Shall only be called by the consumer of the
+ * rings, which shall all use this notifier.
+ *
+ * @param[in,out]   notifier    Notifier of the rings.
+ * @param[in]       rings       Rings read by the consumer.
+ * @param[in]       count       Number of rings.
+ * @param[in]       timeout_ms  Maximum sleeping time in milliseconds.
+ */
+void event_ring_wait(event_ring_notifier_t *notifier, event_ring_t *const rings[], size_t count, uint32_t timeout_ms);
+
+/**
+ * Wake up the consumer sleeping on a notifier, e.g. to let it stop.
+ *
+ * @param[in,out]   notifier    Notifier.
+ */
+void event_ring_wake(event_ring_notifier_t *notifier);
+
+#endif
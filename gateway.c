@@ -0,0 +1,585 @@
+/*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*/
+
+#define _GNU_SOURCE
+
+#include "gateway.h"
+#include "adc_rs485_decoder.h"
+#include "adc_rs485_encoder.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/** Maximum time the accepting thread waits before checking if it shall stop, in milliseconds */
+#define ACCEPT_WAIT_MS 100
+
+/** Time to live of the multicast datagrams: they don't leave the local network */
+#define MULTICAST_TTL 1
+
+static void gateway_write_u16(uint8_t bytes[], uint16_t value)
+{
+    bytes[0] = (uint8_t)(value >> 8);
+    bytes[1] = (uint8_t)value;
+}
+
+static void gateway_write_u32(uint8_t bytes[], uint32_t value)
+{
+    gateway_write_u16(&bytes[0], (uint16_t)(value >> 16));
+    gateway_write_u16(&bytes[2], (uint16_t)value);
+}
+
+static uint16_t gateway_read_u16(const uint8_t bytes[])
+{
+    return (uint16_t)(((uint16_t)bytes[0] << 8) | bytes[1]);
+}
+
+static uint32_t gateway_read_u32(const uint8_t bytes[])
+{
+    return ((uint32_t)gateway_read_u16(&bytes[0]) << 16) | gateway_read_u16(&bytes[2]);
+}
+
+void gateway_header_write(const gateway_header_t *header, uint8_t bytes[])
+{
+    gateway_write_u32(&bytes[0], header->magic);
+    bytes[4] = header->version;
+    bytes[5] = header->port;
+    bytes[6] = header->port_count;
+    bytes[7] = header->frame_count;
+    gateway_write_u32(&bytes[8], header->sequence);
+    gateway_write_u16(&bytes[12], header->length);
+    gateway_write_u16(&bytes[14], header->reserved);
+}
+
+bool gateway_header_read(gateway_header_t *header, const uint8_t bytes[])
+{
+    header->magic = gateway_read_u32(&bytes[0]);
+    header->version = bytes[4];
+    header->port = bytes[5];
+    header->port_count = bytes[6];
+    header->frame_count = bytes[7];
+    header->sequence = gateway_read_u32(&bytes[8]);
+    header->length = gateway_read_u16(&bytes[12]);
+    header->reserved = gateway_read_u16(&bytes[14]);
+
+    return (header->magic == GATEWAY_MAGIC) && (header->version == GATEWAY_VERSION) &&
+           (header->length <= GATEWAY_MAX_PAYLOAD) && (header->port < header->port_count);
+}
+
+/**
+ * Split "host:port" into its host and its port.
+ * @return false if there is no port, true otherwise.
+ */
+static bool gateway_parse_address(const char *address, char host[], size_t host_length, char service[], size_t service_length)
+{
+    const char *colon = strrchr(address, ':');
+
+    if ((colon == NULL) || (colon[1] == '\0') || ((size_t)(colon - address) >= host_length))
+    {
+        return false;
+    }
+    memcpy(host, address, (size_t)(colon - address));
+    host[colon - address] = '\0';
+    snprintf(service, service_length, "%s", colon + 1);
+    return true;
+}
+
+/** Read a multicast group given as "address:port" */
+static bool gateway_parse_group(const char *group, struct sockaddr_in *address)
+{
+    char host[64];
+    char service[16];
+
+    memset(address, 0, sizeof(*address));
+    address->sin_family = AF_INET;
+    if (!gateway_parse_address(group, host, sizeof(host), service, sizeof(service)) ||
+        (inet_pton(AF_INET, host, &address->sin_addr) != 1) || !IN_MULTICAST(ntohl(address->sin_addr.s_addr)))
+    {
+        return false;
+    }
+    address->sin_port = htons((uint16_t)strtoul(service, NULL, 10));
+    return true;
+}
+
+/** Accept the TCP subscribers until the gateway is closed */
+static void *gateway_accept(void *arg)
+{
+    gateway_t *gateway = (gateway_t *)arg;
+    struct pollfd pfd = {.fd = gateway->listen_fd, .events = POLLIN, .revents = 0};
+
+    while (__atomic_load_n(&gateway->stop, __ATOMIC_ACQUIRE) == 0)
+    {
+        if (poll(&pfd, 1, ACCEPT_WAIT_MS) <= 0)
+        {
+            continue;
+        }
+
+        // Non-blocking, so that a subscriber that doesn't read never blocks a serial port reader
+        int client = accept4(gateway->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client < 0)
+        {
+            continue;
+        }
+        int enable = 1;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+        pthread_mutex_lock(&gateway->lock);
+        size_t i = 0;
+        while ((i < GATEWAY_MAX_SUBSCRIBERS) && (gateway->subscribers[i] >= 0))
+        {
+            i++;
+        }
+        if (i < GATEWAY_MAX_SUBSCRIBERS)
+        {
+            gateway->subscribers[i] = client;
+            gateway->accepted++;
+        }
+        else
+        {
+            close(client);
+        }
+        pthread_mutex_unlock(&gateway->lock);
+    }
+    return NULL;
+}
+
+/** Create the socket sending to the multicast group */
+static int32_t gateway_open_multicast(gateway_t *gateway, const char *group)
+{
+    unsigned char ttl = MULTICAST_TTL;
+    unsigned char loop = 1;
+
+    if (!gateway_parse_group(group, &gateway->group))
+    {
+        return EXIT_FAILURE;
+    }
+    gateway->udp_fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (gateway->udp_fd < 0)
+    {
+        return EXIT_FAILURE;
+    }
+    setsockopt(gateway->udp_fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    setsockopt(gateway->udp_fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+    return EXIT_SUCCESS;
+}
+
+/** Create the socket accepting the TCP subscribers and start accepting them */
+static int32_t gateway_open_tcp(gateway_t *gateway, uint16_t tcp_port)
+{
+    struct sockaddr_in address;
+    int enable = 1;
+
+    gateway->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (gateway->listen_fd < 0)
+    {
+        return EXIT_FAILURE;
+    }
+    setsockopt(gateway->listen_fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    // The ground stations connect from other machines
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(tcp_port);
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if ((bind(gateway->listen_fd, (struct sockaddr *)&address, sizeof(address)) != 0) ||
+        (listen(gateway->listen_fd, GATEWAY_MAX_SUBSCRIBERS) != 0) ||
+        (pthread_create(&gateway->accept_thread, NULL, gateway_accept, gateway) != 0))
+    {
+        return EXIT_FAILURE;
+    }
+    gateway->accepting = true;
+    return EXIT_SUCCESS;
+}
+
+int32_t gateway_open(gateway_t *gateway, size_t port_count, const char *group, uint16_t tcp_port)
+{
+    memset(gateway, 0, sizeof(*gateway));
+    gateway->udp_fd = -1;
+    gateway->listen_fd = -1;
+    for (size_t i = 0; i < GATEWAY_MAX_SUBSCRIBERS; i++)
+    {
+        gateway->subscribers[i] = -1;
+    }
+    pthread_mutex_init(&gateway->lock, NULL);
+
+    if ((port_count == 0) || (port_count > UINT8_MAX))
+    {
+        return EXIT_FAILURE;
+    }
+    gateway->port_count = port_count;
+    gateway->sequences = calloc(port_count, sizeof(*gateway->sequences));
+
+    if ((gateway->sequences == NULL) ||
+        ((group != NULL) && (gateway_open_multicast(gateway, group) != EXIT_SUCCESS)) ||
+        ((tcp_port != 0) && (gateway_open_tcp(gateway, tcp_port) != EXIT_SUCCESS)))
+    {
+        gateway_close(gateway);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+/** Send a datagram whose frames have been written after the header */
+static void gateway_send(gateway_t *gateway, uint32_t port, uint8_t datagram[], size_t length, uint32_t frames)
+{
+    gateway_header_t header = {
+        .magic = GATEWAY_MAGIC,
+        .version = GATEWAY_VERSION,
+        .port = (uint8_t)port,
+        .port_count = (uint8_t)gateway->port_count,
+        .frame_count = (uint8_t)frames,
+        .sequence = gateway->sequences[port]++,
+        .length = (uint16_t)length,
+        .reserved = 0};
+    size_t total = GATEWAY_HEADER_LENGTH + length;
+
+    gateway_header_write(&header, datagram);
+    __atomic_add_fetch(&gateway->datagrams, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&gateway->frames, frames, __ATOMIC_RELAXED);
+
+    if ((gateway->udp_fd >= 0) &&
+        (sendto(gateway->udp_fd, datagram, total, MSG_DONTWAIT, (struct sockaddr *)&gateway->group, sizeof(gateway->group)) != (ssize_t)total))
+    {
+        __atomic_add_fetch(&gateway->send_errors, 1, __ATOMIC_RELAXED);
+    }
+
+    if (gateway->listen_fd < 0)
+    {
+        return;
+    }
+    pthread_mutex_lock(&gateway->lock);
+    for (size_t i = 0; i < GATEWAY_MAX_SUBSCRIBERS; i++)
+    {
+        int fd = gateway->subscribers[i];
+        if (fd < 0)
+        {
+            continue;
+        }
+
+        ssize_t sent;
+        do
+        {
+            sent = send(fd, datagram, total, MSG_DONTWAIT | MSG_NOSIGNAL);
+        } while ((sent < 0) && (errno == EINTR));
+
+        if (sent != (ssize_t)total)
+        {
+            // A partial datagram can't be completed later without blocking: the stream is cut
+            if ((sent >= 0) || (errno == EAGAIN) || (errno == EWOULDBLOCK))
+            {
+                gateway->disconnected++;
+            }
+            close(fd);
+            gateway->subscribers[i] = -1;
+        }
+    }
+    pthread_mutex_unlock(&gateway->lock);
+}
+
+void gateway_forward(gateway_t *gateway, uint32_t port, const adc_rs485_msg_t msgs[], size_t count)
+{
+    uint8_t datagram[GATEWAY_MAX_DATAGRAM];
+    uint8_t *payload = &datagram[GATEWAY_HEADER_LENGTH];
+    size_t length = 0;
+    uint32_t frames = 0;
+
+    if (port >= gateway->port_count)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (msgs[i].msg_type == RS485_ERROR)
+        {
+            continue;
+        }
+        if (length + ADC_RS485_MAX_FRAME_LENGTH > GATEWAY_MAX_PAYLOAD)
+        {
+            gateway_send(gateway, port, datagram, length, frames);
+            length = 0;
+            frames = 0;
+        }
+
+        size_t frame_length = adc_rs485_encode(&msgs[i], &payload[length]);
+        if (frame_length > 0)
+        {
+            length += frame_length;
+            frames++;
+        }
+    }
+
+    if (frames > 0)
+    {
+        gateway_send(gateway, port, datagram, length, frames);
+    }
+}
+
+void gateway_close(gateway_t *gateway)
+{
+    if (gateway->accepting)
+    {
+        __atomic_store_n(&gateway->stop, 1, __ATOMIC_RELEASE);
+        pthread_join(gateway->accept_thread, NULL);
+        gateway->accepting = false;
+    }
+    for (size_t i = 0; i < GATEWAY_MAX_SUBSCRIBERS; i++)
+    {
+        if (gateway->subscribers[i] >= 0)
+        {
+            close(gateway->subscribers[i]);
+            gateway->subscribers[i] = -1;
+        }
+    }
+    if (gateway->listen_fd >= 0)
+    {
+        close(gateway->listen_fd);
+        gateway->listen_fd = -1;
+    }
+    if (gateway->udp_fd >= 0)
+    {
+        close(gateway->udp_fd);
+        gateway->udp_fd = -1;
+    }
+    free(gateway->sequences);
+    gateway->sequences = NULL;
+    pthread_mutex_destroy(&gateway->lock);
+}
+
+static void gateway_client_reset(gateway_client_t *client, bool tcp)
+{
+    memset(client, 0, sizeof(*client));
+    client->fd = -1;
+    client->tcp = tcp;
+}
+
+int32_t gateway_client_connect(gateway_client_t *client, const char *address)
+{
+    struct addrinfo hints;
+    struct addrinfo *results = NULL;
+    char host[256];
+    char service[16];
+
+    gateway_client_reset(client, true);
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if (!gateway_parse_address(address, host, sizeof(host), service, sizeof(service)) ||
+        (getaddrinfo(host, service, &hints, &results) != 0))
+    {
+        return EXIT_FAILURE;
+    }
+
+    for (struct addrinfo *result = results; (result != NULL) && (client->fd < 0); result = result->ai_next)
+    {
+        client->fd = socket(result->ai_family, result->ai_socktype | SOCK_CLOEXEC, result->ai_protocol);
+        if ((client->fd >= 0) && (connect(client->fd, result->ai_addr, result->ai_addrlen) != 0))
+        {
+            close(client->fd);
+            client->fd = -1;
+        }
+    }
+    freeaddrinfo(results);
+    return (client->fd < 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int32_t gateway_client_join(gateway_client_t *client, const char *group)
+{
+    struct sockaddr_in address;
+    struct ip_mreq membership;
+    int enable = 1;
+
+    gateway_client_reset(client, false);
+    if (!gateway_parse_group(group, &address))
+    {
+        return EXIT_FAILURE;
+    }
+    client->fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (client->fd < 0)
+    {
+        return EXIT_FAILURE;
+    }
+    // Several clients of the same machine can join the group
+    setsockopt(client->fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    membership.imr_multiaddr = address.sin_addr;
+    membership.imr_interface.s_addr = htonl(INADDR_ANY);
+    if ((bind(client->fd, (struct sockaddr *)&address, sizeof(address)) != 0) ||
+        (setsockopt(client->fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) != 0))
+    {
+        gateway_client_close(client);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Check the sequence number of a datagram received.
+ * @return false if the datagram is late and shall be skipped, true otherwise.
+ */
+static bool gateway_client_sequence(gateway_client_t *client, const gateway_header_t *header)
+{
+    if (client->synchronized[header->port])
+    {
+        int32_t gap = (int32_t)(header->sequence - client->expected[header->port]);
+        if (gap < 0)
+        {
+            client->invalid++;
+            return false;
+        }
+        client->lost += (uint64_t)gap;
+    }
+    client->synchronized[header->port] = true;
+    client->expected[header->port] = header->sequence + 1;
+    client->port_count = header->port_count;
+    client->datagrams++;
+    return true;
+}
+
+/** Wait until the socket of a client can be read */
+static int32_t gateway_client_wait(gateway_client_t *client, bool *readable)
+{
+    struct pollfd pfd = {.fd = client->fd, .events = POLLIN, .revents = 0};
+    int timeout_ms = (client->read_timeout_ms > 0) ? (int)client->read_timeout_ms : -1;
+
+    int count = poll(&pfd, 1, timeout_ms);
+    *readable = (count > 0);
+    return (count < 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/** Receive one datagram from the multicast group */
+static int32_t gateway_client_read_udp(gateway_client_t *client, uint8_t data[], size_t *length, uint8_t *port)
+{
+    gateway_header_t header;
+    bool readable;
+
+    if (gateway_client_wait(client, &readable) != EXIT_SUCCESS)
+    {
+        return EXIT_FAILURE;
+    }
+    if (!readable)
+    {
+        return EXIT_SUCCESS;
+    }
+
+    ssize_t received = recv(client->fd, client->buffer, GATEWAY_MAX_DATAGRAM, MSG_DONTWAIT);
+    if (received < 0)
+    {
+        return ((errno == EAGAIN) || (errno == EWOULDBLOCK)) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (((size_t)received < GATEWAY_HEADER_LENGTH) || !gateway_header_read(&header, client->buffer) ||
+        ((size_t)received != (size_t)GATEWAY_HEADER_LENGTH + (size_t)header.length))
+    {
+        client->invalid++;
+    }
+    else if (gateway_client_sequence(client, &header))
+    {
+        memcpy(data, &client->buffer[GATEWAY_HEADER_LENGTH], header.length);
+        *length = header.length;
+        *port = header.port;
+    }
+    return EXIT_SUCCESS;
+}
+
+/** Receive the stream of a TCP connection until it holds one complete datagram */
+static int32_t gateway_client_read_tcp(gateway_client_t *client, uint8_t data[], size_t *length, uint8_t *port)
+{
+    gateway_header_t header;
+
+    for (;;)
+    {
+        if (client->buffered >= GATEWAY_HEADER_LENGTH)
+        {
+            if (!gateway_header_read(&header, client->buffer))
+            {
+                // The datagrams follow each other without separator, the stream can't be resynchronized
+                client->invalid++;
+                return EXIT_FAILURE;
+            }
+
+            size_t total = GATEWAY_HEADER_LENGTH + header.length;
+            if (client->buffered >= total)
+            {
+                bool in_sequence = gateway_client_sequence(client, &header);
+                if (in_sequence)
+                {
+                    memcpy(data, &client->buffer[GATEWAY_HEADER_LENGTH], header.length);
+                    *length = header.length;
+                    *port = header.port;
+                }
+                client->buffered -= total;
+                memmove(client->buffer, &client->buffer[total], client->buffered);
+                if (in_sequence)
+                {
+                    return EXIT_SUCCESS;
+                }
+                continue;
+            }
+        }
+
+        bool readable;
+        if (gateway_client_wait(client, &readable) != EXIT_SUCCESS)
+        {
+            return EXIT_FAILURE;
+        }
+        if (!readable)
+        {
+            return EXIT_SUCCESS;
+        }
+
+        ssize_t received = recv(client->fd, &client->buffer[client->buffered], sizeof(client->buffer) - client->buffered, MSG_DONTWAIT);
+        if (received == 0)
+        {
+            // The gateway has closed the connection
+            return EXIT_FAILURE;
+        }
+        if (received < 0)
+        {
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+            {
+                return EXIT_FAILURE;
+            }
+        }
+        else
+        {
+            client->buffered += (size_t)received;
+        }
+    }
+}
+
+int32_t gateway_client_read(gateway_client_t *client, uint8_t data[], size_t *length, uint8_t *port)
+{
+    *length = 0;
+    *port = 0;
+
+    if (client->fd < 0)
+    {
+        return EXIT_FAILURE;
+    }
+    return client->tcp ? gateway_client_read_tcp(client, data, length, port) : gateway_client_read_udp(client, data, length, port);
+}
+
+void gateway_client_close(gateway_client_t *client)
+{
+    if (client->fd >= 0)
+    {
+        close(client->fd);
+        client->fd = -1;
+    }
+    client->buffered = 0;
+}
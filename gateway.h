@@ -0,0 +1,198 @@
+/**
+* This module republishes the frames received from swiss air-data computers over the network, so
+* that several ground stations can decode the same stream, and reads them back on the other side.
+*
+* Only the frames that have been decoded without error are forwarded, re-encoded by
+* adc_rs485_encode(). The frames of one read of a serial port are batched into datagrams of at most
+* GATEWAY_MAX_PAYLOAD bytes, each starting with a header (see gateway_header_t) that carries the
+* index of the serial port and a sequence number per port, so that a client can detect the lost
+* datagrams. The datagrams are sent to a UDP multicast group and to every TCP subscriber, on which
+* they follow each other without separator.
+*
+* The frames are sent from the threads reading the serial ports and no send ever blocks: a TCP
+* subscriber whose socket buffer is full has fallen behind and is disconnected.
+*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*
+* Example code only. Use at own risk.
+*
+* This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* Simtec AG has no obligation to provide maintenance, support,  updates, enhancements, or modifications.
+*/
+
+#ifndef GATEWAY_H
+#define GATEWAY_H
+
+#include "adc_rs485_decoder.h"
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Identifies a datagram of the gateway, "ADCG" */
+#define GATEWAY_MAGIC 0x41444347u
+
+/** Version of the format of the datagrams */
+#define GATEWAY_VERSION 1u
+
+/** Size in bytes of the header of a datagram */
+#define GATEWAY_HEADER_LENGTH 16
+
+/** Maximum number of bytes of frames per datagram, so that a datagram fits in an Ethernet frame */
+#define GATEWAY_MAX_PAYLOAD 1400
+
+/** Maximum length in bytes of a datagram */
+#define GATEWAY_MAX_DATAGRAM (GATEWAY_HEADER_LENGTH + GATEWAY_MAX_PAYLOAD)
+
+/** Maximum number of TCP subscribers at the same time */
+#define GATEWAY_MAX_SUBSCRIBERS 32
+
+/**
+ * Header of a datagram, followed by the frames. On the network, every number is in big-endian
+ * byte order and the fields follow each other without padding.
+ */
+typedef struct
+{
+    uint32_t magic;         /**< GATEWAY_MAGIC */
+    uint8_t version;        /**< GATEWAY_VERSION */
+    uint8_t port;           /**< Index of the serial port on which the frames have been received */
+    uint8_t port_count;     /**< Number of serial ports read by the gateway */
+    uint8_t frame_count;    /**< Number of frames of the datagram */
+    uint32_t sequence;      /**< Number of datagrams sent before this one for this port */
+    uint16_t length;        /**< Number of bytes of frames following the header */
+    uint16_t reserved;      /**< 0 */
+} gateway_header_t;
+
+/** Gateway forwarding the frames of several serial ports */
+typedef struct
+{
+    size_t port_count;
+    uint32_t *sequences;                     /**< Next sequence number of every port, written by its reader thread only */
+    int udp_fd;                              /**< Socket sending to the multicast group, -1 for none */
+    struct sockaddr_in group;                /**< Multicast group and UDP port */
+    int listen_fd;                           /**< Socket accepting the TCP subscribers, -1 for none */
+    int subscribers[GATEWAY_MAX_SUBSCRIBERS]; /**< Sockets of the TCP subscribers, -1 for a free entry */
+    pthread_mutex_t lock;                    /**< Protects the subscribers */
+    pthread_t accept_thread;
+    bool accepting;                          /**< Set while accept_thread runs */
+    uint32_t stop;                           /**< Set when accept_thread shall stop */
+    uint64_t datagrams;                      /**< Number of datagrams sent */
+    uint64_t frames;                         /**< Number of frames sent */
+    uint64_t send_errors;                    /**< Number of datagrams that couldn't be sent to the multicast group */
+    uint64_t accepted;                       /**< Number of TCP subscribers that have connected */
+    uint64_t disconnected;                   /**< Number of TCP subscribers disconnected because they were too slow */
+} gateway_t;
+
+/** Client reading the datagrams of a gateway, through TCP or from a multicast group */
+typedef struct
+{
+    int fd;
+    bool tcp;
+    uint32_t read_timeout_ms;                /**< Maximum time gateway_client_read() waits for data, 0 to wait forever */
+    uint8_t buffer[2 * GATEWAY_MAX_DATAGRAM]; /**< Bytes received through TCP that don't form a datagram yet */
+    size_t buffered;
+    uint8_t port_count;                      /**< Number of serial ports of the gateway, 0 before the first datagram */
+    bool synchronized[256];                  /**< Set once a datagram of the port has been received */
+    uint32_t expected[256];                  /**< Next sequence number expected for every port */
+    uint64_t datagrams;                      /**< Number of datagrams received */
+    uint64_t lost;                           /**< Number of datagrams missing from the sequences */
+    uint64_t invalid;                        /**< Number of datagrams rejected: not from a gateway, or late */
+} gateway_client_t;
+
+/**
+ * Write the header of a datagram in network byte order.
+ *
+ * @param[in]   header  Header.
+ * @param[out]  bytes   Array of GATEWAY_HEADER_LENGTH bytes.
+ */
+void gateway_header_write(const gateway_header_t *header, uint8_t bytes[]);
+
+/**
+ * Read the header of a datagram.
+ *
+ * @param[out]  header  Header.
+ * @param[in]   bytes   Array of GATEWAY_HEADER_LENGTH bytes.
+ *
+ * @return false if the bytes are not the header of a datagram of this version, true otherwise.
+ */
+bool gateway_header_read(gateway_header_t *header, const uint8_t bytes[]);
+
+/**
+ * Create the sockets of a gateway. Either the multicast group or the TCP port can be omitted.
+ *
+ * @param[out]  gateway     Gateway.
+ * @param[in]   port_count  Number of serial ports forwarded, at most 255.
+ * @param[in]   group       Multicast group and UDP port as "address:port", e.g. "239.255.0.1:5300",
+ *                          NULL for none. The datagrams are also looped back to the local machine.
+ * @param[in]   tcp_port    TCP port on which the subscribers connect, 0 for none.
+ *
+ * @return EXIT_FAILURE if a socket couldn't be created, EXIT_SUCCESS otherwise.
+ */
+int32_t gateway_open(gateway_t *gateway, size_t port_count, const char *group, uint16_t tcp_port);
+
+/**
+ * Forward the frames of the messages decoded from one read of a serial port, in as few datagrams as
+ * possible. The messages that are not valid are skipped.
+ * Can be called from several threads at the same time, but only from one thread per port.
+ *
+ * @param[in,out]   gateway     Gateway.
+ * @param[in]       port        Index of the serial port.
+ * @param[in]       msgs        Decoded messages.
+ * @param[in]       count       Number of messages.
+ */
+void gateway_forward(gateway_t *gateway, uint32_t port, const adc_rs485_msg_t msgs[], size_t count);
+
+/**
+ * Disconnect the subscribers and close the sockets of a gateway.
+ *
+ * @param[in,out]   gateway     Gateway.
+ */
+void gateway_close(gateway_t *gateway);
+
+/**
+ * Connect to the TCP port of a gateway.
+ *
+ * @param[out]  client      Client.
+ * @param[in]   address     Gateway as "host:port".
+ *
+ * @return EXIT_FAILURE if the gateway couldn't be reached, EXIT_SUCCESS otherwise.
+ */
+int32_t gateway_client_connect(gateway_client_t *client, const char *address);
+
+/**
+ * Join the multicast group of a gateway.
+ *
+ * @param[out]  client      Client.
+ * @param[in]   group       Multicast group and UDP port as "address:port".
+ *
+ * @return EXIT_FAILURE if the group couldn't be joined, EXIT_SUCCESS otherwise.
+ */
+int32_t gateway_client_join(gateway_client_t *client, const char *group);
+
+/**
+ * Read the frames of the next datagram, the counterpart of serial_read() for a network source.
+ * The function blocks until a datagram has been received, or until the read timeout of the client
+ * elapses. The datagrams that are not in sequence are counted, the late ones are skipped.
+ *
+ * @param[in,out]   client      Client.
+ * @param[out]      data        Buffer of at least GATEWAY_MAX_PAYLOAD bytes that will contain the frames.
+ * @param[out]      length      Number of bytes of frames, 0 if the timeout elapsed.
+ * @param[out]      port        Index of the serial port on which the frames have been received.
+ *
+ * @return EXIT_FAILURE if the connection has been closed or couldn't be read, or if the wait has been
+ * interrupted by a signal, EXIT_SUCCESS otherwise.
+ */
+int32_t gateway_client_read(gateway_client_t *client, uint8_t data[], size_t *length, uint8_t *port);
+
+/**
+ * Close a client.
+ *
+ * @param[in,out]   client      Client.
+ */
+void gateway_client_close(gateway_client_t *client);
+
+#endif
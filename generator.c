@@ -0,0 +1,597 @@
+/*
+ * 2023 (c) Simtec AG
+ * All rights reserved
+ *
+ * Generate on a Linux machine the RS485 traffic of swiss air-data computers, to test the decoder
+ * without any hardware. The frames are written to pseudo-terminals, to which any number of
+ * decoders can connect, or to files, FIFOs and pipes.
+ *
+ * The traffic follows the cycles of a product, paced at the baudrate of a real serial line.
+ * Bursts, jitter and corrupted frames can be injected.
+ *
+ * Example code only. Use at own risk.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Simtec AG has no obligation to provide maintenance, support,
+ * updates, enhancements, or modifications.
+ */
+
+#define _GNU_SOURCE
+
+#include "adc_rs485_decoder.h"
+#include "adc_rs485_encoder.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+/** Default baudrate of the generated serial lines */
+#define DEFAULT_BAUDRATE 230400
+
+/** Default number of cycles per second, limited by the baudrate */
+#define DEFAULT_RATE_HZ 50
+
+/** Period at which the outputs are written, in nanoseconds */
+#define TICK_NS 1000000u
+
+/** Maximum number of outputs */
+#define MAX_OUTPUTS 256
+
+/** Size in bytes of the buffer of an output, at least one second of traffic at 1 Mbaud */
+#define OUTPUT_BUFFER_LENGTH (128 * 1024)
+
+/** Maximum number of labels in the cycle of a product */
+#define MAX_CYCLE_LABELS 32
+
+/** Bits per byte on the serial line: start bit, 8 data bits and stop bit */
+#define BITS_PER_BYTE 10u
+
+/** One label of the cycle of a product, the value follows a sine around its base */
+typedef struct
+{
+    data_type_t type;
+    float base;
+    float amplitude;
+    float period_s;
+} cycle_label_t;
+
+/** Messages sent by a product in every cycle */
+typedef struct
+{
+    const char *name;
+    cycle_label_t labels[MAX_CYCLE_LABELS];
+    size_t label_count;
+    bool heater;            /**< Sends a heater status in every cycle */
+} product_t;
+
+/** Products that can be simulated */
+static const product_t PRODUCTS[] = {
+    {.name = "adc10",
+     .labels = {
+         {RS485_QC, 1850.0f, 400.0f, 20.0f},
+         {RS485_PS, 84300.0f, 1500.0f, 60.0f},
+         {RS485_CAS, 55.0f, 6.0f, 20.0f},
+         {RS485_TAS, 61.0f, 6.5f, 20.0f},
+         {RS485_HP, 1550.0f, 120.0f, 60.0f},
+         {RS485_HBARO, 1580.0f, 120.0f, 60.0f},
+         {RS485_CR, 0.0f, 4.0f, 30.0f},
+         {RS485_MACH, 0.18f, 0.02f, 20.0f},
+         {RS485_SAT, 5.0f, 0.5f, 120.0f},
+         {RS485_TAT, 6.5f, 0.5f, 120.0f},
+         {RS485_QNH, 101325.0f, 0.0f, 1.0f},
+         {RS485_PT, 86150.0f, 1500.0f, 60.0f}},
+     .label_count = 12,
+     .heater = false},
+    {.name = "aoa16",
+     .labels = {
+         {RS485_AOA, 4.0f, 3.0f, 5.0f},
+         {RS485_AOS, 0.0f, 2.0f, 7.0f},
+         {RS485_QC, 1850.0f, 400.0f, 20.0f},
+         {RS485_PS, 84300.0f, 1500.0f, 60.0f},
+         {RS485_CAS, 55.0f, 6.0f, 20.0f},
+         {RS485_TAS, 61.0f, 6.5f, 20.0f},
+         {RS485_HP, 1550.0f, 120.0f, 60.0f},
+         {RS485_CR, 0.0f, 4.0f, 30.0f},
+         {RS485_DPAOA, 120.0f, 60.0f, 5.0f},
+         {RS485_DPAOS, 0.0f, 40.0f, 7.0f},
+         {RS485_IAT, 8.0f, 0.5f, 120.0f},
+         {RS485_DTR, 35.0f, 10.0f, 40.0f},
+         {RS485_HTR, 60.0f, 5.0f, 40.0f},
+         {RS485_CUR, 2.5f, 0.5f, 40.0f},
+         {RS485_STAOA, 25.0f, 1.0f, 200.0f},
+         {RS485_STAOS, 25.0f, 1.0f, 200.0f}},
+     .label_count = 16,
+     .heater = true},
+    {.name = "pss8",
+     .labels = {
+         {RS485_QC, 1850.0f, 400.0f, 20.0f},
+         {RS485_PS, 84300.0f, 1500.0f, 60.0f},
+         {RS485_QCRAW, 1852.0f, 400.0f, 20.0f},
+         {RS485_PSRAW, 84310.0f, 1500.0f, 60.0f},
+         {RS485_CAS, 55.0f, 6.0f, 20.0f},
+         {RS485_HP, 1550.0f, 120.0f, 60.0f},
+         {RS485_STQC, 25.0f, 1.0f, 200.0f},
+         {RS485_STPS, 25.0f, 1.0f, 200.0f}},
+     .label_count = 8,
+     .heater = false},
+};
+
+/** Options of the generator */
+typedef struct
+{
+    const product_t *product;
+    uint32_t baudrate;
+    uint32_t rate_hz;           /**< Cycles per second, 0 to fill the line */
+    uint32_t pty_count;         /**< Number of pseudo-terminals to create */
+    const char *outputs[MAX_OUTPUTS]; /**< Files, FIFOs or serial ports to write to */
+    size_t output_count;
+    uint32_t jitter_us;         /**< Maximum random delay of every write */
+    uint32_t burst_ms;          /**< Length of the bursts, 0 for none */
+    double corrupt;             /**< Probability that a frame is corrupted */
+    uint64_t cycles;            /**< Number of cycles per output, 0 to run until Ctrl-C */
+    uint64_t seed;
+} generator_options_t;
+
+/** One generated serial line */
+typedef struct
+{
+    int fd;
+    int slave_fd;               /**< Kept open so that the pseudo-terminal survives the decoders */
+    char name[64];
+    uint64_t rng;
+    uint8_t buffer[OUTPUT_BUFFER_LENGTH];
+    size_t length;              /**< Bytes generated but not sent yet */
+    uint64_t budget;            /**< Bytes the line could have sent since it is busy, times 1e9 */
+    uint64_t last_write_ns;
+    uint64_t next_write_ns;
+    uint64_t next_cycle_ns;
+    uint64_t burst_until_ns;
+    uint64_t cycle_count;
+    uint64_t bytes_written;
+    uint64_t bytes_dropped;     /**< Bytes not accepted by the reader, as an overrun serial line */
+    uint64_t corrupted;
+} generator_output_t;
+
+/** Outputs, too large for the stack */
+static generator_output_t outputs[MAX_OUTPUTS];
+
+/** Set by SIGINT or SIGTERM */
+static volatile sig_atomic_t stop;
+
+static void on_signal(int signal_number)
+{
+    (void)signal_number;
+    stop = 1;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000000000u) + (uint64_t)now.tv_nsec;
+}
+
+/** xorshift64* pseudo-random generator, reproducible with the seed */
+static uint64_t random_next(uint64_t *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ull;
+}
+
+/** Uniform random number in [0, 1) */
+static double random_uniform(uint64_t *state)
+{
+    return (double)(random_next(state) >> 11) / 9007199254740992.0;
+}
+
+/** Damage a frame the way a noisy line would, returns its new length */
+static size_t corrupt_frame(uint64_t *rng, uint8_t frame[], size_t length)
+{
+    size_t pos = 2 + (size_t)(random_next(rng) % (length - 3));
+
+    switch (random_next(rng) % 4)
+    {
+    case 0:
+        // Invalid hexadecimal digit
+        frame[pos] = 'G';
+        break;
+    case 1:
+        // Lost carriage return, the frame is merged with the next one
+        length--;
+        break;
+    case 2:
+        // Lost byte
+        memmove(&frame[pos], &frame[pos + 1], length - pos - 1);
+        length--;
+        break;
+    default:
+        // Stray start of header in the middle of the frame
+        frame[pos] = 0x01u;
+        break;
+    }
+    return length;
+}
+
+/** Append one frame to the buffer of an output, corrupted or not */
+static void append_frame(generator_output_t *output, const generator_options_t *options, uint8_t frame[], size_t length)
+{
+    if ((options->corrupt > 0.0) && (random_uniform(&output->rng) < options->corrupt))
+    {
+        length = corrupt_frame(&output->rng, frame, length);
+        output->corrupted++;
+    }
+    memcpy(&output->buffer[output->length], frame, length);
+    output->length += length;
+}
+
+/** Append all frames of one cycle to the buffer of an output */
+static void append_cycle(generator_output_t *output, const generator_options_t *options, uint64_t time_ns)
+{
+    const product_t *product = options->product;
+    uint8_t frame[ADC_RS485_MAX_FRAME_LENGTH];
+    double t = (double)time_ns / 1e9;
+
+    for (size_t i = 0; i < product->label_count; i++)
+    {
+        const cycle_label_t *label = &product->labels[i];
+        air_data_t data = {
+            .type = label->type,
+            .value = label->base + label->amplitude * (float)sin(2.0 * M_PI * t / label->period_s),
+            .flag = FLAG_VALID};
+
+        append_frame(output, options, frame, adc_rs485_encode_data(&data, frame));
+    }
+
+    if (product->heater)
+    {
+        htr_status_t htr_status = {.number = 0};
+        htr_status.mode = HEATER_MODE_AUTO;
+        append_frame(output, options, frame, adc_rs485_encode_htr_status(htr_status, frame));
+    }
+
+    // The general status closes the cycle
+    adc_gen_status_t gen_status = {.number = 0};
+    gen_status.mode = ADC_MODE_NORMAL;
+    gen_status.qnh_set = true;
+    append_frame(output, options, frame, adc_rs485_encode_gen_status(gen_status, frame));
+
+    output->cycle_count++;
+}
+
+/** Number of bytes of one cycle, without corruption */
+static size_t cycle_length(const product_t *product)
+{
+    return product->label_count * ADC_RS485_DATA_FRAME_LENGTH +
+           (product->heater ? 2u : 1u) * ADC_RS485_STATUS_FRAME_LENGTH;
+}
+
+/** Generate the cycles due and write what the serial line could have sent since the last write */
+static void output_tick(generator_output_t *output, const generator_options_t *options, uint64_t now)
+{
+    size_t max_cycle = cycle_length(options->product);
+    uint64_t period_ns = (options->rate_hz > 0) ? (1000000000u / options->rate_hz) : 0;
+
+    // Kept with fractions of bytes, so that any baudrate is paced exactly
+    output->budget += (now - output->last_write_ns) * options->baudrate / BITS_PER_BYTE;
+    output->last_write_ns = now;
+    uint64_t budget_bytes = output->budget / 1000000000u;
+
+    while ((output->length < budget_bytes) && (now >= output->next_cycle_ns) &&
+           (output->length + max_cycle <= OUTPUT_BUFFER_LENGTH) &&
+           ((options->cycles == 0) || (output->cycle_count < options->cycles)))
+    {
+        append_cycle(output, options, output->next_cycle_ns);
+        output->next_cycle_ns = (period_ns > 0) ? (output->next_cycle_ns + period_ns) : now;
+    }
+
+    if (now < output->burst_until_ns)
+    {
+        // Hold the data back, it is written at once when the burst ends
+        return;
+    }
+
+    size_t count = (output->length < budget_bytes) ? output->length : (size_t)budget_bytes;
+    if (count > 0)
+    {
+        ssize_t written = write(output->fd, output->buffer, count);
+        if (written < 0)
+        {
+            // Nobody reads fast enough: the bytes are lost as on an overrun serial line
+            written = ((errno == EAGAIN) || (errno == EWOULDBLOCK)) ? 0 : -1;
+            if (written < 0)
+            {
+                stop = 1;
+                return;
+            }
+            output->bytes_dropped += count;
+            written = (ssize_t)count;
+        }
+        else
+        {
+            output->bytes_written += (uint64_t)written;
+        }
+        output->length -= (size_t)written;
+        memmove(output->buffer, &output->buffer[written], output->length);
+        output->budget -= (uint64_t)written * 1000000000u;
+    }
+
+    // An idle line doesn't save its time for later
+    if (output->length == 0)
+    {
+        output->budget = 0;
+    }
+
+    output->next_write_ns = now + TICK_NS;
+    if (options->jitter_us > 0)
+    {
+        output->next_write_ns += random_next(&output->rng) % ((uint64_t)options->jitter_us * 1000u);
+    }
+    // On average one burst per second
+    if ((options->burst_ms > 0) && (random_next(&output->rng) % (1000000000u / TICK_NS) == 0))
+    {
+        output->burst_until_ns = now + (uint64_t)options->burst_ms * 1000000u;
+    }
+}
+
+/** Create a pseudo-terminal in raw mode, the decoders open its slave side */
+static int32_t open_pty(generator_output_t *output)
+{
+    output->fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if ((output->fd < 0) || (grantpt(output->fd) != 0) || (unlockpt(output->fd) != 0) ||
+        (ptsname_r(output->fd, output->name, sizeof(output->name)) != 0))
+    {
+        return EXIT_FAILURE;
+    }
+
+    output->slave_fd = open(output->name, O_RDWR | O_NOCTTY);
+    if (output->slave_fd < 0)
+    {
+        return EXIT_FAILURE;
+    }
+
+    // No echo nor line editing until a decoder configures the port
+    struct termios tty;
+    if (tcgetattr(output->slave_fd, &tty) == 0)
+    {
+        cfmakeraw(&tty);
+        tcsetattr(output->slave_fd, TCSANOW, &tty);
+    }
+    return EXIT_SUCCESS;
+}
+
+static int32_t open_file(generator_output_t *output, const char *path)
+{
+    snprintf(output->name, sizeof(output->name), "%s", path);
+    output->slave_fd = -1;
+    output->fd = (strcmp(path, "-") == 0) ? STDOUT_FILENO : open(path, O_WRONLY | O_CREAT | O_NOCTTY, 0644);
+    if (output->fd < 0)
+    {
+        return EXIT_FAILURE;
+    }
+
+    // A slow reader loses bytes instead of stalling the other outputs
+    fcntl(output->fd, F_SETFL, fcntl(output->fd, F_GETFL) | O_NONBLOCK);
+    return EXIT_SUCCESS;
+}
+
+static void print_help()
+{
+    printf("Usage: generate [options]\n");
+    printf("Generate the RS485 traffic of simtec air data computers. \n");
+    printf("Example: generate --product aoa16 --pty 4 --corrupt 0.001\n");
+    printf("\n");
+    printf("Options: \n");
+    printf("  --product name: Cycle of labels to send: adc10 (default), aoa16 or pss8. \n");
+    printf("  --baudrate n: Baudrate at which the bytes are paced. By default, 230400 is used. \n");
+    printf("  --rate n:    Cycles per second, 0 to fill the line. By default, 50 is used. \n");
+    printf("  --pty n:     Create n pseudo-terminals and print their names. \n");
+    printf("  --output path: Write to a file, FIFO or serial port, - for the standard output. \n");
+    printf("               Can be given several times. Without --pty nor --output, the \n");
+    printf("               standard output is used. \n");
+    printf("  --jitter us: Delay every write by a random time of up to us microseconds. \n");
+    printf("  --burst ms:  About once per second, hold the data back for ms milliseconds and \n");
+    printf("               write it at once. \n");
+    printf("  --corrupt p: Probability that a frame is corrupted. By default, 0 is used. \n");
+    printf("  --cycles n:  Stop after n cycles per output. By default, run until Ctrl-C. \n");
+    printf("  --seed n:    Seed of the random generator. \n");
+    printf("\n");
+}
+
+/** Parse the arguments, returns false if the program shall not run */
+static bool parse_options(int argc, char **argv, generator_options_t *options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        bool has_value = (i + 1 < argc);
+
+        if ((strcmp(argv[i], "--product") == 0) && has_value)
+        {
+            const char *name = argv[++i];
+            options->product = NULL;
+            for (size_t p = 0; p < sizeof(PRODUCTS) / sizeof(PRODUCTS[0]); p++)
+            {
+                if (strcmp(name, PRODUCTS[p].name) == 0)
+                {
+                    options->product = &PRODUCTS[p];
+                }
+            }
+            if (options->product == NULL)
+            {
+                fprintf(stderr, "Unknown product %s\n", name);
+                return false;
+            }
+        }
+        else if ((strcmp(argv[i], "--baudrate") == 0) && has_value)
+        {
+            options->baudrate = strtoul(argv[++i], NULL, 10);
+        }
+        else if ((strcmp(argv[i], "--rate") == 0) && has_value)
+        {
+            options->rate_hz = strtoul(argv[++i], NULL, 10);
+        }
+        else if ((strcmp(argv[i], "--pty") == 0) && has_value)
+        {
+            options->pty_count = strtoul(argv[++i], NULL, 10);
+        }
+        else if ((strcmp(argv[i], "--output") == 0) && has_value && (options->output_count < MAX_OUTPUTS))
+        {
+            options->outputs[options->output_count++] = argv[++i];
+        }
+        else if ((strcmp(argv[i], "--jitter") == 0) && has_value)
+        {
+            options->jitter_us = strtoul(argv[++i], NULL, 10);
+        }
+        else if ((strcmp(argv[i], "--burst") == 0) && has_value)
+        {
+            options->burst_ms = strtoul(argv[++i], NULL, 10);
+        }
+        else if ((strcmp(argv[i], "--corrupt") == 0) && has_value)
+        {
+            options->corrupt = strtod(argv[++i], NULL);
+        }
+        else if ((strcmp(argv[i], "--cycles") == 0) && has_value)
+        {
+            options->cycles = strtoull(argv[++i], NULL, 10);
+        }
+        else if ((strcmp(argv[i], "--seed") == 0) && has_value)
+        {
+            options->seed = strtoull(argv[++i], NULL, 10);
+        }
+        else
+        {
+            print_help();
+            return false;
+        }
+    }
+
+    if ((options->baudrate < BITS_PER_BYTE) || (options->pty_count + options->output_count > MAX_OUTPUTS))
+    {
+        fprintf(stderr, "Invalid baudrate or too many outputs\n");
+        return false;
+    }
+    if ((options->pty_count == 0) && (options->output_count == 0))
+    {
+        options->outputs[options->output_count++] = "-";
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    generator_options_t options = {
+        .product = &PRODUCTS[0],
+        .baudrate = DEFAULT_BAUDRATE,
+        .rate_hz = DEFAULT_RATE_HZ,
+        .pty_count = 0,
+        .output_count = 0,
+        .jitter_us = 0,
+        .burst_ms = 0,
+        .corrupt = 0.0,
+        .cycles = 0,
+        .seed = 1};
+    size_t output_count = 0;
+
+    if (!parse_options(argc, argv, &options))
+    {
+        return EXIT_FAILURE;
+    }
+
+    for (uint32_t i = 0; i < options.pty_count; i++, output_count++)
+    {
+        if (open_pty(&outputs[output_count]) != EXIT_SUCCESS)
+        {
+            fprintf(stderr, "Couldn't create a pseudo-terminal\n");
+            return EXIT_FAILURE;
+        }
+        // The names are printed on the standard output so that scripts can start the decoders
+        printf("%s\n", outputs[output_count].name);
+    }
+    fflush(stdout);
+
+    for (size_t i = 0; i < options.output_count; i++, output_count++)
+    {
+        if (open_file(&outputs[output_count], options.outputs[i]) != EXIT_SUCCESS)
+        {
+            fprintf(stderr, "Couldn't open %s\n", options.outputs[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_signal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < output_count; i++)
+    {
+        outputs[i].rng = options.seed + i * 0x9E3779B97F4A7C15ull;
+        outputs[i].last_write_ns = start;
+        outputs[i].next_write_ns = start;
+        outputs[i].next_cycle_ns = start;
+    }
+
+    while (stop == 0)
+    {
+        uint64_t now = now_ns();
+        uint64_t next = now + TICK_NS;
+        bool done = true;
+
+        for (size_t i = 0; i < output_count; i++)
+        {
+            generator_output_t *output = &outputs[i];
+            if (now >= output->next_write_ns)
+            {
+                output_tick(output, &options, now);
+            }
+            if (output->next_write_ns < next)
+            {
+                next = output->next_write_ns;
+            }
+            done &= (options.cycles > 0) && (output->cycle_count >= options.cycles) && (output->length == 0);
+        }
+
+        if (done)
+        {
+            break;
+        }
+
+        struct timespec deadline = {
+            .tv_sec = (time_t)(next / 1000000000u),
+            .tv_nsec = (long)(next % 1000000000u)};
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+    }
+
+    for (size_t i = 0; i < output_count; i++)
+    {
+        fprintf(stderr, "%s: %llu cycles, %llu bytes written, %llu bytes dropped, %llu frames corrupted\n",
+                outputs[i].name, (unsigned long long)outputs[i].cycle_count, (unsigned long long)outputs[i].bytes_written,
+                (unsigned long long)outputs[i].bytes_dropped, (unsigned long long)outputs[i].corrupted);
+        if (outputs[i].slave_fd >= 0)
+        {
+            close(outputs[i].slave_fd);
+        }
+        if (outputs[i].fd != STDOUT_FILENO)
+        {
+            close(outputs[i].fd);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
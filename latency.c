@@ -0,0 +1,102 @@
+/*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*/
+
+#include "latency.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/** Number of bits sent per byte: start bit, 8 data bits and stop bit */
+#define BITS_PER_BYTE 10u
+
+static const char *const STAGE_NAME[LATENCY_STAGE_COUNT] = {
+    [LATENCY_STAGE_FRAME] = "frame",
+    [LATENCY_STAGE_DRIVER] = "driver",
+    [LATENCY_STAGE_DECODE] = "decode",
+    [LATENCY_STAGE_DELIVERY] = "delivery"};
+
+/** Bucket of a latency: linear below LATENCY_SUB_BUCKETS, then LATENCY_SUB_BUCKETS buckets per power of two */
+static inline uint32_t latency_bucket(uint64_t latency_ns)
+{
+    if (latency_ns < LATENCY_SUB_BUCKETS)
+    {
+        return (uint32_t)latency_ns;
+    }
+
+    uint32_t exponent = 63u - (uint32_t)__builtin_clzll(latency_ns);
+    uint32_t shift = exponent - LATENCY_SUB_BUCKET_BITS;
+    uint32_t sub_bucket = (uint32_t)(latency_ns >> shift) & (LATENCY_SUB_BUCKETS - 1u);
+    return ((shift + 1u) << LATENCY_SUB_BUCKET_BITS) + sub_bucket;
+}
+
+/** Highest latency of a bucket */
+static uint64_t latency_bucket_max(uint32_t bucket)
+{
+    if (bucket < LATENCY_SUB_BUCKETS)
+    {
+        return bucket;
+    }
+
+    uint32_t shift = (bucket >> LATENCY_SUB_BUCKET_BITS) - 1u;
+    uint64_t low = (uint64_t)(LATENCY_SUB_BUCKETS + (bucket & (LATENCY_SUB_BUCKETS - 1u))) << shift;
+    return low + ((1ull << shift) - 1u);
+}
+
+uint64_t latency_byte_ns(uint32_t baudrate)
+{
+    return (baudrate > 0) ? (BITS_PER_BYTE * 1000000000ull) / baudrate : 0;
+}
+
+const char *latency_stage_name(latency_stage_t stage)
+{
+    return (stage < LATENCY_STAGE_COUNT) ? STAGE_NAME[stage] : "unknown";
+}
+
+void latency_record(latency_histogram_t *histogram, uint64_t latency_ns)
+{
+    __atomic_fetch_add(&histogram->counts[latency_bucket(latency_ns)], 1, __ATOMIC_RELAXED);
+}
+
+void latency_record_n(latency_histogram_t *histogram, uint64_t latency_ns, uint64_t count)
+{
+    if (count > 0)
+    {
+        __atomic_fetch_add(&histogram->counts[latency_bucket(latency_ns)], count, __ATOMIC_RELAXED);
+    }
+}
+
+void latency_summarize(const latency_histogram_t *histogram, latency_summary_t *summary)
+{
+    uint64_t counts[LATENCY_BUCKETS];
+    uint64_t count = 0;
+
+    // Copy first, so that all percentiles are computed from the same counts
+    for (uint32_t i = 0; i < LATENCY_BUCKETS; i++)
+    {
+        counts[i] = __atomic_load_n(&histogram->counts[i], __ATOMIC_RELAXED);
+        count += counts[i];
+    }
+
+    const double fractions[4] = {0.5, 0.9, 0.99, 0.999};
+    uint64_t *percentiles[4] = {&summary->p50, &summary->p90, &summary->p99, &summary->p999};
+    uint64_t seen = 0;
+    uint32_t next = 0;
+
+    summary->count = count;
+    summary->p50 = summary->p90 = summary->p99 = summary->p999 = summary->max = 0;
+
+    for (uint32_t i = 0; (i < LATENCY_BUCKETS) && (count > 0); i++)
+    {
+        if (counts[i] == 0)
+        {
+            continue;
+        }
+        seen += counts[i];
+        while ((next < 4) && ((double)seen >= fractions[next] * (double)count))
+        {
+            *percentiles[next++] = latency_bucket_max(i);
+        }
+        summary->max = latency_bucket_max(i);
+    }
+}
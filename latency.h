@@ -0,0 +1,118 @@
+/**
+* This module measures how old the air data is at every stage of the decoder program, so that the
+* stage adding the most latency can be found: the serial driver, the decoder or the output.
+*
+* The bytes of a serial port carry no timestamp. The first two stages are therefore estimates: the
+* time of the carriage return of a message is computed back from the time at which read() returned,
+* assuming that the last byte read has just been received, from the number of bytes read after the
+* carriage return and from the duration of one byte at the baudrate, and the start of the frame from
+* its length. The last two stages are measured. For every message:
+*   - frame:    estimated, transmission of the message from its start of header to its carriage return,
+*   - driver:   estimated, from the carriage return until read() returned the message,
+*   - decode:   from read() until the message has been decoded and queued,
+*   - delivery: from the queue until the message has been written to the output.
+* The sum of the stages is the age of the message when it is written, from its start of header.
+*
+* Every stage of every port has its own HDR-style histogram: the buckets are linear within every
+* power of two, with a relative precision of 1/LATENCY_SUB_BUCKETS. Recording a latency costs one
+* relaxed atomic increment, the histograms can be read from any thread.
+*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*
+* Example code only. Use at own risk.
+*
+* This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* Simtec AG has no obligation to provide maintenance, support,  updates, enhancements, or modifications.
+*/
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Number of bits of the sub-bucket of a latency, 16 buckets per power of two */
+#define LATENCY_SUB_BUCKET_BITS 4
+
+/** Number of buckets per power of two */
+#define LATENCY_SUB_BUCKETS (1u << LATENCY_SUB_BUCKET_BITS)
+
+/** Number of buckets of a histogram, covering all 64 bit latencies in nanoseconds */
+#define LATENCY_BUCKETS ((64 - LATENCY_SUB_BUCKET_BITS + 1) * LATENCY_SUB_BUCKETS)
+
+/** Stage of the decoder program */
+typedef enum
+{
+    LATENCY_STAGE_FRAME = 0,    /**< From the start of header to the carriage return of a message, estimated */
+    LATENCY_STAGE_DRIVER = 1,   /**< From the carriage return until read() returned, estimated */
+    LATENCY_STAGE_DECODE = 2,   /**< From read() until the message has been decoded */
+    LATENCY_STAGE_DELIVERY = 3, /**< From the decoder until the message has been written to the output */
+    LATENCY_STAGE_COUNT = 4
+} latency_stage_t;
+
+/** Latencies of one stage of one port, in nanoseconds */
+typedef struct
+{
+    uint64_t counts[LATENCY_BUCKETS];
+} latency_histogram_t;
+
+/** Summary of a histogram, in nanoseconds */
+typedef struct
+{
+    uint64_t count;
+    uint64_t p50;
+    uint64_t p90;
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t max;
+} latency_summary_t;
+
+/**
+ * Returns the duration of one byte at a baudrate, with one start bit, 8 data bits and one stop bit.
+ *
+ * @param[in]   baudrate    Baudrate of the serial port.
+ *
+ * @return Duration of one byte in nanoseconds.
+ */
+uint64_t latency_byte_ns(uint32_t baudrate);
+
+/**
+ * Returns the name of a stage, e.g. "driver".
+ *
+ * @param[in]   stage   Stage.
+ *
+ * @return Name of the stage.
+ */
+const char *latency_stage_name(latency_stage_t stage);
+
+/**
+ * Record one latency. Can be called from any thread.
+ *
+ * @param[in,out]   histogram   Histogram of the stage.
+ * @param[in]       latency_ns  Latency in nanoseconds.
+ */
+void latency_record(latency_histogram_t *histogram, uint64_t latency_ns);
+
+/**
+ * Record the same latency several times, e.g. for all messages of a batch, with one atomic addition.
+ * Can be called from any thread.
+ *
+ * @param[in,out]   histogram   Histogram of the stage.
+ * @param[in]       latency_ns  Latency in nanoseconds.
+ * @param[in]       count       Number of times the latency is recorded.
+ */
+void latency_record_n(latency_histogram_t *histogram, uint64_t latency_ns, uint64_t count);
+
+/**
+ * Compute the percentiles of a histogram. Can be called from any thread while latencies are recorded.
+ * The values are the upper bounds of the buckets.
+ *
+ * @param[in]   histogram   Histogram.
+ * @param[out]  summary     Percentiles.
+ */
+void latency_summarize(const latency_histogram_t *histogram, latency_summary_t *summary);
+
+#endif
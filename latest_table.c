@@ -0,0 +1,133 @@
+/*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*/
+
+#include "latest_table.h"
+#include "adc_event.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/** Write one entry, the caller holds the seqlock of the table */
+static void latest_entry_write(latest_entry_t *entry, uint32_t bits, uint32_t flag, uint64_t timestamp_ns)
+{
+    uint32_t sequence = entry->sequence;
+
+    // Odd sequence: readers of this entry retry until the write is done
+    __atomic_store_n(&entry->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    __atomic_store_n(&entry->bits, bits, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->flag, flag, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->timestamp_ns, timestamp_ns, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->update_count, entry->update_count + 1, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&entry->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+/** Copy the fields of one entry, without checking its seqlock */
+static bool latest_entry_copy(const latest_entry_t *entry, latest_value_t *value)
+{
+    value->status = __atomic_load_n(&entry->bits, __ATOMIC_RELAXED);
+    value->flag = (flag_t)__atomic_load_n(&entry->flag, __ATOMIC_RELAXED);
+    value->timestamp_ns = __atomic_load_n(&entry->timestamp_ns, __ATOMIC_RELAXED);
+    value->update_count = __atomic_load_n(&entry->update_count, __ATOMIC_RELAXED);
+    return value->update_count != 0;
+}
+
+/** Read one entry through its seqlock */
+static bool latest_entry_read(const latest_entry_t *entry, latest_value_t *value)
+{
+    uint32_t before;
+    uint32_t after;
+    bool received;
+
+    do
+    {
+        before = __atomic_load_n(&entry->sequence, __ATOMIC_ACQUIRE);
+        received = latest_entry_copy(entry, value);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&entry->sequence, __ATOMIC_RELAXED);
+    } while (((before & 1u) != 0) || (before != after));
+
+    return received;
+}
+
+void latest_table_init(latest_table_t *table)
+{
+    memset(table, 0, sizeof(*table));
+}
+
+void latest_table_update(latest_table_t *table, const adc_event_t *event)
+{
+    latest_entry_t *entry = NULL;
+
+    switch (event->msg_type)
+    {
+    case RS485_RETURNED_DATA:
+        if (event->data_type < RS485_DATA_NOT_VALID)
+        {
+            entry = &table->data[event->data_type];
+        }
+        break;
+    case RS485_RETURNED_STATUS_GEN:
+        entry = &table->gen_status;
+        break;
+    case RS485_RETURNED_STATUS_HTR:
+        entry = &table->htr_status;
+        break;
+    default:
+        break;
+    }
+
+    if (entry != NULL)
+    {
+        uint32_t sequence = table->sequence;
+
+        __atomic_store_n(&table->sequence, sequence + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+
+        latest_entry_write(entry, event->status, event->flag, event->timestamp_ns);
+
+        __atomic_store_n(&table->sequence, sequence + 2, __ATOMIC_RELEASE);
+    }
+}
+
+bool latest_table_read(const latest_table_t *table, data_type_t type, latest_value_t *value)
+{
+    if ((uint32_t)type >= RS485_DATA_NOT_VALID)
+    {
+        return false;
+    }
+    return latest_entry_read(&table->data[type], value);
+}
+
+bool latest_table_read_gen_status(const latest_table_t *table, latest_value_t *value)
+{
+    return latest_entry_read(&table->gen_status, value);
+}
+
+bool latest_table_read_htr_status(const latest_table_t *table, latest_value_t *value)
+{
+    return latest_entry_read(&table->htr_status, value);
+}
+
+void latest_table_snapshot(const latest_table_t *table, latest_snapshot_t *snapshot)
+{
+    uint32_t before;
+    uint32_t after;
+
+    do
+    {
+        before = __atomic_load_n(&table->sequence, __ATOMIC_ACQUIRE);
+        for (uint32_t i = 0; i < RS485_DATA_NOT_VALID; i++)
+        {
+            latest_entry_copy(&table->data[i], &snapshot->data[i]);
+        }
+        latest_entry_copy(&table->gen_status, &snapshot->gen_status);
+        latest_entry_copy(&table->htr_status, &snapshot->htr_status);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&table->sequence, __ATOMIC_RELAXED);
+    } while (((before & 1u) != 0) || (before != after));
+}
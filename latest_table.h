@@ -0,0 +1,129 @@
+/**
+* This module keeps the latest value received for every label of a swiss air-data computer, as
+* well as the latest general and heater status.
+*
+* The table is written by a single thread, the one decoding the serial port, without any lock.
+* Any number of threads can read it at the same time through a seqlock: a reader never blocks the
+* writer and retries if the entry it read has been modified meanwhile.
+*
+* The table only contains fixed-width fields and no pointer so that it can be placed in memory
+* shared between processes.
+*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*
+* Example code only. Use at own risk.
+*
+* This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* Simtec AG has no obligation to provide maintenance, support,  updates, enhancements, or modifications.
+*/
+
+#ifndef LATEST_TABLE_H
+#define LATEST_TABLE_H
+
+#include "adc_event.h"
+#include "adc_rs485_decoder.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Latest value of one label, 32 bytes */
+typedef struct
+{
+    uint32_t sequence;      /**< Seqlock of the entry, odd while the entry is being written */
+    uint32_t update_count;  /**< Number of values received, 0 if none has been received yet */
+    uint64_t timestamp_ns;  /**< Monotonic time at which the value was received */
+    uint32_t bits;          /**< Bits of the float value, or status word */
+    uint32_t flag;          /**< Flag of the value, flag_t */
+    uint32_t reserved[2];
+} latest_entry_t;
+
+/** Latest values of all labels of one air data computer */
+typedef struct
+{
+    uint32_t sequence;                          /**< Seqlock of the whole table */
+    uint32_t reserved[7];
+    latest_entry_t data[RS485_DATA_NOT_VALID];  /**< Latest value per data_type_t */
+    latest_entry_t gen_status;                  /**< Latest general status */
+    latest_entry_t htr_status;                  /**< Latest heater status */
+} latest_table_t;
+
+/** Copy of the latest value of one label */
+typedef struct
+{
+    union
+    {
+        float value;        /**< Value of a data label */
+        uint32_t status;    /**< Status word of a status */
+    };
+    flag_t flag;            /**< Flag of a data label */
+    uint64_t timestamp_ns;  /**< Monotonic time at which the value was received */
+    uint32_t update_count;  /**< Number of values received */
+} latest_value_t;
+
+/** Consistent copy of a whole table */
+typedef struct
+{
+    latest_value_t data[RS485_DATA_NOT_VALID];
+    latest_value_t gen_status;
+    latest_value_t htr_status;
+} latest_snapshot_t;
+
+/**
+ * Initialize a table, no value has been received yet.
+ *
+ * @param[out]  table   Table to initialize.
+ */
+void latest_table_init(latest_table_t *table);
+
+/**
+ * Store a decoded message in the table. Errors are ignored.
+ * Shall only be called by the single writer of the table.
+ *
+ * @param[in,out]   table   Table.
+ * @param[in]       event   Decoded message.
+ */
+void latest_table_update(latest_table_t *table, const adc_event_t *event);
+
+/**
+ * Read the latest value of one label. Can be called by any thread.
+ *
+ * @param[in]   table   Table.
+ * @param[in]   type    Label to read.
+ * @param[out]  value   Latest value of the label.
+ *
+ * @return false if no value of this label has been received yet, true otherwise.
+ */
+bool latest_table_read(const latest_table_t *table, data_type_t type, latest_value_t *value);
+
+/**
+ * Read the latest general status. Can be called by any thread.
+ *
+ * @param[in]   table   Table.
+ * @param[out]  value   Latest general status.
+ *
+ * @return false if no general status has been received yet, true otherwise.
+ */
+bool latest_table_read_gen_status(const latest_table_t *table, latest_value_t *value);
+
+/**
+ * Read the latest heater status. Can be called by any thread.
+ *
+ * @param[in]   table   Table.
+ * @param[out]  value   Latest heater status.
+ *
+ * @return false if no heater status has been received yet, true otherwise.
+ */
+bool latest_table_read_htr_status(const latest_table_t *table, latest_value_t *value);
+
+/**
+ * Read all labels and statuses at once. The copy is consistent: no message has been stored in
+ * the table while it was read. Can be called by any thread.
+ *
+ * @param[in]   table       Table.
+ * @param[out]  snapshot    Copy of the table.
+ */
+void latest_table_snapshot(const latest_table_t *table, latest_snapshot_t *snapshot);
+
+#endif
@@ -2,8 +2,8 @@
  * 2023 (c) Simtec AG
  * All rights reserved
  * 
- * Read a serial port on a Windows machine and print to the terminal the messages sent by a swiss 
- * air-data computer through RS485.
+ * Read a serial port on a Windows or Linux machine and print to the terminal the messages sent by a 
+ * swiss air-data computer through RS485.
  * Use a RS485 to USB converter. Contact Simtec for more details or for a preconfigured 
  * and assembled cable.
  * 
@@ -22,16 +22,57 @@
 
 #include "print_msg.h"
 #include "adc_rs485_decoder.h"
+#include "adc_rs485_simd.h"
 #include "serial.h"
-#include <conio.h>
+#include "pipeline.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdint.h>
+#include <stdbool.h>
+#ifdef _WIN32
+#include <conio.h>
+#else
+#include <unistd.h>
+#endif
 
 /** Default baudrate at which the serial port is read */
 #define DEFAULT_BAUDRATE 230400
 
+/** Maximum time in milliseconds a read waits for data before checking if the program shall stop */
+#define READ_TIMEOUT_MS 100
+
+/** Size in bytes of the buffer used to read the serial port */
+#define READ_BUFFER_LENGTH 4096
+
+/** Maximum number of messages decoded at once */
+#define MSG_BUFFER_LENGTH 512
+
+/** Default number of messages that can wait between a serial port reader and the output */
+#define DEFAULT_QUEUE_LENGTH 4096
+
+/** Default refresh rate of the dashboard */
+#define DEFAULT_REFRESH_HZ 20
+
+/** Default maximum duration of a cycle whose general status is lost, in milliseconds */
+#define DEFAULT_CYCLE_TIMEOUT_MS 100
+
+/** Default age after which a label resampled is invalid, in milliseconds */
+#define DEFAULT_STALE_MS 1000
+
+/** Default number of recent messages kept in shared memory */
+#define DEFAULT_SHM_RING_LENGTH 4096
+
+#ifdef _WIN32
+#define PROGRAM_NAME "decode.exe"
+#define EXAMPLE_PORT "COM7"
+#define SERIAL_PORT_PREFIX "\\\\.\\"
+#else
+#define PROGRAM_NAME "decode"
+#define EXAMPLE_PORT "/dev/ttyUSB0"
+#define SERIAL_PORT_PREFIX ""
+#endif
+
 static void print_header()
 {
     printf("\n");
@@ -42,16 +83,82 @@ static void print_header()
 
 static void print_help()
 {
-    printf("Usage: decode.exe serial-port [baudrate]\n");
+    printf("Usage: " PROGRAM_NAME " [options] serial-port[,serial-port...] [baudrate]\n");
+    printf("       " PROGRAM_NAME " [options] --replay file\n");
+    printf("       " PROGRAM_NAME " [options] --query file\n");
+    printf("       " PROGRAM_NAME " [options] --connect host:port | --join group:port\n");
     printf("Print to the terminal all messages received by an simtec air data computer. \n");
-    printf("Example: decode.exe COM7 115200\n");
+    printf("Example: " PROGRAM_NAME " " EXAMPLE_PORT " 115200\n");
     printf("\n");
     printf("Arguments: \n");
     printf("  serial-port: Serial port on which the air data computer is connected. \n");
+    printf("               Several serial ports can be given, separated by commas (Linux only). \n");
     printf("  baudrate:    Set the baudrate that the air data computer uses. By default, 230400 is used. \n");
     printf("\n");
+    printf("Options (Linux only): \n");
+    printf("  --threads n: Spread the serial ports over n worker threads. By default, 1 is used. \n");
+    printf("  --pin:       Pin every worker thread to its own CPU. \n");
+    printf("  --queue n:   Number of messages that can wait per serial port when the output is \n");
+    printf("               too slow. By default, 4096 is used. \n");
+    printf("  --overflow policy: What to do when the queue is full: drop-oldest (default), \n");
+    printf("               block or coalesce (keep only the latest message per label). \n");
+    printf("  --shm name:  Publish the latest values and the recent messages in the POSIX shared \n");
+    printf("               memory segment name, e.g. /adc. \n");
+    printf("  --shm-ring n: Number of recent messages kept in the shared memory, 0 for none. \n");
+    printf("               By default, 4096 is used. \n");
+    printf("  --capture file: Record the raw bytes received into file. With several serial ports, \n");
+    printf("               one file per port is written: file.0, file.1, ... \n");
+    printf("  --replay file: Decode a capture file as fast as possible instead of a serial port. \n");
+    printf("  --realtime:  Replay the capture file at the timing it has been recorded. \n");
+    printf("  --jobs n:    Decode the capture file on n threads, split at start of header bytes. \n");
+    printf("               By default, 1 is used. Ignored with --realtime. \n");
+    printf("  --store file: Archive the decoded messages into file, a compressed columnar format. \n");
+    printf("  --query file: Read the messages archived in a store file instead of a serial port. \n");
+    printf("  --from s:    Read the store file from s seconds after its first message. \n");
+    printf("  --to s:      Read the store file until s seconds after its first message. \n");
+    printf("  --labels labels: Read only the comma-separated labels from the store file, e.g. qc,ps. \n");
+    printf("  --dashboard: Show the latest value of every label in place instead of printing \n");
+    printf("               every message. \n");
+    printf("  --refresh n: Refresh rate of the dashboard in Hz. By default, 20 is used. \n");
+    printf("  --format f:  Write the messages as text (default), csv, ndjson or binary records. \n");
+    printf("  --output file: Write the messages into file instead of the standard output. \n");
+    printf("               When csv, ndjson or binary messages are written to the standard \n");
+    printf("               output, everything else is printed to the standard error. \n");
+    printf("  --cycles:    Group the labels sent by an air data computer until its general status \n");
+    printf("               and write one cycle at once instead of every message. \n");
+    printf("  --cycle-timeout ms: Close a cycle whose general status is lost after ms. \n");
+    printf("               By default, 100 is used. \n");
+    printf("  --resample hz: Write the values of all labels at a fixed rate of hz rows per second \n");
+    printf("               instead of every message. Can't be combined with --cycles. \n");
+    printf("  --interpolate labels: Interpolate linearly the comma-separated labels, e.g. qc,ps, \n");
+    printf("               or all of them with all, instead of holding their latest value. \n");
+    printf("               A label slower than the rows is held unless --delay covers its period. \n");
+    printf("  --delay ms:  Write a resampled row ms after its instant, at least the period of the \n");
+    printf("               slowest label interpolated. By default, one period of the rows is used. \n");
+    printf("  --stale ms:  Invalidate a resampled label not received for ms, 0 for never. \n");
+    printf("               By default, 1000 is used. \n");
+    printf("  --window s:  Keep the recent values of every label to show their mean, standard \n");
+    printf("               deviation, minimum and maximum over the last s seconds on the dashboard \n");
+    printf("               and at exit. \n");
+    printf("  --history n: Maximum number of values kept per label, or per label as comma-separated \n");
+    printf("               label=n, e.g. ps=8000,tat=100. By default, 4096 is used. \n");
+    printf("  --stats n:   Print the counters and the label rates of every port every n seconds. \n");
+    printf("  --metrics-port n: Serve the counters in the Prometheus text format on \n");
+    printf("               http://127.0.0.1:n/metrics. \n");
+    printf("  --latency:   Trace the latency of every message through the frame and the serial \n");
+    printf("               driver, both estimated from the baudrate, the decoder and the output, \n");
+    printf("               reported with the counters and at exit. \n");
+    printf("  --multicast group:port: Forward the frames received to a UDP multicast group, \n");
+    printf("               e.g. 239.255.0.1:5300. \n");
+    printf("  --serve port: Forward the frames received to the TCP subscribers of port. A subscriber \n");
+    printf("               that is too slow is disconnected. \n");
+    printf("  --connect host:port: Decode the frames forwarded by a gateway through TCP instead \n");
+    printf("               of a serial port. \n");
+    printf("  --join group:port: Decode the frames forwarded by a gateway to a multicast group \n");
+    printf("               instead of a serial port. \n");
+    printf("\n");
     printf("\n");
-    printf("Other usage: decode.exe --help\n");
+    printf("Other usage: " PROGRAM_NAME " --help\n");
     printf("  Print this message");
     printf("\n");
     printf("\n");
@@ -60,67 +167,433 @@ static void print_help()
     printf("\n");
 }
 
-static void decode_and_print_message(char data)
+/**
+ * Split a comma separated list of serial ports.
+ * @return EXIT_FAILURE if there are too many serial ports, EXIT_SUCCESS otherwise.
+ */
+static int32_t parse_ports(char *list, pipeline_options_t *options)
 {
+    for (char *port = strtok(list, ","); port != NULL; port = strtok(NULL, ","))
+    {
+        if (options->port_count == PIPELINE_MAX_PORTS)
+        {
+            return EXIT_FAILURE;
+        }
+        options->ports[options->port_count++] = port;
+    }
+    return EXIT_SUCCESS;
+}
 
-    adc_rs485_msg_t air_data_msg = adc_rs485_decode(data);
+#ifdef _WIN32
 
-    if(air_data_msg.msg_type != RS485_PENDING)
+static void decode_and_print_messages(adc_rs485_decoder_t *decoder, const uint8_t data[], size_t length)
+{
+    adc_rs485_msg_t msgs[MSG_BUFFER_LENGTH];
+    // The text of a whole batch is written at once
+    static char text[MSG_BUFFER_LENGTH * PRINT_MESSAGE_LENGTH];
+
+    while (length > 0)
     {
-        print_message(&air_data_msg);
-    }
+        size_t consumed = 0;
+        size_t count = adc_rs485_decoder_decode_buffer_simd(decoder, data, length, msgs, MSG_BUFFER_LENGTH, &consumed);
+        size_t text_length = 0;
 
+        for (size_t i = 0; i < count; i++)
+        {
+            text_length += print_format_message(&msgs[i], &text[text_length]);
+        }
+        fwrite(text, 1, text_length, stdout);
+        data += consumed;
+        length -= consumed;
+    }
 }
 
-int main(int argc, char **argv)
+/** Read one serial port until a key is hit */
+static int32_t run(const pipeline_options_t *options)
 {
     int32_t return_code = EXIT_FAILURE;
-    print_header();
     serial_port_t adc_serial =
         {
-            .baudrate = DEFAULT_BAUDRATE,
-            .com_port = "\\\\.\\",
+            .baudrate = options->baudrate,
+            .read_timeout_ms = READ_TIMEOUT_MS,
+            .com_port = SERIAL_PORT_PREFIX,
             .windows_handle = NULL};
 
-    if (argc > 2)
+    if (options->port_count > 1)
     {
-        adc_serial.baudrate = strtol(argv[2], NULL, 10);
+        printf("Only one serial port can be read on Windows\n");
+        return EXIT_FAILURE;
     }
 
-    if ((argc > 1) && ((strcmp(argv[1], "--help") == 0) || (strcmp(argv[1], "-help") == 0)))
+    strcat(adc_serial.com_port, options->ports[0]);
+
+    if (serial_open(&adc_serial) == EXIT_SUCCESS)
     {
-        print_help();
+        adc_rs485_decoder_t decoder;
+        adc_rs485_decoder_init(&decoder);
+
+        printf("Starting on %s @ B%d\n", adc_serial.com_port, adc_serial.baudrate);
+        printf("Hit any key to exit\n\n");
+        return_code = EXIT_SUCCESS;
+
+        while (!kbhit())
+        {
+            uint8_t data[READ_BUFFER_LENGTH];
+            size_t length = 0;
+            if (serial_read(&adc_serial, data, sizeof(data), &length) == EXIT_SUCCESS)
+            {
+                decode_and_print_messages(&decoder, data, length);
+            }
+        }
+
+        serial_close(&adc_serial);
     }
-    else if (argc > 1)
+    else
     {
-        strcat(adc_serial.com_port, argv[1]);
+        printf("Couldn't open %s", adc_serial.com_port);
+    }
 
-        if (serial_open(&adc_serial) == EXIT_SUCCESS)
-        {
-            printf("Starting on %s @ B%d\n", adc_serial.com_port, adc_serial.baudrate);
-            printf("Hit any key to exit\n\n");
+    return return_code;
+}
+
+static int32_t replay(const pipeline_options_t *options)
+{
+    (void)options;
+    printf("Capture files can only be replayed on Linux\n");
+    return EXIT_FAILURE;
+}
+
+static int32_t query(const pipeline_options_t *options)
+{
+    (void)options;
+    printf("Store files can only be read on Linux\n");
+    return EXIT_FAILURE;
+}
+
+static int32_t subscribe(const pipeline_options_t *options)
+{
+    (void)options;
+    printf("Gateways can only be read on Linux\n");
+    return EXIT_FAILURE;
+}
+
+/** The messages are always printed as text on Windows */
+static void separate_output(pipeline_options_t *options)
+{
+    options->output_format = OUTPUT_FORMAT_TEXT;
+}
+
+#else
+
+/** Read all serial ports until Ctrl-C is hit */
+static int32_t run(const pipeline_options_t *options)
+{
+    return pipeline_run(options);
+}
 
-            while (!kbhit())
+/** Decode a capture file */
+static int32_t replay(const pipeline_options_t *options)
+{
+    return pipeline_replay(options);
+}
+
+/** Read a store file */
+static int32_t query(const pipeline_options_t *options)
+{
+    return pipeline_query(options);
+}
+
+/** Read the frames forwarded by a gateway */
+static int32_t subscribe(const pipeline_options_t *options)
+{
+    return pipeline_subscribe(options);
+}
+
+/**
+ * Keep the standard output for the machine-readable messages: everything else printed by the
+ * program goes to the standard error instead.
+ */
+static void separate_output(pipeline_options_t *options)
+{
+    if ((options->output_format != OUTPUT_FORMAT_TEXT) && (options->output_path == NULL))
+    {
+        fflush(stdout);
+        options->output_fd = dup(STDOUT_FILENO);
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+    }
+}
+
+#endif
+
+int main(int argc, char **argv)
+{
+    int32_t return_code = EXIT_FAILURE;
+    pipeline_options_t options = {
+        .port_count = 0,
+        .baudrate = DEFAULT_BAUDRATE,
+        .threads = 1,
+        .pin_threads = false,
+        .queue_length = DEFAULT_QUEUE_LENGTH,
+        .overflow = EVENT_RING_DROP_OLDEST,
+        .shm_name = NULL,
+        .shm_ring_length = DEFAULT_SHM_RING_LENGTH,
+        .capture_path = NULL,
+        .replay_path = NULL,
+        .replay_realtime = false,
+        .replay_jobs = 1,
+        .store_path = NULL,
+        .query_path = NULL,
+        .query_from_s = 0,
+        .query_to_s = 0,
+        .query_labels = NULL,
+        .dashboard = false,
+        .refresh_hz = DEFAULT_REFRESH_HZ,
+        .output_format = OUTPUT_FORMAT_TEXT,
+        .output_path = NULL,
+        .output_fd = -1,
+        .cycles = false,
+        .cycle_timeout_ms = DEFAULT_CYCLE_TIMEOUT_MS,
+        .resample_hz = 0,
+        .interpolate = NULL,
+        .stale_ms = DEFAULT_STALE_MS,
+        .resample_delay_ms = 0,
+        .window_s = 0,
+        .history = NULL,
+        .stats_period_s = 0,
+        .metrics_port = 0,
+        .latency = false,
+        .gateway_group = NULL,
+        .gateway_port = 0,
+        .subscribe_address = NULL,
+        .subscribe_group = NULL};
+    char *positional[2] = {NULL, NULL};
+    size_t positional_count = 0;
+    bool help = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if ((strcmp(argv[i], "--help") == 0) || (strcmp(argv[i], "-help") == 0))
+        {
+            help = true;
+        }
+        else if ((strcmp(argv[i], "--threads") == 0) && (i + 1 < argc))
+        {
+            options.threads = strtol(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--pin") == 0)
+        {
+            options.pin_threads = true;
+        }
+        else if ((strcmp(argv[i], "--queue") == 0) && (i + 1 < argc))
+        {
+            options.queue_length = strtoul(argv[++i], NULL, 10);
+        }
+        else if ((strcmp(argv[i], "--overflow") == 0) && (i + 1 < argc))
+        {
+            i++;
+            if (strcmp(argv[i], "block") == 0)
+            {
+                options.overflow = EVENT_RING_BLOCK;
+            }
+            else if (strcmp(argv[i], "coalesce") == 0)
+            {
+                options.overflow = EVENT_RING_COALESCE;
+            }
+            else
             {
-                char data = 0;
-                if (serial_get_data(&adc_serial, &data) == EXIT_SUCCESS)
-                {
-                    decode_and_print_message(data);
-                }
+                options.overflow = EVENT_RING_DROP_OLDEST;
             }
+        }
+        else if ((strcmp(argv[i], "--shm") == 0) && (i + 1 < argc))
+        {
+            options.shm_name = argv[++i];
+        }
+        else if ((strcmp(argv[i], "--shm-ring") == 0) && (i + 1 < argc))
+        {
+            options.shm_ring_length = strtoul(argv[++i], NULL, 10);
+        }
+        else if ((strcmp(argv[i], "--capture") == 0) && (i + 1 < argc))
+        {
+            options.capture_path = argv[++i];
+        }
+        else if ((strcmp(argv[i], "--replay") == 0) && (i + 1 < argc))
+        {
+            options.replay_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--realtime") == 0)
+        {
+            options.replay_realtime = true;
+        }
+        else if ((strcmp(argv[i], "--jobs") == 0) && (i + 1 < argc))
+        {
+            options.replay_jobs = strtoul(argv[++i], NULL, 10);
+        }
+        else if ((strcmp(argv[i], "--store") == 0) && (i + 1 < argc))
+        {
+            options.store_path = argv[++i];
+        }
+        else if ((strcmp(argv[i], "--query") == 0) && (i + 1 < argc))
+        {
+            options.query_path = argv[++i];
+        }
+        else if ((strcmp(argv[i], "--from") == 0) && (i + 1 < argc))
+        {
+            options.query_from_s = strtoul(argv[++i], NULL, 10);
+        }
+        else if ((strcmp(argv[i], "--to") == 0) && (i + 1 < argc))
+        {
+            options.query_to_s = strtoul(argv[++i], NULL, 10);
+        }
+        else if ((strcmp(argv[i], "--labels") == 0) && (i + 1 < argc))
+        {
+            options.query_labels = argv[++i];
+        }
+        else if (strcmp(argv[i], "--dashboard") == 0)
+        {
+            options.dashboard = true;
+        }
+        else if ((strcmp(argv[i], "--refresh") == 0) && (i + 1 < argc))
+        {
+            options.refresh_hz = strtoul(argv[++i], NULL, 10);
+        }
+        else if ((strcmp(argv[i], "--format") == 0) && (i + 1 < argc))
+        {
+            i++;
+            if (strcmp(argv[i], "csv") == 0)
+            {
+                options.output_format = OUTPUT_FORMAT_CSV;
+            }
+            else if (strcmp(argv[i], "ndjson") == 0)
+            {
+                options.output_format = OUTPUT_FORMAT_NDJSON;
+            }
+            else if (strcmp(argv[i], "binary") == 0)
+            {
+                options.output_format = OUTPUT_FORMAT_BINARY;
+            }
+            else
+            {
+                options.output_format = OUTPUT_FORMAT_TEXT;
+            }
+        }
+        else if ((strcmp(argv[i], "--output") == 0) && (i + 1 < argc))
+        {
+            options.output_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--cycles") == 0)
+        {
+            options.cycles = true;
+        }
+        else if ((strcmp(argv[i], "--cycle-timeout") == 0) && (i + 1 < argc))
+        {
+            options.cycle_timeout_ms = strtoul(argv[++i], NULL, 10);
+        }
+        else if ((strcmp(argv[i], "--resample") == 0) && (i + 1 < argc))
+        {
+            options.resample_hz = strtoul(argv[++i], NULL, 10);
+        }
+        else if ((strcmp(argv[i], "--interpolate") == 0) && (i + 1 < argc))
+        {
+            options.interpolate = argv[++i];
+        }
+        else if ((strcmp(argv[i], "--delay") == 0) && (i + 1 < argc))
+        {
+            options.resample_delay_ms = strtoul(argv[++i], NULL, 10);
+        }
+        else if ((strcmp(argv[i], "--stale") == 0) && (i + 1 < argc))
+        {
+            options.stale_ms = strtoul(argv[++i], NULL, 10);
+        }
+        else if ((strcmp(argv[i], "--window") == 0) && (i + 1 < argc))
+        {
+            options.window_s = strtoul(argv[++i], NULL, 10);
+        }
+        else if ((strcmp(argv[i], "--history") == 0) && (i + 1 < argc))
+        {
+            options.history = argv[++i];
+        }
+        else if ((strcmp(argv[i], "--stats") == 0) && (i + 1 < argc))
+        {
+            options.stats_period_s = strtoul(argv[++i], NULL, 10);
+        }
+        else if ((strcmp(argv[i], "--metrics-port") == 0) && (i + 1 < argc))
+        {
+            options.metrics_port = (uint16_t)strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--latency") == 0)
+        {
+            options.latency = true;
+        }
+        else if ((strcmp(argv[i], "--multicast") == 0) && (i + 1 < argc))
+        {
+            options.gateway_group = argv[++i];
+        }
+        else if ((strcmp(argv[i], "--serve") == 0) && (i + 1 < argc))
+        {
+            options.gateway_port = (uint16_t)strtoul(argv[++i], NULL, 10);
+        }
+        else if ((strcmp(argv[i], "--connect") == 0) && (i + 1 < argc))
+        {
+            options.subscribe_address = argv[++i];
+        }
+        else if ((strcmp(argv[i], "--join") == 0) && (i + 1 < argc))
+        {
+            options.subscribe_group = argv[++i];
+        }
+        else if (positional_count < 2)
+        {
+            positional[positional_count++] = argv[i];
+        }
+    }
+
+    separate_output(&options);
+    print_header();
 
-            serial_close(&adc_serial);
+    if (positional[1] != NULL)
+    {
+        options.baudrate = strtol(positional[1], NULL, 10);
+    }
+
+    if (help)
+    {
+        print_help();
+    }
+    else if (options.cycles && (options.resample_hz > 0))
+    {
+        printf("Error, --cycles and --resample can't be combined! \n");
+    }
+    else if (options.replay_path != NULL)
+    {
+        return_code = replay(&options);
+    }
+    else if (options.query_path != NULL)
+    {
+        return_code = query(&options);
+    }
+    else if ((options.subscribe_address != NULL) || (options.subscribe_group != NULL))
+    {
+        return_code = subscribe(&options);
+    }
+    else if (positional[0] != NULL)
+    {
+        if (parse_ports(positional[0], &options) == EXIT_SUCCESS)
+        {
+            return_code = run(&options);
         }
         else
         {
-            printf("Couldn't open %s", adc_serial.com_port);
+            printf("Error, at most %d serial ports can be read! \n", PIPELINE_MAX_PORTS);
         }
     }
     else
     {
         print_help();
         printf("Error, The serial port needs to be passed as an argument! \n");
+#ifdef _WIN32
         printf("E.g.: COM1, COM2, ... \n\n");
+#else
+        printf("E.g.: /dev/ttyUSB0, /dev/ttyS0, ... \n\n");
+#endif
     }
 
     return return_code;
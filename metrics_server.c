@@ -0,0 +1,129 @@
+/*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*/
+
+#define _GNU_SOURCE
+
+#include "metrics_server.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+/** Maximum time given to a client to send its request, in milliseconds */
+#define REQUEST_TIMEOUT_MS 500
+
+/** Maximum time a slow client can block the answer, in seconds */
+#define SEND_TIMEOUT_S 1
+
+int32_t metrics_server_open(metrics_server_t *server, uint16_t port)
+{
+    struct sockaddr_in address;
+    int enable = 1;
+
+    server->fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (server->fd < 0)
+    {
+        return EXIT_FAILURE;
+    }
+    setsockopt(server->fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if ((bind(server->fd, (struct sockaddr *)&address, sizeof(address)) != 0) || (listen(server->fd, 8) != 0))
+    {
+        close(server->fd);
+        server->fd = -1;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int metrics_server_accept(metrics_server_t *server, int32_t timeout_ms)
+{
+    struct pollfd pfd = {.fd = server->fd, .events = POLLIN, .revents = 0};
+
+    if ((server->fd < 0) || (poll(&pfd, 1, timeout_ms) <= 0))
+    {
+        return -1;
+    }
+    return accept4(server->fd, NULL, NULL, SOCK_CLOEXEC);
+}
+
+void metrics_server_reply(int client, const char text[], size_t length)
+{
+    struct pollfd pfd = {.fd = client, .events = POLLIN, .revents = 0};
+    struct timeval send_timeout = {.tv_sec = SEND_TIMEOUT_S, .tv_usec = 0};
+    char request[1024];
+    char header[160];
+
+    // The request itself is not needed, but it is read so that the client doesn't get a reset
+    if (poll(&pfd, 1, REQUEST_TIMEOUT_MS) > 0)
+    {
+        ssize_t ignored = read(client, request, sizeof(request));
+        (void)ignored;
+    }
+
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+    int header_length = snprintf(header, sizeof(header),
+                                 "HTTP/1.0 200 OK\r\n"
+                                 "Content-Type: text/plain; version=0.0.4\r\n"
+                                 "Content-Length: %zu\r\n"
+                                 "Connection: close\r\n\r\n",
+                                 length);
+
+    struct iovec parts[2] = {
+        {.iov_base = header, .iov_len = (size_t)header_length},
+        {.iov_base = (void *)text, .iov_len = length}};
+    struct msghdr message = {.msg_iov = parts, .msg_iovlen = 2};
+    size_t left = (size_t)header_length + length;
+
+    while (left > 0)
+    {
+        ssize_t sent = sendmsg(client, &message, MSG_NOSIGNAL);
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        left -= (size_t)sent;
+
+        // Skip what has been sent
+        while ((sent > 0) && (message.msg_iovlen > 0))
+        {
+            size_t step = ((size_t)sent < message.msg_iov->iov_len) ? (size_t)sent : message.msg_iov->iov_len;
+            message.msg_iov->iov_base = (char *)message.msg_iov->iov_base + step;
+            message.msg_iov->iov_len -= step;
+            sent -= (ssize_t)step;
+            if (message.msg_iov->iov_len == 0)
+            {
+                message.msg_iov++;
+                message.msg_iovlen--;
+            }
+        }
+    }
+    close(client);
+}
+
+void metrics_server_close(metrics_server_t *server)
+{
+    if (server->fd >= 0)
+    {
+        close(server->fd);
+        server->fd = -1;
+    }
+}
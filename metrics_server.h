@@ -0,0 +1,65 @@
+/**
+* This module serves the decoder metrics over HTTP on the loopback interface, in the Prometheus
+* text format, so that they can be scraped by a local monitoring agent. Every request is answered
+* with the metrics, whatever its path, and the connection is closed.
+*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*
+* Example code only. Use at own risk.
+*
+* This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* Simtec AG has no obligation to provide maintenance, support,  updates, enhancements, or modifications.
+*/
+
+#ifndef METRICS_SERVER_H
+#define METRICS_SERVER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** HTTP server of the metrics */
+typedef struct
+{
+    int fd;     /**< Listening socket, -1 when closed */
+} metrics_server_t;
+
+/**
+ * Start listening on 127.0.0.1.
+ *
+ * @param[out]  server  Server.
+ * @param[in]   port    TCP port.
+ *
+ * @return EXIT_FAILURE if the port couldn't be bound, EXIT_SUCCESS otherwise.
+ */
+int32_t metrics_server_open(metrics_server_t *server, uint16_t port);
+
+/**
+ * Wait for a client to connect.
+ *
+ * @param[in]   server      Server.
+ * @param[in]   timeout_ms  Maximum waiting time.
+ *
+ * @return Socket of the client, -1 if no client has connected.
+ */
+int metrics_server_accept(metrics_server_t *server, int32_t timeout_ms);
+
+/**
+ * Read the request of a client, answer it with the metrics and close the connection.
+ *
+ * @param[in]   client  Socket of the client.
+ * @param[in]   text    Metrics in the Prometheus text format.
+ * @param[in]   length  Length of the text.
+ */
+void metrics_server_reply(int client, const char text[], size_t length);
+
+/**
+ * Stop listening.
+ *
+ * @param[in,out]   server  Server.
+ */
+void metrics_server_close(metrics_server_t *server);
+
+#endif
@@ -0,0 +1,508 @@
+/*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*/
+
+#include "output_sink.h"
+#include "adc_cycle.h"
+#include "adc_event.h"
+#include "adc_resample.h"
+#include "adc_rs485_decoder.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/** Maximum length of the text of one message or cycle, the buffer is written before it can't hold one more */
+#define OUTPUT_SINK_LINE_LENGTH 4096
+
+/** Name of every type of message */
+static const char *const msg_type_name[] = {
+    [RS485_PENDING] = "pending",
+    [RS485_RETURNED_DATA] = "data",
+    [RS485_RETURNED_STATUS_GEN] = "gen_status",
+    [RS485_RETURNED_STATUS_HTR] = "htr_status",
+    [RS485_ERROR] = "error"};
+
+/** Name of every flag, the same as printed by print_msg */
+static const char *const flag_name[] = {
+    [FLAG_VALID] = "valid",
+    [FLAG_RANGE_ABOVE] = "range+",
+    [FLAG_RANGE_BELLOW] = "range-",
+    [FLAG_INVALID_POS] = "invalid+",
+    [FLAG_INVALID_NEG] = "invalid-",
+    [FLAG_INVALID] = "invalid"};
+
+/** Name of every reason why a cycle is closed */
+static const char *const closed_by_name[] = {
+    [ADC_CYCLE_CLOSED_BY_STATUS] = "status",
+    [ADC_CYCLE_CLOSED_BY_TIMEOUT] = "timeout",
+    [ADC_CYCLE_CLOSED_BY_REPEAT] = "repeat",
+    [ADC_CYCLE_CLOSED_BY_END] = "end"};
+
+static const char *output_msg_type_name(uint8_t msg_type)
+{
+    return (msg_type <= RS485_ERROR) ? msg_type_name[msg_type] : "unknown";
+}
+
+static const char *output_flag_name(uint8_t flag)
+{
+    return (flag <= FLAG_INVALID) ? flag_name[flag] : "unknown";
+}
+
+/** Write the whole buffer, a single write() unless the file accepts only a part of it */
+static int32_t output_sink_write_all(output_sink_t *sink)
+{
+    const char *data = sink->buffer;
+    size_t length = sink->length;
+
+    while ((length > 0) && !sink->failed)
+    {
+        ssize_t written = write(sink->fd, data, length);
+        if (written < 0)
+        {
+            if (errno != EINTR)
+            {
+                sink->failed = true;
+            }
+            continue;
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+    sink->length = 0;
+    return sink->failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/** Append formatted text to the buffer, which has room for at least OUTPUT_SINK_LINE_LENGTH bytes */
+static void output_sink_printf(output_sink_t *sink, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+static void output_sink_printf(output_sink_t *sink, const char *format, ...)
+{
+    size_t room = OUTPUT_SINK_BUFFER_LENGTH - sink->length;
+    va_list args;
+
+    va_start(args, format);
+    int written = vsnprintf(&sink->buffer[sink->length], room, format, args);
+    va_end(args);
+
+    if (written > 0)
+    {
+        sink->length += ((size_t)written < room) ? (size_t)written : room - 1;
+    }
+}
+
+static const char *output_closed_by_name(uint8_t closed_by)
+{
+    return (closed_by <= ADC_CYCLE_CLOSED_BY_END) ? closed_by_name[closed_by] : "unknown";
+}
+
+/** Make room for one more message or cycle */
+static void output_sink_reserve(output_sink_t *sink)
+{
+    if (OUTPUT_SINK_BUFFER_LENGTH - sink->length < OUTPUT_SINK_LINE_LENGTH)
+    {
+        output_sink_write_all(sink);
+    }
+}
+
+static void output_sink_put_le(output_sink_t *sink, uint64_t value, size_t bytes)
+{
+    for (size_t i = 0; i < bytes; i++)
+    {
+        sink->buffer[sink->length++] = (char)(uint8_t)(value >> (8 * i));
+    }
+}
+
+static void output_sink_csv_header(output_sink_t *sink)
+{
+    output_sink_printf(sink, "timestamp_ns,port,msg_type,flag");
+    for (size_t type = 0; type < RS485_DATA_NOT_VALID; type++)
+    {
+        output_sink_printf(sink, ",%s", adc_event_label_name(type));
+    }
+    output_sink_printf(sink, ",gen_status,htr_status\n");
+}
+
+static void output_sink_csv_cycle_header(output_sink_t *sink)
+{
+    output_sink_printf(sink, "start_ns,end_ns,port,closed_by,errors");
+    for (size_t type = 0; type < RS485_DATA_NOT_VALID; type++)
+    {
+        output_sink_printf(sink, ",%s,%s_flag", adc_event_label_name(type), adc_event_label_name(type));
+    }
+    output_sink_printf(sink, ",gen_status,htr_status\n");
+}
+
+static void output_sink_csv_row_header(output_sink_t *sink)
+{
+    output_sink_printf(sink, "time_ns,port,valid");
+    for (size_t type = 0; type < RS485_DATA_NOT_VALID; type++)
+    {
+        output_sink_printf(sink, ",%s,%s_flag", adc_event_label_name(type), adc_event_label_name(type));
+    }
+    output_sink_printf(sink, ",gen_status,htr_status\n");
+}
+
+/** One row per message, only the column of the message is filled */
+static void output_sink_csv(output_sink_t *sink, const adc_event_t *event)
+{
+    // Columns of the labels, then of the general and of the heater status
+    size_t column = RS485_DATA_NOT_VALID + 2;
+    const char *flag = "";
+
+    if ((event->msg_type == RS485_RETURNED_DATA) && (event->data_type < RS485_DATA_NOT_VALID))
+    {
+        column = event->data_type;
+        flag = output_flag_name(event->flag);
+    }
+    else if (event->msg_type == RS485_RETURNED_STATUS_GEN)
+    {
+        column = RS485_DATA_NOT_VALID;
+    }
+    else if (event->msg_type == RS485_RETURNED_STATUS_HTR)
+    {
+        column = RS485_DATA_NOT_VALID + 1;
+    }
+
+    output_sink_printf(sink, "%llu,%u,%s,%s", (unsigned long long)event->timestamp_ns, event->port,
+                       output_msg_type_name(event->msg_type), flag);
+    for (size_t i = 0; i < RS485_DATA_NOT_VALID + 2; i++)
+    {
+        if (i != column)
+        {
+            sink->buffer[sink->length++] = ',';
+        }
+        else if (i < RS485_DATA_NOT_VALID)
+        {
+            // 9 significant digits are enough to read back exactly the same float
+            output_sink_printf(sink, ",%.9g", event->value);
+        }
+        else
+        {
+            output_sink_printf(sink, ",%u", event->status & 0xFFFFu);
+        }
+    }
+    sink->buffer[sink->length++] = '\n';
+}
+
+static void output_sink_ndjson(output_sink_t *sink, const adc_event_t *event)
+{
+    output_sink_printf(sink, "{\"timestamp_ns\":%llu,\"port\":%u,\"msg_type\":\"%s\"", (unsigned long long)event->timestamp_ns,
+                       event->port, output_msg_type_name(event->msg_type));
+
+    if ((event->msg_type == RS485_RETURNED_DATA) && (event->data_type < RS485_DATA_NOT_VALID))
+    {
+        output_sink_printf(sink, ",\"label\":\"%s\"", adc_event_label_name(event->data_type));
+        // JSON has no representation of the non-finite numbers
+        if (isfinite(event->value))
+        {
+            output_sink_printf(sink, ",\"value\":%.9g", event->value);
+        }
+        else
+        {
+            output_sink_printf(sink, ",\"value\":null");
+        }
+        output_sink_printf(sink, ",\"flag\":\"%s\"}\n", output_flag_name(event->flag));
+    }
+    else if ((event->msg_type == RS485_RETURNED_STATUS_GEN) || (event->msg_type == RS485_RETURNED_STATUS_HTR))
+    {
+        output_sink_printf(sink, ",\"status\":%u}\n", event->status & 0xFFFFu);
+    }
+    else if (event->msg_type == RS485_ERROR)
+    {
+        output_sink_printf(sink, ",\"reason\":\"%s\"}\n", adc_event_error_name(event->status));
+    }
+    else
+    {
+        output_sink_printf(sink, "}\n");
+    }
+}
+
+/**
+ * Columns of the labels and of the status of a cycle or of a row, the columns not received are empty.
+ * Cycles and rows use the same bits for the status in present.
+ */
+static void output_sink_csv_values(output_sink_t *sink, uint64_t present, const float values[], const uint8_t flags[],
+                                   uint16_t gen_status, uint16_t htr_status)
+{
+    for (size_t type = 0; type < RS485_DATA_NOT_VALID; type++)
+    {
+        if ((present & (1ull << type)) != 0)
+        {
+            output_sink_printf(sink, ",%.9g,%s", values[type], output_flag_name(flags[type]));
+        }
+        else
+        {
+            output_sink_printf(sink, ",,");
+        }
+    }
+    if ((present & (1ull << ADC_RESAMPLE_GEN_STATUS)) != 0)
+    {
+        output_sink_printf(sink, ",%u", gen_status);
+    }
+    else
+    {
+        sink->buffer[sink->length++] = ',';
+    }
+    if ((present & (1ull << ADC_RESAMPLE_HTR_STATUS)) != 0)
+    {
+        output_sink_printf(sink, ",%u", htr_status);
+    }
+    else
+    {
+        sink->buffer[sink->length++] = ',';
+    }
+    sink->buffer[sink->length++] = '\n';
+}
+
+/** Status and labels of a cycle or of a row, without the closing brace */
+static void output_sink_ndjson_values(output_sink_t *sink, uint64_t present, const float values[], const uint8_t flags[],
+                                      uint16_t gen_status, uint16_t htr_status)
+{
+    const char *separator = "";
+
+    if ((present & (1ull << ADC_RESAMPLE_GEN_STATUS)) != 0)
+    {
+        output_sink_printf(sink, ",\"gen_status\":%u", gen_status);
+    }
+    if ((present & (1ull << ADC_RESAMPLE_HTR_STATUS)) != 0)
+    {
+        output_sink_printf(sink, ",\"htr_status\":%u", htr_status);
+    }
+
+    output_sink_printf(sink, ",\"labels\":{");
+    for (size_t type = 0; type < RS485_DATA_NOT_VALID; type++)
+    {
+        if ((present & (1ull << type)) == 0)
+        {
+            continue;
+        }
+        if (isfinite(values[type]))
+        {
+            output_sink_printf(sink, "%s\"%s\":{\"value\":%.9g", separator, adc_event_label_name(type), values[type]);
+        }
+        else
+        {
+            output_sink_printf(sink, "%s\"%s\":{\"value\":null", separator, adc_event_label_name(type));
+        }
+        output_sink_printf(sink, ",\"flag\":\"%s\"}", output_flag_name(flags[type]));
+        separator = ",";
+    }
+    output_sink_printf(sink, "}");
+}
+
+/** Value and flag of every label of a cycle or of a row */
+static void output_sink_binary_values(output_sink_t *sink, const float values[], const uint8_t flags[])
+{
+    for (size_t type = 0; type < RS485_DATA_NOT_VALID; type++)
+    {
+        uint32_t bits;
+        memcpy(&bits, &values[type], sizeof(bits));
+        output_sink_put_le(sink, bits, 4);
+    }
+    for (size_t type = 0; type < RS485_DATA_NOT_VALID; type++)
+    {
+        output_sink_put_le(sink, flags[type], 1);
+    }
+}
+
+/** One row per cycle, the columns of the labels not received are empty */
+static void output_sink_csv_cycle(output_sink_t *sink, const adc_cycle_t *cycle)
+{
+    output_sink_printf(sink, "%llu,%llu,%u,%s,%u", (unsigned long long)cycle->start_ns, (unsigned long long)cycle->end_ns,
+                       cycle->port, output_closed_by_name(cycle->closed_by), cycle->errors);
+    output_sink_csv_values(sink, cycle->present, cycle->values, cycle->flags, cycle->gen_status, cycle->htr_status);
+}
+
+static void output_sink_ndjson_cycle(output_sink_t *sink, const adc_cycle_t *cycle)
+{
+    output_sink_printf(sink, "{\"start_ns\":%llu,\"end_ns\":%llu,\"port\":%u,\"closed_by\":\"%s\",\"errors\":%u",
+                       (unsigned long long)cycle->start_ns, (unsigned long long)cycle->end_ns, cycle->port,
+                       output_closed_by_name(cycle->closed_by), cycle->errors);
+    output_sink_ndjson_values(sink, cycle->present, cycle->values, cycle->flags, cycle->gen_status, cycle->htr_status);
+    output_sink_printf(sink, "}\n");
+}
+
+static void output_sink_binary_cycle(output_sink_t *sink, const adc_cycle_t *cycle)
+{
+    output_sink_put_le(sink, cycle->start_ns, 8);
+    output_sink_put_le(sink, cycle->end_ns, 8);
+    output_sink_put_le(sink, cycle->present, 8);
+    output_sink_put_le(sink, cycle->gen_status, 2);
+    output_sink_put_le(sink, cycle->htr_status, 2);
+    output_sink_put_le(sink, cycle->errors, 2);
+    output_sink_put_le(sink, cycle->port, 1);
+    output_sink_put_le(sink, cycle->closed_by, 1);
+    output_sink_binary_values(sink, cycle->values, cycle->flags);
+}
+
+static void output_sink_csv_row(output_sink_t *sink, const adc_resample_row_t *row)
+{
+    output_sink_printf(sink, "%llu,%u,%u", (unsigned long long)row->time_ns, row->port, row->valid ? 1u : 0u);
+    output_sink_csv_values(sink, row->present, row->values, row->flags, row->gen_status, row->htr_status);
+}
+
+static void output_sink_ndjson_row(output_sink_t *sink, const adc_resample_row_t *row)
+{
+    output_sink_printf(sink, "{\"time_ns\":%llu,\"port\":%u,\"valid\":%s", (unsigned long long)row->time_ns, row->port,
+                       row->valid ? "true" : "false");
+    output_sink_ndjson_values(sink, row->present, row->values, row->flags, row->gen_status, row->htr_status);
+    output_sink_printf(sink, "}\n");
+}
+
+static void output_sink_binary_row(output_sink_t *sink, const adc_resample_row_t *row)
+{
+    output_sink_put_le(sink, row->time_ns, 8);
+    output_sink_put_le(sink, row->present, 8);
+    output_sink_put_le(sink, row->gen_status, 2);
+    output_sink_put_le(sink, row->htr_status, 2);
+    output_sink_put_le(sink, row->port, 1);
+    output_sink_put_le(sink, row->valid ? 1u : 0u, 1);
+    output_sink_put_le(sink, 0, 2);
+    output_sink_binary_values(sink, row->values, row->flags);
+}
+
+static void output_sink_binary(output_sink_t *sink, const adc_event_t *event)
+{
+    output_sink_put_le(sink, event->timestamp_ns, 8);
+    output_sink_put_le(sink, event->status, 4);
+    output_sink_put_le(sink, event->msg_type, 1);
+    output_sink_put_le(sink, event->data_type, 1);
+    output_sink_put_le(sink, event->flag, 1);
+    output_sink_put_le(sink, event->port, 1);
+}
+
+int32_t output_sink_open(output_sink_t *sink, output_format_t format, output_record_t record, const char *path, int fd)
+{
+    memset(sink, 0, sizeof(*sink));
+    sink->format = format;
+    sink->record = record;
+    sink->fd = fd;
+
+    sink->buffer = malloc(OUTPUT_SINK_BUFFER_LENGTH);
+    if (sink->buffer == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+
+    if (path != NULL)
+    {
+        sink->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (sink->fd < 0)
+        {
+            free(sink->buffer);
+            sink->buffer = NULL;
+            return EXIT_FAILURE;
+        }
+        sink->owns_fd = true;
+    }
+
+    if ((format == OUTPUT_FORMAT_CSV) && (record == OUTPUT_RECORD_CYCLES))
+    {
+        output_sink_csv_cycle_header(sink);
+    }
+    else if ((format == OUTPUT_FORMAT_CSV) && (record == OUTPUT_RECORD_ROWS))
+    {
+        output_sink_csv_row_header(sink);
+    }
+    else if (format == OUTPUT_FORMAT_CSV)
+    {
+        output_sink_csv_header(sink);
+    }
+    return EXIT_SUCCESS;
+}
+
+void output_sink_write(output_sink_t *sink, const adc_event_t events[], size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        output_sink_reserve(sink);
+
+        switch (sink->format)
+        {
+        case OUTPUT_FORMAT_CSV:
+            output_sink_csv(sink, &events[i]);
+            break;
+        case OUTPUT_FORMAT_NDJSON:
+            output_sink_ndjson(sink, &events[i]);
+            break;
+        case OUTPUT_FORMAT_BINARY:
+            output_sink_binary(sink, &events[i]);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void output_sink_write_cycles(output_sink_t *sink, const adc_cycle_t cycles[], size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        output_sink_reserve(sink);
+
+        switch (sink->format)
+        {
+        case OUTPUT_FORMAT_CSV:
+            output_sink_csv_cycle(sink, &cycles[i]);
+            break;
+        case OUTPUT_FORMAT_NDJSON:
+            output_sink_ndjson_cycle(sink, &cycles[i]);
+            break;
+        case OUTPUT_FORMAT_BINARY:
+            output_sink_binary_cycle(sink, &cycles[i]);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void output_sink_write_rows(output_sink_t *sink, const adc_resample_row_t rows[], size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        output_sink_reserve(sink);
+
+        switch (sink->format)
+        {
+        case OUTPUT_FORMAT_CSV:
+            output_sink_csv_row(sink, &rows[i]);
+            break;
+        case OUTPUT_FORMAT_NDJSON:
+            output_sink_ndjson_row(sink, &rows[i]);
+            break;
+        case OUTPUT_FORMAT_BINARY:
+            output_sink_binary_row(sink, &rows[i]);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+int32_t output_sink_flush(output_sink_t *sink)
+{
+    return output_sink_write_all(sink);
+}
+
+int32_t output_sink_close(output_sink_t *sink)
+{
+    int32_t return_code = output_sink_write_all(sink);
+
+    if (sink->owns_fd && (close(sink->fd) != 0))
+    {
+        return_code = EXIT_FAILURE;
+    }
+    free(sink->buffer);
+    sink->buffer = NULL;
+    sink->owns_fd = false;
+    return return_code;
+}
@@ -0,0 +1,166 @@
+/**
+* This module writes the decoded messages in machine-readable formats, so that other programs don't
+* have to parse the text printed for humans:
+*   - CSV, one row per message and one column per data_type_t,
+*   - NDJSON, one JSON object per line and per message,
+*   - binary, one fixed-layout little-endian record of 16 bytes per message.
+*
+* The messages are formatted into a large buffer, which is written with a single write per batch
+* of messages.
+*
+* Binary record, all numbers little-endian:
+*   - bytes 0 to 7:  monotonic time at which the message was received, in nanoseconds,
+*   - bytes 8 to 11: bits of the float value of a data message, status word, or adc_rs485_error_t of an error,
+*   - byte 12:       type of message, rs485_msg_type_t,
+*   - byte 13:       type of data, data_type_t,
+*   - byte 14:       flag, flag_t,
+*   - byte 15:       index of the serial port.
+*
+* With the cycle assembler, one row, object or record is written per cycle instead. Binary cycle
+* record, all numbers little-endian:
+*   - bytes 0 to 7:    receive time of the first message of the cycle, in nanoseconds,
+*   - bytes 8 to 15:   receive time of the last message of the cycle, in nanoseconds,
+*   - bytes 16 to 23:  labels present, adc_cycle_t.present,
+*   - bytes 24 to 25:  general status,
+*   - bytes 26 to 27:  heater status,
+*   - bytes 28 to 29:  number of messages that couldn't be decoded,
+*   - byte 30:         index of the serial port,
+*   - byte 31:         reason why the cycle has been closed, adc_cycle_close_t,
+*   - bytes 32 to 175: bits of the float value of every data_type_t,
+*   - bytes 176 to 211: flag of every data_type_t.
+*
+* With the resampler, one row, object or record is written per row instead. Binary row record, all
+* numbers little-endian:
+*   - bytes 0 to 7:    instant of the row, in nanoseconds,
+*   - bytes 8 to 15:   labels present, adc_resample_row_t.present,
+*   - bytes 16 to 17:  general status,
+*   - bytes 18 to 19:  heater status,
+*   - byte 20:         index of the serial port,
+*   - byte 21:         1 if the row is valid, 0 otherwise,
+*   - bytes 22 to 23:  0,
+*   - bytes 24 to 167: bits of the float value of every data_type_t,
+*   - bytes 168 to 203: flag of every data_type_t.
+*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*
+* Example code only. Use at own risk.
+*
+* This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* Simtec AG has no obligation to provide maintenance, support,  updates, enhancements, or modifications.
+*/
+
+#ifndef OUTPUT_SINK_H
+#define OUTPUT_SINK_H
+
+#include "adc_cycle.h"
+#include "adc_event.h"
+#include "adc_resample.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Size in bytes of the buffer of a sink */
+#define OUTPUT_SINK_BUFFER_LENGTH (1024 * 1024)
+
+/** Size in bytes of one binary record */
+#define OUTPUT_SINK_RECORD_LENGTH 16
+
+/** Size in bytes of one binary cycle record */
+#define OUTPUT_SINK_CYCLE_RECORD_LENGTH (32 + 5 * RS485_DATA_NOT_VALID)
+
+/** Size in bytes of one binary row record */
+#define OUTPUT_SINK_ROW_RECORD_LENGTH (24 + 5 * RS485_DATA_NOT_VALID)
+
+/** Format of the output */
+typedef enum
+{
+    OUTPUT_FORMAT_TEXT,     /**< Text for humans, printed by print_message(), not handled by a sink */
+    OUTPUT_FORMAT_CSV,
+    OUTPUT_FORMAT_NDJSON,
+    OUTPUT_FORMAT_BINARY
+} output_format_t;
+
+/** What is written to the output */
+typedef enum
+{
+    OUTPUT_RECORD_MESSAGES, /**< Every message, with output_sink_write() */
+    OUTPUT_RECORD_CYCLES,   /**< Cycles assembled, with output_sink_write_cycles() */
+    OUTPUT_RECORD_ROWS      /**< Rows resampled at a fixed rate, with output_sink_write_rows() */
+} output_record_t;
+
+/** Machine-readable output */
+typedef struct
+{
+    output_format_t format;
+    int fd;
+    output_record_t record; /**< What is written */
+    bool owns_fd;           /**< Set if the file has been opened by the sink */
+    bool failed;            /**< Set when a write failed, nothing is written anymore */
+    size_t length;          /**< Number of bytes in the buffer */
+    char *buffer;
+} output_sink_t;
+
+/**
+ * Open a sink. The CSV header is written immediately.
+ *
+ * @param[out]  sink    Sink.
+ * @param[in]   format  Format of the output, not OUTPUT_FORMAT_TEXT.
+ * @param[in]   record  What is written.
+ * @param[in]   path    File to write, an existing file is replaced. NULL to write to a file
+ *                      descriptor instead.
+ * @param[in]   fd      File descriptor written if path is NULL, it is not closed by the sink.
+ *
+ * @return EXIT_FAILURE if the file couldn't be opened or if the buffer couldn't be allocated,
+ * EXIT_SUCCESS otherwise.
+ */
+int32_t output_sink_open(output_sink_t *sink, output_format_t format, output_record_t record, const char *path, int fd);
+
+/**
+ * Format messages into the buffer of a sink. The buffer is written when it is full.
+ *
+ * @param[in,out]   sink    Sink.
+ * @param[in]       events  Decoded messages.
+ * @param[in]       count   Number of messages.
+ */
+void output_sink_write(output_sink_t *sink, const adc_event_t events[], size_t count);
+
+/**
+ * Format cycles into the buffer of a sink. The buffer is written when it is full.
+ *
+ * @param[in,out]   sink    Sink.
+ * @param[in]       cycles  Cycles assembled.
+ * @param[in]       count   Number of cycles.
+ */
+void output_sink_write_cycles(output_sink_t *sink, const adc_cycle_t cycles[], size_t count);
+
+/**
+ * Format resampled rows into the buffer of a sink. The buffer is written when it is full.
+ *
+ * @param[in,out]   sink    Sink.
+ * @param[in]       rows    Rows resampled.
+ * @param[in]       count   Number of rows.
+ */
+void output_sink_write_rows(output_sink_t *sink, const adc_resample_row_t rows[], size_t count);
+
+/**
+ * Write the buffer of a sink, at the end of every batch of messages.
+ *
+ * @param[in,out]   sink    Sink.
+ *
+ * @return EXIT_FAILURE if the output can't be written anymore, EXIT_SUCCESS otherwise.
+ */
+int32_t output_sink_flush(output_sink_t *sink);
+
+/**
+ * Write the buffer and close a sink.
+ *
+ * @param[in,out]   sink    Sink.
+ *
+ * @return EXIT_FAILURE if the output couldn't be completely written, EXIT_SUCCESS otherwise.
+ */
+int32_t output_sink_close(output_sink_t *sink);
+
+#endif
@@ -0,0 +1,367 @@
+/*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*/
+
+#include "parallel_decode.h"
+#include "adc_event.h"
+#include "adc_metrics.h"
+#include "adc_rs485_decoder.h"
+#include "adc_rs485_simd.h"
+#include "capture.h"
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Number of messages decoded at once by a worker */
+#define PARALLEL_DECODE_BATCH_LENGTH 1024
+
+/** Jobs decoded ahead of the caller per worker */
+#define PARALLEL_DECODE_SLOTS_PER_THREAD 2
+
+/** Job not decoded yet */
+#define PARALLEL_DECODE_NO_JOB SIZE_MAX
+
+/** Start of a job, at a start of header */
+typedef struct
+{
+    size_t pos;             /**< Offset of the chunk that holds the start of header */
+    uint64_t time_ns;       /**< Time of the chunk before it, to read the chunk again */
+    size_t offset;          /**< Offset of the start of header in the chunk */
+} parallel_decode_split_t;
+
+/** Messages of one job */
+typedef struct
+{
+    size_t job;             /**< Job decoded into the slot, PARALLEL_DECODE_NO_JOB while it is being decoded */
+    adc_event_t *events;
+    size_t count;
+    size_t capacity;
+    adc_metrics_t metrics;  /**< Counters of the bytes of the job */
+    bool failed;            /**< Set when the events couldn't be allocated */
+} parallel_decode_slot_t;
+
+/** Shared by the caller and the workers */
+typedef struct
+{
+    const capture_reader_t *reader;
+    const parallel_decode_split_t *splits;
+    size_t job_count;
+    uint8_t port;
+    parallel_decode_slot_t *slots;
+    size_t slot_count;
+    size_t next_job;        /**< Next job to be taken by a worker */
+    size_t consumed;        /**< Jobs handed to the caller so far */
+    bool quit;
+    pthread_mutex_t mutex;
+    pthread_cond_t done;    /**< Signaled when a job has been decoded */
+    pthread_cond_t released; /**< Signaled when a slot can be reused */
+} parallel_decode_t;
+
+static inline bool parallel_decode_is_soh(uint8_t byte)
+{
+    return (byte == 0x01u) || (byte == 0x02u) || (byte == 0x03u) || (byte == 0x05u);
+}
+
+/**
+ * Find where the jobs start, about every PARALLEL_DECODE_JOB_LENGTH bytes. Only the headers of the
+ * chunks are read, and the bytes of the chunks until the first start of header after each split.
+ */
+static parallel_decode_split_t *parallel_decode_split(const capture_reader_t *reader, size_t *count)
+{
+    capture_reader_t cursor = *reader;
+    size_t capacity = 64;
+    parallel_decode_split_t *splits = malloc(capacity * sizeof(*splits));
+    const uint8_t *data;
+    size_t length;
+    uint64_t timestamp_ns;
+
+    if (splits == NULL)
+    {
+        return NULL;
+    }
+
+    // The first job starts at the first chunk, whatever its first byte
+    splits[0].pos = cursor.pos;
+    splits[0].time_ns = cursor.time_ns;
+    splits[0].offset = 0;
+    *count = 1;
+
+    size_t pos = cursor.pos;
+    uint64_t time_ns = cursor.time_ns;
+    while (capture_reader_next(&cursor, &data, &length, &timestamp_ns))
+    {
+        if (pos - splits[*count - 1].pos >= PARALLEL_DECODE_JOB_LENGTH)
+        {
+            const uint8_t *soh = data;
+            while ((soh < data + length) && !parallel_decode_is_soh(*soh))
+            {
+                soh++;
+            }
+
+            // Without any start of header, the split moves to the next chunk
+            if (soh < data + length)
+            {
+                if (*count == capacity)
+                {
+                    parallel_decode_split_t *larger = realloc(splits, 2 * capacity * sizeof(*splits));
+                    if (larger == NULL)
+                    {
+                        free(splits);
+                        return NULL;
+                    }
+                    splits = larger;
+                    capacity *= 2;
+                }
+                splits[*count].pos = pos;
+                splits[*count].time_ns = time_ns;
+                splits[*count].offset = (size_t)(soh - data);
+                (*count)++;
+            }
+        }
+        pos = cursor.pos;
+        time_ns = cursor.time_ns;
+    }
+    return splits;
+}
+
+/** Append the messages decoded in one chunk to a slot */
+static bool parallel_decode_append(parallel_decode_slot_t *slot, const adc_rs485_msg_t msgs[], size_t count, uint8_t port,
+                                   uint64_t timestamp_ns)
+{
+    if (slot->count + count > slot->capacity)
+    {
+        size_t capacity = (slot->capacity > 0) ? 2 * slot->capacity : 4 * PARALLEL_DECODE_BATCH_LENGTH;
+        while (capacity < slot->count + count)
+        {
+            capacity *= 2;
+        }
+        adc_event_t *events = realloc(slot->events, capacity * sizeof(*events));
+        if (events == NULL)
+        {
+            return false;
+        }
+        slot->events = events;
+        slot->capacity = capacity;
+    }
+
+    // The messages keep the time at which their chunk has been recorded
+    for (size_t i = 0; i < count; i++)
+    {
+        adc_event_from_msg(&slot->events[slot->count + i], &msgs[i], port, timestamp_ns);
+    }
+    slot->count += count;
+    return true;
+}
+
+/** Decode the bytes of one job, from its start of header to the start of header of the next one */
+static void parallel_decode_job(const parallel_decode_t *state, size_t job, parallel_decode_slot_t *slot)
+{
+    adc_rs485_msg_t msgs[PARALLEL_DECODE_BATCH_LENGTH];
+    adc_rs485_decoder_t decoder;
+    capture_reader_t cursor = *state->reader;
+    const parallel_decode_split_t *from = &state->splits[job];
+    const parallel_decode_split_t *to = (job + 1 < state->job_count) ? &state->splits[job + 1] : NULL;
+    const uint8_t *data;
+    size_t length;
+    uint64_t timestamp_ns;
+
+    slot->count = 0;
+    slot->failed = false;
+    memset(&slot->metrics, 0, sizeof(slot->metrics));
+
+    cursor.pos = from->pos;
+    cursor.time_ns = from->time_ns;
+    size_t start = from->offset;
+    bool last_chunk = false;
+
+    adc_rs485_decoder_init(&decoder);
+    while (!last_chunk && !slot->failed)
+    {
+        size_t pos = cursor.pos;
+        if (!capture_reader_next(&cursor, &data, &length, &timestamp_ns))
+        {
+            break;
+        }
+        if ((to != NULL) && (pos == to->pos))
+        {
+            length = to->offset;
+            last_chunk = true;
+        }
+
+        data += start;
+        length -= start;
+        slot->metrics.bytes += length;
+        start = 0;
+
+        while (length > 0)
+        {
+            size_t consumed = 0;
+            size_t count = adc_rs485_decoder_decode_buffer_simd(&decoder, data, length, msgs, PARALLEL_DECODE_BATCH_LENGTH,
+                                                                &consumed);
+
+            adc_metrics_count_msgs(&slot->metrics, msgs, count);
+            if (!parallel_decode_append(slot, msgs, count, state->port, timestamp_ns))
+            {
+                slot->failed = true;
+                break;
+            }
+            data += consumed;
+            length -= consumed;
+        }
+    }
+
+    // The start of header of the next job interrupts the message still being received
+    if ((to != NULL) && (decoder.pos > 0))
+    {
+        decoder.truncated++;
+    }
+    slot->metrics.truncated = decoder.truncated;
+    slot->metrics.errors[ADC_RS485_ERROR_NO_SOH] = decoder.resync;
+}
+
+static void *parallel_decode_worker(void *arg)
+{
+    parallel_decode_t *state = arg;
+
+    pthread_mutex_lock(&state->mutex);
+    for (;;)
+    {
+        // A slot is free once the caller has consumed the job decoded in it before
+        while (!state->quit && (state->next_job < state->job_count) &&
+               (state->next_job >= state->consumed + state->slot_count))
+        {
+            pthread_cond_wait(&state->released, &state->mutex);
+        }
+        if (state->quit || (state->next_job >= state->job_count))
+        {
+            break;
+        }
+
+        size_t job = state->next_job++;
+        parallel_decode_slot_t *slot = &state->slots[job % state->slot_count];
+        pthread_mutex_unlock(&state->mutex);
+
+        parallel_decode_job(state, job, slot);
+
+        pthread_mutex_lock(&state->mutex);
+        slot->job = job;
+        pthread_cond_broadcast(&state->done);
+    }
+    pthread_mutex_unlock(&state->mutex);
+    return NULL;
+}
+
+int32_t parallel_decode_capture(const capture_reader_t *reader, uint32_t threads, uint8_t port, adc_metrics_t *metrics,
+                                parallel_decode_handler_t handler, void *user, const volatile sig_atomic_t *stop)
+{
+    parallel_decode_t state;
+    pthread_t workers[PARALLEL_DECODE_MAX_THREADS];
+    uint32_t started = 0;
+    int32_t return_code = EXIT_SUCCESS;
+
+    if (threads == 0)
+    {
+        threads = 1;
+    }
+    else if (threads > PARALLEL_DECODE_MAX_THREADS)
+    {
+        threads = PARALLEL_DECODE_MAX_THREADS;
+    }
+
+    memset(&state, 0, sizeof(state));
+    state.reader = reader;
+    state.port = port;
+    state.splits = parallel_decode_split(reader, &state.job_count);
+    if (state.splits == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    if (threads > state.job_count)
+    {
+        threads = (uint32_t)state.job_count;
+    }
+
+    state.slot_count = PARALLEL_DECODE_SLOTS_PER_THREAD * (size_t)threads;
+    state.slots = calloc(state.slot_count, sizeof(*state.slots));
+    if (state.slots == NULL)
+    {
+        free((void *)state.splits);
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < state.slot_count; i++)
+    {
+        state.slots[i].job = PARALLEL_DECODE_NO_JOB;
+    }
+
+    pthread_mutex_init(&state.mutex, NULL);
+    pthread_cond_init(&state.done, NULL);
+    pthread_cond_init(&state.released, NULL);
+
+    while (started < threads)
+    {
+        if (pthread_create(&workers[started], NULL, parallel_decode_worker, &state) != 0)
+        {
+            break;
+        }
+        started++;
+    }
+    if (started == 0)
+    {
+        return_code = EXIT_FAILURE;
+    }
+
+    // The jobs are handed to the caller in the order of the file, whatever order they are decoded in
+    for (size_t job = 0; (started > 0) && (job < state.job_count) && (*stop == 0); job++)
+    {
+        parallel_decode_slot_t *slot = &state.slots[job % state.slot_count];
+
+        pthread_mutex_lock(&state.mutex);
+        while (slot->job != job)
+        {
+            pthread_cond_wait(&state.done, &state.mutex);
+        }
+        pthread_mutex_unlock(&state.mutex);
+
+        if (slot->failed)
+        {
+            return_code = EXIT_FAILURE;
+            break;
+        }
+        if (metrics != NULL)
+        {
+            adc_metrics_merge(metrics, &slot->metrics);
+        }
+        handler(slot->events, slot->count, user);
+
+        pthread_mutex_lock(&state.mutex);
+        slot->job = PARALLEL_DECODE_NO_JOB;
+        state.consumed = job + 1;
+        pthread_cond_broadcast(&state.released);
+        pthread_mutex_unlock(&state.mutex);
+    }
+
+    pthread_mutex_lock(&state.mutex);
+    state.quit = true;
+    pthread_cond_broadcast(&state.released);
+    pthread_mutex_unlock(&state.mutex);
+    for (uint32_t i = 0; i < started; i++)
+    {
+        pthread_join(workers[i], NULL);
+    }
+
+    pthread_cond_destroy(&state.released);
+    pthread_cond_destroy(&state.done);
+    pthread_mutex_destroy(&state.mutex);
+    for (size_t i = 0; i < state.slot_count; i++)
+    {
+        free(state.slots[i].events);
+    }
+    free(state.slots);
+    free((void *)state.splits);
+    return return_code;
+}
@@ -0,0 +1,69 @@
+/**
+* This module decodes a capture file on several threads, so that a large archive is decoded again
+* at the speed of all cores instead of one.
+*
+* The messages are self-synchronizing: the start of header bytes never appear in a payload, and a
+* start of header resets the decoder whatever its state. A decoder state starting at any start of
+* header therefore decodes exactly the same messages as a decoder that has read all bytes before.
+* The capture file is split into jobs of about PARALLEL_DECODE_JOB_LENGTH bytes, each starting at
+* the first start of header of a chunk, and every job is decoded by a worker thread with its own
+* decoder state. The only difference is a message interrupted by the start of header of the next
+* job, which is counted as truncated once the job is complete.
+*
+* The messages of the jobs are handed to the caller in the order of the file, on the calling
+* thread. At most two jobs per worker are decoded ahead of the caller, so the memory used doesn't
+* depend on the size of the file.
+*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*
+* Example code only. Use at own risk.
+*
+* This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* Simtec AG has no obligation to provide maintenance, support,  updates, enhancements, or modifications.
+*/
+
+#ifndef PARALLEL_DECODE_H
+#define PARALLEL_DECODE_H
+
+#include "adc_event.h"
+#include "adc_metrics.h"
+#include "capture.h"
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Number of bytes of the capture file decoded per job */
+#define PARALLEL_DECODE_JOB_LENGTH (1024 * 1024)
+
+/** Maximum number of worker threads */
+#define PARALLEL_DECODE_MAX_THREADS 256
+
+/**
+ * Called on the calling thread with the messages of one job, in the order of the capture file.
+ *
+ * @param[in]   events  Decoded messages, with the time at which their chunk has been recorded.
+ * @param[in]   count   Number of messages.
+ * @param[in]   user    Pointer given to parallel_decode_capture().
+ */
+typedef void (*parallel_decode_handler_t)(const adc_event_t events[], size_t count, void *user);
+
+/**
+ * Decode a whole capture file on several threads.
+ *
+ * @param[in]       reader      Capture file, open and not read yet. It isn't modified.
+ * @param[in]       threads     Number of worker threads, at most PARALLEL_DECODE_MAX_THREADS.
+ * @param[in]       port        Index of the serial port written into the messages.
+ * @param[in,out]   metrics     Counters of the capture file, updated on the calling thread, or NULL.
+ * @param[in]       handler     Called with the messages of every job, in order.
+ * @param[in]       user        Pointer passed to the handler.
+ * @param[in]       stop        Set asynchronously, e.g. by a signal handler, to stop before the end of the file.
+ *
+ * @return EXIT_FAILURE if the threads or the memory couldn't be allocated, EXIT_SUCCESS otherwise.
+ */
+int32_t parallel_decode_capture(const capture_reader_t *reader, uint32_t threads, uint8_t port, adc_metrics_t *metrics,
+                                parallel_decode_handler_t handler, void *user, const volatile sig_atomic_t *stop);
+
+#endif
@@ -0,0 +1,1781 @@
+/*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*/
+
+#include "pipeline.h"
+#include "acquisition.h"
+#include "adc_cycle.h"
+#include "adc_metrics.h"
+#include "adc_history.h"
+#include "adc_resample.h"
+#include "adc_store.h"
+#include "adc_rs485_simd.h"
+#include "adc_shm.h"
+#include "capture.h"
+#include "dashboard.h"
+#include "adc_event.h"
+#include "event_ring.h"
+#include "gateway.h"
+#include "latency.h"
+#include "latest_table.h"
+#include "metrics_server.h"
+#include "output_sink.h"
+#include "parallel_decode.h"
+#include "print_msg.h"
+#include "serial.h"
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/** Maximum number of messages moved at once between the threads */
+#define EVENT_BATCH_LENGTH 512
+
+/** Maximum sleeping time of the consumer, in milliseconds */
+#define CONSUMER_WAIT_MS 100
+
+/** Period of the update of the metrics without stats line, in seconds */
+#define METRICS_PERIOD_S 1
+
+/** Size in bytes of the text of the metrics */
+#define METRICS_TEXT_LENGTH (1024 * 1024)
+
+/** Maximum number of rows resampled at once */
+#define ROW_BATCH_LENGTH 64
+
+/** Maximum number of messages decoded at once from a capture file */
+#define REPLAY_BATCH_LENGTH 4096
+
+/** Size in bytes of the text written at once to the standard output */
+#define TEXT_BUFFER_LENGTH (64 * 1024)
+
+/**
+ * Maximum number of characters of the text of a cycle or of a row without the name of its port:
+ * its first line, the errors, the statuses and the empty line, and a line for every label.
+ */
+#define BLOCK_TEXT_LENGTH (256 + RS485_DATA_NOT_VALID * (PRINT_LINE_LENGTH + 2))
+
+/** State of the decoder program */
+typedef struct
+{
+    const pipeline_options_t *options;
+    const char *const *port_names;      /**< Names of the ports being read, from the options or the file */
+    size_t port_count;                  /**< Number of ports actually opened */
+    acquisition_port_t ports[PIPELINE_MAX_PORTS];
+    event_ring_t rings[PIPELINE_MAX_PORTS];
+    event_ring_t *ring_list[PIPELINE_MAX_PORTS];
+    event_ring_notifier_t notifier;
+    latest_table_t local_latest[PIPELINE_MAX_PORTS];
+    latest_table_t *latest;             /**< Latest value tables, local or in shared memory */
+    adc_shm_t shm;
+    bool shm_enabled;
+    capture_writer_t captures[PIPELINE_MAX_PORTS];
+    size_t capture_count;
+    uint32_t capture_failed;            /**< Set when a capture file couldn't be written */
+    dashboard_t dashboard;
+    output_sink_t sink;
+    bool sink_enabled;
+    adc_store_writer_t store;
+    bool store_enabled;
+    gateway_t gateway;
+    bool gateway_enabled;
+    adc_cycle_assembler_t assemblers[PIPELINE_MAX_PORTS];
+    adc_resampler_t resamplers[PIPELINE_MAX_PORTS];
+    adc_history_t *histories;           /**< Recent values of every port, NULL if not kept */
+    size_t history_count;
+    adc_metrics_t replay_metrics;       /**< Counters of the capture file being replayed */
+    adc_metrics_report_t report;
+    metrics_server_t metrics_server;
+    latency_histogram_t (*latency)[LATENCY_STAGE_COUNT]; /**< Latencies of every port, NULL if not traced */
+    pthread_t stats_thread;
+    bool stats_running;
+    uint64_t next_refresh_ns;           /**< Time of the next refresh of the dashboard */
+    char text[TEXT_BUFFER_LENGTH];      /**< Text of the messages, cycles or rows being printed */
+    uint32_t stop;                      /**< Set when the consumer shall stop */
+} pipeline_t;
+
+/** State of the program, too large for the stack */
+static pipeline_t pipeline;
+
+/** Called by the acquisition engine on the worker thread of the port */
+static void pipeline_push(uint32_t port_id, const adc_rs485_msg_t msgs[], size_t count, void *user)
+{
+    pipeline_t *state = (pipeline_t *)user;
+    adc_event_t events[EVENT_BATCH_LENGTH];
+    uint64_t now = adc_event_now_ns();
+
+    if (state->gateway_enabled)
+    {
+        gateway_forward(&state->gateway, port_id, msgs, count);
+    }
+
+    while (count > 0)
+    {
+        size_t batch = (count < EVENT_BATCH_LENGTH) ? count : EVENT_BATCH_LENGTH;
+        for (size_t i = 0; i < batch; i++)
+        {
+            adc_event_from_msg(&events[i], &msgs[i], (uint8_t)port_id, now);
+            latest_table_update(&state->latest[port_id], &events[i]);
+        }
+        event_ring_push(&state->rings[port_id], events, batch);
+        msgs += batch;
+        count -= batch;
+    }
+}
+
+/** Called by the acquisition engine with the raw bytes of every read */
+static void pipeline_capture(uint32_t port_id, const uint8_t data[], size_t length, void *user)
+{
+    pipeline_t *state = (pipeline_t *)user;
+
+    if (capture_writer_write(&state->captures[port_id], data, length, adc_event_now_ns()) != EXIT_SUCCESS)
+    {
+        __atomic_store_n(&state->capture_failed, 1, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * Make room in the text buffer for the text of one message, cycle or row of a port, writing the text
+ * buffered so far if needed, then append the name of the port if there are several.
+ * Returns the new length of the text in the buffer.
+ */
+static size_t pipeline_append_port(pipeline_t *state, size_t length, uint32_t port, size_t text_length)
+{
+    const char *name = state->port_names[port];
+    size_t name_length = (state->port_count > 1) ? strlen(name) : 0;
+
+    if (length + name_length + 3 + text_length > TEXT_BUFFER_LENGTH)
+    {
+        fwrite(state->text, 1, length, stdout);
+        length = 0;
+    }
+    if (state->port_count > 1)
+    {
+        if (name_length + 3 + text_length > TEXT_BUFFER_LENGTH)
+        {
+            // Too long to be buffered, never seen with real port names
+            printf("[%s] ", name);
+        }
+        else
+        {
+            state->text[length++] = '[';
+            memcpy(&state->text[length], name, name_length);
+            length += name_length;
+            state->text[length++] = ']';
+            state->text[length++] = ' ';
+        }
+    }
+    return length;
+}
+
+/** Append formatted text to the text buffer, room has been made for it. Returns the new length of the text. */
+static size_t pipeline_printf(pipeline_t *state, size_t length, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+static size_t pipeline_printf(pipeline_t *state, size_t length, const char *format, ...)
+{
+    size_t room = TEXT_BUFFER_LENGTH - length;
+    va_list args;
+
+    va_start(args, format);
+    int written = vsnprintf(&state->text[length], room, format, args);
+    va_end(args);
+
+    if (written > 0)
+    {
+        length += ((size_t)written < room) ? (size_t)written : room - 1;
+    }
+    return length;
+}
+
+/** Append the labels of a cycle or of a row with the text of print_message() */
+static size_t pipeline_append_labels(pipeline_t *state, size_t length, uint64_t present, const float values[], const uint8_t flags[])
+{
+    for (uint32_t type = 0; type < RS485_DATA_NOT_VALID; type++)
+    {
+        if ((present & (1ull << type)) != 0)
+        {
+            air_data_t air_data = {
+                .type = (data_type_t)type,
+                .value = values[type],
+                .flag = (flags[type] <= FLAG_INVALID) ? (flag_t)flags[type] : FLAG_INVALID};
+            state->text[length++] = ' ';
+            state->text[length++] = ' ';
+            length += print_format_air_data(&air_data, &state->text[length], PRINT_LINE_LENGTH);
+            state->text[length++] = '\n';
+        }
+    }
+    return length;
+}
+
+/** Append one cycle with the text of print_message() */
+static size_t pipeline_append_cycle(pipeline_t *state, size_t length, const adc_cycle_t *cycle)
+{
+    static const char *const reasons[] = {
+        [ADC_CYCLE_CLOSED_BY_STATUS] = "general status",
+        [ADC_CYCLE_CLOSED_BY_TIMEOUT] = "timeout",
+        [ADC_CYCLE_CLOSED_BY_REPEAT] = "label repeated",
+        [ADC_CYCLE_CLOSED_BY_END] = "end of the messages"};
+
+    length = pipeline_append_port(state, length, cycle->port, BLOCK_TEXT_LENGTH);
+    length = pipeline_printf(state, length, "Cycle of %.1f ms (%s)\n", (double)(cycle->end_ns - cycle->start_ns) / 1e6,
+                             (cycle->closed_by <= ADC_CYCLE_CLOSED_BY_END) ? reasons[cycle->closed_by] : "unknown");
+
+    length = pipeline_append_labels(state, length, cycle->present, cycle->values, cycle->flags);
+    if (cycle->errors > 0)
+    {
+        length = pipeline_printf(state, length, "  %u messages couldn't be decoded\n", cycle->errors);
+    }
+    if ((cycle->present & (1ull << ADC_CYCLE_HTR_STATUS)) != 0)
+    {
+        length = pipeline_printf(state, length, "  Heater status = 0x%04X\n", cycle->htr_status);
+    }
+    if ((cycle->present & (1ull << ADC_CYCLE_GEN_STATUS)) != 0)
+    {
+        length = pipeline_printf(state, length, "  General status = 0x%04X\n", cycle->gen_status);
+    }
+    state->text[length++] = '\n';
+    return length;
+}
+
+/** Append one resampled row with the text of print_message() */
+static size_t pipeline_append_row(pipeline_t *state, size_t length, const adc_resample_row_t *row)
+{
+    length = pipeline_append_port(state, length, row->port, BLOCK_TEXT_LENGTH);
+    length = pipeline_printf(state, length, "Row at %.3f s (%s)\n", (double)row->time_ns / 1e9, row->valid ? "valid" : "invalid");
+
+    length = pipeline_append_labels(state, length, row->present, row->values, row->flags);
+    if ((row->present & (1ull << ADC_RESAMPLE_HTR_STATUS)) != 0)
+    {
+        length = pipeline_printf(state, length, "  Heater status = 0x%04X\n", row->htr_status);
+    }
+    if ((row->present & (1ull << ADC_RESAMPLE_GEN_STATUS)) != 0)
+    {
+        length = pipeline_printf(state, length, "  General status = 0x%04X\n", row->gen_status);
+    }
+    state->text[length++] = '\n';
+    return length;
+}
+
+/** Handle the cycles completed by the assemblers */
+static void pipeline_output_cycles(pipeline_t *state, const adc_cycle_t cycles[], size_t count)
+{
+    if (state->sink_enabled)
+    {
+        output_sink_write_cycles(&state->sink, cycles, count);
+    }
+    else if (!state->options->dashboard)
+    {
+        // The text of the cycles is appended into one buffer, written at once
+        size_t length = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            length = pipeline_append_cycle(state, length, &cycles[i]);
+        }
+        fwrite(state->text, 1, length, stdout);
+    }
+}
+
+/** Close the cycles whose general status hasn't come in time, the sink is only flushed when one was closed */
+static void pipeline_poll_cycles(pipeline_t *state, uint64_t now_ns)
+{
+    adc_cycle_t cycle;
+    bool closed = false;
+
+    if (state->options->cycles)
+    {
+        for (size_t port = 0; port < PIPELINE_MAX_PORTS; port++)
+        {
+            if (adc_cycle_poll(&state->assemblers[port], now_ns, &cycle))
+            {
+                pipeline_output_cycles(state, &cycle, 1);
+                closed = true;
+            }
+        }
+        if (state->sink_enabled && closed)
+        {
+            output_sink_flush(&state->sink);
+        }
+    }
+}
+
+/** Output the cycles still open once all messages have been handled */
+static void pipeline_flush_cycles(pipeline_t *state)
+{
+    adc_cycle_t cycle;
+
+    if (state->options->cycles)
+    {
+        for (size_t port = 0; port < PIPELINE_MAX_PORTS; port++)
+        {
+            if (adc_cycle_flush(&state->assemblers[port], &cycle))
+            {
+                pipeline_output_cycles(state, &cycle, 1);
+            }
+        }
+        if (state->sink_enabled)
+        {
+            output_sink_flush(&state->sink);
+        }
+    }
+}
+
+/** Handle the rows computed by the resamplers */
+static void pipeline_output_rows(pipeline_t *state, const adc_resample_row_t rows[], size_t count)
+{
+    if (state->sink_enabled)
+    {
+        output_sink_write_rows(&state->sink, rows, count);
+    }
+    else if (!state->options->dashboard)
+    {
+        // The text of the rows is appended into one buffer, written at once
+        size_t length = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            length = pipeline_append_row(state, length, &rows[i]);
+        }
+        fwrite(state->text, 1, length, stdout);
+    }
+}
+
+/** Compute the rows of one port up to the current time, returns the number of rows output */
+static size_t pipeline_poll_port_rows(pipeline_t *state, size_t port, uint64_t now_ns)
+{
+    adc_resample_row_t rows[ROW_BATCH_LENGTH];
+    size_t total = 0;
+    size_t count;
+
+    do
+    {
+        count = adc_resampler_poll(&state->resamplers[port], now_ns, rows, ROW_BATCH_LENGTH);
+        pipeline_output_rows(state, rows, count);
+        total += count;
+    } while (count == ROW_BATCH_LENGTH);
+    return total;
+}
+
+/**
+ * Compute the rows of all ports up to the current time, also when no message is received.
+ * The sink is only flushed when rows were output, not on every poll.
+ */
+static void pipeline_poll_rows(pipeline_t *state, uint64_t now_ns)
+{
+    size_t total = 0;
+
+    if (state->options->resample_hz > 0)
+    {
+        for (size_t port = 0; port < PIPELINE_MAX_PORTS; port++)
+        {
+            total += pipeline_poll_port_rows(state, port, now_ns);
+        }
+        if (state->sink_enabled && (total > 0))
+        {
+            output_sink_flush(&state->sink);
+        }
+    }
+}
+
+/** Compute the rows up to the last message once all messages have been handled */
+static void pipeline_flush_rows(pipeline_t *state)
+{
+    adc_resample_row_t rows[ROW_BATCH_LENGTH];
+
+    if (state->options->resample_hz > 0)
+    {
+        for (size_t port = 0; port < PIPELINE_MAX_PORTS; port++)
+        {
+            size_t count;
+            do
+            {
+                count = adc_resampler_flush(&state->resamplers[port], rows, ROW_BATCH_LENGTH);
+                pipeline_output_rows(state, rows, count);
+            } while (count == ROW_BATCH_LENGTH);
+        }
+        if (state->sink_enabled)
+        {
+            output_sink_flush(&state->sink);
+        }
+    }
+}
+
+/** Remove the values older than the window from the histories */
+static void pipeline_expire_history(pipeline_t *state, uint64_t now_ns)
+{
+    if (state->histories != NULL)
+    {
+        for (size_t port = 0; port < state->history_count; port++)
+        {
+            adc_history_expire(&state->histories[port], now_ns);
+        }
+    }
+}
+
+/**
+ * Print messages with the text of print_message(), prefixed by the name of their port if there are
+ * several. The text is appended into one buffer, written at once when full and at the end.
+ */
+static void pipeline_print_messages(pipeline_t *state, const adc_event_t events[], size_t count)
+{
+    size_t length = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        length = pipeline_append_port(state, length, events[i].port, PRINT_MESSAGE_LENGTH);
+
+        adc_rs485_msg_t msg;
+        adc_event_to_msg(&events[i], &msg);
+        length += print_format_message(&msg, &state->text[length]);
+    }
+    fwrite(state->text, 1, length, stdout);
+}
+
+/** Handle the messages popped by the consumer */
+static void pipeline_consume(pipeline_t *state, const adc_event_t events[], size_t count)
+{
+    if (state->shm_enabled)
+    {
+        adc_shm_publish(&state->shm, events, count);
+    }
+
+    if (state->store_enabled)
+    {
+        adc_store_writer_add(&state->store, events, count);
+    }
+
+    if (state->histories != NULL)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            adc_history_add(&state->histories[events[i].port], &events[i]);
+        }
+    }
+
+    if (state->options->dashboard)
+    {
+        // The values are shown from the latest value tables
+        dashboard_count(&state->dashboard, events, count);
+    }
+
+    if (state->options->cycles)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            adc_cycle_t completed[ADC_CYCLE_MAX_COMPLETED];
+            size_t cycles = adc_cycle_add(&state->assemblers[events[i].port], &events[i], completed);
+            pipeline_output_cycles(state, completed, cycles);
+        }
+    }
+    else if (state->options->resample_hz > 0)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            adc_resampler_add(&state->resamplers[events[i].port], &events[i]);
+        }
+        // The rows are computed on the clock of the messages, also when they are replayed
+        if (count > 0)
+        {
+            pipeline_poll_port_rows(state, events[count - 1].port, events[count - 1].timestamp_ns);
+        }
+    }
+    else if (state->sink_enabled)
+    {
+        output_sink_write(&state->sink, events, count);
+    }
+    else if (!state->options->dashboard)
+    {
+        pipeline_print_messages(state, events, count);
+    }
+
+    if (state->sink_enabled)
+    {
+        output_sink_flush(&state->sink);
+    }
+
+    if (state->latency != NULL)
+    {
+        // The events carry the time at which they have been decoded
+        uint64_t now = adc_event_now_ns();
+        for (size_t i = 0; i < count; i++)
+        {
+            latency_record(&state->latency[events[i].port][LATENCY_STAGE_DELIVERY], now - events[i].timestamp_ns);
+        }
+    }
+}
+
+/** Record the ports read, whose names prefix the printed messages when there are several */
+static void pipeline_set_ports(pipeline_t *state, const char *const names[], size_t count)
+{
+    state->port_names = names;
+    state->port_count = count;
+}
+
+/** Start the dashboard if requested by the options */
+static void pipeline_open_dashboard(pipeline_t *state, const char *const names[], size_t count)
+{
+    const latest_table_t *tables[PIPELINE_MAX_PORTS];
+
+    if (state->options->dashboard)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            tables[i] = &state->latest[i];
+        }
+        // The dashboard writes directly to the terminal, after what has been printed so far
+        fflush(stdout);
+        dashboard_init(&state->dashboard, STDOUT_FILENO, names, tables, count);
+        state->next_refresh_ns = 0;
+
+        if (state->histories != NULL)
+        {
+            const adc_history_t *histories[PIPELINE_MAX_PORTS];
+            for (size_t i = 0; i < count; i++)
+            {
+                histories[i] = &state->histories[i];
+            }
+            dashboard_set_histories(&state->dashboard, histories);
+        }
+    }
+}
+
+/**
+ * Refresh the dashboard if it is time to.
+ * @return Time until the next refresh in milliseconds, CONSUMER_WAIT_MS without dashboard.
+ */
+static int32_t pipeline_refresh_dashboard(pipeline_t *state, bool force)
+{
+    if (!state->options->dashboard)
+    {
+        return CONSUMER_WAIT_MS;
+    }
+
+    uint32_t refresh_hz = (state->options->refresh_hz > 0) ? state->options->refresh_hz : 1u;
+    uint64_t period_ns = 1000000000u / refresh_hz;
+    uint64_t now = adc_event_now_ns();
+
+    if (force || (now >= state->next_refresh_ns))
+    {
+        dashboard_refresh(&state->dashboard, now);
+        // A late refresh doesn't make the next ones closer together
+        state->next_refresh_ns = (now - state->next_refresh_ns < period_ns) ? (state->next_refresh_ns + period_ns) : (now + period_ns);
+    }
+    return (int32_t)((state->next_refresh_ns - now + 999999u) / 1000000u);
+}
+
+static void pipeline_close_dashboard(pipeline_t *state)
+{
+    if (state->options->dashboard)
+    {
+        pipeline_refresh_dashboard(state, true);
+        dashboard_close(&state->dashboard);
+    }
+}
+
+static void *pipeline_consumer(void *arg)
+{
+    pipeline_t *state = (pipeline_t *)arg;
+    size_t port_count = state->options->port_count;
+    adc_event_t events[EVENT_BATCH_LENGTH];
+
+    for (;;)
+    {
+        int32_t timeout_ms = pipeline_refresh_dashboard(state, false);
+        size_t total = 0;
+
+        pipeline_poll_cycles(state, adc_event_now_ns());
+        for (size_t i = 0; i < port_count; i++)
+        {
+            size_t count = event_ring_pop(&state->rings[i], events, EVENT_BATCH_LENGTH);
+            pipeline_consume(state, events, count);
+            total += count;
+        }
+        // After the rings, so that the messages received before the rows are taken into account
+        pipeline_poll_rows(state, adc_event_now_ns());
+        pipeline_expire_history(state, adc_event_now_ns());
+
+        if (total == 0)
+        {
+            // Stop only once the rings have been emptied
+            if (__atomic_load_n(&state->stop, __ATOMIC_ACQUIRE) != 0)
+            {
+                pipeline_flush_cycles(state);
+                pipeline_flush_rows(state);
+                break;
+            }
+            event_ring_wait(&state->notifier, state->ring_list, port_count, (timeout_ms < CONSUMER_WAIT_MS) ? timeout_ms : CONSUMER_WAIT_MS);
+        }
+    }
+    return NULL;
+}
+
+/** Reset the state of the program, the latest value tables are local */
+static void pipeline_reset(const pipeline_options_t *options)
+{
+    memset(&pipeline, 0, sizeof(pipeline));
+    pipeline.options = options;
+    pipeline.latest = pipeline.local_latest;
+    for (size_t i = 0; i < PIPELINE_MAX_PORTS; i++)
+    {
+        latest_table_init(&pipeline.latest[i]);
+        adc_cycle_assembler_init(&pipeline.assemblers[i], (uint8_t)i, (uint64_t)options->cycle_timeout_ms * 1000000u);
+        if (options->resample_hz > 0)
+        {
+            adc_resampler_init(&pipeline.resamplers[i], (uint8_t)i, 1000000000u / options->resample_hz,
+                               (uint64_t)options->stale_ms * 1000000u);
+            adc_resampler_set_delay(&pipeline.resamplers[i], (uint64_t)options->resample_delay_ms * 1000000u);
+        }
+    }
+}
+
+/** Select the labels interpolated by the resamplers from the options */
+static int32_t pipeline_open_resample(void)
+{
+    const char *labels = pipeline.options->interpolate;
+
+    while ((pipeline.options->resample_hz > 0) && (labels != NULL) && (*labels != '\0'))
+    {
+        size_t length = strcspn(labels, ",");
+        bool all = (length == 3) && (strncmp(labels, "all", 3) == 0);
+        bool found = all;
+
+        for (uint32_t type = 0; type < RS485_DATA_NOT_VALID; type++)
+        {
+            const char *name = adc_event_label_name(type);
+            if (all || ((strlen(name) == length) && (strncmp(labels, name, length) == 0)))
+            {
+                for (size_t port = 0; port < PIPELINE_MAX_PORTS; port++)
+                {
+                    adc_resampler_set_method(&pipeline.resamplers[port], (data_type_t)type, ADC_RESAMPLE_LINEAR);
+                }
+                found = true;
+            }
+        }
+        if (!found)
+        {
+            printf("Unknown label %.*s\n", (int)length, labels);
+            return EXIT_FAILURE;
+        }
+        labels += (labels[length] == ',') ? length + 1 : length;
+    }
+    return EXIT_SUCCESS;
+}
+
+/** Read the number of values kept of every label from the options */
+static int32_t pipeline_parse_history(uint32_t capacities[RS485_DATA_NOT_VALID])
+{
+    const char *labels = pipeline.options->history;
+
+    for (uint32_t type = 0; type < RS485_DATA_NOT_VALID; type++)
+    {
+        capacities[type] = ADC_HISTORY_DEFAULT_CAPACITY;
+    }
+
+    while ((labels != NULL) && (*labels != '\0'))
+    {
+        size_t length = strcspn(labels, ",");
+        const char *equal = memchr(labels, '=', length);
+        size_t name_length = (equal != NULL) ? (size_t)(equal - labels) : 0;
+        uint32_t capacity = strtoul((equal != NULL) ? equal + 1 : labels, NULL, 10);
+        // A number alone applies to all labels, as all=n
+        bool all = (equal == NULL) || ((name_length == 3) && (strncmp(labels, "all", 3) == 0));
+        bool found = all;
+
+        for (uint32_t type = 0; type < RS485_DATA_NOT_VALID; type++)
+        {
+            const char *name = adc_event_label_name(type);
+            if (all || ((strlen(name) == name_length) && (strncmp(labels, name, name_length) == 0)))
+            {
+                capacities[type] = capacity;
+                found = true;
+            }
+        }
+        if (!found)
+        {
+            printf("Unknown label %.*s\n", (int)name_length, labels);
+            return EXIT_FAILURE;
+        }
+        labels += (labels[length] == ',') ? length + 1 : length;
+    }
+    return EXIT_SUCCESS;
+}
+
+/** Allocate the recent values of every port if requested by the options */
+static int32_t pipeline_open_history(size_t count)
+{
+    uint32_t capacities[RS485_DATA_NOT_VALID];
+
+    if (pipeline.options->window_s == 0)
+    {
+        return EXIT_SUCCESS;
+    }
+    if (pipeline_parse_history(capacities) != EXIT_SUCCESS)
+    {
+        return EXIT_FAILURE;
+    }
+
+    pipeline.histories = calloc(count, sizeof(*pipeline.histories));
+    for (size_t i = 0; (pipeline.histories != NULL) && (i < count); i++)
+    {
+        if (adc_history_init(&pipeline.histories[i], capacities, (uint64_t)pipeline.options->window_s * 1000000000u) != EXIT_SUCCESS)
+        {
+            for (size_t j = 0; j < i; j++)
+            {
+                adc_history_free(&pipeline.histories[j]);
+            }
+            free(pipeline.histories);
+            pipeline.histories = NULL;
+        }
+    }
+    if (pipeline.histories == NULL)
+    {
+        printf("Not enough memory\n");
+        return EXIT_FAILURE;
+    }
+    pipeline.history_count = count;
+    return EXIT_SUCCESS;
+}
+
+/** Print the statistics of every label over the window, then free the recent values */
+static void pipeline_close_history(const char *const names[])
+{
+    if (pipeline.histories == NULL)
+    {
+        return;
+    }
+
+    for (size_t port = 0; port < pipeline.history_count; port++)
+    {
+        bool header = false;
+        for (uint32_t type = 0; type < RS485_DATA_NOT_VALID; type++)
+        {
+            adc_history_stats_t stats;
+            if (!adc_history_stats(&pipeline.histories[port], (data_type_t)type, &stats))
+            {
+                continue;
+            }
+            if (!header)
+            {
+                printf("Statistics of %s over the last %u s\n", names[port], pipeline.options->window_s);
+                printf("  label        count          mean        stddev           min           max\n");
+                header = true;
+            }
+            printf("  %-8s %9u %13.6g %13.6g %13.6g %13.6g\n", adc_event_label_name(type), stats.count, stats.mean,
+                   stats.stddev, (double)stats.min, (double)stats.max);
+        }
+        adc_history_free(&pipeline.histories[port]);
+    }
+    free(pipeline.histories);
+    pipeline.histories = NULL;
+    pipeline.history_count = 0;
+}
+
+/** Move the latest value tables to shared memory if requested by the options */
+static int32_t pipeline_open_shm(const char *const names[], size_t count)
+{
+    const pipeline_options_t *options = pipeline.options;
+
+    if (options->shm_name != NULL)
+    {
+        if (adc_shm_create(&pipeline.shm, options->shm_name, names, (uint32_t)count,
+                           (uint32_t)options->shm_ring_length) != EXIT_SUCCESS)
+        {
+            printf("Couldn't create the shared memory %s\n", options->shm_name);
+            return EXIT_FAILURE;
+        }
+        pipeline.shm_enabled = true;
+        pipeline.latest = pipeline.shm.tables;
+        printf("Publishing to the shared memory %s\n", options->shm_name);
+    }
+    return EXIT_SUCCESS;
+}
+
+static void pipeline_close_shm(void)
+{
+    if (pipeline.shm_enabled)
+    {
+        adc_shm_close(&pipeline.shm);
+        pipeline.shm_enabled = false;
+    }
+}
+
+/** Create one capture file per serial port if requested by the options */
+static int32_t pipeline_open_captures(void)
+{
+    const pipeline_options_t *options = pipeline.options;
+
+    if (options->capture_path == NULL)
+    {
+        return EXIT_SUCCESS;
+    }
+
+    for (; pipeline.capture_count < options->port_count; pipeline.capture_count++)
+    {
+        char path[4096];
+        size_t i = pipeline.capture_count;
+
+        // With several serial ports, the index of the port is appended to the path
+        if (options->port_count > 1)
+        {
+            snprintf(path, sizeof(path), "%s.%zu", options->capture_path, i);
+        }
+        else
+        {
+            snprintf(path, sizeof(path), "%s", options->capture_path);
+        }
+
+        if (capture_writer_open(&pipeline.captures[i], path, options->ports[i], options->baudrate) != EXIT_SUCCESS)
+        {
+            printf("Couldn't create the capture file %s\n", path);
+            return EXIT_FAILURE;
+        }
+        printf("Recording %s into %s\n", options->ports[i], path);
+    }
+    return EXIT_SUCCESS;
+}
+
+static void pipeline_close_captures(void)
+{
+    for (size_t i = 0; i < pipeline.capture_count; i++)
+    {
+        if (capture_writer_close(&pipeline.captures[i]) != EXIT_SUCCESS)
+        {
+            pipeline.capture_failed = 1;
+        }
+    }
+    if (pipeline.capture_failed != 0)
+    {
+        printf("Error writing the capture files\n");
+    }
+    pipeline.capture_count = 0;
+}
+
+/** Open the machine-readable output if requested by the options */
+static int32_t pipeline_open_sink(void)
+{
+    const pipeline_options_t *options = pipeline.options;
+
+    if (options->output_format == OUTPUT_FORMAT_TEXT)
+    {
+        return EXIT_SUCCESS;
+    }
+
+    output_record_t record = OUTPUT_RECORD_MESSAGES;
+    if (options->cycles)
+    {
+        record = OUTPUT_RECORD_CYCLES;
+    }
+    else if (options->resample_hz > 0)
+    {
+        record = OUTPUT_RECORD_ROWS;
+    }
+
+    if (output_sink_open(&pipeline.sink, options->output_format, record, options->output_path, options->output_fd) != EXIT_SUCCESS)
+    {
+        printf("Couldn't create the output file %s\n", (options->output_path != NULL) ? options->output_path : "");
+        return EXIT_FAILURE;
+    }
+    pipeline.sink_enabled = true;
+    return EXIT_SUCCESS;
+}
+
+static void pipeline_close_sink(void)
+{
+    if (pipeline.sink_enabled)
+    {
+        if ((output_sink_close(&pipeline.sink) != EXIT_SUCCESS) || pipeline.sink.failed)
+        {
+            printf("Error writing the output\n");
+        }
+        pipeline.sink_enabled = false;
+    }
+}
+
+/** Archive the decoded messages into a store file if requested by the options */
+static int32_t pipeline_open_store(const char *const names[], size_t count)
+{
+    const char *path = pipeline.options->store_path;
+
+    if (path != NULL)
+    {
+        if (adc_store_writer_open(&pipeline.store, path, names, (uint32_t)count, ADC_STORE_DEFAULT_RESOLUTION_NS) != EXIT_SUCCESS)
+        {
+            printf("Couldn't create the store file %s\n", path);
+            return EXIT_FAILURE;
+        }
+        pipeline.store_enabled = true;
+    }
+    return EXIT_SUCCESS;
+}
+
+static void pipeline_close_store(void)
+{
+    if (pipeline.store_enabled)
+    {
+        if (adc_store_writer_close(&pipeline.store) != EXIT_SUCCESS)
+        {
+            printf("Error writing the store file %s\n", pipeline.options->store_path);
+        }
+        else
+        {
+            printf("%llu messages archived into %llu bytes\n", (unsigned long long)pipeline.store.samples,
+                   (unsigned long long)pipeline.store.offset);
+        }
+        pipeline.store_enabled = false;
+    }
+}
+
+/** Forward the frames received to the network if requested by the options */
+static int32_t pipeline_open_gateway(size_t count)
+{
+    const pipeline_options_t *options = pipeline.options;
+
+    if ((options->gateway_group == NULL) && (options->gateway_port == 0))
+    {
+        return EXIT_SUCCESS;
+    }
+    if (gateway_open(&pipeline.gateway, count, options->gateway_group, options->gateway_port) != EXIT_SUCCESS)
+    {
+        printf("Couldn't open the gateway\n");
+        return EXIT_FAILURE;
+    }
+    pipeline.gateway_enabled = true;
+    if (options->gateway_group != NULL)
+    {
+        printf("Forwarding the frames to the multicast group %s\n", options->gateway_group);
+    }
+    if (options->gateway_port != 0)
+    {
+        printf("Forwarding the frames to the subscribers of TCP port %u\n", options->gateway_port);
+    }
+    return EXIT_SUCCESS;
+}
+
+/** Close the gateway, the serial ports shall not be read anymore */
+static void pipeline_close_gateway(void)
+{
+    if (pipeline.gateway_enabled)
+    {
+        gateway_close(&pipeline.gateway);
+        pipeline.gateway_enabled = false;
+        printf("%llu frames forwarded in %llu datagrams, %llu subscribers, %llu disconnected for being too slow\n",
+               (unsigned long long)pipeline.gateway.frames, (unsigned long long)pipeline.gateway.datagrams,
+               (unsigned long long)pipeline.gateway.accepted, (unsigned long long)pipeline.gateway.disconnected);
+        if (pipeline.gateway.send_errors > 0)
+        {
+            printf("%llu datagrams couldn't be sent to the multicast group\n", (unsigned long long)pipeline.gateway.send_errors);
+        }
+    }
+}
+
+/** Print the stats line of every port */
+static void pipeline_print_stats(pipeline_t *state)
+{
+    char line[4096];
+
+    for (size_t port = 0; port < state->report.port_count; port++)
+    {
+        adc_metrics_report_line(&state->report, port, line, sizeof(line));
+        fprintf(stderr, "%s\n", line);
+    }
+}
+
+/** Update the metrics periodically, print the stats lines and answer the metrics requests */
+static void *pipeline_stats(void *arg)
+{
+    pipeline_t *state = (pipeline_t *)arg;
+    uint32_t period_s = (state->options->stats_period_s > 0) ? state->options->stats_period_s : METRICS_PERIOD_S;
+    uint64_t next_update_ns = adc_event_now_ns() + (uint64_t)period_s * 1000000000u;
+    char *text = malloc(METRICS_TEXT_LENGTH);
+
+    adc_metrics_report_update(&state->report, adc_event_now_ns());
+
+    while (__atomic_load_n(&state->stop, __ATOMIC_ACQUIRE) == 0)
+    {
+        uint64_t now = adc_event_now_ns();
+        if (now >= next_update_ns)
+        {
+            adc_metrics_report_update(&state->report, now);
+            if (state->options->stats_period_s > 0)
+            {
+                pipeline_print_stats(state);
+            }
+            next_update_ns += (uint64_t)period_s * 1000000000u;
+        }
+
+        // Woken up regularly to notice the end of the program
+        int client = metrics_server_accept(&state->metrics_server, CONSUMER_WAIT_MS);
+        if (client >= 0)
+        {
+            size_t length = (text != NULL) ? adc_metrics_report_prometheus(&state->report, text, METRICS_TEXT_LENGTH) : 0;
+            metrics_server_reply(client, text, length);
+        }
+        else if (state->metrics_server.fd < 0)
+        {
+            struct timespec wait = {.tv_sec = 0, .tv_nsec = CONSUMER_WAIT_MS * 1000000L};
+            nanosleep(&wait, NULL);
+        }
+    }
+
+    free(text);
+    return NULL;
+}
+
+/** Start the stats thread if requested by the options, latency is NULL if not traced */
+static int32_t pipeline_start_stats(const char *const names[], const adc_metrics_t *const metrics[],
+                                    const latency_histogram_t *const latency[], size_t count)
+{
+    const pipeline_options_t *options = pipeline.options;
+    const latest_table_t *tables[PIPELINE_MAX_PORTS];
+
+    pipeline.metrics_server.fd = -1;
+    if ((options->stats_period_s == 0) && (options->metrics_port == 0))
+    {
+        return EXIT_SUCCESS;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        tables[i] = &pipeline.latest[i];
+    }
+    adc_metrics_report_init(&pipeline.report, names, metrics, tables, count);
+    if (latency != NULL)
+    {
+        adc_metrics_report_set_latency(&pipeline.report, latency);
+    }
+
+    if (options->metrics_port != 0)
+    {
+        if (metrics_server_open(&pipeline.metrics_server, options->metrics_port) != EXIT_SUCCESS)
+        {
+            printf("Couldn't serve the metrics on port %u\n", options->metrics_port);
+            return EXIT_FAILURE;
+        }
+        printf("Serving the metrics on http://127.0.0.1:%u/metrics\n", options->metrics_port);
+    }
+
+    if (pthread_create(&pipeline.stats_thread, NULL, pipeline_stats, &pipeline) != 0)
+    {
+        metrics_server_close(&pipeline.metrics_server);
+        return EXIT_FAILURE;
+    }
+    pipeline.stats_running = true;
+    return EXIT_SUCCESS;
+}
+
+/** Stop the stats thread, pipeline.stop shall be set, and print the final stats lines */
+static void pipeline_stop_stats(void)
+{
+    if (pipeline.stats_running)
+    {
+        pthread_join(pipeline.stats_thread, NULL);
+        metrics_server_close(&pipeline.metrics_server);
+        pipeline.stats_running = false;
+
+        if (pipeline.options->stats_period_s > 0)
+        {
+            adc_metrics_report_update(&pipeline.report, adc_event_now_ns());
+            pipeline_print_stats(&pipeline);
+        }
+    }
+}
+
+/** Allocate the latency histograms of every port if requested by the options */
+static int32_t pipeline_open_latency(size_t count)
+{
+    if (pipeline.options->latency)
+    {
+        pipeline.latency = calloc(count, sizeof(*pipeline.latency));
+        if (pipeline.latency == NULL)
+        {
+            printf("Not enough memory\n");
+            return EXIT_FAILURE;
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            pipeline.ports[i].latency = pipeline.latency[i];
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+/** Print the latency percentiles of every stage of every port */
+static void pipeline_close_latency(size_t count)
+{
+    if (pipeline.latency == NULL)
+    {
+        return;
+    }
+
+    for (size_t port = 0; port < count; port++)
+    {
+        printf("Latency of %s in ms     count       p50       p90       p99     p99.9       max\n", pipeline.options->ports[port]);
+        for (uint32_t stage = 0; stage < LATENCY_STAGE_COUNT; stage++)
+        {
+            latency_summary_t summary;
+            latency_summarize(&pipeline.latency[port][stage], &summary);
+            printf("  %-8s %14llu %9.3f %9.3f %9.3f %9.3f %9.3f\n", latency_stage_name((latency_stage_t)stage),
+                   (unsigned long long)summary.count, (double)summary.p50 / 1e6, (double)summary.p90 / 1e6,
+                   (double)summary.p99 / 1e6, (double)summary.p999 / 1e6, (double)summary.max / 1e6);
+        }
+    }
+    free(pipeline.latency);
+    pipeline.latency = NULL;
+}
+
+const latest_table_t *pipeline_latest_table(size_t port)
+{
+    return &pipeline.latest[port];
+}
+
+int32_t pipeline_run(const pipeline_options_t *options)
+{
+    acquisition_t acquisition;
+    pthread_t consumer;
+    int32_t return_code = EXIT_FAILURE;
+    size_t opened = 0;
+    size_t rings = 0;
+
+    pipeline_reset(options);
+    event_ring_notifier_init(&pipeline.notifier);
+
+    if ((pipeline_open_resample() != EXIT_SUCCESS) || (pipeline_open_history(options->port_count) != EXIT_SUCCESS))
+    {
+        return EXIT_FAILURE;
+    }
+
+    if (pipeline_open_shm(options->ports, options->port_count) != EXIT_SUCCESS)
+    {
+        pipeline_close_history(options->ports);
+        return EXIT_FAILURE;
+    }
+    if (pipeline_open_sink() != EXIT_SUCCESS)
+    {
+        pipeline_close_history(options->ports);
+        pipeline_close_shm();
+        return EXIT_FAILURE;
+    }
+    if (pipeline_open_store(options->ports, options->port_count) != EXIT_SUCCESS)
+    {
+        pipeline_close_history(options->ports);
+        pipeline_close_sink();
+        pipeline_close_shm();
+        return EXIT_FAILURE;
+    }
+
+    for (; opened < options->port_count; opened++)
+    {
+        serial_port_t *serial = &pipeline.ports[opened].serial;
+        snprintf(serial->com_port, sizeof(serial->com_port), "%s", options->ports[opened]);
+        serial->baudrate = options->baudrate;
+        serial->fd = -1;
+
+        if (serial_open(serial) != EXIT_SUCCESS)
+        {
+            printf("Couldn't open %s\n", serial->com_port);
+            break;
+        }
+        printf("Starting on %s @ B%d\n", serial->com_port, serial->baudrate);
+    }
+
+    for (; (opened == options->port_count) && (rings < opened); rings++)
+    {
+        if (event_ring_init(&pipeline.rings[rings], options->queue_length, options->overflow, &pipeline.notifier) != EXIT_SUCCESS)
+        {
+            printf("Not enough memory\n");
+            break;
+        }
+        pipeline.ring_list[rings] = &pipeline.rings[rings];
+    }
+
+    // The stop signals are received by the acquisition engine only, through a signalfd: block them
+    // before any thread is started so that every thread inherits the mask
+    sigset_t stop_signals;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, NULL);
+
+    if ((rings == options->port_count) && (pipeline_open_captures() == EXIT_SUCCESS) && (pipeline_open_gateway(opened) == EXIT_SUCCESS) &&
+        (acquisition_init(&acquisition, pipeline.ports, opened, options->threads, options->pin_threads, pipeline_push, &pipeline) == EXIT_SUCCESS) &&
+        (pipeline_open_latency(opened) == EXIT_SUCCESS))
+    {
+        if (pipeline.capture_count > 0)
+        {
+            acquisition.raw_handler = pipeline_capture;
+        }
+
+        const adc_metrics_t *metrics[PIPELINE_MAX_PORTS];
+        const latency_histogram_t *latency[PIPELINE_MAX_PORTS];
+        for (size_t i = 0; i < opened; i++)
+        {
+            metrics[i] = &pipeline.ports[i].metrics;
+            latency[i] = pipeline.ports[i].latency;
+        }
+
+        printf("Hit Ctrl-C to exit\n\n");
+        pipeline_set_ports(&pipeline, options->ports, opened);
+        pipeline_open_dashboard(&pipeline, options->ports, opened);
+
+        if ((pipeline_start_stats(options->ports, metrics, (pipeline.latency != NULL) ? latency : NULL, opened) == EXIT_SUCCESS) &&
+            (pthread_create(&consumer, NULL, pipeline_consumer, &pipeline) == 0))
+        {
+            return_code = acquisition_run(&acquisition);
+
+            // The readers are stopped, let the consumer empty the rings
+            for (size_t i = 0; i < rings; i++)
+            {
+                event_ring_close(&pipeline.rings[i]);
+            }
+            __atomic_store_n(&pipeline.stop, 1, __ATOMIC_RELEASE);
+            event_ring_wake(&pipeline.notifier);
+            pthread_join(consumer, NULL);
+        }
+        __atomic_store_n(&pipeline.stop, 1, __ATOMIC_RELEASE);
+        pipeline_close_dashboard(&pipeline);
+        pipeline_stop_stats();
+        acquisition_close(&acquisition);
+
+        for (size_t i = 0; i < opened; i++)
+        {
+            if (pipeline.ports[i].failed)
+            {
+                printf("Error reading %s\n", pipeline.ports[i].serial.com_port);
+            }
+            if (event_ring_dropped(&pipeline.rings[i]) > 0)
+            {
+                printf("%llu messages of %s dropped, the output was too slow\n",
+                       (unsigned long long)event_ring_dropped(&pipeline.rings[i]), pipeline.ports[i].serial.com_port);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < rings; i++)
+    {
+        event_ring_free(&pipeline.rings[i]);
+    }
+    for (size_t i = 0; i < opened; i++)
+    {
+        serial_close(&pipeline.ports[i].serial);
+    }
+    pipeline_close_gateway();
+    pipeline_close_latency(opened);
+    pipeline_close_history(options->ports);
+    pipeline_close_captures();
+    pipeline_close_store();
+    pipeline_close_sink();
+    pipeline_close_shm();
+
+    return return_code;
+}
+
+/** Set by SIGINT or SIGTERM to stop a replay */
+static volatile sig_atomic_t replay_stop;
+
+static void pipeline_replay_signal(int signal_number)
+{
+    (void)signal_number;
+    replay_stop = 1;
+}
+
+/** Stop a replay or a query at the first SIGINT or SIGTERM */
+static void pipeline_catch_stop(void)
+{
+    struct sigaction action;
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = pipeline_replay_signal;
+    sigemptyset(&action.sa_mask);
+    replay_stop = 0;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+}
+
+static void pipeline_release_stop(void)
+{
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+}
+
+/** Wait until the monotonic time has been reached, interrupted by the stop signals */
+static void pipeline_sleep_until(uint64_t time_ns)
+{
+    struct timespec deadline = {
+        .tv_sec = (time_t)(time_ns / 1000000000u),
+        .tv_nsec = (long)(time_ns % 1000000000u)};
+
+    while ((replay_stop == 0) && (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) != 0))
+    {
+    }
+}
+
+/** Consume the messages of one job of the parallel decoder, chunk by chunk as when replayed on a single thread */
+static void pipeline_replay_job(const adc_event_t events[], size_t count, void *user)
+{
+    uint64_t *messages = user;
+    size_t first = 0;
+
+    while (first < count)
+    {
+        // The messages of a chunk share the time at which it has been recorded
+        uint64_t timestamp_ns = events[first].timestamp_ns;
+        size_t last = first + 1;
+        while ((last < count) && (events[last].timestamp_ns == timestamp_ns))
+        {
+            last++;
+        }
+
+        pipeline_poll_cycles(&pipeline, timestamp_ns);
+        pipeline_poll_rows(&pipeline, timestamp_ns);
+        pipeline_expire_history(&pipeline, timestamp_ns);
+        for (size_t i = first; i < last; i++)
+        {
+            latest_table_update(&pipeline.latest[0], &events[i]);
+        }
+        pipeline_consume(&pipeline, &events[first], last - first);
+        first = last;
+    }
+    *messages += count;
+    pipeline_refresh_dashboard(&pipeline, false);
+}
+
+int32_t pipeline_replay(const pipeline_options_t *options)
+{
+    capture_reader_t reader;
+    adc_rs485_decoder_t decoder;
+    static adc_rs485_msg_t msgs[REPLAY_BATCH_LENGTH];
+    static adc_event_t events[REPLAY_BATCH_LENGTH];
+    const uint8_t *data;
+    size_t length;
+    uint64_t timestamp_ns;
+    uint64_t bytes = 0;
+    uint64_t messages = 0;
+
+    pipeline_reset(options);
+
+    if (pipeline_open_resample() != EXIT_SUCCESS)
+    {
+        return EXIT_FAILURE;
+    }
+    if (capture_reader_open(&reader, options->replay_path) != EXIT_SUCCESS)
+    {
+        printf("Couldn't read the capture file %s\n", options->replay_path);
+        return EXIT_FAILURE;
+    }
+
+    const char *device = reader.header.device;
+    if (pipeline_open_history(1) != EXIT_SUCCESS)
+    {
+        capture_reader_close(&reader);
+        return EXIT_FAILURE;
+    }
+    if (pipeline_open_shm(&device, 1) != EXIT_SUCCESS)
+    {
+        pipeline_close_history(&device);
+        capture_reader_close(&reader);
+        return EXIT_FAILURE;
+    }
+    if (pipeline_open_sink() != EXIT_SUCCESS)
+    {
+        pipeline_close_history(&device);
+        capture_reader_close(&reader);
+        pipeline_close_shm();
+        return EXIT_FAILURE;
+    }
+    if (pipeline_open_store(&device, 1) != EXIT_SUCCESS)
+    {
+        pipeline_close_history(&device);
+        capture_reader_close(&reader);
+        pipeline_close_sink();
+        pipeline_close_shm();
+        return EXIT_FAILURE;
+    }
+
+    printf("Replaying %s, recorded on %s @ B%u\n", options->replay_path, device, reader.header.baudrate);
+    printf("Hit Ctrl-C to exit\n\n");
+    pipeline_set_ports(&pipeline, &device, 1);
+    pipeline_open_dashboard(&pipeline, &device, 1);
+
+    const adc_metrics_t *metrics = &pipeline.replay_metrics;
+    if (pipeline_start_stats(&device, &metrics, NULL, 1) != EXIT_SUCCESS)
+    {
+        pipeline_close_dashboard(&pipeline);
+        pipeline_close_history(&device);
+        capture_reader_close(&reader);
+        pipeline_close_store();
+        pipeline_close_sink();
+        pipeline_close_shm();
+        return EXIT_FAILURE;
+    }
+
+    pipeline_catch_stop();
+
+    // The original timing is reproduced relative to the start of the replay
+    uint64_t offset_ns = adc_event_now_ns() - reader.header.start_monotonic_ns;
+
+    // Decoded on several threads as fast as possible, the timing can only be reproduced on one
+    bool parallel = (options->replay_jobs > 1) && !options->replay_realtime;
+    int32_t return_code = EXIT_SUCCESS;
+    if (parallel)
+    {
+        return_code = parallel_decode_capture(&reader, options->replay_jobs, 0, &pipeline.replay_metrics, pipeline_replay_job,
+                                              &messages, &replay_stop);
+        if (return_code != EXIT_SUCCESS)
+        {
+            printf("Couldn't decode the capture file on %u threads\n", options->replay_jobs);
+        }
+        bytes = pipeline.replay_metrics.bytes;
+    }
+
+    adc_rs485_decoder_init(&decoder);
+    while (!parallel && (replay_stop == 0) && capture_reader_next(&reader, &data, &length, &timestamp_ns))
+    {
+        if (options->replay_realtime)
+        {
+            pipeline_sleep_until(timestamp_ns + offset_ns);
+        }
+        size_t chunk_length = length;
+        bytes += length;
+        pipeline_poll_cycles(&pipeline, timestamp_ns);
+        pipeline_poll_rows(&pipeline, timestamp_ns);
+        pipeline_expire_history(&pipeline, timestamp_ns);
+
+        while (length > 0)
+        {
+            size_t consumed = 0;
+            size_t count = adc_rs485_decoder_decode_buffer_simd(&decoder, data, length, msgs, REPLAY_BATCH_LENGTH, &consumed);
+
+            adc_metrics_count_msgs(&pipeline.replay_metrics, msgs, count);
+
+            // The messages keep the time at which they have been recorded
+            for (size_t i = 0; i < count; i++)
+            {
+                adc_event_from_msg(&events[i], &msgs[i], 0, timestamp_ns);
+                latest_table_update(&pipeline.latest[0], &events[i]);
+            }
+            pipeline_consume(&pipeline, events, count);
+            messages += count;
+            data += consumed;
+            length -= consumed;
+        }
+        adc_metrics_count_bytes(&pipeline.replay_metrics, &decoder, chunk_length);
+        pipeline_refresh_dashboard(&pipeline, false);
+    }
+    pipeline_flush_cycles(&pipeline);
+    pipeline_flush_rows(&pipeline);
+    __atomic_store_n(&pipeline.stop, 1, __ATOMIC_RELEASE);
+    pipeline_close_dashboard(&pipeline);
+    pipeline_stop_stats();
+
+    pipeline_release_stop();
+
+    printf("%llu bytes, %llu messages replayed\n", (unsigned long long)bytes, (unsigned long long)messages);
+
+    pipeline_close_history(&device);
+    capture_reader_close(&reader);
+    pipeline_close_store();
+    pipeline_close_sink();
+    pipeline_close_shm();
+    return return_code;
+}
+
+/** Select the streams read from a store file from the options, the statuses are always read */
+static int32_t pipeline_parse_streams(bool selected[ADC_STORE_STREAMS])
+{
+    const char *labels = pipeline.options->query_labels;
+
+    for (uint32_t stream = 0; stream < ADC_STORE_STREAMS; stream++)
+    {
+        selected[stream] = (labels == NULL) || (stream >= RS485_DATA_NOT_VALID);
+    }
+
+    while ((labels != NULL) && (*labels != '\0'))
+    {
+        size_t length = strcspn(labels, ",");
+        bool found = false;
+
+        for (uint32_t type = 0; type < RS485_DATA_NOT_VALID; type++)
+        {
+            const char *name = adc_event_label_name(type);
+            if ((strlen(name) == length) && (strncmp(labels, name, length) == 0))
+            {
+                selected[type] = true;
+                found = true;
+            }
+        }
+        if (!found)
+        {
+            printf("Unknown label %.*s\n", (int)length, labels);
+            return EXIT_FAILURE;
+        }
+        labels += (labels[length] == ',') ? length + 1 : length;
+    }
+    return EXIT_SUCCESS;
+}
+
+int32_t pipeline_query(const pipeline_options_t *options)
+{
+    static adc_store_reader_t reader;
+    static adc_store_cursor_t cursors[ADC_STORE_MAX_PORTS * ADC_STORE_STREAMS];
+    static adc_event_t next[ADC_STORE_MAX_PORTS * ADC_STORE_STREAMS];
+    static adc_event_t events[REPLAY_BATCH_LENGTH];
+    const char *names[ADC_STORE_MAX_PORTS];
+    bool selected[ADC_STORE_STREAMS];
+    size_t cursor_count = 0;
+    uint64_t messages = 0;
+
+    pipeline_reset(options);
+
+    if ((pipeline_open_resample() != EXIT_SUCCESS) || (pipeline_parse_streams(selected) != EXIT_SUCCESS))
+    {
+        return EXIT_FAILURE;
+    }
+    if (adc_store_reader_open(&reader, options->query_path) != EXIT_SUCCESS)
+    {
+        printf("Couldn't read the store file %s\n", options->query_path);
+        return EXIT_FAILURE;
+    }
+
+    size_t port_count = reader.header.port_count;
+    for (size_t i = 0; i < port_count; i++)
+    {
+        names[i] = reader.header.devices[i];
+    }
+    if (pipeline_open_history(port_count) != EXIT_SUCCESS)
+    {
+        adc_store_reader_close(&reader);
+        return EXIT_FAILURE;
+    }
+    if ((pipeline_open_sink() != EXIT_SUCCESS) || (pipeline_open_store(names, port_count) != EXIT_SUCCESS))
+    {
+        pipeline_close_history(names);
+        pipeline_close_sink();
+        adc_store_reader_close(&reader);
+        return EXIT_FAILURE;
+    }
+
+    printf("Reading %s, %zu blocks of %zu ports\n", options->query_path, reader.block_count, port_count);
+    printf("Hit Ctrl-C to exit\n\n");
+    pipeline_set_ports(&pipeline, names, port_count);
+    pipeline_open_dashboard(&pipeline, names, port_count);
+    pipeline_catch_stop();
+
+    // The range is relative to the first message of the file, replayed messages are older than the file
+    uint64_t from_ns = reader.first_ns + (uint64_t)options->query_from_s * 1000000000u;
+    uint64_t to_ns = (options->query_to_s > 0) ? reader.first_ns + (uint64_t)options->query_to_s * 1000000000u : UINT64_MAX;
+
+    for (size_t port = 0; port < port_count; port++)
+    {
+        for (uint32_t stream = 0; stream < ADC_STORE_STREAMS; stream++)
+        {
+            if (selected[stream])
+            {
+                adc_store_cursor_init(&cursors[cursor_count], &reader, (uint8_t)port, (uint8_t)stream, from_ns, to_ns, -INFINITY, INFINITY);
+                if (adc_store_cursor_next(&cursors[cursor_count], &next[cursor_count]))
+                {
+                    cursor_count++;
+                }
+            }
+        }
+    }
+
+    // The streams are merged in the order of the time of their messages
+    while ((replay_stop == 0) && (cursor_count > 0))
+    {
+        size_t count = 0;
+
+        while ((count < REPLAY_BATCH_LENGTH) && (cursor_count > 0))
+        {
+            size_t oldest = 0;
+            for (size_t i = 1; i < cursor_count; i++)
+            {
+                if (next[i].timestamp_ns < next[oldest].timestamp_ns)
+                {
+                    oldest = i;
+                }
+            }
+
+            events[count] = next[oldest];
+            latest_table_update(&pipeline.latest[events[count].port], &events[count]);
+            count++;
+            if (!adc_store_cursor_next(&cursors[oldest], &next[oldest]))
+            {
+                // The stream is complete, the last one takes its place
+                cursor_count--;
+                cursors[oldest] = cursors[cursor_count];
+                next[oldest] = next[cursor_count];
+            }
+        }
+
+        pipeline_poll_cycles(&pipeline, events[0].timestamp_ns);
+        pipeline_poll_rows(&pipeline, events[0].timestamp_ns);
+        pipeline_expire_history(&pipeline, events[0].timestamp_ns);
+        pipeline_consume(&pipeline, events, count);
+        messages += count;
+        pipeline_refresh_dashboard(&pipeline, false);
+    }
+    pipeline_flush_cycles(&pipeline);
+    pipeline_flush_rows(&pipeline);
+    pipeline_close_dashboard(&pipeline);
+    pipeline_release_stop();
+
+    printf("%llu messages read\n", (unsigned long long)messages);
+
+    pipeline_close_history(names);
+    pipeline_close_store();
+    pipeline_close_sink();
+    adc_store_reader_close(&reader);
+    return EXIT_SUCCESS;
+}
+
+/** Decode the frames of one datagram received from a gateway */
+static size_t pipeline_decode_datagram(uint8_t port, const uint8_t data[], size_t length, uint64_t now_ns)
+{
+    acquisition_port_t *source = &pipeline.ports[port];
+    adc_rs485_msg_t msgs[EVENT_BATCH_LENGTH];
+    adc_event_t events[EVENT_BATCH_LENGTH];
+    size_t chunk_length = length;
+    size_t messages = 0;
+
+    while (length > 0)
+    {
+        size_t consumed = 0;
+        size_t count = adc_rs485_decoder_decode_buffer_simd(&source->decoder, data, length, msgs, EVENT_BATCH_LENGTH, &consumed);
+
+        adc_metrics_count_msgs(&source->metrics, msgs, count);
+        for (size_t i = 0; i < count; i++)
+        {
+            adc_event_from_msg(&events[i], &msgs[i], port, now_ns);
+            latest_table_update(&pipeline.latest[port], &events[i]);
+        }
+        pipeline_consume(&pipeline, events, count);
+        messages += count;
+        data += consumed;
+        length -= consumed;
+    }
+    adc_metrics_count_bytes(&source->metrics, &source->decoder, chunk_length);
+    return messages;
+}
+
+int32_t pipeline_subscribe(const pipeline_options_t *options)
+{
+    static gateway_client_t client;
+    static char names[PIPELINE_MAX_PORTS][128];
+    const char *name_list[PIPELINE_MAX_PORTS];
+    const adc_metrics_t *metrics[PIPELINE_MAX_PORTS];
+    uint8_t data[GATEWAY_MAX_PAYLOAD];
+    size_t length = 0;
+    uint8_t port = 0;
+    uint64_t messages = 0;
+    bool tcp = (options->subscribe_address != NULL);
+    const char *source = tcp ? options->subscribe_address : options->subscribe_group;
+
+    pipeline_reset(options);
+
+    if (pipeline_open_resample() != EXIT_SUCCESS)
+    {
+        return EXIT_FAILURE;
+    }
+    if ((tcp ? gateway_client_connect(&client, source) : gateway_client_join(&client, source)) != EXIT_SUCCESS)
+    {
+        printf("Couldn't receive from the gateway %s\n", source);
+        return EXIT_FAILURE;
+    }
+    client.read_timeout_ms = CONSUMER_WAIT_MS;
+
+    printf("Waiting for the gateway %s\n", source);
+    pipeline_catch_stop();
+
+    // The number of serial ports of the gateway is known from its first datagram
+    int32_t return_code = EXIT_SUCCESS;
+    while ((replay_stop == 0) && (return_code == EXIT_SUCCESS) && (client.port_count == 0))
+    {
+        return_code = gateway_client_read(&client, data, &length, &port);
+    }
+    if (client.port_count == 0)
+    {
+        pipeline_release_stop();
+        gateway_client_close(&client);
+        return (replay_stop != 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    size_t port_count = (client.port_count < PIPELINE_MAX_PORTS) ? client.port_count : PIPELINE_MAX_PORTS;
+    for (size_t i = 0; i < port_count; i++)
+    {
+        snprintf(names[i], sizeof(names[i]), "%s#%zu", source, i);
+        name_list[i] = names[i];
+        metrics[i] = &pipeline.ports[i].metrics;
+        adc_rs485_decoder_init(&pipeline.ports[i].decoder);
+    }
+
+    if (pipeline_open_history(port_count) != EXIT_SUCCESS)
+    {
+        pipeline_release_stop();
+        gateway_client_close(&client);
+        return EXIT_FAILURE;
+    }
+    if ((pipeline_open_shm(name_list, port_count) != EXIT_SUCCESS) || (pipeline_open_sink() != EXIT_SUCCESS) ||
+        (pipeline_open_store(name_list, port_count) != EXIT_SUCCESS) ||
+        (pipeline_start_stats(name_list, metrics, NULL, port_count) != EXIT_SUCCESS))
+    {
+        pipeline_release_stop();
+        pipeline_close_history(name_list);
+        gateway_client_close(&client);
+        pipeline_close_store();
+        pipeline_close_sink();
+        pipeline_close_shm();
+        return EXIT_FAILURE;
+    }
+
+    printf("Receiving %zu serial ports from the gateway %s\n", port_count, source);
+    printf("Hit Ctrl-C to exit\n\n");
+    pipeline_set_ports(&pipeline, name_list, port_count);
+    pipeline_open_dashboard(&pipeline, name_list, port_count);
+
+    while ((replay_stop == 0) && (return_code == EXIT_SUCCESS))
+    {
+        // The messages get the time at which they have been received from the network
+        uint64_t now = adc_event_now_ns();
+        pipeline_poll_cycles(&pipeline, now);
+        pipeline_poll_rows(&pipeline, now);
+        pipeline_expire_history(&pipeline, now);
+        if ((length > 0) && (port < port_count))
+        {
+            messages += pipeline_decode_datagram(port, data, length, now);
+        }
+        pipeline_refresh_dashboard(&pipeline, false);
+
+        return_code = gateway_client_read(&client, data, &length, &port);
+    }
+    if (replay_stop != 0)
+    {
+        return_code = EXIT_SUCCESS;
+    }
+    else
+    {
+        printf("Connection to the gateway %s lost\n", source);
+    }
+    pipeline_flush_cycles(&pipeline);
+    pipeline_flush_rows(&pipeline);
+    __atomic_store_n(&pipeline.stop, 1, __ATOMIC_RELEASE);
+    pipeline_close_dashboard(&pipeline);
+    pipeline_stop_stats();
+
+    pipeline_release_stop();
+
+    printf("%llu datagrams, %llu messages received, %llu datagrams lost\n", (unsigned long long)client.datagrams,
+           (unsigned long long)messages, (unsigned long long)client.lost);
+
+    pipeline_close_history(name_list);
+    gateway_client_close(&client);
+    pipeline_close_store();
+    pipeline_close_sink();
+    pipeline_close_shm();
+    return return_code;
+}
@@ -0,0 +1,139 @@
+/**
+* This module connects the stages of the decoder program on a Linux machine: the serial ports are
+* read and decoded by the acquisition engine, the decoded messages are handed through one lock-free
+* ring per port to a consumer thread, which prints them or shows them on a dashboard.
+*
+* A slow consumer, such as the terminal, never stalls the serial reads: when a ring is full, its
+* overflow policy decides which messages are dropped and the drops are counted.
+*
+* The worker threads also keep a table of the latest value of every label, per port, that other
+* threads can read at any time without going through the message stream. Optionally, these tables
+* and a ring of the recent messages are published in shared memory for other processes.
+*
+* The raw bytes received can be recorded into capture files and decoded again later. The decoded
+* messages can be archived into compressed store files, whose time ranges can be read back quickly.
+*
+* The frames received can be forwarded over the network to other machines, where another instance of
+* the program decodes them as if it read the serial ports.
+*
+* The consumer can keep the recent values of every label, to show their statistics over a sliding
+* window on the dashboard and at exit.
+*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*
+* Example code only. Use at own risk.
+*
+* This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+* even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+*
+* Simtec AG has no obligation to provide maintenance, support,  updates, enhancements, or modifications.
+*/
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "event_ring.h"
+#include "latest_table.h"
+#include "output_sink.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Maximum number of serial ports that can be read at the same time */
+#define PIPELINE_MAX_PORTS 64
+
+/** Options of the decoder program */
+typedef struct
+{
+    const char *ports[PIPELINE_MAX_PORTS]; /**< Serial ports to read */
+    size_t port_count;
+    uint32_t baudrate;
+    uint32_t threads;                      /**< Number of worker threads reading the serial ports */
+    bool pin_threads;                      /**< Pin every worker thread to its own CPU */
+    size_t queue_length;                   /**< Number of messages each ring can hold */
+    event_ring_overflow_t overflow;        /**< What to do when the consumer is too slow */
+    const char *shm_name;                  /**< Name of the shared memory segment, NULL for none */
+    size_t shm_ring_length;                /**< Number of recent messages kept in shared memory */
+    const char *capture_path;              /**< File recording the raw bytes received, NULL for none */
+    const char *replay_path;               /**< Capture file decoded instead of the serial ports */
+    bool replay_realtime;                  /**< Replay the capture file at its original timing */
+    uint32_t replay_jobs;                  /**< Threads decoding the capture file, unless replayed at its original timing */
+    const char *store_path;                /**< Store file the decoded messages are archived into, NULL for none */
+    const char *query_path;                /**< Store file read instead of the serial ports */
+    uint32_t query_from_s;                 /**< Start of the messages read from the store file, in seconds after its first message */
+    uint32_t query_to_s;                   /**< End of the messages read from the store file, 0 for the end of the file */
+    const char *query_labels;              /**< Comma-separated labels read from the store file, NULL for all */
+    bool dashboard;                        /**< Show a dashboard of the latest values instead of the messages */
+    uint32_t refresh_hz;                   /**< Refresh rate of the dashboard */
+    output_format_t output_format;         /**< Format of the messages written */
+    const char *output_path;               /**< File the messages are written to, NULL for output_fd */
+    int output_fd;                         /**< File descriptor the messages are written to without output_path */
+    bool cycles;                           /**< Write one cycle of every air data computer instead of every message */
+    uint32_t cycle_timeout_ms;             /**< Maximum duration of a cycle whose general status is lost */
+    uint32_t resample_hz;                  /**< Write the labels at this fixed rate instead of every message, 0 for none */
+    const char *interpolate;               /**< Comma-separated labels interpolated instead of held, "all", or NULL */
+    uint32_t stale_ms;                     /**< Age after which a label resampled is invalid, 0 for never */
+    uint32_t resample_delay_ms;            /**< Time after its instant at which a row is written, 0 for one period */
+    uint32_t window_s;                     /**< Window of the statistics of the labels in seconds, 0 for none */
+    const char *history;                   /**< Values kept per label: n for all labels, or comma-separated label=n, or NULL */
+    uint32_t stats_period_s;               /**< Period of the stats line of every port, 0 for none */
+    uint16_t metrics_port;                 /**< TCP port of the local Prometheus endpoint, 0 for none */
+    bool latency;                          /**< Trace the latency of every message through the stages */
+    const char *gateway_group;             /**< Multicast group the frames are forwarded to, as "address:port", NULL for none */
+    uint16_t gateway_port;                 /**< TCP port on which the frames are forwarded to the subscribers, 0 for none */
+    const char *subscribe_address;         /**< Gateway read through TCP instead of the serial ports, as "host:port" */
+    const char *subscribe_group;           /**< Multicast group of a gateway read instead of the serial ports */
+} pipeline_options_t;
+
+/**
+ * Read, decode and print the messages of all serial ports until Ctrl-C is hit.
+ *
+ * @param[in]   options     Options of the program.
+ *
+ * @return EXIT_FAILURE if a serial port couldn't be opened or read, EXIT_SUCCESS otherwise.
+ */
+int32_t pipeline_run(const pipeline_options_t *options);
+
+/**
+ * Returns the table of the latest values received on a serial port. The table is updated by the
+ * thread reading the port and can be read from any thread while pipeline_run() runs.
+ *
+ * @param[in]   port    Index of the serial port in the options.
+ *
+ * @return Table of the latest values of the serial port.
+ */
+const latest_table_t *pipeline_latest_table(size_t port);
+
+/**
+ * Decode and print the messages of a capture file, either as fast as possible or at the timing at
+ * which the bytes have been received.
+ *
+ * @param[in]   options     Options of the program, with the path of the capture file.
+ *
+ * @return EXIT_FAILURE if the capture file couldn't be read, EXIT_SUCCESS otherwise.
+ */
+int32_t pipeline_replay(const pipeline_options_t *options);
+
+/**
+ * Read back the messages archived in a store file within a time range and handle them as if they
+ * were received, in the order of their time. The statuses are always read.
+ *
+ * @param[in]   options     Options of the program, with the path of the store file.
+ *
+ * @return EXIT_FAILURE if the store file couldn't be read, EXIT_SUCCESS otherwise.
+ */
+int32_t pipeline_query(const pipeline_options_t *options);
+
+/**
+ * Decode and print the frames forwarded by a gateway, through TCP or from a multicast group, until
+ * Ctrl-C is hit or until the connection is lost.
+ *
+ * @param[in]   options     Options of the program, with the address of the gateway.
+ *
+ * @return EXIT_FAILURE if the gateway couldn't be reached or the connection has been lost,
+ * EXIT_SUCCESS otherwise.
+ */
+int32_t pipeline_subscribe(const pipeline_options_t *options);
+
+#endif
@@ -5,165 +5,253 @@
 
 #include "print_msg.h"
 #include "adc_rs485_decoder.h"
+#include "adc_rs485_labels.h"
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
+#include <stddef.h>
 #include <stdint.h>
 
-/** Flag string representation */
-static char *flag_str[] = {
-    [FLAG_VALID] = "valid",
-    [FLAG_RANGE_ABOVE] = "range+",
-    [FLAG_RANGE_BELLOW] = "range-",
-    [FLAG_INVALID_POS] = "invalid+",
-    [FLAG_INVALID_NEG] = "invalid-",
-    [FLAG_INVALID] = "invalid"};
+/** Degree sign, in the code page of the terminals */
+#define DEG "\xF8"
 
-static void print_air_data(air_data_t *air_data)
+/** Largest value scaled to its precision that is formatted in fixed point, below 2^53 */
+#define FIXED_MAX 1e15
+
+/** Text printed around the value of a type of data */
+typedef struct
+{
+    const char *name;       /**< Text before the value */
+    uint8_t name_length;
+    uint8_t width;          /**< Minimum number of characters of the value, right-aligned */
+    uint8_t precision;      /**< Number of decimals of the value, at most 3 */
+    const char *unit;       /**< Text between the value and the flag */
+    uint8_t unit_length;
+} print_label_t;
+
+#define LABEL(name, width, precision, unit) {name, sizeof(name) - 1u, width, precision, unit, sizeof(unit) - 1u}
+
+/** Text of every type of data */
+static const print_label_t PRINT_LABEL[RS485_DATA_NOT_VALID] = {
+    [RS485_QC] = LABEL("Qc   = ", 9, 1, " [Pa]  ("),
+    [RS485_PS] = LABEL("Ps   = ", 9, 1, " [Pa]  ("),
+    [RS485_AOA] = LABEL("AoA  = ", 9, 3, " [" DEG "]   ("),
+    [RS485_AOS] = LABEL("AoS  = ", 9, 1, " [" DEG "]   ("),
+    [RS485_CAS] = LABEL("CAS  = ", 9, 2, " [m/s] ("),
+    [RS485_TAS] = LABEL("TAS  = ", 9, 2, " [m/s] ("),
+    [RS485_HP] = LABEL("HP   = ", 9, 1, " [m]   ("),
+    [RS485_MACH] = LABEL("Mach = ", 9, 3, " [-]   ("),
+    [RS485_SAT] = LABEL("SAT  = ", 9, 1, " [" DEG "C]  ("),
+    [RS485_TAT] = LABEL("TAT  = ", 9, 1, " [" DEG "C]  ("),
+    [RS485_QNH] = LABEL("QNH  = ", 9, 1, " [Pa]  ("),
+    [RS485_CR] = LABEL("CR   = ", 9, 1, " [m/s] ("),
+    [RS485_PT] = LABEL("Pt   = ", 9, 1, " [Pa]  ("),
+    [RS485_CAS_RATE] = LABEL("CAS RATE = ", 5, 1, " [m/s] ("),
+    [RS485_TAS_RATE] = LABEL("TAS RATE = ", 5, 1, " [m/s] ("),
+    [RS485_HBARO] = LABEL("HBARO = ", 8, 1, " [m]   ("),
+    [RS485_DTR] = LABEL("DTR  = ", 9, 2, " [-] ("),
+    [RS485_HTR] = LABEL("HTR  = ", 9, 1, " [" DEG "C]  ("),
+    [RS485_CUR] = LABEL("CUR  = ", 9, 2, " [A] ("),
+    [RS485_QCRAW] = LABEL("Qc R = ", 9, 1, " [Pa]  ("),
+    [RS485_PSRAW] = LABEL("Ps R = ", 9, 1, " [Pa]  ("),
+    [RS485_DPAOA] = LABEL("DP AoA = ", 7, 1, " [Pa]  ("),
+    [RS485_DPAOS] = LABEL("DP AoS = ", 7, 1, " [Pa]  ("),
+    [RS485_IAT] = LABEL("IAT  = ", 9, 1, " [" DEG "C]  ("),
+    [RS485_BAT] = LABEL("BAT  = ", 9, 1, " [" DEG "C]  ("),
+    [RS485_STQC] = LABEL("ST Qc= ", 9, 1, " [" DEG "C]  ("),
+    [RS485_STPS] = LABEL("ST Ps= ", 9, 1, " [" DEG "C]  ("),
+    [RS485_STAOA] = LABEL("ST AoA = ", 7, 1, " [" DEG "C]  ("),
+    [RS485_STAOS] = LABEL("ST AoS = ", 7, 1, " [" DEG "C]  ("),
+    [RS485_QC_U] = LABEL("QC_U = ", 9, 1, " [?]   ("),
+    [RS485_PS_U] = LABEL("PS_U = ", 9, 1, " [?]   ("),
+    [RS485_HP_U] = LABEL("HP_U = ", 9, 1, " [?]   ("),
+    [RS485_HBARO_U] = LABEL("HBARO_U=", 8, 1, " [?]   ("),
+    [RS485_CAS_U] = LABEL("CAS_U =", 9, 1, " [?]   ("),
+    [RS485_TAS_U] = LABEL("TAS_U =", 9, 1, " [?]   ("),
+    [RS485_CR_U] = LABEL("CR_U = ", 9, 1, " [?]   (")};
+
+/** Flag string representation, with the closing parenthesis */
+static const struct
+{
+    const char *text;
+    uint8_t length;
+} flag_str[] = {
+    [FLAG_VALID] = {"valid)", 6},
+    [FLAG_RANGE_ABOVE] = {"range+)", 7},
+    [FLAG_RANGE_BELLOW] = {"range-)", 7},
+    [FLAG_INVALID_POS] = {"invalid+)", 9},
+    [FLAG_INVALID_NEG] = {"invalid-)", 9},
+    [FLAG_INVALID] = {"invalid)", 8}};
+
+/** Scale of every precision */
+static const double POW10[] = {1.0, 10.0, 100.0, 1000.0};
+
+/** Uppercase hexadecimal digits of the statuses */
+static const char HEX_CHAR[16] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'};
+
+/**
+ * Write a value with a fixed number of decimals, right-aligned, exactly as printf("%*.*f") does.
+ * A float scaled by at most 1000 is exact in a double, so it is rounded to an integer once, to the
+ * nearest and to even on a tie as printf does, and the digits are written from that integer.
+ * @param[out]  text        Buffer of at least PRINT_VALUE_LENGTH characters, not null terminated.
+ * @param[in]   value       Value.
+ * @param[in]   width       Minimum number of characters.
+ * @param[in]   precision   Number of decimals, at most 3.
+ * @return Number of characters written.
+ */
+static size_t print_fixed(char text[], float value, uint8_t width, uint8_t precision)
 {
-    const char deg = (char)0xF8u;
+    bool negative = signbit(value);
+    double scaled = (negative ? -(double)value : (double)value) * POW10[precision];
+    char digits[PRINT_VALUE_LENGTH + 1];
+    size_t count = 0;
 
-    switch (air_data->type)
+    if (!(scaled < FIXED_MAX))
     {
-    case RS485_QC:
-        printf("Qc   = %9.1f [Pa]  (%s)\n", air_data->value, flag_str[air_data->flag]);
-        break;
-    case RS485_PS:
-        printf("Ps   = %9.1f [Pa]  (%s)\n", air_data->value, flag_str[air_data->flag]);
-        break;
-    case RS485_AOA:
-        printf("AoA  = %9.3f [%c]   (%s)\n", air_data->value, deg, flag_str[air_data->flag]);
-        break;
-    case RS485_AOS:
-        printf("AoS  = %9.1f [%c]   (%s)\n", air_data->value, deg, flag_str[air_data->flag]);
-        break;
-    case RS485_CAS:
-        printf("CAS  = %9.2f [m/s] (%s)\n", air_data->value, flag_str[air_data->flag]);
-        break;
-    case RS485_TAS:
-        printf("TAS  = %9.2f [m/s] (%s)\n", air_data->value, flag_str[air_data->flag]);
-        break;
-    case RS485_HP:
-        printf("HP   = %9.1f [m]   (%s)\n", air_data->value, flag_str[air_data->flag]);
-        break;
-    case RS485_MACH:
-        printf("Mach = %9.3f [-]   (%s)\n", air_data->value, flag_str[air_data->flag]);
-        break;
-    case RS485_SAT:
-        printf("SAT  = %9.1f [%cC]  (%s)\n", air_data->value, deg, flag_str[air_data->flag]);
-        break;
-    case RS485_TAT:
-        printf("TAT  = %9.1f [%cC]  (%s)\n", air_data->value, deg, flag_str[air_data->flag]);
-        break;
-    case RS485_QNH:
-        printf("QNH  = %9.1f [Pa]  (%s)\n", air_data->value, flag_str[air_data->flag]);
-        break;
-    case RS485_CR:
-        printf("CR   = %9.1f [m/s] (%s)\n", air_data->value, flag_str[air_data->flag]);
-        break;
-    case RS485_PT:
-        printf("Pt   = %9.1f [Pa]  (%s)\n", air_data->value, flag_str[air_data->flag]);
-        break;
-    case RS485_CAS_RATE:
-        printf("CAS RATE = %5.1f [m/s] (%s)\n", air_data->value, flag_str[air_data->flag]);
-        break;
-    case RS485_TAS_RATE:
-        printf("TAS RATE = %5.1f [m/s] (%s)\n", air_data->value, flag_str[air_data->flag]);
-        break;
-    case RS485_HBARO:
-        printf("HBARO = %8.1f [m]   (%s)\n", air_data->value, flag_str[air_data->flag]);
-        break;
-    case RS485_DTR:
-        printf("DTR  = %9.2f [-] (%s)\n", air_data->value, flag_str[air_data->flag]);
-        break;
-    case RS485_HTR:
-        printf("HTR  = %9.1f [%cC]  (%s)\n", air_data->value, deg, flag_str[air_data->flag]);
-        break;
-    case RS485_CUR:
-        printf("CUR  = %9.2f [A] (%s)\n", air_data->value, flag_str[air_data->flag]);
-        break;
-    case RS485_QCRAW:
-        printf("Qc R = %9.1f [Pa]  (%s)\n", air_data->value, flag_str[air_data->flag]);
-        break;
-    case RS485_PSRAW:
-        printf("Ps R = %9.1f [Pa]  (%s)\n", air_data->value, flag_str[air_data->flag]);
-        break;
-    case RS485_DPAOA:
-        printf("DP AoA = %7.1f [Pa]  (%s)\n", air_data->value, flag_str[air_data->flag]);
-        break;
-    case RS485_DPAOS:
-        printf("DP AoS = %7.1f [Pa]  (%s)\n", air_data->value, flag_str[air_data->flag]);
-        break;
-    case RS485_IAT:
-        printf("IAT  = %9.1f [%cC]  (%s)\n", air_data->value, deg, flag_str[air_data->flag]);
-        break;
-    case RS485_BAT:
-        printf("BAT  = %9.1f [%cC]  (%s)\n", air_data->value, deg, flag_str[air_data->flag]);
-        break;
-    case RS485_STQC:
-        printf("ST Qc= %9.1f [%cC]  (%s)\n", air_data->value, deg, flag_str[air_data->flag]);
-        break;
-    case RS485_STPS:
-        printf("ST Ps= %9.1f [%cC]  (%s)\n", air_data->value, deg, flag_str[air_data->flag]);
-        break;
-    case RS485_STAOA:
-        printf("ST AoA = %7.1f [%cC]  (%s)\n", air_data->value, deg, flag_str[air_data->flag]);
-        break;
-    case RS485_STAOS:
-        printf("ST AoS = %7.1f [%cC]  (%s)\n", air_data->value, deg, flag_str[air_data->flag]);
-        break;
-    case RS485_QC_U:
-        printf("QC_U = %9.1f [?]   (%s)\n", air_data->value, flag_str[air_data->flag]);
-        break;
-    case RS485_PS_U:
-        printf("PS_U = %9.1f [?]   (%s)\n", air_data->value, flag_str[air_data->flag]);
-        break;
-    case RS485_HP_U:
-        printf("HP_U = %9.1f [?]   (%s)\n", air_data->value, flag_str[air_data->flag]);
-        break;
-    case RS485_HBARO_U:
-        printf("HBARO_U=%8.1f [?]   (%s)\n", air_data->value, flag_str[air_data->flag]);
-        break;
-    case RS485_CAS_U:
-        printf("CAS_U =%9.1f [?]   (%s)\n", air_data->value, flag_str[air_data->flag]);
-        break;
-    case RS485_TAS_U:
-        printf("TAS_U =%9.1f [?]   (%s)\n", air_data->value, flag_str[air_data->flag]);
-        break;
-    case RS485_CR_U:
-        printf("CR_U = %9.1f [?]   (%s)\n", air_data->value, flag_str[air_data->flag]);
-        break;
-    default:
-        break;
+        // Infinite, not a number or too large: rare enough for printf
+        int written = snprintf(digits, sizeof(digits), "%*.*f", width, precision, value);
+        count = (written < 0) ? 0u : ((size_t)written < sizeof(digits)) ? (size_t)written : sizeof(digits) - 1u;
+        memcpy(text, digits, count);
+        return count;
+    }
+
+    uint64_t number = (uint64_t)scaled;
+    double rest = scaled - (double)number;
+    if ((rest > 0.5) || ((rest == 0.5) && ((number & 1u) != 0)))
+    {
+        number++;
+    }
+
+    // Written backwards, from the last decimal
+    for (uint8_t i = 0; i < precision; i++)
+    {
+        digits[count++] = (char)('0' + (number % 10u));
+        number /= 10u;
+    }
+    if (precision > 0)
+    {
+        digits[count++] = '.';
+    }
+    do
+    {
+        digits[count++] = (char)('0' + (number % 10u));
+        number /= 10u;
+    } while (number > 0);
+    if (negative)
+    {
+        digits[count++] = '-';
+    }
+
+    size_t length = 0;
+    while (length + count < width)
+    {
+        text[length++] = ' ';
+    }
+    while (count > 0)
+    {
+        text[length++] = digits[--count];
+    }
+    return length;
+}
+
+/** Append a text whose length is known */
+static size_t print_append(char text[], size_t length, const char *part, size_t part_length)
+{
+    memcpy(&text[length], part, part_length);
+    return length + part_length;
+}
+
+/**
+ * Write one air data as print_message() prints it, without the end of line.
+ * @param[out]  text        Buffer of at least PRINT_MESSAGE_LENGTH characters, not null terminated.
+ * @param[in]   air_data    Decoded air data.
+ * @return Number of characters written, 0 if the type of data is not valid.
+ */
+static size_t print_append_air_data(char text[], const air_data_t *air_data)
+{
+    if (!adc_rs485_profile_sends(air_data->type))
+    {
+        return 0;
     }
+
+    const print_label_t *label = &PRINT_LABEL[air_data->type];
+    uint32_t flag = ((uint32_t)air_data->flag <= FLAG_INVALID) ? (uint32_t)air_data->flag : FLAG_INVALID;
+    size_t length = print_append(text, 0, label->name, label->name_length);
+
+    length += print_fixed(&text[length], air_data->value, label->width, label->precision);
+    length = print_append(text, length, label->unit, label->unit_length);
+    return print_append(text, length, flag_str[flag].text, flag_str[flag].length);
 }
 
-static void print_gen_status(adc_gen_status_t *gen_status)
+/** Write a status as print_message() prints it */
+static size_t print_append_status(char text[], const char *name, size_t name_length, uint16_t status)
 {
-    printf("General status = 0x%04X \n\n", gen_status->number);
+    size_t length = print_append(text, 0, name, name_length);
+
+    for (int32_t shift = 12; shift >= 0; shift -= 4)
+    {
+        text[length++] = HEX_CHAR[(status >> shift) & 0x0Fu];
+    }
+    return print_append(text, length, " \n\n", 3);
 }
 
-static void print_htr_status(htr_status_t *htr_status)
+size_t print_format_air_data(const air_data_t *air_data, char buffer[], size_t length)
 {
-    printf("Heater status = 0x%04X \n\n", htr_status->number);
+    char text[PRINT_MESSAGE_LENGTH];
+    size_t written = print_append_air_data(text, air_data);
+
+    if (length == 0)
+    {
+        return 0;
+    }
+    // The text may be truncated to the buffer
+    if (written >= length)
+    {
+        written = length - 1u;
+    }
+    memcpy(buffer, text, written);
+    buffer[written] = '\0';
+    return written;
 }
 
-void print_message(adc_rs485_msg_t *msg)
+size_t print_format_message(const adc_rs485_msg_t *msg, char text[])
 {
+    static const char error[] = "\nError decoding the message! \n\n";
+    static const char gen_status[] = "General status = 0x";
+    static const char htr_status[] = "Heater status = 0x";
+    size_t length = 0;
+
     switch (msg->msg_type)
     {
     case RS485_ERROR:
-        printf("\nError decoding the message! \n\n");
+        length = print_append(text, 0, error, sizeof(error) - 1u);
         break;
     case RS485_RETURNED_DATA:
-        print_air_data(&(msg->air_data));
+        length = print_append_air_data(text, &msg->air_data);
+        if (length > 0)
+        {
+            text[length++] = '\n';
+        }
         break;
     case RS485_RETURNED_STATUS_GEN:
-        print_gen_status(&(msg->gen_status));
+        length = print_append_status(text, gen_status, sizeof(gen_status) - 1u, msg->gen_status.number);
         break;
     case RS485_RETURNED_STATUS_HTR:
-        print_htr_status(&(msg->htr_status));
+        length = print_append_status(text, htr_status, sizeof(htr_status) - 1u, msg->htr_status.number);
         break;
     default:
         break;
     }
-}
\ No newline at end of file
+    return length;
+}
+
+void print_message(const adc_rs485_msg_t *msg)
+{
+    char text[PRINT_MESSAGE_LENGTH];
+    size_t length = print_format_message(msg, text);
+
+    if (length > 0)
+    {
+        fwrite(text, 1, length, stdout);
+    }
+}
@@ -18,6 +18,22 @@
 #define PRINT_MSG_H
 
 #include "adc_rs485_decoder.h"
+#include <stddef.h>
+
+/**
+ * Maximum number of characters of a formatted value, also when it is out of the usual ranges: the
+ * sign, the 39 integer digits of FLT_MAX, the decimal point and 3 decimals.
+ */
+#define PRINT_VALUE_LENGTH 44
+
+/** Maximum number of characters around a value: the name "CAS RATE = ", the unit " [m/s] (" and the flag "invalid+)" */
+#define PRINT_LABEL_LENGTH 28
+
+/** Size in bytes of a buffer that can hold any formatted air data, null terminator included */
+#define PRINT_LINE_LENGTH (PRINT_LABEL_LENGTH + PRINT_VALUE_LENGTH + 1)
+
+/** Maximum number of characters of the text of any message, end of lines included */
+#define PRINT_MESSAGE_LENGTH 96
 
 /**
  * Print one message received by an air data computer. This message shall already be decoded!
@@ -25,6 +41,29 @@
  * @param[in]   msg     Decoded air-data massage sent by a swiss air-data computer.
 *
  */
-void print_message(adc_rs485_msg_t *msg);
+void print_message(const adc_rs485_msg_t *msg);
+
+/**
+ * Format one air data as print_message() prints it, without the end of line.
+ *
+ * @param[in]   air_data    Decoded air data.
+ * @param[out]  buffer      Buffer that will contain the text, null terminated.
+ * @param[in]   length      Size of the buffer, PRINT_LINE_LENGTH is enough for any value. The end of
+ *                          the text is truncated to a shorter buffer, as snprintf() does.
+ *
+ * @return Length of the text, 0 if the type of data is not valid.
+ */
+size_t print_format_air_data(const air_data_t *air_data, char buffer[], size_t length);
+
+/**
+ * Format one message as print_message() prints it, end of lines included, so that the text of many
+ * messages can be appended into one buffer and written at once.
+ *
+ * @param[in]   msg     Decoded air-data massage sent by a swiss air-data computer.
+ * @param[out]  text    Buffer of at least PRINT_MESSAGE_LENGTH characters, not null terminated.
+ *
+ * @return Length of the text, 0 if nothing is printed for the message.
+ */
+size_t print_format_message(const adc_rs485_msg_t *msg, char text[]);
 
 #endif
\ No newline at end of file
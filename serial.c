@@ -3,9 +3,12 @@
 * Company Confidential
 */
 
+#ifdef _WIN32
+
 #include "serial.h"
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <windef.h>
 #include <windows.h>
 
@@ -26,10 +29,10 @@ int32_t serial_open(serial_port_t *serial)
         return EXIT_FAILURE;
     }
 
-    // No (minimal) blocking!
-    timeouts.ReadIntervalTimeout = 1;
-    timeouts.ReadTotalTimeoutMultiplier = 0;
-    timeouts.ReadTotalTimeoutConstant = 1;
+    // A read returns as soon as at least one byte has been received, or when the timeout elapses
+    timeouts.ReadIntervalTimeout = MAXDWORD;
+    timeouts.ReadTotalTimeoutMultiplier = MAXDWORD;
+    timeouts.ReadTotalTimeoutConstant = (serial->read_timeout_ms == 0) ? (MAXDWORD - 1) : serial->read_timeout_ms;
     timeouts.WriteTotalTimeoutMultiplier = 0;
     timeouts.WriteTotalTimeoutConstant = 0;
     if (SetCommTimeouts(serial->windows_handle, &timeouts) == 0)
@@ -84,3 +87,13 @@ int32_t serial_get_data(serial_port_t *serial, char *data)
         return EXIT_FAILURE;
     }
 }
+
+int32_t serial_read(serial_port_t *serial, uint8_t data[], size_t max_length, size_t *length)
+{
+    DWORD cnt = 0;
+    bool success = ReadFile(serial->windows_handle, data, (DWORD)max_length, &cnt, NULL);
+    *length = cnt;
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#endif
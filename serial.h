@@ -1,5 +1,6 @@
 /**
-* This module does read a serial port on a windows machine.
+* This module does read a serial port on a windows machine (serial.c) or on a POSIX machine such as
+* Linux (serial_posix.c).
 *
 * © 2023 Simtec AG. All rights reserved.
 * Company Confidential
@@ -18,14 +19,22 @@
 #define SERIAL_H
 
 #include <stdint.h>
+#include <stddef.h>
+#ifdef _WIN32
 #include <windows.h>
+#endif
 
 /** Structure of a serial port */
 typedef struct
 {
     char com_port[32];
     uint32_t baudrate;
+    uint32_t read_timeout_ms; /**< Maximum time serial_read() waits for data, 0 to wait forever */
+#ifdef _WIN32
     HANDLE windows_handle;
+#else
+    int fd;                   /**< File descriptor of the opened serial port, -1 if closed */
+#endif
 } serial_port_t;
 
 /**
@@ -59,4 +68,19 @@ int32_t serial_close(serial_port_t *serial);
  */
 int32_t serial_get_data(serial_port_t *serial, char *data);
 
+/**
+ * Read all bytes received through a serial port, up to the size of the buffer.
+ * The function blocks until at least one byte has been received, or until the read timeout of the
+ * serial port elapses. The thread doesn't use any CPU while it waits.
+ * @note A call to the function serial_open() shall have been done before calling this function
+ *
+ * @param[in,out]   serial      Pointer to the serial port returned by the function serial_open()
+ * @param[out]      data        Buffer that will contain the bytes read.
+ * @param[in]       max_length  Size of the buffer.
+ * @param[out]      length      Number of bytes read, 0 if the timeout elapsed.
+ * @return EXIT_FAILURE if the serial port couldn't be read or if the wait has been interrupted
+ * by a signal, EXIT_SUCCESS otherwise.
+ */
+int32_t serial_read(serial_port_t *serial, uint8_t data[], size_t max_length, size_t *length);
+
 #endif
\ No newline at end of file
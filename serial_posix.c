@@ -0,0 +1,197 @@
+/*
+* © 2023 Simtec AG. All rights reserved.
+* Company Confidential
+*/
+
+#ifndef _WIN32
+
+#include "serial.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#ifdef __linux__
+// termios2 allows any baudrate, it can't be mixed with the glibc <termios.h>
+#include <asm/termbits.h>
+#include <sys/ioctl.h>
+#else
+#include <termios.h>
+#endif
+
+#ifdef __linux__
+
+/**
+ * Configure the serial port in raw mode, 8N1, at any baudrate.
+ * @param[in]   fd          File descriptor of the serial port.
+ * @param[in]   baudrate    Baudrate of the serial port.
+ * @return EXIT_FAILURE if the serial port couldn't be configured, EXIT_SUCCESS otherwise.
+ */
+static int32_t serial_configure(int fd, uint32_t baudrate)
+{
+    struct termios2 tio;
+
+    if (ioctl(fd, TCGETS2, &tio) != 0)
+    {
+        return EXIT_FAILURE;
+    }
+
+    tio.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON | IXOFF | IXANY);
+    tio.c_oflag &= ~OPOST;
+    tio.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+    tio.c_cflag &= ~(CSIZE | PARENB | CSTOPB | CRTSCTS | CBAUD | (CBAUD << IBSHIFT));
+    tio.c_cflag |= CS8 | CREAD | CLOCAL | BOTHER | (BOTHER << IBSHIFT);
+    tio.c_ispeed = baudrate;
+    tio.c_ospeed = baudrate;
+
+    // A read blocks until at least one byte has been received, then returns all available bytes
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+
+    if (ioctl(fd, TCSETS2, &tio) != 0)
+    {
+        return EXIT_FAILURE;
+    }
+    ioctl(fd, TCFLSH, TCIOFLUSH);
+
+    return EXIT_SUCCESS;
+}
+
+#else
+
+/** Baudrates supported by the standard termios interface */
+static const struct
+{
+    uint32_t baudrate;
+    speed_t speed;
+} standard_baudrates[] = {
+    {9600, B9600}, {19200, B19200}, {38400, B38400}, {57600, B57600}, {115200, B115200}, {230400, B230400}};
+
+/**
+ * Configure the serial port in raw mode, 8N1, at one of the standard baudrates.
+ * @param[in]   fd          File descriptor of the serial port.
+ * @param[in]   baudrate    Baudrate of the serial port.
+ * @return EXIT_FAILURE if the serial port couldn't be configured, EXIT_SUCCESS otherwise.
+ */
+static int32_t serial_configure(int fd, uint32_t baudrate)
+{
+    struct termios tio;
+    bool found = false;
+
+    if (tcgetattr(fd, &tio) != 0)
+    {
+        return EXIT_FAILURE;
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+    tio.c_cflag |= CREAD | CLOCAL;
+
+    for (size_t i = 0; i < sizeof(standard_baudrates) / sizeof(standard_baudrates[0]); i++)
+    {
+        if (standard_baudrates[i].baudrate == baudrate)
+        {
+            found = (cfsetspeed(&tio, standard_baudrates[i].speed) == 0);
+        }
+    }
+    if (!found)
+    {
+        return EXIT_FAILURE;
+    }
+
+    // A read blocks until at least one byte has been received, then returns all available bytes
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+
+    if (tcsetattr(fd, TCSANOW, &tio) != 0)
+    {
+        return EXIT_FAILURE;
+    }
+    tcflush(fd, TCIOFLUSH);
+
+    return EXIT_SUCCESS;
+}
+
+#endif
+
+int32_t serial_open(serial_port_t *serial)
+{
+    serial->fd = open(serial->com_port, O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (serial->fd < 0)
+    {
+        return EXIT_FAILURE;
+    }
+
+    if (serial_configure(serial->fd, serial->baudrate) != EXIT_SUCCESS)
+    {
+        close(serial->fd);
+        serial->fd = -1;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int32_t serial_close(serial_port_t *serial)
+{
+    if (serial->fd >= 0)
+    {
+        close(serial->fd);
+        serial->fd = -1;
+        return EXIT_SUCCESS;
+    }
+    else
+    {
+        return EXIT_FAILURE;
+    }
+}
+
+int32_t serial_read(serial_port_t *serial, uint8_t data[], size_t max_length, size_t *length)
+{
+    struct pollfd pfd = {.fd = serial->fd, .events = POLLIN, .revents = 0};
+    int timeout = (serial->read_timeout_ms == 0) ? -1 : (int)serial->read_timeout_ms;
+
+    *length = 0;
+
+    // Sleep until data is available, the serial port is closed or the timeout elapses
+    int ready = poll(&pfd, 1, timeout);
+    if (ready < 0)
+    {
+        return EXIT_FAILURE;
+    }
+    if (ready == 0)
+    {
+        return EXIT_SUCCESS;
+    }
+
+    ssize_t cnt = read(serial->fd, data, max_length);
+    if (cnt < 0)
+    {
+        return ((errno == EAGAIN) || (errno == EWOULDBLOCK)) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if ((cnt == 0) && ((pfd.revents & POLLHUP) != 0))
+    {
+        // The other end has been closed
+        return EXIT_FAILURE;
+    }
+
+    *length = (size_t)cnt;
+    return EXIT_SUCCESS;
+}
+
+int32_t serial_get_data(serial_port_t *serial, char *data)
+{
+    size_t cnt = 0;
+    if ((serial_read(serial, (uint8_t *)data, 1, &cnt) == EXIT_SUCCESS) && (cnt == 1))
+    {
+        return EXIT_SUCCESS;
+    }
+    else
+    {
+        return EXIT_FAILURE;
+    }
+}
+
+#endif
@@ -0,0 +1,401 @@
+/*
+ * 2023 (c) Simtec AG
+ * All rights reserved
+ *
+ * Verify that the buffer decoders return exactly the same messages as the decoder called per byte,
+ * and that adc_rs485_decoder_decode_buffer_simd() returns exactly the same messages and leaves
+ * exactly the same decoder state as adc_rs485_decoder_decode_buffer() with every instruction set
+ * supported by the processor. The streams are random frames of every label, damaged in every way
+ * seen on a serial line, decoded in chunks and message arrays of random sizes. The variants that also
+ * return where every message ends are checked against the byte that completed it, and
+ * adc_rs485_decoder_dispatch() must call the handlers with the same messages and errors.
+ *
+ * Example code only. Use at own risk.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Simtec AG has no obligation to provide maintenance, support,
+ * updates, enhancements, or modifications.
+ */
+
+#include "adc_rs485_decoder.h"
+#include "adc_rs485_encoder.h"
+#include "adc_rs485_simd.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Number of random streams decoded */
+#define STREAM_COUNT 2000
+
+/** Maximum size of a stream in bytes */
+#define STREAM_LENGTH 8192
+
+/** Every byte of a stream can at most complete one message */
+#define MSG_BUFFER_LENGTH STREAM_LENGTH
+
+/** Bytes that delimit the messages, the noise is biased towards them */
+static const uint8_t DELIMITER[5] = {0x01u, 0x02u, 0x03u, 0x05u, 0x0Du};
+
+/** Messages returned by a decoder for a whole stream and the decoder state at the end */
+typedef struct
+{
+    adc_rs485_msg_t msgs[MSG_BUFFER_LENGTH];
+    size_t ends[MSG_BUFFER_LENGTH]; /**< Offset in the stream of the byte that completed every message, SIZE_MAX if not returned */
+    size_t count;
+    adc_rs485_decoder_t decoder;
+} decoded_t;
+
+/** xorshift64* pseudo-random generator, the streams are identical at every execution */
+static uint64_t random_next(uint64_t *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ull;
+}
+
+/** Random number between 0 and range - 1 */
+static uint32_t random_below(uint64_t *rng, uint32_t range)
+{
+    return (uint32_t)((random_next(rng) >> 32) % range);
+}
+
+/** Append one frame of a random label, status or invalid label to the stream */
+static size_t append_frame(uint64_t *rng, uint8_t frame[])
+{
+    uint32_t kind = random_below(rng, 16);
+    uint32_t bits = (uint32_t)random_next(rng);
+    size_t length;
+
+    if (kind == 0)
+    {
+        length = adc_rs485_encode_gen_status((adc_gen_status_t){.number = (uint16_t)bits}, frame);
+    }
+    else if (kind == 1)
+    {
+        length = adc_rs485_encode_htr_status((htr_status_t){.number = (uint16_t)bits}, frame);
+    }
+    else
+    {
+        air_data_t data = {.type = (data_type_t)random_below(rng, RS485_DATA_NOT_VALID), .flag = (flag_t)random_below(rng, 8)};
+        memcpy(&data.value, &bits, sizeof(bits));
+        length = adc_rs485_encode_data(&data, frame);
+        if (kind == 2)
+        {
+            // Any start of header and label ID, most of them don't correspond to any data
+            frame[0] = DELIMITER[random_below(rng, 4)];
+            frame[1] = (uint8_t)((frame[1] & 0xF0u) | random_below(rng, 16));
+        }
+    }
+    return length;
+}
+
+/** Damage a frame as seen on a serial line, returns its new length */
+static size_t damage_frame(uint64_t *rng, uint8_t frame[], size_t length)
+{
+    size_t pos = 1 + random_below(rng, (uint32_t)(length - 1));
+
+    switch (random_below(rng, 8))
+    {
+    case 0:
+        // Invalid digit, also lowercase and above 0x7F to catch signed comparisons
+        frame[pos] = (uint8_t)random_next(rng);
+        break;
+    case 1:
+        frame[pos] = (random_below(rng, 2) == 0) ? (uint8_t)'a' : (uint8_t)0xC6u;
+        break;
+    case 2:
+        // The CR arrives early
+        frame[pos] = 0x0Du;
+        length = pos + 1;
+        break;
+    case 3:
+        // The end of the frame is lost
+        length = pos;
+        break;
+    case 4:
+        // The CR is lost, the frame runs into the next one
+        frame[length - 1] = (uint8_t)'0';
+        break;
+    case 5:
+        frame[pos] = DELIMITER[random_below(rng, 5)];
+        break;
+    default:
+        break;
+    }
+    return length;
+}
+
+/** Fill a buffer with a random stream, returns its length */
+static size_t generate_stream(uint64_t *rng, uint8_t data[])
+{
+    size_t length = 64 + random_below(rng, STREAM_LENGTH - 64);
+    uint32_t damage = random_below(rng, 4);
+    uint32_t noise = random_below(rng, 4);
+    size_t pos = 0;
+
+    while (pos < length)
+    {
+        uint8_t frame[ADC_RS485_MAX_FRAME_LENGTH];
+        size_t frame_length = append_frame(rng, frame);
+
+        if (random_below(rng, 8) < damage)
+        {
+            frame_length = damage_frame(rng, frame, frame_length);
+        }
+        for (size_t i = 0; (i < frame_length) && (pos < length); i++)
+        {
+            data[pos++] = frame[i];
+        }
+
+        // Bytes outside of the messages, some of them long enough to be longer than any message
+        if (random_below(rng, 8) < noise)
+        {
+            size_t noise_length = 1 + random_below(rng, (random_below(rng, 4) == 0) ? 40 : 4);
+            for (size_t i = 0; (i < noise_length) && (pos < length); i++)
+            {
+                uint64_t byte = random_next(rng);
+                data[pos++] = ((byte & 3u) == 0) ? DELIMITER[(byte >> 8) % 5] : (uint8_t)(byte >> 16);
+            }
+        }
+    }
+    return length;
+}
+
+/** Decode a stream with the decoder called per byte, keeping the messages returned by the buffer decoders */
+static void decode_per_byte(const uint8_t data[], size_t length, decoded_t *decoded)
+{
+    adc_rs485_decoder_init(&decoded->decoder);
+    decoded->count = 0;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        adc_rs485_msg_t msg = adc_rs485_decoder_decode(&decoded->decoder, (char)data[i]);
+        if ((msg.msg_type != RS485_PENDING) && ((msg.msg_type != RS485_ERROR) || (msg.error != ADC_RS485_ERROR_NO_SOH)))
+        {
+            decoded->ends[decoded->count] = i;
+            decoded->msgs[decoded->count++] = msg;
+        }
+    }
+}
+
+/**
+ * Decode a stream in chunks and message arrays of random sizes, with the SIMD decoder or not, and
+ * with or without the offsets of the ends of the messages.
+ */
+static void decode_chunks(uint64_t *rng, bool simd, const uint8_t data[], size_t length, decoded_t *decoded)
+{
+    size_t offset = 0;
+
+    adc_rs485_decoder_init(&decoded->decoder);
+    decoded->count = 0;
+
+    while (offset < length)
+    {
+        size_t chunk = 1 + random_below(rng, (random_below(rng, 2) == 0) ? 16 : 1024);
+        size_t max_msgs = 1 + random_below(rng, (random_below(rng, 2) == 0) ? 4 : 256);
+        bool with_ends = (random_below(rng, 2) == 0);
+        adc_rs485_msg_t *msgs = &decoded->msgs[decoded->count];
+        size_t *ends = &decoded->ends[decoded->count];
+        size_t consumed = 0;
+        size_t count;
+
+        chunk = (chunk < length - offset) ? chunk : length - offset;
+        if (simd && with_ends)
+        {
+            count = adc_rs485_decoder_decode_buffer_simd_ends(&decoded->decoder, &data[offset], chunk, msgs, ends, max_msgs,
+                                                              &consumed);
+        }
+        else if (simd)
+        {
+            count = adc_rs485_decoder_decode_buffer_simd(&decoded->decoder, &data[offset], chunk, msgs, max_msgs, &consumed);
+        }
+        else if (with_ends)
+        {
+            count = adc_rs485_decoder_decode_buffer_ends(&decoded->decoder, &data[offset], chunk, msgs, ends, max_msgs,
+                                                         &consumed);
+        }
+        else
+        {
+            count = adc_rs485_decoder_decode_buffer(&decoded->decoder, &data[offset], chunk, msgs, max_msgs, &consumed);
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            ends[i] = with_ends ? (ends[i] + offset) : SIZE_MAX;
+        }
+        decoded->count += count;
+        offset += consumed;
+    }
+}
+
+/** Handlers of the dispatch decoder, appending the messages to the decoded stream */
+static void append_data(data_type_t type, float value, flag_t flag, void *user)
+{
+    decoded_t *decoded = (decoded_t *)user;
+    adc_rs485_msg_t *msg = &decoded->msgs[decoded->count];
+
+    msg->msg_type = RS485_RETURNED_DATA;
+    msg->air_data = (air_data_t){.type = type, .value = value, .flag = flag};
+    decoded->ends[decoded->count++] = SIZE_MAX;
+}
+
+static void append_gen_status(adc_gen_status_t status, void *user)
+{
+    decoded_t *decoded = (decoded_t *)user;
+
+    decoded->msgs[decoded->count].msg_type = RS485_RETURNED_STATUS_GEN;
+    decoded->msgs[decoded->count].gen_status = status;
+    decoded->ends[decoded->count++] = SIZE_MAX;
+}
+
+static void append_htr_status(htr_status_t status, void *user)
+{
+    decoded_t *decoded = (decoded_t *)user;
+
+    decoded->msgs[decoded->count].msg_type = RS485_RETURNED_STATUS_HTR;
+    decoded->msgs[decoded->count].htr_status = status;
+    decoded->ends[decoded->count++] = SIZE_MAX;
+}
+
+static void append_error(adc_rs485_error_t error, void *user)
+{
+    decoded_t *decoded = (decoded_t *)user;
+
+    decoded->msgs[decoded->count].msg_type = RS485_ERROR;
+    decoded->msgs[decoded->count].error = error;
+    decoded->ends[decoded->count++] = SIZE_MAX;
+}
+
+/** Decode a stream in chunks of random sizes with a handler for every message */
+static void decode_dispatch(uint64_t *rng, const uint8_t data[], size_t length, decoded_t *decoded)
+{
+    adc_rs485_dispatch_t dispatch;
+    size_t offset = 0;
+
+    adc_rs485_dispatch_init(&dispatch);
+    for (uint32_t type = 0; type < RS485_DATA_NOT_VALID; type++)
+    {
+        // Fails for the labels the product never sends, decoded as errors
+        (void)adc_rs485_dispatch_on_data(&dispatch, (data_type_t)type, append_data, decoded);
+    }
+    adc_rs485_dispatch_on_gen_status(&dispatch, append_gen_status, decoded);
+    adc_rs485_dispatch_on_htr_status(&dispatch, append_htr_status, decoded);
+    adc_rs485_dispatch_on_error(&dispatch, append_error, decoded);
+
+    adc_rs485_decoder_init(&decoded->decoder);
+    decoded->count = 0;
+
+    while (offset < length)
+    {
+        size_t chunk = 1 + random_below(rng, (random_below(rng, 2) == 0) ? 16 : 1024);
+
+        chunk = (chunk < length - offset) ? chunk : length - offset;
+        adc_rs485_decoder_dispatch(&decoded->decoder, &dispatch, &data[offset], chunk);
+        offset += chunk;
+    }
+}
+
+/** Returns whether two messages are identical, the unused bytes of the union excepted */
+static bool same_message(const adc_rs485_msg_t *a, const adc_rs485_msg_t *b)
+{
+    if (a->msg_type != b->msg_type)
+    {
+        return false;
+    }
+    switch (a->msg_type)
+    {
+    case RS485_RETURNED_DATA:
+        return (a->air_data.type == b->air_data.type) && (a->air_data.flag == b->air_data.flag) &&
+               (memcmp(&a->air_data.value, &b->air_data.value, sizeof(a->air_data.value)) == 0);
+    case RS485_RETURNED_STATUS_GEN:
+        return a->gen_status.number == b->gen_status.number;
+    case RS485_RETURNED_STATUS_HTR:
+        return a->htr_status.number == b->htr_status.number;
+    case RS485_ERROR:
+        return a->error == b->error;
+    default:
+        return true;
+    }
+}
+
+/** Compare the messages and the decoder states, print the first difference */
+static bool same_decoded(const char *name, size_t stream, const decoded_t *expected, const decoded_t *decoded)
+{
+    const adc_rs485_decoder_t *a = &expected->decoder;
+    const adc_rs485_decoder_t *b = &decoded->decoder;
+
+    if (expected->count != decoded->count)
+    {
+        printf("%s, stream %zu: %zu messages instead of %zu\n", name, stream, decoded->count, expected->count);
+        return false;
+    }
+    for (size_t i = 0; i < expected->count; i++)
+    {
+        if (!same_message(&expected->msgs[i], &decoded->msgs[i]))
+        {
+            printf("%s, stream %zu: message %zu differs, type %d instead of %d\n", name, stream, i,
+                   (int)decoded->msgs[i].msg_type, (int)expected->msgs[i].msg_type);
+            return false;
+        }
+        if ((decoded->ends[i] != SIZE_MAX) && (decoded->ends[i] != expected->ends[i]))
+        {
+            printf("%s, stream %zu: message %zu ends at %zu instead of %zu\n", name, stream, i, decoded->ends[i],
+                   expected->ends[i]);
+            return false;
+        }
+    }
+    if ((a->pos != b->pos) || (memcmp(a->buffer, b->buffer, a->pos) != 0) || (a->truncated != b->truncated) ||
+        (a->resync != b->resync))
+    {
+        printf("%s, stream %zu: decoder state differs, pos %u truncated %u resync %llu instead of %u %u %llu\n", name, stream,
+               (unsigned)b->pos, (unsigned)b->truncated, (unsigned long long)b->resync, (unsigned)a->pos,
+               (unsigned)a->truncated, (unsigned long long)a->resync);
+        return false;
+    }
+    return true;
+}
+
+int main(void)
+{
+    static const char *const SIMD_NAME[] = {"simd-none", "simd-sse2", "simd-avx2"};
+    static uint8_t data[STREAM_LENGTH];
+    static decoded_t expected;
+    static decoded_t decoded;
+    adc_rs485_simd_t supported = adc_rs485_simd_supported();
+    uint64_t rng = 0x5EED0003u;
+    uint64_t compared = 0;
+    bool passed = true;
+
+    for (size_t stream = 0; (stream < STREAM_COUNT) && passed; stream++)
+    {
+        size_t length = generate_stream(&rng, data);
+
+        decode_per_byte(data, length, &expected);
+        decode_chunks(&rng, false, data, length, &decoded);
+        passed = same_decoded("buffer", stream, &expected, &decoded);
+
+        if (passed)
+        {
+            decode_dispatch(&rng, data, length, &decoded);
+            passed = same_decoded("dispatch", stream, &expected, &decoded);
+        }
+
+        for (uint32_t simd = ADC_RS485_SIMD_NONE; (simd <= (uint32_t)supported) && passed; simd++)
+        {
+            adc_rs485_simd_select((adc_rs485_simd_t)simd);
+            decode_chunks(&rng, true, data, length, &decoded);
+            passed = same_decoded(SIMD_NAME[simd], stream, &expected, &decoded);
+        }
+        compared += expected.count;
+    }
+
+    printf("test_decoder: %s, %llu messages compared up to %s\n", passed ? "passed" : "FAILED", (unsigned long long)compared,
+           SIMD_NAME[supported]);
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,306 @@
+/*
+ * 2023 (c) Simtec AG
+ * All rights reserved
+ *
+ * Verify the ring of decoded messages with a producer and a consumer thread, for every overflow
+ * policy. The consumer pops batches of random sizes and pauses at random, so that the small ring
+ * is often full. Every message carries its sequence number: the messages received shall be in the
+ * order they have been pushed, without duplicate and intact. Blocking, none is lost; dropping the
+ * oldest, the messages received and the messages counted as dropped add up to the messages pushed;
+ * coalescing too, and the latest message of every label is always received. Finally a producer
+ * blocked by a full ring shall give up once the ring is closed.
+ *
+ * Example code only. Use at own risk.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Simtec AG has no obligation to provide maintenance, support,
+ * updates, enhancements, or modifications.
+ */
+
+#include "adc_event.h"
+#include "adc_rs485_decoder.h"
+#include "event_ring.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/** Number of messages pushed with every policy */
+#define EVENT_COUNT 400000
+
+/** Capacity of the ring, small so that it overflows */
+#define RING_CAPACITY 64
+
+/** Maximum number of messages pushed or popped at once */
+#define BATCH_LENGTH 48
+
+/** Number of labels the messages are spread over: every data type and both statuses */
+#define KEY_COUNT (RS485_DATA_NOT_VALID + 2)
+
+/** Ring shared by the producer and the consumer, and the messages received */
+typedef struct
+{
+    event_ring_t ring;
+    event_ring_notifier_t notifier;
+    uint32_t done;                /**< Set once the producer has pushed every message */
+    uint64_t seed;
+    uint64_t *received;           /**< Sequence numbers received, in the order they have been popped */
+    size_t received_count;
+    bool intact;                  /**< Cleared if a message doesn't match its sequence number */
+} stress_t;
+
+/** xorshift64* pseudo-random generator, the batches are identical at every execution */
+static uint64_t random_next(uint64_t *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ull;
+}
+
+/** Random number between 0 and range - 1 */
+static uint32_t random_below(uint64_t *rng, uint32_t range)
+{
+    return (uint32_t)((random_next(rng) >> 32) % range);
+}
+
+/** Label of a message, the labels are repeated irregularly */
+static uint32_t sequence_key(uint64_t sequence)
+{
+    return (uint32_t)((sequence * 0x9E3779B97F4A7C15ull) >> 40) % KEY_COUNT;
+}
+
+/** Message number sequence: its label and a check word derived from the number */
+static void make_event(adc_event_t *event, uint64_t sequence)
+{
+    uint32_t key = sequence_key(sequence);
+
+    memset(event, 0, sizeof(*event));
+    event->timestamp_ns = sequence;
+    event->status = (uint32_t)(sequence * 2654435761u) ^ 0xA5A5A5A5u;
+    if (key < RS485_DATA_NOT_VALID)
+    {
+        event->msg_type = (uint8_t)RS485_RETURNED_DATA;
+        event->data_type = (uint8_t)key;
+        event->flag = (uint8_t)(sequence % 6u);
+    }
+    else
+    {
+        event->msg_type = (key == RS485_DATA_NOT_VALID) ? (uint8_t)RS485_RETURNED_STATUS_GEN : (uint8_t)RS485_RETURNED_STATUS_HTR;
+        event->data_type = (uint8_t)RS485_DATA_NOT_VALID;
+    }
+}
+
+/** Pause a thread for a few microseconds */
+static void pause_us(uint32_t microseconds)
+{
+    struct timespec pause = {.tv_sec = 0, .tv_nsec = (long)microseconds * 1000L};
+    nanosleep(&pause, NULL);
+}
+
+static void *producer_thread(void *argument)
+{
+    stress_t *stress = (stress_t *)argument;
+    adc_event_t events[BATCH_LENGTH];
+    uint64_t rng = stress->seed;
+    uint64_t sequence = 0;
+
+    while (sequence < EVENT_COUNT)
+    {
+        size_t count = 1 + random_below(&rng, BATCH_LENGTH);
+        count = (count < EVENT_COUNT - sequence) ? count : (size_t)(EVENT_COUNT - sequence);
+        for (size_t i = 0; i < count; i++)
+        {
+            make_event(&events[i], sequence++);
+        }
+        event_ring_push(&stress->ring, events, count);
+        if (random_below(&rng, 16) == 0)
+        {
+            pause_us(random_below(&rng, 100));
+        }
+    }
+    __atomic_store_n(&stress->done, 1, __ATOMIC_RELEASE);
+    event_ring_wake(&stress->notifier);
+    return NULL;
+}
+
+static void *consumer_thread(void *argument)
+{
+    stress_t *stress = (stress_t *)argument;
+    adc_event_t events[BATCH_LENGTH];
+    event_ring_t *rings[1] = {&stress->ring};
+    uint64_t rng = stress->seed ^ 0xC0FFEEu;
+
+    for (;;)
+    {
+        // Everything has been pushed before this pop if done was already set
+        bool done = (__atomic_load_n(&stress->done, __ATOMIC_ACQUIRE) != 0);
+        size_t count = event_ring_pop(&stress->ring, events, 1 + random_below(&rng, BATCH_LENGTH));
+
+        if ((count == 0) && done)
+        {
+            break;
+        }
+        if (count == 0)
+        {
+            event_ring_wait(&stress->notifier, rings, 1, 10);
+            continue;
+        }
+
+        for (size_t i = 0; (i < count) && (stress->received_count < EVENT_COUNT); i++)
+        {
+            adc_event_t expected;
+            make_event(&expected, events[i].timestamp_ns);
+            stress->intact = stress->intact && (memcmp(&expected, &events[i], sizeof(expected)) == 0);
+            stress->received[stress->received_count++] = events[i].timestamp_ns;
+        }
+        if (random_below(&rng, 64) == 0)
+        {
+            pause_us(random_below(&rng, 300));
+        }
+    }
+    return NULL;
+}
+
+/** Check the messages received with a policy, print the first problem */
+static bool check_received(const stress_t *stress, event_ring_overflow_t overflow, const char *name)
+{
+    static uint64_t last_of_key[KEY_COUNT];
+    uint64_t dropped = event_ring_dropped(&stress->ring);
+    bool last_received[KEY_COUNT];
+
+    if (!stress->intact)
+    {
+        printf("%s: a message has been damaged\n", name);
+        return false;
+    }
+    for (size_t i = 1; i < stress->received_count; i++)
+    {
+        if (stress->received[i] <= stress->received[i - 1])
+        {
+            printf("%s: message %llu received after %llu\n", name, (unsigned long long)stress->received[i],
+                   (unsigned long long)stress->received[i - 1]);
+            return false;
+        }
+    }
+    if ((stress->received_count + dropped != EVENT_COUNT) || ((overflow == EVENT_RING_BLOCK) && (dropped != 0)))
+    {
+        printf("%s: %zu messages received and %llu dropped out of %u\n", name, stress->received_count,
+               (unsigned long long)dropped, (unsigned)EVENT_COUNT);
+        return false;
+    }
+
+    if (overflow == EVENT_RING_COALESCE)
+    {
+        memset(last_received, 0, sizeof(last_received));
+        for (uint64_t sequence = 0; sequence < EVENT_COUNT; sequence++)
+        {
+            last_of_key[sequence_key(sequence)] = sequence;
+        }
+        for (size_t i = 0; i < stress->received_count; i++)
+        {
+            uint32_t key = sequence_key(stress->received[i]);
+            last_received[key] = last_received[key] || (stress->received[i] == last_of_key[key]);
+        }
+        for (uint32_t key = 0; key < KEY_COUNT; key++)
+        {
+            if (!last_received[key])
+            {
+                printf("%s: the latest message of label %u has been lost\n", name, key);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/** Push and pop every message from two threads with one policy */
+static bool run_policy(event_ring_overflow_t overflow, const char *name, uint64_t *dropped)
+{
+    static stress_t stress;
+    pthread_t producer;
+    pthread_t consumer;
+    bool passed;
+
+    memset(&stress, 0, sizeof(stress));
+    stress.seed = 0x5EED0007u + (uint64_t)overflow;
+    stress.intact = true;
+    stress.received = malloc(EVENT_COUNT * sizeof(*stress.received));
+    event_ring_notifier_init(&stress.notifier);
+    if ((stress.received == NULL) || (event_ring_init(&stress.ring, RING_CAPACITY, overflow, &stress.notifier) != EXIT_SUCCESS))
+    {
+        printf("%s: out of memory\n", name);
+        free(stress.received);
+        return false;
+    }
+
+    passed = (pthread_create(&consumer, NULL, consumer_thread, &stress) == 0);
+    if (passed && (pthread_create(&producer, NULL, producer_thread, &stress) != 0))
+    {
+        // Let the consumer stop
+        __atomic_store_n(&stress.done, 1, __ATOMIC_RELEASE);
+        passed = false;
+    }
+    if (passed)
+    {
+        pthread_join(producer, NULL);
+    }
+    pthread_join(consumer, NULL);
+
+    passed = passed && check_received(&stress, overflow, name);
+    *dropped = event_ring_dropped(&stress.ring);
+    event_ring_free(&stress.ring);
+    free(stress.received);
+    return passed;
+}
+
+/** A producer blocked by a full ring drops its messages once the ring is closed */
+static bool run_close(void)
+{
+    static event_ring_t ring;
+    adc_event_t events[RING_CAPACITY + 5];
+    bool passed;
+
+    if (event_ring_init(&ring, RING_CAPACITY, EVENT_RING_BLOCK, NULL) != EXIT_SUCCESS)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < RING_CAPACITY + 5; i++)
+    {
+        make_event(&events[i], i);
+    }
+    event_ring_close(&ring);
+    event_ring_push(&ring, events, RING_CAPACITY + 5);
+
+    passed = (event_ring_dropped(&ring) == 5) && (event_ring_pop(&ring, events, RING_CAPACITY + 5) == RING_CAPACITY);
+    if (!passed)
+    {
+        printf("block: a closed ring didn't drop the messages that didn't fit\n");
+    }
+    event_ring_free(&ring);
+    return passed;
+}
+
+int main(void)
+{
+    static const char *const POLICY_NAME[] = {"block", "drop-oldest", "coalesce"};
+    uint64_t dropped[3] = {0};
+    bool passed = true;
+
+    for (uint32_t overflow = EVENT_RING_BLOCK; (overflow <= EVENT_RING_COALESCE) && passed; overflow++)
+    {
+        passed = run_policy((event_ring_overflow_t)overflow, POLICY_NAME[overflow], &dropped[overflow]);
+    }
+    passed = passed && run_close();
+
+    printf("test_event_ring: %s, %u messages per policy, %llu dropped and %llu coalesced\n", passed ? "passed" : "FAILED",
+           (unsigned)EVENT_COUNT, (unsigned long long)dropped[EVENT_RING_DROP_OLDEST],
+           (unsigned long long)dropped[EVENT_RING_COALESCE]);
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
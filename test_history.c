@@ -0,0 +1,268 @@
+/*
+ * 2023 (c) Simtec AG
+ * All rights reserved
+ *
+ * Verify the statistics of adc_history.c against the same statistics computed from scratch over
+ * the window, after every message and every expiry. The labels have rings of different capacities,
+ * some smaller than the window so that the ring is full and wraps around, and values that test the
+ * monotonic deques of the minimum and the maximum (monotonic, constant, jumping) and the offset
+ * sums (large values varying little, values drifting far from the offset while the window is never
+ * empty, over enough values for the sums to be recomputed many times).
+ * Values that are not valid, not a number or infinite, and statuses are ignored.
+ *
+ * Example code only. Use at own risk.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Simtec AG has no obligation to provide maintenance, support,
+ * updates, enhancements, or modifications.
+ */
+
+#include "adc_event.h"
+#include "adc_history.h"
+#include "adc_rs485_decoder.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Number of messages added */
+#define EVENT_COUNT 300000
+
+/** Duration of the window */
+#define WINDOW_NS (50ull * 1000000u)
+
+/** Number of labels with values, the other labels are never received */
+#define LABEL_COUNT 9
+
+/** How the values of a label change */
+typedef enum
+{
+    VALUES_WALK,        /**< Random walk */
+    VALUES_NEAR_LARGE,  /**< Large value varying little, where the sums cancel */
+    VALUES_JUMPS,       /**< Any value of a wide range */
+    VALUES_CONSTANT,
+    VALUES_INCREASING,
+    VALUES_DECREASING,
+    VALUES_DRIFT,       /**< Drifting far from the offset of the sums while the window is never empty */
+    VALUES_FEW          /**< Few distinct values, many of them equal */
+} values_kind_t;
+
+/** Label received, its capacity and its values */
+typedef struct
+{
+    data_type_t type;
+    uint32_t capacity;
+    values_kind_t kind;
+} label_setup_t;
+
+static const label_setup_t LABELS[LABEL_COUNT] = {
+    {RS485_QC, 16, VALUES_WALK},           // Always full, the window is longer than the ring
+    {RS485_PS, 4096, VALUES_NEAR_LARGE},   // Limited by the window
+    {RS485_HP, 7, VALUES_JUMPS},
+    {RS485_CAS, 40, VALUES_CONSTANT},
+    {RS485_TAS, 33, VALUES_INCREASING},
+    {RS485_MACH, 64, VALUES_DECREASING},
+    {RS485_SAT, 25, VALUES_FEW},
+    {RS485_QNH, 48, VALUES_DRIFT},
+    {RS485_TAT, 0, VALUES_WALK}};          // Not kept
+
+/** Values accepted for one label, and where its window starts */
+typedef struct
+{
+    adc_history_sample_t *samples;
+    size_t count;
+    size_t first;       /**< Oldest value still in the window */
+    float value;        /**< Latest value generated */
+} reference_t;
+
+/** xorshift64* pseudo-random generator, the values are identical at every execution */
+static uint64_t random_next(uint64_t *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ull;
+}
+
+/** Random number between 0 and range - 1 */
+static uint32_t random_below(uint64_t *rng, uint32_t range)
+{
+    return (uint32_t)((random_next(rng) >> 32) % range);
+}
+
+/** Random number between -1 and 1 */
+static double random_signed(uint64_t *rng)
+{
+    return (double)(random_next(rng) >> 11) / (double)(1ull << 52) - 1.0;
+}
+
+/** Next value of a label */
+static float next_value(uint64_t *rng, values_kind_t kind, float previous)
+{
+    switch (kind)
+    {
+    case VALUES_WALK:
+        return previous + (float)random_signed(rng);
+    case VALUES_NEAR_LARGE:
+        return 101325.0f + (float)(random_signed(rng) * 0.5);
+    case VALUES_JUMPS:
+        return (float)(random_signed(rng) * 1e6);
+    case VALUES_CONSTANT:
+        return 42.125f;
+    case VALUES_INCREASING:
+        return previous + 0.25f * (float)random_below(rng, 3);
+    case VALUES_DECREASING:
+        return previous - 0.25f * (float)random_below(rng, 3);
+    case VALUES_DRIFT:
+        return previous + (float)(300.0 * (1.0 + random_signed(rng)));
+    default:
+        return (float)random_below(rng, 4);
+    }
+}
+
+/** Remove the values older than the window from a reference, as the history does */
+static void reference_expire(reference_t *reference, uint64_t now_ns)
+{
+    while ((reference->first < reference->count) && (now_ns > reference->samples[reference->first].time_ns) &&
+           (now_ns - reference->samples[reference->first].time_ns > WINDOW_NS))
+    {
+        reference->first++;
+    }
+}
+
+/** Compare the statistics of a label with the statistics of the values in its window, print the difference */
+static bool same_stats(const adc_history_t *history, const label_setup_t *setup, const reference_t *reference, size_t event)
+{
+    adc_history_stats_t stats;
+    bool found = adc_history_stats(history, setup->type, &stats);
+    size_t count = reference->count - reference->first;
+    long double sum = 0.0L;
+    long double squares = 0.0L;
+    float min = INFINITY;
+    float max = -INFINITY;
+
+    // The ring keeps the latest values only
+    size_t first = (count > setup->capacity) ? reference->count - setup->capacity : reference->first;
+    count = reference->count - first;
+    if ((setup->capacity == 0) || (count == 0))
+    {
+        if (found)
+        {
+            printf("label %d, message %zu: statistics of an empty window\n", (int)setup->type, event);
+        }
+        return !found;
+    }
+
+    for (size_t i = first; i < reference->count; i++)
+    {
+        float value = reference->samples[i].value;
+        sum += value;
+        min = (value < min) ? value : min;
+        max = (value > max) ? value : max;
+    }
+    long double mean = sum / (long double)count;
+    for (size_t i = first; i < reference->count; i++)
+    {
+        long double difference = (long double)reference->samples[i].value - mean;
+        squares += difference * difference;
+    }
+    double variance = (count > 1) ? (double)(squares / (long double)(count - 1)) : 0.0;
+
+    // The sums are offset by a value of the window, their error is relative to the spread of the values
+    double spread = (double)max - (double)min;
+    bool same = found && (stats.count == count) && (stats.first_ns == reference->samples[first].time_ns) &&
+                (stats.last_ns == reference->samples[reference->count - 1].time_ns) && (stats.min == min) && (stats.max == max) &&
+                (fabs(stats.mean - (double)mean) <= 1e-9 * (spread + 1e-3)) &&
+                (fabs(stats.variance - variance) <= 1e-9 * (spread * spread + 1e-6));
+    if (!same)
+    {
+        printf("label %d, message %zu: count %u mean %.17g variance %.17g min %g max %g instead of %zu %.17g %.17g %g %g\n",
+               (int)setup->type, event, stats.count, stats.mean, stats.variance, (double)stats.min, (double)stats.max, count,
+               (double)mean, variance, (double)min, (double)max);
+    }
+    return same;
+}
+
+int main(void)
+{
+    static reference_t references[LABEL_COUNT];
+    uint32_t capacities[RS485_DATA_NOT_VALID] = {0};
+    uint64_t rng = 0x5EED0020u;
+    uint64_t now_ns = 1000000000u;
+    adc_history_t history;
+    uint64_t checked = 0;
+    bool passed = true;
+
+    for (uint32_t label = 0; label < LABEL_COUNT; label++)
+    {
+        capacities[LABELS[label].type] = LABELS[label].capacity;
+        references[label].samples = malloc(EVENT_COUNT * sizeof(adc_history_sample_t));
+        references[label].value = 1000.0f;
+        passed = passed && (references[label].samples != NULL);
+    }
+    passed = passed && (adc_history_init(&history, capacities, WINDOW_NS) == EXIT_SUCCESS);
+
+    for (size_t i = 0; (i < EVENT_COUNT) && passed; i++)
+    {
+        uint32_t label = random_below(&rng, LABEL_COUNT);
+        const label_setup_t *setup = &LABELS[label];
+        reference_t *reference = &references[label];
+        uint32_t kind = random_below(&rng, 1000);
+        adc_event_t event;
+
+        // About 100 us between the messages, sometimes none, rarely longer than the window
+        now_ns += (random_below(&rng, 20000) == 0) ? WINDOW_NS + random_below(&rng, (uint32_t)WINDOW_NS) : random_below(&rng, 200000);
+
+        memset(&event, 0, sizeof(event));
+        event.timestamp_ns = now_ns;
+        event.msg_type = (uint8_t)RS485_RETURNED_DATA;
+        event.data_type = (uint8_t)setup->type;
+        reference->value = next_value(&rng, setup->kind, reference->value);
+        event.value = reference->value;
+        if (kind < 30)
+        {
+            // Ignored: not valid, not a number, infinite or a status
+            event.flag = (uint8_t)(1 + random_below(&rng, 5));
+            event.value = (kind < 10) ? NAN : (kind < 15) ? -INFINITY : event.value;
+            event.flag = (kind < 15) ? (uint8_t)FLAG_VALID : event.flag;
+            event.msg_type = (kind < 20) ? event.msg_type : (uint8_t)RS485_RETURNED_STATUS_GEN;
+        }
+        adc_history_add(&history, &event);
+
+        if ((event.msg_type == RS485_RETURNED_DATA) && (event.flag == FLAG_VALID) && isfinite(event.value))
+        {
+            reference_expire(reference, now_ns);
+            reference->samples[reference->count].time_ns = now_ns;
+            reference->samples[reference->count].value = event.value;
+            reference->count++;
+        }
+        passed = same_stats(&history, setup, reference, i);
+        checked++;
+
+        // Every label expires, also those not received anymore, rarely the whole window
+        if (random_below(&rng, 64) == 0)
+        {
+            uint64_t expire_ns = now_ns + random_below(&rng, (random_below(&rng, 256) == 0) ? (uint32_t)(2 * WINDOW_NS) : (uint32_t)(WINDOW_NS / 2));
+            adc_history_expire(&history, expire_ns);
+            for (uint32_t other = 0; (other < LABEL_COUNT) && passed; other++)
+            {
+                reference_expire(&references[other], expire_ns);
+                passed = same_stats(&history, &LABELS[other], &references[other], i);
+                checked++;
+            }
+        }
+    }
+
+    adc_history_free(&history);
+    for (uint32_t label = 0; label < LABEL_COUNT; label++)
+    {
+        free(references[label].samples);
+    }
+    printf("test_history: %s, %llu statistics compared\n", passed ? "passed" : "FAILED", (unsigned long long)checked);
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,276 @@
+/*
+ * 2023 (c) Simtec AG
+ * All rights reserved
+ *
+ * Verify that print_format_air_data() and print_format_message() write byte for byte the text that
+ * printf() writes with the formats the messages have always been printed with, for every label, flag
+ * and size of buffer, with values around the ties of the rounding, out of the usual ranges, not a
+ * number or infinite, and random bits. Also verify that PRINT_LINE_LENGTH and PRINT_MESSAGE_LENGTH
+ * hold the longest text.
+ *
+ * Example code only. Use at own risk.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Simtec AG has no obligation to provide maintenance, support,
+ * updates, enhancements, or modifications.
+ */
+
+#include "adc_rs485_decoder.h"
+#include "adc_rs485_labels.h"
+#include "print_msg.h"
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Number of values formatted with every label */
+#define VALUE_COUNT 200000
+
+/** Size of the buffers compared, larger than any text */
+#define TEXT_LENGTH 256
+
+/** Degree sign, in the code page of the terminals */
+#define DEG "\xF8"
+
+/** Format every type of data has always been printed with, the value followed by the flag */
+static const char *const REFERENCE_FORMAT[RS485_DATA_NOT_VALID] = {
+    [RS485_QC] = "Qc   = %9.1f [Pa]  (%s)",
+    [RS485_PS] = "Ps   = %9.1f [Pa]  (%s)",
+    [RS485_AOA] = "AoA  = %9.3f [" DEG "]   (%s)",
+    [RS485_AOS] = "AoS  = %9.1f [" DEG "]   (%s)",
+    [RS485_CAS] = "CAS  = %9.2f [m/s] (%s)",
+    [RS485_TAS] = "TAS  = %9.2f [m/s] (%s)",
+    [RS485_HP] = "HP   = %9.1f [m]   (%s)",
+    [RS485_MACH] = "Mach = %9.3f [-]   (%s)",
+    [RS485_SAT] = "SAT  = %9.1f [" DEG "C]  (%s)",
+    [RS485_TAT] = "TAT  = %9.1f [" DEG "C]  (%s)",
+    [RS485_QNH] = "QNH  = %9.1f [Pa]  (%s)",
+    [RS485_CR] = "CR   = %9.1f [m/s] (%s)",
+    [RS485_PT] = "Pt   = %9.1f [Pa]  (%s)",
+    [RS485_CAS_RATE] = "CAS RATE = %5.1f [m/s] (%s)",
+    [RS485_TAS_RATE] = "TAS RATE = %5.1f [m/s] (%s)",
+    [RS485_HBARO] = "HBARO = %8.1f [m]   (%s)",
+    [RS485_DTR] = "DTR  = %9.2f [-] (%s)",
+    [RS485_HTR] = "HTR  = %9.1f [" DEG "C]  (%s)",
+    [RS485_CUR] = "CUR  = %9.2f [A] (%s)",
+    [RS485_QCRAW] = "Qc R = %9.1f [Pa]  (%s)",
+    [RS485_PSRAW] = "Ps R = %9.1f [Pa]  (%s)",
+    [RS485_DPAOA] = "DP AoA = %7.1f [Pa]  (%s)",
+    [RS485_DPAOS] = "DP AoS = %7.1f [Pa]  (%s)",
+    [RS485_IAT] = "IAT  = %9.1f [" DEG "C]  (%s)",
+    [RS485_BAT] = "BAT  = %9.1f [" DEG "C]  (%s)",
+    [RS485_STQC] = "ST Qc= %9.1f [" DEG "C]  (%s)",
+    [RS485_STPS] = "ST Ps= %9.1f [" DEG "C]  (%s)",
+    [RS485_STAOA] = "ST AoA = %7.1f [" DEG "C]  (%s)",
+    [RS485_STAOS] = "ST AoS = %7.1f [" DEG "C]  (%s)",
+    [RS485_QC_U] = "QC_U = %9.1f [?]   (%s)",
+    [RS485_PS_U] = "PS_U = %9.1f [?]   (%s)",
+    [RS485_HP_U] = "HP_U = %9.1f [?]   (%s)",
+    [RS485_HBARO_U] = "HBARO_U=%8.1f [?]   (%s)",
+    [RS485_CAS_U] = "CAS_U =%9.1f [?]   (%s)",
+    [RS485_TAS_U] = "TAS_U =%9.1f [?]   (%s)",
+    [RS485_CR_U] = "CR_U = %9.1f [?]   (%s)"};
+
+/** Flags as they have always been printed */
+static const char *const REFERENCE_FLAG[] = {
+    [FLAG_VALID] = "valid",
+    [FLAG_RANGE_ABOVE] = "range+",
+    [FLAG_RANGE_BELLOW] = "range-",
+    [FLAG_INVALID_POS] = "invalid+",
+    [FLAG_INVALID_NEG] = "invalid-",
+    [FLAG_INVALID] = "invalid"};
+
+/** Values printed differently by a naive rounding: ties, negative zero, limits of the fixed point */
+static const float SPECIAL_VALUE[] = {0.0f, -0.0f, 0.05f, -0.05f, 0.25f, 0.125f, 0.0005f, -0.0005f, 2.5f, 0.45f,
+                                      0.95f, -0.95f, 1.0005f, 99999.95f, 123456.789f, 9.99e14f, 1e15f, 1e10f,
+                                      -1e10f, FLT_MAX, -FLT_MAX, FLT_MIN, -FLT_MIN, INFINITY, -INFINITY, NAN};
+
+/** xorshift64* pseudo-random generator, the values are identical at every execution */
+static uint64_t random_next(uint64_t *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ull;
+}
+
+/** Value number i formatted with every label */
+static float test_value(uint64_t *rng, uint32_t i)
+{
+    uint64_t bits = random_next(rng);
+    float value;
+
+    if (i < sizeof(SPECIAL_VALUE) / sizeof(SPECIAL_VALUE[0]))
+    {
+        return SPECIAL_VALUE[i];
+    }
+    switch (i % 4)
+    {
+    case 0:
+    {
+        // Any float, not a number and infinite included
+        uint32_t number = (uint32_t)(bits >> 32);
+        memcpy(&value, &number, sizeof(value));
+        break;
+    }
+    case 1:
+        // Binary fractions, many of them exact ties of the rounding
+        value = (float)((int64_t)((bits >> 32) % 2000001u) - 1000000) / (float)(1u << ((bits >> 8) % 12u));
+        break;
+    case 2:
+        // Decimal values, the closest floats to the ties of the rounding
+        value = (float)((double)((int64_t)((bits >> 32) % 20000000u) - 10000000) / 1000.0);
+        break;
+    default:
+        // The floats next to a decimal value
+        value = nextafterf((float)((double)((int64_t)((bits >> 32) % 2000000u) - 1000000) / 100.0),
+                           ((bits & 1u) != 0) ? INFINITY : -INFINITY);
+        break;
+    }
+    return value;
+}
+
+/**
+ * Format an air data with printf() as it has always been, truncated to the buffer like
+ * print_format_air_data(). Nothing is printed for the labels the product never sends.
+ */
+static size_t reference_format(const air_data_t *air_data, char buffer[], size_t length)
+{
+    if (!adc_rs485_profile_sends(air_data->type))
+    {
+        if (length > 0)
+        {
+            buffer[0] = '\0';
+        }
+        return 0;
+    }
+
+    int written = snprintf(buffer, length, REFERENCE_FORMAT[air_data->type], air_data->value, REFERENCE_FLAG[air_data->flag]);
+
+    if ((written <= 0) || (length == 0))
+    {
+        return 0;
+    }
+    return ((size_t)written < length) ? (size_t)written : (length - 1);
+}
+
+/** Compare one air data formatted into buffers of every size, print the first difference */
+static bool same_air_data(const air_data_t *air_data, bool every_length)
+{
+    char expected[TEXT_LENGTH];
+    char text[TEXT_LENGTH];
+    size_t expected_length = reference_format(air_data, expected, sizeof(expected));
+    size_t text_length = print_format_air_data(air_data, text, sizeof(text));
+
+    if ((text_length != expected_length) || (strcmp(text, expected) != 0))
+    {
+        printf("type %d, value %.9g: <%s> instead of <%s>\n", (int)air_data->type, (double)air_data->value, text, expected);
+        return false;
+    }
+    if (text_length >= PRINT_LINE_LENGTH)
+    {
+        printf("type %d, value %.9g: %zu characters don't fit in PRINT_LINE_LENGTH\n", (int)air_data->type,
+               (double)air_data->value, text_length);
+        return false;
+    }
+
+    // The same text truncated to every shorter buffer, with a mark after its end
+    for (size_t length = 0; every_length && (length <= expected_length); length++)
+    {
+        memset(expected, 0x55, sizeof(expected));
+        memset(text, 0x55, sizeof(text));
+        expected_length = reference_format(air_data, expected, length);
+        text_length = print_format_air_data(air_data, text, length);
+        if ((text_length != expected_length) || (memcmp(text, expected, length + 1u) != 0))
+        {
+            printf("type %d, value %.9g: differs when truncated to %zu bytes\n", (int)air_data->type,
+                   (double)air_data->value, length);
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Compare the text of one message with the reference text, print the first difference */
+static bool same_message(const adc_rs485_msg_t *msg, const char *expected)
+{
+    char text[PRINT_MESSAGE_LENGTH + 1];
+    size_t length = print_format_message(msg, text);
+
+    text[length] = '\0';
+    if ((length != strlen(expected)) || (strcmp(text, expected) != 0))
+    {
+        printf("message type %d: <%s> instead of <%s>\n", (int)msg->msg_type, text, expected);
+        return false;
+    }
+    return true;
+}
+
+/** Compare the texts of the statuses, the errors and the air data with their end of line */
+static bool same_messages(uint64_t *rng)
+{
+    char expected[TEXT_LENGTH];
+    adc_rs485_msg_t msg;
+    bool passed = true;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_type = RS485_ERROR;
+    passed = same_message(&msg, "\nError decoding the message! \n\n");
+
+    for (uint32_t i = 0; (i < 4096) && passed; i++)
+    {
+        uint16_t status = (i < 2) ? (uint16_t)(0xFFFFu * i) : (uint16_t)random_next(rng);
+
+        msg.msg_type = RS485_RETURNED_STATUS_GEN;
+        msg.gen_status.number = status;
+        snprintf(expected, sizeof(expected), "General status = 0x%04X \n\n", status);
+        passed = same_message(&msg, expected);
+
+        msg.msg_type = RS485_RETURNED_STATUS_HTR;
+        msg.htr_status.number = status;
+        snprintf(expected, sizeof(expected), "Heater status = 0x%04X \n\n", status);
+        passed = passed && same_message(&msg, expected);
+    }
+
+    for (uint32_t type = 0; (type < RS485_DATA_NOT_VALID) && passed; type++)
+    {
+        msg.msg_type = RS485_RETURNED_DATA;
+        msg.air_data = (air_data_t){.type = (data_type_t)type, .value = -FLT_MAX, .flag = FLAG_INVALID_POS};
+        if (reference_format(&msg.air_data, expected, sizeof(expected)) > 0)
+        {
+            strcat(expected, "\n");
+        }
+        passed = same_message(&msg, expected);
+    }
+
+    // Nothing is printed for a type of data that is not valid
+    msg.air_data.type = RS485_DATA_NOT_VALID;
+    return passed && same_message(&msg, "");
+}
+
+int main(void)
+{
+    uint64_t rng = 0x5EED0025u;
+    uint64_t compared = 0;
+    bool passed = same_messages(&rng);
+
+    for (uint32_t type = 0; (type < RS485_DATA_NOT_VALID) && passed; type++)
+    {
+        for (uint32_t i = 0; (i < VALUE_COUNT) && passed; i++)
+        {
+            air_data_t air_data = {.type = (data_type_t)type, .value = test_value(&rng, i), .flag = (flag_t)(i % 6u)};
+
+            passed = same_air_data(&air_data, (i % 64u) == 0);
+            compared++;
+        }
+    }
+
+    printf("test_print_msg: %s, %llu values compared\n", passed ? "passed" : "FAILED", (unsigned long long)compared);
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,301 @@
+/*
+ * 2023 (c) Simtec AG
+ * All rights reserved
+ *
+ * Verify the rows computed by adc_resample.c from messages with synthetic timestamps: the instants
+ * of the rows, the labels held and interpolated, the worst flag of an interpolation across a value
+ * that is not valid, a history shorter than the delay falling back to the oldest value kept, the
+ * labels invalidated once stale, and the rows computed only once the delay has elapsed.
+ *
+ * Example code only. Use at own risk.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Simtec AG has no obligation to provide maintenance, support,
+ * updates, enhancements, or modifications.
+ */
+
+#include "adc_event.h"
+#include "adc_resample.h"
+#include "adc_rs485_decoder.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** One millisecond in nanoseconds, the unit of the synthetic timestamps */
+#define MS 1000000ull
+
+/** Maximum number of rows computed at once */
+#define MAX_ROWS 64
+
+/** Number of rows checked so far */
+static uint32_t rows_checked;
+
+/** Add a data message received at a time */
+static void add_data(adc_resampler_t *resampler, data_type_t type, uint64_t time_ns, float value, flag_t flag)
+{
+    adc_event_t event;
+
+    memset(&event, 0, sizeof(event));
+    event.timestamp_ns = time_ns;
+    event.msg_type = (uint8_t)RS485_RETURNED_DATA;
+    event.data_type = (uint8_t)type;
+    event.value = value;
+    event.flag = (uint8_t)flag;
+    adc_resampler_add(resampler, &event);
+}
+
+/** Add a status message received at a time */
+static void add_status(adc_resampler_t *resampler, rs485_msg_type_t msg_type, uint64_t time_ns, uint16_t status)
+{
+    adc_event_t event;
+
+    memset(&event, 0, sizeof(event));
+    event.timestamp_ns = time_ns;
+    event.msg_type = (uint8_t)msg_type;
+    event.data_type = (uint8_t)RS485_DATA_NOT_VALID;
+    event.status = status;
+    adc_resampler_add(resampler, &event);
+}
+
+/** Compute exactly one row when polled at a time, print why not */
+static bool poll_one(const char *name, adc_resampler_t *resampler, uint64_t now_ns, adc_resample_row_t *row)
+{
+    adc_resample_row_t rows[MAX_ROWS];
+    size_t count = adc_resampler_poll(resampler, now_ns, rows, MAX_ROWS);
+
+    if (count != 1)
+    {
+        printf("%s: %zu rows computed at %llu ms instead of 1\n", name, count, (unsigned long long)(now_ns / MS));
+        return false;
+    }
+    *row = rows[0];
+    rows_checked++;
+    return true;
+}
+
+/** Check the instant and one label of a row, print the difference */
+static bool check_label(const char *name, const adc_resample_row_t *row, uint64_t time_ns, data_type_t type, bool present,
+                        float value, flag_t flag)
+{
+    bool is_present = ((row->present >> type) & 1u) != 0;
+
+    if ((row->time_ns != time_ns) || (is_present != present) ||
+        (present && ((row->values[type] != value) || (row->flags[type] != (uint8_t)flag))))
+    {
+        printf("%s: row at %llu ms, label %d present %d value %g flag %u instead of row at %llu ms present %d value %g flag %u\n",
+               name, (unsigned long long)(row->time_ns / MS), (int)type, (int)is_present, (double)row->values[type],
+               (unsigned)row->flags[type], (unsigned long long)(time_ns / MS), (int)present, (double)value, (unsigned)flag);
+        return false;
+    }
+    return true;
+}
+
+/** Rows at the multiples of the period after the first message, held labels and statuses */
+static bool test_hold(void)
+{
+    adc_resampler_t resampler;
+    adc_resample_row_t row;
+    bool passed;
+
+    adc_resampler_init(&resampler, 3, 10 * MS, 0);
+    add_data(&resampler, RS485_QC, 13 * MS, 100.0f, FLAG_VALID);
+    add_data(&resampler, RS485_PS, 17 * MS, 90000.0f, FLAG_RANGE_ABOVE);
+    add_status(&resampler, RS485_RETURNED_STATUS_GEN, 18 * MS, 0x1234);
+    add_data(&resampler, RS485_QC, 23 * MS, 200.0f, FLAG_VALID);
+
+    // The first row is at 20 ms, computed one period later
+    passed = poll_one("hold", &resampler, 30 * MS, &row) && check_label("hold", &row, 20 * MS, RS485_QC, true, 100.0f, FLAG_VALID) &&
+             check_label("hold", &row, 20 * MS, RS485_PS, true, 90000.0f, FLAG_RANGE_ABOVE) &&
+             check_label("hold", &row, 20 * MS, RS485_TAS, false, 0.0f, FLAG_VALID);
+    if (passed && ((row.port != 3) || row.valid || (row.gen_status != 0x1234) ||
+                   ((row.present & (1ull << ADC_RESAMPLE_GEN_STATUS)) == 0) || ((row.present & (1ull << ADC_RESAMPLE_HTR_STATUS)) != 0)))
+    {
+        printf("hold: port, validity or statuses of the row differ\n");
+        passed = false;
+    }
+
+    passed = passed && poll_one("hold", &resampler, 40 * MS, &row) &&
+             check_label("hold", &row, 30 * MS, RS485_QC, true, 200.0f, FLAG_VALID);
+    return passed;
+}
+
+/** Linear interpolation, its worst flag, and the labels held without a value after the instant */
+static bool test_linear(void)
+{
+    adc_resampler_t resampler;
+    adc_resample_row_t row;
+    bool passed;
+
+    adc_resampler_init(&resampler, 0, 10 * MS, 0);
+    adc_resampler_set_method(&resampler, RS485_QC, ADC_RESAMPLE_LINEAR);
+    adc_resampler_set_method(&resampler, RS485_PS, ADC_RESAMPLE_LINEAR);
+    adc_resampler_set_method(&resampler, RS485_AOA, ADC_RESAMPLE_LINEAR);
+    adc_resampler_set_method(&resampler, RS485_AOS, ADC_RESAMPLE_LINEAR);
+    add_data(&resampler, RS485_QC, 5 * MS, 0.0f, FLAG_VALID);
+    add_data(&resampler, RS485_PS, 5 * MS, 10.0f, FLAG_VALID);
+    add_data(&resampler, RS485_AOA, 5 * MS, 10.0f, FLAG_INVALID_POS);
+    add_data(&resampler, RS485_AOS, 8 * MS, 1.0f, FLAG_VALID);
+    add_data(&resampler, RS485_QC, 15 * MS, 100.0f, FLAG_VALID);
+    add_data(&resampler, RS485_PS, 13 * MS, 50.0f, FLAG_INVALID);
+    add_data(&resampler, RS485_AOA, 15 * MS, 20.0f, FLAG_VALID);
+
+    // Row at 10 ms: Qc halfway, Ps across the invalid value after the instant, AoA across the
+    // invalid value before, AoS without a value after the instant within the delay
+    passed = poll_one("linear", &resampler, 20 * MS, &row) && check_label("linear", &row, 10 * MS, RS485_QC, true, 50.0f, FLAG_VALID) &&
+             check_label("linear", &row, 10 * MS, RS485_PS, true, 35.0f, FLAG_INVALID) &&
+             check_label("linear", &row, 10 * MS, RS485_AOA, true, 15.0f, FLAG_INVALID_POS) &&
+             check_label("linear", &row, 10 * MS, RS485_AOS, true, 1.0f, FLAG_VALID);
+    if (passed && row.valid)
+    {
+        printf("linear: a row interpolated across values that are not valid is valid\n");
+        passed = false;
+    }
+
+    // Two values at the same time, the latest is held
+    add_data(&resampler, RS485_AOS, 25 * MS, 2.0f, FLAG_VALID);
+    add_data(&resampler, RS485_AOS, 25 * MS, 3.0f, FLAG_VALID);
+    passed = passed && poll_one("linear", &resampler, 30 * MS, &row) &&
+             check_label("linear", &row, 20 * MS, RS485_QC, true, 100.0f, FLAG_VALID) &&
+             check_label("linear", &row, 20 * MS, RS485_AOS, true, 1.0f + (2.0f - 1.0f) * (12.0f / 17.0f), FLAG_VALID);
+    passed = passed && poll_one("linear", &resampler, 40 * MS, &row) &&
+             check_label("linear", &row, 30 * MS, RS485_AOS, true, 3.0f, FLAG_VALID);
+    return passed;
+}
+
+/** A label sent more often than the history holds during the delay, computed from the oldest value kept */
+static bool test_short_history(void)
+{
+    adc_resampler_t resampler;
+    adc_resample_row_t row;
+    bool passed;
+
+    adc_resampler_init(&resampler, 0, 10 * MS, 0);
+    adc_resampler_set_delay(&resampler, 100 * MS);
+    adc_resampler_set_method(&resampler, RS485_QC, ADC_RESAMPLE_LINEAR);
+
+    // Qc every millisecond from 1 ms, Ps only after the first row
+    for (uint64_t time = 1; time <= 110; time++)
+    {
+        add_data(&resampler, RS485_QC, time * MS, (float)time, ((time & 1u) != 0) ? FLAG_VALID : FLAG_RANGE_BELLOW);
+    }
+    add_data(&resampler, RS485_PS, 12 * MS, 1.0f, FLAG_VALID);
+
+    // Qc of 95 ms is the oldest of the 16 values kept, held without interpolation
+    passed = poll_one("history", &resampler, 110 * MS, &row) &&
+             check_label("history", &row, 10 * MS, RS485_QC, true, 95.0f, FLAG_VALID) &&
+             check_label("history", &row, 10 * MS, RS485_PS, false, 0.0f, FLAG_VALID);
+
+    // One value more than the history after the instant, the oldest of them is used
+    adc_resampler_init(&resampler, 0, 10 * MS, 0);
+    adc_resampler_set_delay(&resampler, 20 * MS);
+    add_data(&resampler, RS485_QC, 1 * MS, 1.0f, FLAG_VALID);
+    for (uint64_t time = 11; time <= 26; time++)
+    {
+        add_data(&resampler, RS485_QC, time * MS, (float)time, FLAG_VALID);
+    }
+    passed = passed && poll_one("history", &resampler, 30 * MS, &row) &&
+             check_label("history", &row, 10 * MS, RS485_QC, true, 11.0f, FLAG_VALID);
+
+    // Only 15 values are received during a shorter delay, the row is exact
+    adc_resampler_init(&resampler, 0, 10 * MS, 0);
+    adc_resampler_set_delay(&resampler, 15 * MS);
+    adc_resampler_set_method(&resampler, RS485_QC, ADC_RESAMPLE_LINEAR);
+    for (uint64_t time = 1; time <= 25; time++)
+    {
+        add_data(&resampler, RS485_QC, time * MS, (float)time, FLAG_VALID);
+    }
+    passed = passed && poll_one("history", &resampler, 25 * MS, &row) &&
+             check_label("history", &row, 10 * MS, RS485_QC, true, 10.0f, FLAG_VALID);
+    return passed;
+}
+
+/** A label not received for longer than the stale time is invalid, until it is received again */
+static bool test_stale(void)
+{
+    adc_resampler_t resampler;
+    adc_resample_row_t rows[MAX_ROWS];
+    bool passed = true;
+
+    adc_resampler_init(&resampler, 0, 10 * MS, 25 * MS);
+    adc_resampler_set_method(&resampler, RS485_PS, ADC_RESAMPLE_LINEAR);
+    add_data(&resampler, RS485_QC, 5 * MS, 1.0f, FLAG_VALID);
+    add_data(&resampler, RS485_PS, 5 * MS, 1.0f, FLAG_VALID);
+    add_data(&resampler, RS485_QC, 55 * MS, 2.0f, FLAG_VALID);
+    add_data(&resampler, RS485_PS, 55 * MS, 2.0f, FLAG_VALID);
+
+    // Rows at 10 to 60 ms; 30 ms is exactly the stale time after the value of 5 ms
+    size_t count = adc_resampler_poll(&resampler, 70 * MS, rows, MAX_ROWS);
+    static const flag_t EXPECTED_FLAG[6] = {FLAG_VALID, FLAG_VALID, FLAG_VALID, FLAG_INVALID, FLAG_INVALID, FLAG_VALID};
+    if (count != 6)
+    {
+        printf("stale: %zu rows instead of 6\n", count);
+        return false;
+    }
+    for (size_t i = 0; (i < count) && passed; i++)
+    {
+        uint64_t time = (10 + 10 * i) * MS;
+        float held = (i < 5) ? 1.0f : 2.0f;
+        float interpolated = (i < 5) ? 1.0f + (float)((double)(time - 5 * MS) / (double)(50 * MS)) : 2.0f;
+        passed = check_label("stale", &rows[i], time, RS485_QC, true, held, EXPECTED_FLAG[i]) &&
+                 check_label("stale", &rows[i], time, RS485_PS, true, interpolated, EXPECTED_FLAG[i]);
+        if (passed && (rows[i].valid != (EXPECTED_FLAG[i] == FLAG_VALID)))
+        {
+            printf("stale: row at %llu ms valid %d\n", (unsigned long long)(time / MS), (int)rows[i].valid);
+            passed = false;
+        }
+        rows_checked++;
+    }
+    return passed;
+}
+
+/** The rows are computed once their delay has elapsed, in batches when polled late, and at the end */
+static bool test_delay(void)
+{
+    adc_resampler_t resampler;
+    adc_resample_row_t rows[MAX_ROWS];
+    adc_resample_row_t row;
+    bool passed;
+
+    // Nothing before the first message
+    adc_resampler_init(&resampler, 0, 10 * MS, 0);
+    passed = (adc_resampler_poll(&resampler, 1000 * MS, rows, MAX_ROWS) == 0) && (adc_resampler_flush(&resampler, rows, MAX_ROWS) == 0);
+
+    adc_resampler_set_delay(&resampler, 35 * MS);
+    add_data(&resampler, RS485_QC, 2 * MS, 1.0f, FLAG_VALID);
+    passed = passed && (adc_resampler_poll(&resampler, 45 * MS - 1, rows, MAX_ROWS) == 0) &&
+             poll_one("delay", &resampler, 45 * MS, &row) && check_label("delay", &row, 10 * MS, RS485_QC, true, 1.0f, FLAG_VALID) &&
+             (adc_resampler_poll(&resampler, 55 * MS - 1, rows, MAX_ROWS) == 0);
+
+    // Polled late, the rows come in batches limited by the array
+    passed = passed && (adc_resampler_poll(&resampler, 135 * MS, rows, 4) == 4) && (rows[3].time_ns == 50 * MS) &&
+             (adc_resampler_poll(&resampler, 135 * MS, rows, MAX_ROWS) == 5) && (rows[4].time_ns == 100 * MS);
+
+    // Back to one period
+    adc_resampler_set_delay(&resampler, 0);
+    passed = passed && (adc_resampler_poll(&resampler, 120 * MS - 1, rows, MAX_ROWS) == 0) && poll_one("delay", &resampler, 120 * MS, &row) &&
+             (row.time_ns == 110 * MS);
+
+    // At the end of the messages, the rows up to the latest one
+    add_data(&resampler, RS485_QC, 143 * MS, 2.0f, FLAG_VALID);
+    passed = passed && (adc_resampler_flush(&resampler, rows, MAX_ROWS) == 3) && (rows[2].time_ns == 140 * MS) &&
+             check_label("delay", &rows[2], 140 * MS, RS485_QC, true, 1.0f, FLAG_VALID);
+    if (!passed)
+    {
+        printf("delay: rows computed before their delay or missing\n");
+    }
+    rows_checked += 14;
+    return passed;
+}
+
+int main(void)
+{
+    bool passed = test_hold() && test_linear() && test_short_history() && test_stale() && test_delay();
+
+    printf("test_resample: %s, %u rows checked\n", passed ? "passed" : "FAILED", rows_checked);
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
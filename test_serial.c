@@ -0,0 +1,265 @@
+/*
+ * 2023 (c) Simtec AG
+ * All rights reserved
+ *
+ * Verify serial_posix.c on the slave side of a pseudo-terminal: serial_open() shall configure the
+ * port in raw mode, 8N1, at a baudrate termios doesn't define. serial_read() shall wait for the
+ * read timeout when nothing is received, return the bytes written to the master side unchanged
+ * and in bulk, without echoing them, and fail once the master side has been closed.
+ *
+ * Example code only. Use at own risk.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Simtec AG has no obligation to provide maintenance, support,
+ * updates, enhancements, or modifications.
+ */
+
+#define _GNU_SOURCE
+
+#include "serial.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// termios2 to read back the baudrate, it can't be mixed with the glibc <termios.h>
+#include <asm/termbits.h>
+#include <sys/ioctl.h>
+
+/** Baudrate of the port, none of the speeds termios defines */
+#define BAUDRATE 250000u
+
+/** Read timeout of the port */
+#define TIMEOUT_MS 50u
+
+/** Number of bytes written to the master side at once, read back in bulk */
+#define ROUND_LENGTH 1000u
+
+/** Number of rounds written and read back */
+#define ROUND_COUNT 64u
+
+/** xorshift64* pseudo-random generator, the bytes are identical at every execution */
+static uint64_t random_next(uint64_t *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ull;
+}
+
+/** Monotonic time in milliseconds */
+static uint64_t now_ms(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000u + (uint64_t)now.tv_nsec / 1000000u;
+}
+
+/** Create a pseudo-terminal, return its master side and the name of its slave side */
+static int open_master(char name[], size_t length)
+{
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+
+    if ((fd >= 0) && ((grantpt(fd) != 0) || (unlockpt(fd) != 0) || (ptsname_r(fd, name, length) != 0)))
+    {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+/** The slave side is in raw mode, 8N1, at the baudrate of the port */
+static bool check_configuration(const char *name)
+{
+    struct termios2 tio;
+    int fd = open(name, O_RDWR | O_NOCTTY);
+    bool configured = (fd >= 0) && (ioctl(fd, TCGETS2, &tio) == 0);
+
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    if (!configured)
+    {
+        printf("the configuration of %s couldn't be read\n", name);
+        return false;
+    }
+    if (((tio.c_cflag & CBAUD) != BOTHER) || (tio.c_ospeed != BAUDRATE) || (tio.c_ispeed != BAUDRATE))
+    {
+        printf("baudrate %u/%u instead of %u\n", (unsigned)tio.c_ospeed, (unsigned)tio.c_ispeed, BAUDRATE);
+        return false;
+    }
+    if (((tio.c_cflag & (CSIZE | PARENB | CSTOPB | CRTSCTS)) != CS8) || ((tio.c_cflag & (CREAD | CLOCAL)) != (CREAD | CLOCAL)) ||
+        ((tio.c_lflag & (ECHO | ECHONL | ICANON | ISIG | IEXTEN)) != 0) || ((tio.c_oflag & OPOST) != 0) ||
+        ((tio.c_iflag & (ISTRIP | INLCR | IGNCR | ICRNL | IXON | IXOFF)) != 0) || (tio.c_cc[VMIN] != 1) || (tio.c_cc[VTIME] != 0))
+    {
+        printf("not configured in raw mode, 8N1\n");
+        return false;
+    }
+    return true;
+}
+
+/** Nothing received: serial_read() returns no byte once the timeout has elapsed */
+static bool check_timeout(serial_port_t *serial)
+{
+    uint8_t data[16];
+    size_t length = 1;
+    uint64_t start_ms = now_ms();
+    int32_t result = serial_read(serial, data, sizeof(data), &length);
+    uint64_t elapsed_ms = now_ms() - start_ms;
+
+    // poll() may round the timeout to the tick of the kernel
+    if ((result != EXIT_SUCCESS) || (length != 0) || (elapsed_ms + 5u < TIMEOUT_MS) || (elapsed_ms > 20u * TIMEOUT_MS))
+    {
+        printf("timeout: result %d, %zu bytes after %llu ms instead of none after %u ms\n", (int)result, length,
+               (unsigned long long)elapsed_ms, TIMEOUT_MS);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Write rounds of random bytes to the master side, the control characters of a terminal included,
+ * and read them back. Every read shall return all the bytes available, up to the buffer.
+ */
+static bool check_bulk_read(serial_port_t *serial, int master, uint64_t *reads)
+{
+    static uint8_t written[ROUND_LENGTH];
+    static uint8_t received[ROUND_LENGTH];
+    uint64_t rng = 0x5EED0005u;
+
+    for (uint32_t round = 0; round < ROUND_COUNT; round++)
+    {
+        size_t total = 0;
+
+        for (size_t i = 0; i < ROUND_LENGTH; i++)
+        {
+            written[i] = (uint8_t)(random_next(&rng) >> 56);
+        }
+        if (write(master, written, ROUND_LENGTH) != (ssize_t)ROUND_LENGTH)
+        {
+            printf("round %u: the master side couldn't be written\n", round);
+            return false;
+        }
+
+        while (total < ROUND_LENGTH)
+        {
+            size_t length = 0;
+            if ((serial_read(serial, &received[total], ROUND_LENGTH - total, &length) != EXIT_SUCCESS) || (length == 0))
+            {
+                printf("round %u: %zu bytes received out of %u\n", round, total, ROUND_LENGTH);
+                return false;
+            }
+            total += length;
+            (*reads)++;
+        }
+        if (memcmp(written, received, ROUND_LENGTH) != 0)
+        {
+            printf("round %u: the bytes received differ from the bytes written\n", round);
+            return false;
+        }
+    }
+
+    // The bytes are read in bulk, not one per read
+    if (*reads > ROUND_COUNT * 8u)
+    {
+        printf("%llu reads for %u bytes\n", (unsigned long long)*reads, ROUND_COUNT * ROUND_LENGTH);
+        return false;
+    }
+    return true;
+}
+
+/** The slave side doesn't echo the bytes received back to the master side */
+static bool check_no_echo(int master)
+{
+    uint8_t data[16];
+    int flags = fcntl(master, F_GETFL);
+    ssize_t echoed;
+
+    fcntl(master, F_SETFL, flags | O_NONBLOCK);
+    echoed = read(master, data, sizeof(data));
+    fcntl(master, F_SETFL, flags);
+    if (echoed >= 0)
+    {
+        printf("%zd bytes echoed to the master side\n", echoed);
+        return false;
+    }
+    return true;
+}
+
+/** serial_get_data() reads one byte */
+static bool check_get_data(serial_port_t *serial, int master)
+{
+    static const char BYTES[] = {'\r', '\n'};
+    char data = 0;
+
+    if (write(master, BYTES, sizeof(BYTES)) != (ssize_t)sizeof(BYTES))
+    {
+        return false;
+    }
+    for (size_t i = 0; i < sizeof(BYTES); i++)
+    {
+        if ((serial_get_data(serial, &data) != EXIT_SUCCESS) || (data != BYTES[i]))
+        {
+            printf("serial_get_data: 0x%02X instead of 0x%02X\n", (unsigned)(uint8_t)data, (unsigned)(uint8_t)BYTES[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(void)
+{
+    serial_port_t serial = {.baudrate = BAUDRATE, .read_timeout_ms = TIMEOUT_MS, .fd = -1};
+    uint64_t reads = 0;
+    uint8_t data[16];
+    size_t length = 0;
+    int master = open_master(serial.com_port, sizeof(serial.com_port));
+    bool passed = (master >= 0);
+
+    if (!passed)
+    {
+        printf("no pseudo-terminal: %s\n", strerror(errno));
+    }
+    if (passed && (serial_open(&serial) != EXIT_SUCCESS))
+    {
+        printf("%s couldn't be opened at %u bauds: %s\n", serial.com_port, BAUDRATE, strerror(errno));
+        passed = false;
+    }
+
+    passed = passed && check_configuration(serial.com_port);
+    passed = passed && check_timeout(&serial);
+    passed = passed && check_bulk_read(&serial, master, &reads);
+    passed = passed && check_no_echo(master);
+    passed = passed && check_get_data(&serial, master);
+
+    // The master side closed, a read fails instead of waiting for the timeout again and again
+    if (master >= 0)
+    {
+        close(master);
+    }
+    if (passed && (serial_read(&serial, data, sizeof(data), &length) != EXIT_FAILURE))
+    {
+        printf("a read succeeded after the master side has been closed\n");
+        passed = false;
+    }
+
+    if (passed && ((serial_close(&serial) != EXIT_SUCCESS) || (serial.fd != -1) || (serial_close(&serial) != EXIT_FAILURE)))
+    {
+        printf("serial_close: the port isn't closed once\n");
+        passed = false;
+    }
+    serial_close(&serial);
+
+    printf("test_serial: %s, %llu reads for %u bytes at %u bauds\n", passed ? "passed" : "FAILED", (unsigned long long)reads,
+           ROUND_COUNT * ROUND_LENGTH, BAUDRATE);
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
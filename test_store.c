@@ -0,0 +1,465 @@
+/*
+ * 2023 (c) Simtec AG
+ * All rights reserved
+ *
+ * Verify that a store file written by adc_store.c gives back exactly the samples added to it: the
+ * timestamps rounded down to the resolution of the file, the bits of the values, not a number,
+ * infinite and negative zero included, and the flags. The timestamps are jittered, repeated and
+ * jump over minutes and days, and runs of flags span several blocks. The samples are read back per
+ * stream as --labels does, within ranges of time as --from and --to do and within ranges of values,
+ * from the index of a closed file and by walking the blocks of a file truncated without its index.
+ *
+ * Example code only. Use at own risk.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * Simtec AG has no obligation to provide maintenance, support,
+ * updates, enhancements, or modifications.
+ */
+
+#include "adc_event.h"
+#include "adc_rs485_decoder.h"
+#include "adc_store.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/** Number of messages added to the store file */
+#define EVENT_COUNT 200000
+
+/** Number of ports of the store file */
+#define PORT_COUNT 2
+
+/** Number of random ranges read back from every file */
+#define QUERY_COUNT 200
+
+/** Number of truncations of the file read back */
+#define TRUNCATION_COUNT 20
+
+/** Values stored differently from a slowly changing value */
+static const float SPECIAL_VALUE[] = {0.0f, -0.0f, INFINITY, -INFINITY, NAN, -NAN, 1e-45f, -1e-45f, 3.4028235e38f, 1.0f};
+
+/** Messages added to the store file and their timestamps once stored */
+static adc_event_t events[EVENT_COUNT];
+static uint64_t stored_ns[EVENT_COUNT];
+
+/** xorshift64* pseudo-random generator, the files are identical at every execution */
+static uint64_t random_next(uint64_t *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ull;
+}
+
+/** Random number between 0 and range - 1 */
+static uint32_t random_below(uint64_t *rng, uint32_t range)
+{
+    return (uint32_t)((random_next(rng) >> 32) % range);
+}
+
+/** Stream of a message, ADC_STORE_STREAMS if it is not stored */
+static uint32_t event_stream(const adc_event_t *event)
+{
+    switch (event->msg_type)
+    {
+    case RS485_RETURNED_DATA:
+        return (event->data_type < RS485_DATA_NOT_VALID) ? event->data_type : ADC_STORE_STREAMS;
+    case RS485_RETURNED_STATUS_GEN:
+        return ADC_STORE_GEN_STATUS;
+    case RS485_RETURNED_STATUS_HTR:
+        return ADC_STORE_HTR_STATUS;
+    default:
+        return ADC_STORE_STREAMS;
+    }
+}
+
+/** Value a message is filtered on, the status word of a status */
+static float event_value(const adc_event_t *event)
+{
+    return (event->msg_type == RS485_RETURNED_DATA) ? event->value : (float)event->status;
+}
+
+/** Time between two messages of a port: the period with jitter, repeated times and long gaps */
+static uint64_t next_delta(uint64_t *rng)
+{
+    uint32_t kind = random_below(rng, 1000);
+
+    if (kind < 50)
+    {
+        return 0;
+    }
+    if (kind < 100)
+    {
+        // Below the resolution of the file
+        return random_below(rng, 1000);
+    }
+    if (kind < 102)
+    {
+        // Longer than a block may last
+        return 90ull * 1000000000u + random_below(rng, 1000000000u);
+    }
+    if (kind < 103)
+    {
+        // Days, a difference of deltas that takes the longest code
+        return (1ull << 48) + random_next(rng) % (1ull << 40);
+    }
+    return 200000u + random_below(rng, 20000);
+}
+
+/** Next value of a label: repeated, slowly changing, special or random bits */
+static uint32_t next_bits(uint64_t *rng, uint32_t previous)
+{
+    uint32_t kind = random_below(rng, 100);
+    float value;
+
+    if (kind < 30)
+    {
+        return previous;
+    }
+    if (kind < 70)
+    {
+        return previous ^ (random_below(rng, 1u << 12) << random_below(rng, 8));
+    }
+    if (kind < 85)
+    {
+        value = SPECIAL_VALUE[random_below(rng, sizeof(SPECIAL_VALUE) / sizeof(SPECIAL_VALUE[0]))];
+        memcpy(&previous, &value, sizeof(previous));
+        return previous;
+    }
+    return (uint32_t)random_next(rng);
+}
+
+/** Fill the messages of every port, stored in the order of their port's clock */
+static void generate_events(uint64_t *rng)
+{
+    uint64_t time_ns[PORT_COUNT];
+    uint32_t bits[PORT_COUNT][ADC_STORE_STREAMS];
+    uint8_t flag[PORT_COUNT][RS485_DATA_NOT_VALID];
+    uint32_t run[PORT_COUNT][RS485_DATA_NOT_VALID];
+
+    memset(bits, 0, sizeof(bits));
+    memset(run, 0, sizeof(run));
+    for (uint32_t port = 0; port < PORT_COUNT; port++)
+    {
+        time_ns[port] = 1000000000000ull * (port + 1) + random_below(rng, 1000000);
+    }
+
+    for (size_t i = 0; i < EVENT_COUNT; i++)
+    {
+        adc_event_t *event = &events[i];
+        uint32_t port = random_below(rng, PORT_COUNT);
+        uint32_t kind = random_below(rng, 100);
+
+        time_ns[port] += next_delta(rng);
+        memset(event, 0, sizeof(*event));
+        event->timestamp_ns = time_ns[port];
+        event->port = (uint8_t)port;
+
+        if (kind < 4)
+        {
+            // Never stored
+            event->msg_type = (kind < 2) ? (uint8_t)RS485_ERROR : (uint8_t)RS485_RETURNED_DATA;
+            event->data_type = (uint8_t)RS485_DATA_NOT_VALID;
+            event->status = (uint32_t)random_next(rng);
+        }
+        else if (kind < 8)
+        {
+            // Status words, often repeated
+            uint32_t stream = (kind < 6) ? ADC_STORE_GEN_STATUS : ADC_STORE_HTR_STATUS;
+            if (random_below(rng, 4) == 0)
+            {
+                bits[port][stream] = random_below(rng, 0x10000u);
+            }
+            event->msg_type = (stream == ADC_STORE_GEN_STATUS) ? (uint8_t)RS485_RETURNED_STATUS_GEN : (uint8_t)RS485_RETURNED_STATUS_HTR;
+            event->data_type = (uint8_t)RS485_DATA_NOT_VALID;
+            event->status = bits[port][stream];
+        }
+        else
+        {
+            // Half of the labels are Qc and Ps, so that they fill many blocks
+            uint32_t type = (kind < 54) ? (kind & 1u) : random_below(rng, RS485_DATA_NOT_VALID);
+            if (run[port][type] == 0)
+            {
+                flag[port][type] = (uint8_t)random_below(rng, 6);
+                run[port][type] = (random_below(rng, 8) == 0) ? 1 + random_below(rng, 5000) : 1 + random_below(rng, 10);
+            }
+            run[port][type]--;
+            bits[port][type] = next_bits(rng, bits[port][type]);
+            event->msg_type = (uint8_t)RS485_RETURNED_DATA;
+            event->data_type = (uint8_t)type;
+            event->flag = flag[port][type];
+            event->status = bits[port][type];
+        }
+    }
+}
+
+/** Returns whether a sample read back is the message added, print the difference if not */
+static bool same_event(const adc_event_t *expected, uint64_t expected_ns, const adc_event_t *read)
+{
+    bool data = (expected->msg_type == RS485_RETURNED_DATA);
+
+    if ((read->msg_type != expected->msg_type) || (read->port != expected->port) || (read->timestamp_ns != expected_ns) ||
+        (read->status != expected->status) || (data && ((read->data_type != expected->data_type) || (read->flag != expected->flag))))
+    {
+        printf("port %u stream %u: type %u time %llu bits 0x%08X flag %u instead of type %u time %llu bits 0x%08X flag %u\n",
+               (unsigned)expected->port, event_stream(expected), (unsigned)read->msg_type,
+               (unsigned long long)read->timestamp_ns, read->status, (unsigned)read->flag, (unsigned)expected->msg_type,
+               (unsigned long long)expected_ns, expected->status, (unsigned)expected->flag);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Read one stream within ranges of time and values, and compare with the messages added in these
+ * ranges. A truncated file may return only the first of them.
+ */
+static bool same_stream(const adc_store_reader_t *reader, uint32_t port, uint32_t stream, uint64_t from_ns, uint64_t to_ns,
+                        float min, float max, bool truncated)
+{
+    adc_store_cursor_t cursor;
+    adc_event_t read;
+    bool filtered = (min > -INFINITY) || (max < INFINITY);
+    size_t i = 0;
+
+    adc_store_cursor_init(&cursor, reader, (uint8_t)port, (uint8_t)stream, from_ns, to_ns, min, max);
+    while (adc_store_cursor_next(&cursor, &read))
+    {
+        while ((i < EVENT_COUNT) &&
+               ((events[i].port != port) || (event_stream(&events[i]) != stream) || (stored_ns[i] < from_ns) ||
+                (stored_ns[i] > to_ns) ||
+                (filtered && !((event_value(&events[i]) >= min) && (event_value(&events[i]) <= max)))))
+        {
+            i++;
+        }
+        if (i == EVENT_COUNT)
+        {
+            printf("port %u stream %u: more samples than added\n", port, stream);
+            return false;
+        }
+        if (!same_event(&events[i], stored_ns[i], &read))
+        {
+            return false;
+        }
+        i++;
+    }
+
+    // Nothing has been skipped
+    for (; (i < EVENT_COUNT) && !truncated; i++)
+    {
+        if ((events[i].port == port) && (event_stream(&events[i]) == stream) && (stored_ns[i] >= from_ns) &&
+            (stored_ns[i] <= to_ns) && (!filtered || ((event_value(&events[i]) >= min) && (event_value(&events[i]) <= max))))
+        {
+            printf("port %u stream %u: sample at %llu missing\n", port, stream, (unsigned long long)stored_ns[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Read every stream of a file, whole or truncated */
+static bool same_streams(const adc_store_reader_t *reader, bool truncated)
+{
+    bool passed = true;
+
+    for (uint32_t port = 0; port < PORT_COUNT; port++)
+    {
+        for (uint32_t stream = 0; (stream < ADC_STORE_STREAMS) && passed; stream++)
+        {
+            passed = same_stream(reader, port, stream, 0, UINT64_MAX, -INFINITY, INFINITY, truncated);
+        }
+    }
+    return passed;
+}
+
+/** Read random streams within random ranges of time and of values */
+static bool same_queries(uint64_t *rng, const adc_store_reader_t *reader)
+{
+    bool passed = true;
+
+    for (uint32_t query = 0; (query < QUERY_COUNT) && passed; query++)
+    {
+        uint32_t port = random_below(rng, PORT_COUNT);
+        uint32_t stream = (random_below(rng, 2) == 0) ? random_below(rng, 2) : random_below(rng, ADC_STORE_STREAMS);
+        uint64_t span = reader->last_ns - reader->first_ns;
+        uint64_t from_ns = reader->first_ns + random_next(rng) % (span + 1);
+        uint64_t to_ns = from_ns + random_next(rng) % (span / 8 + 1);
+        float min = -INFINITY;
+        float max = INFINITY;
+
+        if (query % 4 == 1)
+        {
+            // As --from and --to, whole seconds after the first message of the file
+            from_ns = reader->first_ns + (uint64_t)random_below(rng, 120) * 1000000000u;
+            to_ns = (random_below(rng, 2) == 0) ? UINT64_MAX : from_ns + (uint64_t)random_below(rng, 120) * 1000000000u;
+        }
+        else if (query % 4 == 2)
+        {
+            // Values within a range, one of its bounds infinite
+            from_ns = 0;
+            to_ns = UINT64_MAX;
+            min = (random_below(rng, 3) == 0) ? -INFINITY : (float)random_below(rng, 4096) - 2048.0f;
+            max = (min == -INFINITY) ? (float)random_below(rng, 4096) - 2048.0f : (random_below(rng, 2) == 0) ? INFINITY : min + 1e30f;
+        }
+        passed = same_stream(reader, port, stream, from_ns, to_ns, min, max, false);
+    }
+    return passed;
+}
+
+/** Write the first length bytes of a file into another one */
+static int32_t write_prefix(const uint8_t data[], size_t length, const char *path)
+{
+    FILE *file = fopen(path, "wb");
+
+    if (file == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    size_t written = fwrite(data, 1, length, file);
+    return ((fclose(file) == 0) && (written == length)) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/** Read back the file truncated without its index, and within its last blocks */
+static bool same_truncated(uint64_t *rng, const char *path, const char *truncated_path)
+{
+    adc_store_reader_t reader;
+    adc_store_trailer_t trailer;
+    bool passed = false;
+    FILE *file = fopen(path, "rb");
+    uint8_t *data = NULL;
+    long size = -1;
+
+    if ((file != NULL) && (fseek(file, 0, SEEK_END) == 0))
+    {
+        size = ftell(file);
+        data = (size > 0) ? malloc((size_t)size) : NULL;
+        rewind(file);
+    }
+    if ((data == NULL) || (fread(data, 1, (size_t)size, file) != (size_t)size))
+    {
+        printf("%s couldn't be read back\n", path);
+        size = -1;
+    }
+    if (file != NULL)
+    {
+        fclose(file);
+    }
+
+    // Without its index and trailer, all blocks are found by walking through them
+    if (size > (long)sizeof(trailer))
+    {
+        memcpy(&trailer, &data[(size_t)size - sizeof(trailer)], sizeof(trailer));
+        passed = (write_prefix(data, (size_t)trailer.offset, truncated_path) == EXIT_SUCCESS) &&
+                 (adc_store_reader_open(&reader, truncated_path) == EXIT_SUCCESS);
+        if (passed)
+        {
+            passed = (reader.scanned != NULL) && same_streams(&reader, false);
+            adc_store_reader_close(&reader);
+        }
+    }
+
+    // Cut anywhere, the complete blocks are read back
+    for (uint32_t i = 0; (i < TRUNCATION_COUNT) && passed; i++)
+    {
+        size_t length = sizeof(adc_store_header_t) + random_next(rng) % ((size_t)trailer.offset - sizeof(adc_store_header_t));
+        passed = (write_prefix(data, length, truncated_path) == EXIT_SUCCESS) &&
+                 (adc_store_reader_open(&reader, truncated_path) == EXIT_SUCCESS);
+        if (passed)
+        {
+            passed = same_streams(&reader, true);
+            adc_store_reader_close(&reader);
+        }
+    }
+
+    if (!passed)
+    {
+        printf("the file truncated without its index differs\n");
+    }
+    unlink(truncated_path);
+    free(data);
+    return passed;
+}
+
+/** Write all messages into a store file of a resolution, then read them back in every way */
+static bool same_file(uint64_t *rng, uint64_t resolution_ns)
+{
+    static const char *const DEVICES[PORT_COUNT] = {"/dev/ttyUSB0", "/dev/ttyUSB1"};
+    char path[] = "/tmp/test_store_XXXXXX";
+    char truncated_path[] = "/tmp/test_store_XXXXXX";
+    adc_store_writer_t writer;
+    adc_store_reader_t reader;
+    bool passed;
+    int fd = mkstemp(path);
+    int truncated_fd = mkstemp(truncated_path);
+
+    if ((fd < 0) || (truncated_fd < 0))
+    {
+        printf("temporary files couldn't be created\n");
+        return false;
+    }
+    close(fd);
+    close(truncated_fd);
+
+    // Some messages added one by one, the others in batches
+    passed = (adc_store_writer_open(&writer, path, DEVICES, PORT_COUNT, resolution_ns) == EXIT_SUCCESS);
+    for (size_t i = 0; (i < EVENT_COUNT) && passed;)
+    {
+        size_t count = 1 + random_below(rng, 64);
+        count = (count < EVENT_COUNT - i) ? count : EVENT_COUNT - i;
+        adc_store_writer_add(&writer, &events[i], count);
+        i += count;
+    }
+    passed = passed && (adc_store_writer_close(&writer) == EXIT_SUCCESS) && (adc_store_reader_open(&reader, path) == EXIT_SUCCESS);
+    if (!passed)
+    {
+        printf("%s couldn't be written and opened\n", path);
+        unlink(path);
+        unlink(truncated_path);
+        return false;
+    }
+
+    uint64_t first_ns = UINT64_MAX;
+    uint64_t last_ns = 0;
+    for (size_t i = 0; i < EVENT_COUNT; i++)
+    {
+        stored_ns[i] = events[i].timestamp_ns / resolution_ns * resolution_ns;
+        if (event_stream(&events[i]) < ADC_STORE_STREAMS)
+        {
+            first_ns = (stored_ns[i] < first_ns) ? stored_ns[i] : first_ns;
+            last_ns = (stored_ns[i] > last_ns) ? stored_ns[i] : last_ns;
+        }
+    }
+    if ((reader.first_ns != first_ns) || (reader.last_ns != last_ns) || (reader.scanned != NULL) ||
+        (reader.header.port_count != PORT_COUNT) || (strcmp(reader.header.devices[1], DEVICES[1]) != 0))
+    {
+        printf("header or index of %s differs\n", path);
+        passed = false;
+    }
+
+    passed = passed && same_streams(&reader, false) && same_queries(rng, &reader);
+    adc_store_reader_close(&reader);
+    passed = passed && same_truncated(rng, path, truncated_path);
+    unlink(path);
+    unlink(truncated_path);
+    return passed;
+}
+
+int main(void)
+{
+    uint64_t rng = 0x5EED0021u;
+    bool passed;
+
+    generate_events(&rng);
+    passed = same_file(&rng, ADC_STORE_DEFAULT_RESOLUTION_NS) && same_file(&rng, 1);
+
+    printf("test_store: %s, %u messages read back at a resolution of 1 us and 1 ns\n", passed ? "passed" : "FAILED",
+           (unsigned)EVENT_COUNT);
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}